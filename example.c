@@ -1,4 +1,5 @@
 #include "mfrc522.h"
+#include "mfrc522_idle.h"
 
 void main() {
     stdio_init_all();
@@ -7,10 +8,14 @@ void main() {
     uint8_t tag1[] = {0x93, 0xE3, 0x9A, 0x92};
 
     MFRC522Ptr_t mfrc = MFRC522_Init();
-    PCD_Init(mfrc, spi0);
+    StatusCode initStatus = PCD_Init(mfrc, spi0);
 
     sleep_ms(5000);
 
+    if (initStatus != STATUS_OK) {
+        printf("MFRC522 not found, check the wiring\n\r");
+    }
+
     // char test_result = PCD_SelfTest(mfrc);
 
     // if (test_result == 0) {
@@ -19,13 +24,40 @@ void main() {
     //     printf("Self Test: FAILED");
     // }
 
+    // Follow the card on the reader, it is only processed once on arrival
+    PICC_Tracker tracker;
+    PICC_TrackerInit(&tracker);
+
+    // Without a card the reader is parked and only wakes up four times a
+    // second for a single REQA
+    MFRC522_IdleConfig idleConfig;
+    MFRC522_IdleConfigInit(&idleConfig);
+    MFRC522_Idle idle;
+    MFRC522_IdleBegin(&idle, mfrc, &idleConfig);
+
+    printf("Waiting for card\n\r");
     while(1) {
-        //Wait for new card
-        printf("Waiting for card\n\r");
-        while(!PICC_IsNewCardPresent(mfrc));
-        //Select the card
-        printf("Selecting card\n\r");
-        PICC_ReadCardSerial(mfrc);
+        // Right after a departure the tracker itself looks for the PICC
+        // once more, it may only have been halted by a failed check
+        PICC_TrackerEvent event;
+        if (!tracker.present && !tracker.wakeup) {
+            if (MFRC522_IdleWaitForCard(&idle, 0) != IDLE_EVENT_CARD ||
+                !PICC_ReadCardSerial(mfrc)) {
+                continue;
+            }
+            PICC_TrackerAdopt(&tracker, &mfrc->uid);
+            event = PICC_TRACKER_ARRIVED;
+        } else {
+            event = PICC_TrackerPoll(mfrc, &tracker);
+        }
+        if (event == PICC_TRACKER_DEPARTED) {
+            printf("Card removed\n\r");
+            printf("Waiting for card\n\r");
+            continue;
+        }
+        if (event != PICC_TRACKER_ARRIVED) {
+            continue;
+        }
 
         //Show UID on serial monitor
         printf("PICC dump: \n\r");
@@ -43,4 +75,4 @@ void main() {
             printf("Authentication Failed\n\r");
         }
     }
-}
\ No newline at end of file
+}
@@ -1,20 +1,74 @@
 /**
-* mfrc522 library for pi pico c/c++ sdk
+* mfrc522 library for pi pico c/c++ sdk: the MFRC522 itself, register access
+* and exchanges with PICCs. The PICC protocols are in mfrc522_picc.c, serial
+* dumps and UID changing tools in mfrc522_debug.c.
 * NOTE: Please also check the comments in MFRC522.h - they provide useful hints
 * and background information.
 */
 
 #include "mfrc522.h"
 
+#if MFRC522_SPI_TRANSPORT
+//Chip select for pi pico SPI
+static inline void cs_select(const uint cs);
+static inline void cs_deselect(const uint cs); 
+#endif
+
+// FIFO contents after the self test of a version 2.0 MFRC522
+const uint8_t SELF_TEST_BYTES[FIFO_SIZE] = {
+	0x00, 0xEB, 0x66, 0xBA, 0x57, 0xBF, 0x23, 0x95,
+	0xD0, 0xE3, 0x0D, 0x3D, 0x27, 0x89, 0x5C, 0xDE,
+	0x9D, 0x3B, 0xA7, 0x00, 0x21, 0x5B, 0x89, 0x82,
+	0x51, 0x3A, 0xEB, 0x02, 0x0C, 0xA5, 0x00, 0x49,
+	0x7C, 0x84, 0x4D, 0xB3, 0xCC, 0xD2, 0x1B, 0x81,
+	0x5D, 0x48, 0x76, 0xD5, 0x71, 0x61, 0x21, 0xA9,
+	0x86, 0x96, 0x83, 0x38, 0xCF, 0x9D, 0x5B, 0x6D,
+	0xDC, 0x15, 0xBA, 0x3E, 0x7D, 0x95, 0x3B, 0x2F
+};
+
 // ADT object allocation counter
 static int MFRC_Instance_Counter = 0;
+// allocate instance struct array
+static struct MFRC522_T mfrc_Instances[MFRC_MAX_INSTANCES];
+
+// One SPI chip select frame of len uint8_ts
+#define PCD_STAT_SPI(mfrc, len)                                                \
+	do {                                                                       \
+		PCD_STAT_ADD(mfrc, spiTransactions, 1);                                \
+		PCD_STAT_ADD(mfrc, spiBytes, len);                                     \
+	} while (0)
+
+// Register shadow copy: bit n of a mask stands for the register at SPI
+// address n << 1
+#define PCD_SHADOW_BIT(reg) (1ULL << ((reg) >> 1))
+// Configuration registers only the host changes. Reads are served from the
+// shadow copy and writes of an unchanged value are skipped.
+static const uint64_t PCD_SHADOW_READS =
+	PCD_SHADOW_BIT(ComIEnReg) | PCD_SHADOW_BIT(DivIEnReg) |
+	PCD_SHADOW_BIT(WaterLevelReg) | PCD_SHADOW_BIT(ModeReg) |
+	PCD_SHADOW_BIT(TxModeReg) | PCD_SHADOW_BIT(RxModeReg) |
+	PCD_SHADOW_BIT(TxControlReg) | PCD_SHADOW_BIT(TxASKReg) |
+	PCD_SHADOW_BIT(TxSelReg) | PCD_SHADOW_BIT(RxSelReg) |
+	PCD_SHADOW_BIT(RxThresholdReg) | PCD_SHADOW_BIT(DemodReg) |
+	PCD_SHADOW_BIT(MfTxReg) | PCD_SHADOW_BIT(MfRxReg) |
+	PCD_SHADOW_BIT(ModWidthReg) | PCD_SHADOW_BIT(RFCfgReg) |
+	PCD_SHADOW_BIT(GsNReg) | PCD_SHADOW_BIT(CWGsPReg) |
+	PCD_SHADOW_BIT(ModGsPReg) | PCD_SHADOW_BIT(TModeReg) |
+	PCD_SHADOW_BIT(TPrescalerReg) | PCD_SHADOW_BIT(TReloadRegH) |
+	PCD_SHADOW_BIT(TReloadRegL);
+// Plus CollReg, whose only writable bit is ValuesAfterColl. Its other bits
+// report collisions and are always read from the chip.
+static const uint64_t PCD_SHADOW_WRITES =
+	PCD_SHADOW_READS | PCD_SHADOW_BIT(CollReg);
 
 /**
  * Set up the data structures of an MFRC522 ADT object and return a pointer
  */
 MFRC522Ptr_t MFRC522_Init() {
-	// allocate instance struct array
-	static struct MFRC522_T mfrc_Instances[MFRC_MAX_INSTANCES];
+	if (MFRC_Instance_Counter >= MFRC_MAX_INSTANCES) {
+		return NULL;
+	}
+
 	//      static Chip_SSP_DATA_SETUP_T dataSetup_Instances[MFRC_MAX_INSTANCES];
 	//		struct MFRC522_T mfrc_struct;
 	//		Chip_SSP_DATA_SETUP_T data_setup;
@@ -26,7 +80,21 @@ MFRC522Ptr_t MFRC522_Init() {
 		mfrc_Instances[MFRC_Instance_Counter].Tx_Buf[i] = 0;
 	}
 
-	mfrc_Instances[MFRC_Instance_Counter]._chipSelectPin = cs_pin;
+	mfrc_Instances[MFRC_Instance_Counter]._chipSelectPin = MFRC522_CS_PIN;
+	mfrc_Instances[MFRC_Instance_Counter]._resetPin = RESET_PIN;
+	mfrc_Instances[MFRC_Instance_Counter].dmaTx = -1;
+	mfrc_Instances[MFRC_Instance_Counter].dmaRx = -1;
+	mfrc_Instances[MFRC_Instance_Counter].irqPin = -1;
+	mfrc_Instances[MFRC_Instance_Counter].exchange.active = false;
+	mfrc_Instances[MFRC_Instance_Counter].crcMode = PCD_CRC_SOFTWARE;
+	PCD_SetTransport(&mfrc_Instances[MFRC_Instance_Counter], NULL, NULL);
+#if MFRC522_STATS
+	MFRC522_ResetStats(&mfrc_Instances[MFRC_Instance_Counter]);
+#endif
+	mfrc_Instances[MFRC_Instance_Counter].txRate = PCD_BITRATE_106;
+	mfrc_Instances[MFRC_Instance_Counter].rxRate = PCD_BITRATE_106;
+	mfrc_Instances[MFRC_Instance_Counter].rfProfileSet = false;
+	PCD_ResetCommandTimeouts(&mfrc_Instances[MFRC_Instance_Counter]);
 
 	// update instance counter
 	MFRC_Instance_Counter++;
@@ -40,91 +108,359 @@ MFRC522Ptr_t MFRC522_Init() {
 * Basic interface functions for communicating with the MFRC522
 *******************************************************************************/
 
+#if MFRC522_SPI_TRANSPORT
 /**
- * Writes a uint8_t to the specified register in the MFRC522 chip.
- * The interface is described in the datasheet section 8.1.2.
+ * Runs one full-duplex SPI burst of len bytes on the claimed DMA channels and
+ * waits for it to finish. Chip select must already be asserted.
+ * With txIncrement false the single byte at *tx is sent len times, with
+ * rxIncrement false every received byte is dropped into *rx.
+ */
+static void MFRC522_HOT(PCD_DMABurst)(MFRC522Ptr_t mfrc, const uint8_t *tx,
+									  bool txIncrement, uint8_t *rx,
+									  bool rxIncrement, uint len) {
+	dma_channel_config c = dma_channel_get_default_config(mfrc->dmaTx);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+	channel_config_set_read_increment(&c, txIncrement);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, spi_get_dreq(mfrc->spi, true));
+	dma_channel_configure(mfrc->dmaTx, &c, &spi_get_hw(mfrc->spi)->dr, tx, len,
+						  false);
+
+	c = dma_channel_get_default_config(mfrc->dmaRx);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, rxIncrement);
+	channel_config_set_dreq(&c, spi_get_dreq(mfrc->spi, false));
+	dma_channel_configure(mfrc->dmaRx, &c, rx, &spi_get_hw(mfrc->spi)->dr, len,
+						  false);
+
+	// Start both at once so the RX FIFO can never overflow
+	dma_start_channel_mask((1u << mfrc->dmaTx) | (1u << mfrc->dmaRx));
+	// The last byte is only clocked in after it has left the TX FIFO
+	dma_channel_wait_for_finish_blocking(mfrc->dmaRx);
+}
+
+/**
+ * Claims a pair of DMA channels for FIFO bursts. PCD_WriteNRegister() and
+ * PCD_ReadNRegister() fall back to blocking SPI when this is not called or
+ * no channels are free.
+ *
+ * @return true if the channels could be claimed.
+ */
+bool PCD_EnableDMA(MFRC522Ptr_t mfrc) {
+	if (mfrc->dmaTx >= 0 && mfrc->dmaRx >= 0) {
+		return true;
+	}
+	mfrc->dmaTx = dma_claim_unused_channel(false);
+	mfrc->dmaRx = dma_claim_unused_channel(false);
+	if (mfrc->dmaTx < 0 || mfrc->dmaRx < 0) {
+		PCD_DisableDMA(mfrc);
+		return false;
+	}
+	return true;
+} // End PCD_EnableDMA()
+
+/**
+ * Releases the DMA channels claimed by PCD_EnableDMA().
  */
-void PCD_WriteRegister(MFRC522Ptr_t mfrc, uint8_t reg, uint8_t value) {
-	uint8_t msg[2];
-	msg[0] = 0x00 | reg;
-	msg[1] = value;
+void PCD_DisableDMA(MFRC522Ptr_t mfrc) {
+	if (mfrc->dmaTx >= 0) {
+		dma_channel_unclaim(mfrc->dmaTx);
+	}
+	if (mfrc->dmaRx >= 0) {
+		dma_channel_unclaim(mfrc->dmaRx);
+	}
+	mfrc->dmaTx = -1;
+	mfrc->dmaRx = -1;
+} // End PCD_DisableDMA()
+
+/**
+ * SPI transport: writes count uint8_ts to one register in a single chip
+ * select frame, the MFRC522 keeps writing to the same address. The interface
+ * is described in the datasheet section 8.1.2.
+ */
+static void MFRC522_HOT(PCD_SpiWrite)(void *context, uint8_t reg,
+									  const uint8_t *values, uint8_t count) {
+	MFRC522Ptr_t mfrc = context;
+
+	if (mfrc->dmaTx >= 0 && count >= MFRC522_DMA_MIN_BURST) {
+		const uint8_t address = 0x00 | reg;
+		uint8_t discard;
+
+		cs_select(mfrc->_chipSelectPin);
+		spi_write_blocking(mfrc->spi, &address, 1);
+		// Stream straight from the caller's buffer, the echoed bytes are
+		// dropped so the RX FIFO is empty for the next transfer.
+		PCD_DMABurst(mfrc, values, true, &discard, false, count);
+		cs_deselect(mfrc->_chipSelectPin);
+		return;
+	}
 
+	const uint8_t address = 0x00 | reg;
 	cs_select(mfrc->_chipSelectPin);
-	spi_write_blocking(mfrc->spi, msg, 2);
+	spi_write_blocking(mfrc->spi, &address, 1);
+	spi_write_blocking(mfrc->spi, values, count);
 	cs_deselect(mfrc->_chipSelectPin);
 }
 
 /**
- * Writes a number of uint8_ts to the specified register in the MFRC522 chip.
+ * SPI transport: PCD_SpiWrite() of a PCD_Frame payload. The address goes in
+ * the headroom, so address and values leave as one burst.
+ */
+static void MFRC522_HOT(PCD_SpiWriteFrame)(void *context, uint8_t reg,
+										   uint8_t *values, uint8_t count) {
+	MFRC522Ptr_t mfrc = context;
+	uint8_t *frame = values - 1;
+
+	frame[0] = 0x00 | reg;
+	cs_select(mfrc->_chipSelectPin);
+	if (mfrc->dmaTx >= 0 && count >= MFRC522_DMA_MIN_BURST) {
+		uint8_t discard;
+		PCD_DMABurst(mfrc, frame, true, &discard, false, count + 1);
+	} else {
+		spi_write_blocking(mfrc->spi, frame, count + 1);
+	}
+	cs_deselect(mfrc->_chipSelectPin);
+}
+
+/**
+ * SPI transport: reads count uint8_ts from one register with the pipelined
+ * read of datasheet section 8.1.2.1. The address is sent count times
+ * followed by 0x00, and every byte clocked in is the answer to the previous
+ * address. The whole read is a single chip select frame.
+ */
+static void MFRC522_HOT(PCD_SpiRead)(void *context, uint8_t reg,
+									 uint8_t *values, uint8_t count) {
+	MFRC522Ptr_t mfrc = context;
+
+	memset(mfrc->Tx_Buf, 0x80 | reg, count);
+	mfrc->Tx_Buf[count] = 0x00; // Stop reading
+
+	cs_select(mfrc->_chipSelectPin);
+	if (mfrc->dmaTx >= 0 && count >= MFRC522_DMA_MIN_BURST) {
+		PCD_DMABurst(mfrc, mfrc->Tx_Buf, true, mfrc->Rx_Buf, true, count + 1);
+	} else {
+		spi_write_read_blocking(mfrc->spi, mfrc->Tx_Buf, mfrc->Rx_Buf,
+								count + 1);
+	}
+	cs_deselect(mfrc->_chipSelectPin);
+
+	// Rx_Buf[0] was clocked in while the first address was sent
+	memcpy(values, &mfrc->Rx_Buf[1], count);
+}
+
+/**
+ * SPI transport: PCD_SpiRead() into a PCD_Frame payload. The byte clocked in
+ * with the first address lands in the headroom, the answers right in values.
+ */
+static void MFRC522_HOT(PCD_SpiReadFrame)(void *context, uint8_t reg,
+										  uint8_t *values, uint8_t count) {
+	MFRC522Ptr_t mfrc = context;
+
+	memset(mfrc->Tx_Buf, 0x80 | reg, count);
+	mfrc->Tx_Buf[count] = 0x00; // Stop reading
+
+	cs_select(mfrc->_chipSelectPin);
+	if (mfrc->dmaTx >= 0 && count >= MFRC522_DMA_MIN_BURST) {
+		PCD_DMABurst(mfrc, mfrc->Tx_Buf, true, values - 1, true, count + 1);
+	} else {
+		spi_write_read_blocking(mfrc->spi, mfrc->Tx_Buf, values - 1,
+								count + 1);
+	}
+	cs_deselect(mfrc->_chipSelectPin);
+}
+
+static const PCD_Transport PCD_SPI_TRANSPORT = {
+	PCD_SpiWrite, PCD_SpiRead, NULL, PCD_SpiWriteFrame, PCD_SpiReadFrame};
+#else
+bool PCD_EnableDMA(MFRC522Ptr_t mfrc) {
+	(void)mfrc;
+	return false; // Only the SPI transport uses DMA
+} // End PCD_EnableDMA()
+
+void PCD_DisableDMA(MFRC522Ptr_t mfrc) {
+	(void)mfrc;
+} // End PCD_DisableDMA()
+#endif
+
+/**
+ * Routes the register access of an instance through another transport than
+ * SPI, for example the simulator of mfrc522_sim.h. NULL goes back to SPI.
+ * Call before PCD_InitWithConfig(), with config.spi set to NULL so that no
+ * SPI pins are set up.
+ */
+void PCD_SetTransport(MFRC522Ptr_t mfrc, const PCD_Transport *transport,
+					  void *context) {
+#if MFRC522_SPI_TRANSPORT
+	if (transport == NULL) {
+		transport = &PCD_SPI_TRANSPORT;
+		context = mfrc;
+	}
+#endif
+	mfrc->transport = transport;
+	mfrc->transportContext = context;
+	mfrc->shadowValid = 0; // Nothing is known about the new chip
+} // End PCD_SetTransport()
+
+/**
+ * Records a register write in the shadow.
+ *
+ * @return false if the chip already holds value and the write can be
+ * skipped.
+ */
+static bool MFRC522_HOT(PCD_ShadowWrite)(MFRC522Ptr_t mfrc, uint8_t reg,
+										 uint8_t value) {
+	uint64_t bit = PCD_SHADOW_BIT(reg);
+	if (bit & PCD_SHADOW_WRITES) {
+		if ((mfrc->shadowValid & bit) && mfrc->shadow[reg >> 1] == value) {
+			return false;
+		}
+		mfrc->shadow[reg >> 1] = value;
+		mfrc->shadowValid |= bit;
+	}
+	return true;
+}
+
+/**
+ * Forgets the shadow once a write has reset the chip.
+ */
+static void MFRC522_HOT(PCD_ShadowWritten)(MFRC522Ptr_t mfrc, uint8_t reg,
+										   uint8_t value) {
+	if (reg == CommandReg && (value & 0x0F) == PCD_SoftReset) {
+		mfrc->shadowValid = 0; // Every register is back to its reset value
+	}
+}
+
+/**
+ * Writes a uint8_t to the specified register in the MFRC522 chip.
  * The interface is described in the datasheet section 8.1.2.
  */
-void PCD_WriteNRegister(
+void MFRC522_HOT(PCD_WriteRegister)(MFRC522Ptr_t mfrc, uint8_t reg,
+									 uint8_t value) {
+	if (!PCD_ShadowWrite(mfrc, reg, value)) {
+		return; // The chip already holds this value
+	}
+
+	mfrc->transport->write(mfrc->transportContext, reg, &value, 1);
+	PCD_STAT_SPI(mfrc, 2);
+	PCD_ShadowWritten(mfrc, reg, value);
+}
+
+/**
+ * Writes a number of uint8_ts to the specified register in the MFRC522 chip.
+ * All bytes go out in a single chip select frame, the MFRC522 keeps writing
+ * to the same address. The interface is described in the datasheet section
+ * 8.1.2.
+ */
+void MFRC522_HOT(PCD_WriteNRegister)(
 	MFRC522Ptr_t mfrc,
 	uint8_t reg,   ///< The register to write to. One of the PCD_Register enums.
 	uint8_t count, ///< The number of uint8_ts to write to the register
 	uint8_t *values ///< The values to write. uint8_t array.
 	) {
-	uint8_t msg[count + 1]; //Values and address
-	msg[0] = 0x00 | reg;
-
-	uint8_t i;
-	for(i = 0; i < count; i++) {
-		msg[i + 1] = values[i];
+	if (count == 0) {
+		return;
 	}
+	mfrc->transport->write(mfrc->transportContext, reg, values, count);
+	PCD_STAT_SPI(mfrc, count + 1);
+}
 
-	cs_select(mfrc->_chipSelectPin);
-	spi_write_blocking(mfrc->spi, msg, count + 1);
-	cs_deselect(mfrc->_chipSelectPin);
+/**
+ * PCD_WriteNRegister() of a PCD_Frame payload, through the writeFrame of the
+ * transport if it has one.
+ */
+static void MFRC522_HOT(PCD_WriteFrameRegister)(MFRC522Ptr_t mfrc,
+												uint8_t reg, uint8_t count,
+												uint8_t *values) {
+	if (count == 0) {
+		return;
+	}
+	if (mfrc->transport->writeFrame) {
+		mfrc->transport->writeFrame(mfrc->transportContext, reg, values,
+									count);
+	} else {
+		mfrc->transport->write(mfrc->transportContext, reg, values, count);
+	}
+	PCD_STAT_SPI(mfrc, count + 1);
 }
 
 /**
  * Reads a uint8_t from the specified register in the MFRC522 chip.
  * The interface is described in the datasheet section 8.1.2.
  */
-uint8_t PCD_ReadRegister(
+uint8_t MFRC522_HOT(PCD_ReadRegister)(
 	MFRC522Ptr_t mfrc, 
 	uint8_t reg ///< The register to read from. One of the PCD_Register enums
 	) {
 	uint8_t buf = 0;
-	const uint8_t msg = 0x80 | reg;
+
+	uint64_t bit = PCD_SHADOW_BIT(reg);
+	if ((bit & PCD_SHADOW_READS) && (mfrc->shadowValid & bit)) {
+		return mfrc->shadow[reg >> 1];
+	}
 	
-	cs_select(mfrc->_chipSelectPin);
-	spi_write_blocking(mfrc->spi, &msg, 1);
-	spi_read_blocking(mfrc->spi, 0, &buf, 1);
-	cs_deselect(mfrc->_chipSelectPin);
+	mfrc->transport->read(mfrc->transportContext, reg, &buf, 1);
+	PCD_STAT_SPI(mfrc, 2);
+
+	if (bit & PCD_SHADOW_READS) {
+		mfrc->shadow[reg >> 1] = buf;
+		mfrc->shadowValid |= bit;
+	}
 	return buf;
 }
 
+/**
+ * PCD_ReadNRegister(), with values a PCD_Frame payload if framed.
+ */
+static void MFRC522_HOT(PCD_ReadN)(MFRC522Ptr_t mfrc, uint8_t reg,
+								   uint8_t count, uint8_t *values,
+								   uint8_t rxAlign, bool framed) {
+	if (count == 0) {
+		return;
+	}
+	if (count > BUFFER_SIZE - 1) {
+		count = BUFFER_SIZE - 1;
+	}
+
+	uint8_t first = values[0];
+	if (framed && mfrc->transport->readFrame) {
+		mfrc->transport->readFrame(mfrc->transportContext, reg, values, count);
+	} else {
+		mfrc->transport->read(mfrc->transportContext, reg, values, count);
+	}
+	PCD_STAT_SPI(mfrc, count + 1);
+
+	if (rxAlign) { // Only update bit positions rxAlign..7 in values[0]
+		uint8_t mask = (0xFF << rxAlign) & 0xFF;
+		values[0] = (first & ~mask) | (values[0] & mask);
+	}
+}
+
 /**
  * Reads a number of uint8_ts from the specified register in the MFRC522 chip.
- * The interface is described in the datasheet section 8.1.2.
+ * Over SPI this is the pipelined read of datasheet section 8.1.2.1, a single
+ * chip select frame.
  */
-void PCD_ReadNRegister(
+void MFRC522_HOT(PCD_ReadNRegister)(
 	MFRC522Ptr_t mfrc,
 	uint8_t reg, ///< The register to read from. One of the PCD_Register enums.
 	uint8_t count,   ///< The number of uint8_ts to read
 	uint8_t *values, ///< uint8_t array to store the values in.
 	uint8_t rxAlign ///< Only bit positions rxAlign..7 in values[0] are updated.
 	) {
-	uint8_t buf = 0;
-	const uint8_t msg = 0x80 | reg;
-	
-	cs_select(mfrc->_chipSelectPin);
-
-	// uint8_t i;
-	// for(i = 0; i < count; i++) {
-	// 	uint8_t value = 0;
-	// 	spi_write_blocking(mfrc->spi, &msg, 1);
-	// 	spi_read_blocking(mfrc->spi, 0, &value, 1);
-	// 	values[i] = value;
-	// }
+	PCD_ReadN(mfrc, reg, count, values, rxAlign, false);
+}
 
-	uint8_t i;
-	for(i = 0; i < count; i++) {
-		values[i] = PCD_ReadRegister(mfrc, msg);
+/**
+ * Value of a register for a read-modify-write. CollReg is only written for
+ * its ValuesAfterColl bit, the other bits are read-only.
+ */
+static uint8_t PCD_ReadShadow(MFRC522Ptr_t mfrc, uint8_t reg) {
+	uint64_t bit = PCD_SHADOW_BIT(reg);
+	if ((bit & PCD_SHADOW_WRITES) && (mfrc->shadowValid & bit)) {
+		return mfrc->shadow[reg >> 1];
 	}
-
-	cs_deselect(mfrc->_chipSelectPin);
+	return PCD_ReadRegister(mfrc, reg);
 }
 
 /**
@@ -135,9 +471,7 @@ void PCD_SetRegisterBitMask(
 	uint8_t reg, ///< The register to update. One of the PCD_Register enums.
 	uint8_t mask ///< The bits to set.
 	) {
-	uint8_t tmp;
-	tmp = PCD_ReadRegister(mfrc, reg);
-	PCD_WriteRegister(mfrc, reg, tmp | mask); // set bit mask
+	PCD_WriteRegister(mfrc, reg, PCD_ReadShadow(mfrc, reg) | mask); // set bit mask
 } // End PCD_SetRegisterBitMask()
 
 /**
@@ -148,13 +482,191 @@ void PCD_ClearRegisterBitMask(
 	uint8_t reg, ///< The register to update. One of the PCD_Register enums.
 	uint8_t mask ///< The bits to clear.
 	) {
-	uint8_t tmp;
-	tmp = PCD_ReadRegister(mfrc, reg);
-	PCD_WriteRegister(mfrc, reg, tmp & (~mask)); // clear bit mask
+	PCD_WriteRegister(mfrc, reg,
+					  PCD_ReadShadow(mfrc, reg) & (~mask)); // clear bit mask
 } // End PCD_ClearRegisterBitMask()
 
 /**
- * Use the CRC coprocessor in the MFRC522 to calculate a CRC_A.
+ * Writes a sequence of registers in one loop. Steps that would not change
+ * a shadowed configuration register are skipped. If the transport has a
+ * writeScript the remaining steps are handed over PCD_SCRIPT_BATCH at a
+ * time, otherwise every step is a PCD_WriteRegister().
+ */
+void PCD_RunScript(MFRC522Ptr_t mfrc,
+				   const PCD_RegisterWrite *script, ///< The steps, in order
+				   size_t length ///< Number of steps, see PCD_SCRIPT_LENGTH()
+				   ) {
+	if (mfrc->transport->writeScript == NULL) {
+		for (size_t i = 0; i < length; i++) {
+			PCD_WriteRegister(mfrc, script[i].reg, script[i].value);
+		}
+		return;
+	}
+
+	PCD_RegisterWrite batch[PCD_SCRIPT_BATCH];
+	size_t count = 0;
+	for (size_t i = 0; i < length; i++) {
+		if (PCD_ShadowWrite(mfrc, script[i].reg, script[i].value)) {
+			batch[count++] = script[i];
+			PCD_STAT_SPI(mfrc, 2);
+			PCD_ShadowWritten(mfrc, script[i].reg, script[i].value);
+		}
+		if (count == PCD_SCRIPT_BATCH || (count > 0 && i == length - 1)) {
+			mfrc->transport->writeScript(mfrc->transportContext, batch, count);
+			count = 0;
+		}
+	}
+} // End PCD_RunScript()
+
+#if MFRC522_SPI_TRANSPORT
+// IRQ pins in use. PCD_IrqPinHandler serves all of them, so it is only
+// registered once, while the count is above 0: every further shared handler
+// would take one of the PICO_MAX_SHARED_IRQ_HANDLERS slots of IO_IRQ_BANK0.
+static uint8_t irqPinCount;
+
+/**
+ * Shared GPIO handler for the IRQ pins of all instances. It only acknowledges
+ * the edge, the waiting code re-checks the pin level after waking up.
+ */
+static void PCD_IrqPinHandler(void) {
+	for (int i = 0; i < MFRC_Instance_Counter; i++) {
+		int pin = mfrc_Instances[i].irqPin;
+		if (pin >= 0 && (gpio_get_irq_event_mask(pin) & GPIO_IRQ_EDGE_FALL)) {
+			gpio_acknowledge_irq(pin, GPIO_IRQ_EDGE_FALL);
+		}
+	}
+}
+#endif
+
+/**
+ * Uses the MFRC522 IRQ output to signal command completion instead of polling
+ * ComIrqReg/DivIrqReg over SPI. Call after PCD_Init(). A negative pin goes
+ * back to polling. Without the SPI transport there is no IRQ pin support and
+ * the interrupt registers are always polled.
+ */
+void PCD_SetIrqPin(MFRC522Ptr_t mfrc, int pin) {
+#if MFRC522_SPI_TRANSPORT
+	if (mfrc->irqPin >= 0) {
+		gpio_set_irq_enabled(mfrc->irqPin, GPIO_IRQ_EDGE_FALL, false);
+		if (--irqPinCount == 0) { // The last pin
+			gpio_remove_raw_irq_handler(mfrc->irqPin, PCD_IrqPinHandler);
+		}
+	}
+	mfrc->irqPin = pin;
+	if (pin < 0) {
+		return;
+	}
+
+	// IRqInv=1 => the pin goes low on an interrupt. Every source stays
+	// disabled until a wait enables the ones it needs.
+	PCD_WriteRegister(mfrc, ComIEnReg, 0x80);
+	PCD_WriteRegister(mfrc, DivIEnReg, 0x80); // IRQPushPull=1, no pull-up needed
+
+	gpio_init(pin);
+	gpio_set_dir(pin, GPIO_IN);
+	gpio_pull_up(pin);
+	if (irqPinCount++ == 0) { // The first pin
+		gpio_add_raw_irq_handler(pin, PCD_IrqPinHandler);
+	}
+	gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_FALL, true);
+	irq_set_enabled(IO_IRQ_BANK0, true);
+#else
+	(void)mfrc;
+	(void)pin;
+#endif
+} // End PCD_SetIrqPin()
+
+/**
+ * Sleeps with __wfe() until the IRQ pin is asserted or timeoutUs passes.
+ *
+ * @return true if the pin was asserted.
+ */
+static bool MFRC522_HOT(PCD_WaitIrqPin)(MFRC522Ptr_t mfrc,
+									  uint32_t timeoutUs) {
+	absolute_time_t deadline = make_timeout_time_us(timeoutUs);
+	while (gpio_get(mfrc->irqPin)) {
+		PCD_STAT_ADD(mfrc, irqWaitIterations, 1);
+		if (best_effort_wfe_or_timeout(deadline)) {
+			return !gpio_get(mfrc->irqPin);
+		}
+	}
+	return true;
+}
+
+// CRC_A lookup table: CRC-16 polynomial x^16 + x^12 + x^5 + 1, bit reversed
+// (0x8408) as ISO/IEC 14443-3 transmits LSB first
+static const uint16_t MFRC522_HOT_DATA CRC_A_TABLE[256] = {
+	0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+	0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+	0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+	0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+	0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+	0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+	0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+	0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+	0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+	0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+	0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+	0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+	0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+	0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+	0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+	0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+	0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+	0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+	0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+	0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+	0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+	0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+	0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+	0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+	0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+	0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+	0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+	0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+	0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+	0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+	0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+	0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78,
+};
+
+/**
+ * Calculates a CRC_A (ISO/IEC 14443-3 part 6.2.4, preset 0x6363) on the MCU.
+ * Gives the same result as the MFRC522 CRC coprocessor without any SPI
+ * traffic.
+ */
+void MFRC522_HOT(PCD_SoftwareCRC)(
+	const uint8_t *data, ///< In: The data to calculate the CRC_A over.
+	uint16_t length,	 ///< In: The number of uint8_ts.
+	uint8_t *result ///< Out: Pointer to result buffer. Result is written to
+					///result[0..1], low uint8_t first.
+	) {
+	uint16_t crc = 0x6363;
+	for (uint16_t i = 0; i < length; i++) {
+		crc = (crc >> 8) ^ CRC_A_TABLE[(crc ^ data[i]) & 0xFF];
+	}
+	result[0] = crc & 0xFF;
+	result[1] = crc >> 8;
+} // End PCD_SoftwareCRC()
+
+/**
+ * Selects how PCD_CalculateCRC() computes CRC_A values for this instance.
+ */
+void PCD_SetCRCMode(MFRC522Ptr_t mfrc, PCD_CRCMode mode) {
+	mfrc->crcMode = mode;
+} // End PCD_SetCRCMode()
+
+// Register setup before a CalcCRC command
+static const PCD_RegisterWrite PCD_CRC_PROLOGUE[] = {
+	{CommandReg, PCD_Idle}, // Stop any active command.
+	{DivIrqReg, 0x04},		// Clear the CRCIRq interrupt request bit
+	{FIFOLevelReg, 0x80},   // FlushBuffer = 1, FIFO initialization
+};
+
+/**
+ * Calculate a CRC_A, either on the MCU or with the CRC coprocessor in the
+ * MFRC522 depending on the instance's PCD_CRCMode. During an asynchronous
+ * exchange it is always calculated on the MCU.
  *
  * @return STATUS_OK on success, STATUS_??? otherwise.
  */
@@ -166,20 +678,35 @@ PCD_CalculateCRC(MFRC522Ptr_t mfrc,
 				 uint8_t *result ///< Out: Pointer to result buffer. Result is
 								 ///written to result[0..1], low uint8_t first.
 				 ) {
-	PCD_WriteRegister(mfrc, CommandReg, PCD_Idle); // Stop any active command.
-	PCD_WriteRegister(mfrc, DivIrqReg,
-					  0x04); // Clear the CRCIRq interrupt request bit
-	PCD_SetRegisterBitMask(mfrc, FIFOLevelReg,
-						   0x80); // FlushBuffer = 1, FIFO initialization
+	// The coprocessor needs CommandReg and the FIFO, which belong to an
+	// asynchronous exchange while one runs
+	if (mfrc->crcMode == PCD_CRC_SOFTWARE || mfrc->exchange.active) {
+		PCD_SoftwareCRC(data, length, result);
+		return STATUS_OK;
+	}
+
+	PCD_RunScript(mfrc, PCD_CRC_PROLOGUE, PCD_SCRIPT_LENGTH(PCD_CRC_PROLOGUE));
 	PCD_WriteNRegister(mfrc, FIFODataReg, length,
 					   data);						  // Write data to the FIFO
+	if (mfrc->irqPin >= 0) {
+		PCD_WriteRegister(mfrc, DivIEnReg, 0x84); // IRQPushPull, CRCIEn
+	}
 	PCD_WriteRegister(mfrc, CommandReg, PCD_CalcCRC); // Start the calculation
 
 	// Wait for the CRC calculation to complete. Each iteration of the
 	// while-loop takes 17.73�s.
 	uint16_t i = 5000;
 	uint8_t n;
-	while (1) {
+	if (mfrc->irqPin >= 0) {
+		PCD_WaitIrqPin(mfrc, MFRC522_CRC_IRQ_TIMEOUT_US);
+		PCD_WriteRegister(mfrc, DivIEnReg, 0x80);
+		if (!(PCD_ReadRegister(mfrc, DivIrqReg) & 0x04)) {
+			return STATUS_TIMEOUT;
+		}
+		i = 0; // Skip the polling loop
+	}
+	while (i) {
+		PCD_STAT_ADD(mfrc, irqWaitIterations, 1);
 		n = PCD_ReadRegister(mfrc, DivIrqReg); // DivIrqReg[7..0] bits are: Set2
 											   // reserved reserved MfinActIRq
 											   // reserved CRCIRq reserved
@@ -207,85 +734,492 @@ PCD_CalculateCRC(MFRC522Ptr_t mfrc,
 * Functions for manipulating the MFRC522
 *******************************************************************************/
 
+// Register setup after the soft reset of PCD_InitWithConfig()
+static const PCD_RegisterWrite PCD_INIT_SCRIPT[] = {
+	// When communicating with a PICC we need a timeout if something goes
+	// wrong. f_timer = 13.56 MHz / (2*TPreScaler+1) where TPreScaler =
+	// [TPrescaler_Hi:TPrescaler_Lo].
+	// TPrescaler_Hi are the four low bits in TModeReg. TPrescaler_Lo is
+	// TPrescalerReg.
+	{TModeReg, 0x80},	  // TAuto=1; timer starts automatically at the end
+						   // of the transmission in all communication modes
+						   // at all speeds
+	{TPrescalerReg, 0xA9}, // TPreScaler = TModeReg[3..0]:TPrescalerReg, ie
+						   // 0x0A9 = 169 => f_timer=40kHz, ie a timer period
+						   // of 25�s.
+	{TReloadRegH, (MFRC522_DEFAULT_TIMEOUT_US / 25) >> 8}, // Reload timer
+	{TReloadRegL, (MFRC522_DEFAULT_TIMEOUT_US / 25) & 0xFF}, // with 0x3E8 =
+						   // 1000, ie 25ms before timeout.
+	{TxASKReg, 0x40},	  // Default 0x00. Force a 100 % ASK modulation
+						   // independent of the ModGsPReg register setting
+	{ModeReg, 0x3D},	   // Default 0x3F. Set the preset value for the CRC
+						   // coprocessor for the CalcCRC command to 0x6363
+						   // (ISO 14443-3 part 6.2.4)
+};
+
+/**
+ * Fills in the wiring PCD_Init() has always used: spi0 at MFRC522_BIT_RATE
+ * with the pins from mfrc522.h and no IRQ pin. Without the SPI transport
+ * there is no SPI instance and no reset pin.
+ */
+void MFRC522_GetDefaultConfig(MFRC522_Config *config) {
+#if MFRC522_SPI_TRANSPORT
+	config->spi = spi0;
+#else
+	config->spi = NULL;
+#endif
+	config->baudrate = MFRC522_BIT_RATE;
+	config->sckPin = MFRC522_SCK_PIN;
+	config->mosiPin = MFRC522_MOSI_PIN;
+	config->misoPin = MFRC522_MISO_PIN;
+	config->csPin = MFRC522_CS_PIN;
+	config->rstPin = MFRC522_SPI_TRANSPORT ? RESET_PIN : -1;
+	config->irqPin = -1;
+} // End MFRC522_GetDefaultConfig()
+
+#if MFRC522_SPI_TRANSPORT
+/**
+ * Checks that SPI transfers are reliable at the current clock: VersionReg
+ * must read back as expected and a full FIFO burst must survive the round
+ * trip.
+ */
+static bool PCD_LinkIsStable(MFRC522Ptr_t mfrc, uint8_t version) {
+	uint8_t pattern[FIFO_SIZE];
+	uint8_t readBack[FIFO_SIZE];
+
+	for (uint8_t i = 0; i < 8; i++) {
+		if (PCD_ReadRegister(mfrc, VersionReg) != version) {
+			return false;
+		}
+	}
+	for (uint8_t i = 0; i < FIFO_SIZE; i++) {
+		pattern[i] = (i & 1) ? (0xA5 ^ i) : (0x5A + i);
+	}
+	PCD_WriteRegister(mfrc, FIFOLevelReg, 0x80); // Flush the FIFO
+	PCD_WriteNRegister(mfrc, FIFODataReg, FIFO_SIZE, pattern);
+	if (PCD_ReadRegister(mfrc, FIFOLevelReg) != FIFO_SIZE) {
+		return false;
+	}
+	PCD_ReadNRegister(mfrc, FIFODataReg, FIFO_SIZE, readBack, 0);
+	PCD_WriteRegister(mfrc, FIFOLevelReg, 0x80);
+	return memcmp(pattern, readBack, FIFO_SIZE) == 0;
+}
+#endif
+
+/**
+ * Finds the highest SPI clock up to maxBaudrate at which the MFRC522 still
+ * answers reliably and leaves the bus at that clock. The FIFO contents are
+ * lost.
+ *
+ * @return The SPI clock in use, 0 if the MFRC522 does not answer even at
+ * 1 MHz or is not attached over SPI.
+ */
+uint PCD_ProbeBaudrate(MFRC522Ptr_t mfrc, uint maxBaudrate) {
+#if MFRC522_SPI_TRANSPORT
+	static const uint candidates[] = {10000000, 8000000, 6000000, 5000000,
+									  4000000,  2000000, 1000000};
+
+	if (mfrc->spi == NULL) {
+		return 0;
+	}
+	spi_set_baudrate(mfrc->spi, 1000000);
+	uint8_t version = PCD_ReadRegister(mfrc, VersionReg);
+	if (version == 0x00 || version == 0xFF) { // Communication failure
+		return 0;
+	}
+
+	for (uint i = 0; i < count_of(candidates); i++) {
+		if (candidates[i] > maxBaudrate) {
+			continue;
+		}
+		uint actual = spi_set_baudrate(mfrc->spi, candidates[i]);
+		if (PCD_LinkIsStable(mfrc, version)) {
+			return actual;
+		}
+	}
+	return spi_set_baudrate(mfrc->spi, 1000000);
+#else
+	(void)mfrc;
+	(void)maxBaudrate;
+	return 0;
+#endif
+} // End PCD_ProbeBaudrate()
+
+/**
+ * Initializes the MFRC522 chip with the default wiring, but on the given SPI
+ * instance. See PCD_InitWithConfig().
+ *
+ * @return STATUS_OK on success, STATUS_TIMEOUT if the chip did not come up.
+ */
+StatusCode PCD_Init(MFRC522Ptr_t mfrc, spi_inst_t *spi) {
+	MFRC522_Config config;
+	MFRC522_GetDefaultConfig(&config);
+	config.spi = spi;
+	return PCD_InitWithConfig(mfrc, &config);
+} // End PCD_Init()
+
+/**
+ * Polls until the MFRC522 answers after a reset: VersionReg reads something
+ * else than a floating MISO line, the PowerDown bit of CommandReg is clear
+ * and no SoftReset is still running.
+ *
+ * @return STATUS_OK on success, STATUS_TIMEOUT if the chip did not come up
+ * within timeoutUs.
+ */
+static StatusCode PCD_WaitReady(MFRC522Ptr_t mfrc, uint32_t timeoutUs) {
+	absolute_time_t deadline = make_timeout_time_us(timeoutUs);
+	for (;;) {
+		uint8_t version = PCD_ReadRegister(mfrc, VersionReg);
+		uint8_t command = PCD_ReadRegister(mfrc, CommandReg);
+		if (version != 0x00 && version != 0xFF && !(command & 0x10) &&
+			(command & 0x0F) != PCD_SoftReset) {
+			return STATUS_OK;
+		}
+		if (time_reached(deadline)) {
+			return STATUS_TIMEOUT;
+		}
+	}
+}
+
 /**
- * Initializes the MFRC522 chip.
+ * Sets up the chip select, reset and SPI pins of a reader. The hard reset,
+ * if wired, is left asserted for the caller to release. Without an SPI
+ * instance only the reset pin is set up, the transport given to
+ * PCD_SetTransport() owns the rest.
  */
-void PCD_Init(MFRC522Ptr_t mfrc, spi_inst_t *spi) {
+static void PCD_InitPins(MFRC522Ptr_t mfrc, const MFRC522_Config *config) {
+	mfrc->spi = config->spi;
+	mfrc->_chipSelectPin = config->csPin;
+	mfrc->_resetPin = config->rstPin;
+
+	if (config->rstPin >= 0) {
+		gpio_init(config->rstPin);
+		gpio_set_dir(config->rstPin, GPIO_OUT);
+		gpio_put(config->rstPin, 0);
+	}
+	if (config->spi == NULL) {
+		return;
+	}
+
+#if MFRC522_SPI_TRANSPORT
+    gpio_init(config->csPin);
+    gpio_set_dir(config->csPin, GPIO_OUT);
+    gpio_put(config->csPin, 1);
 
-	mfrc->spi = spi0;
-	gpio_put(RESET_PIN, 0);
-    sleep_ms(1000);
-    gpio_put(RESET_PIN, 1);
-	sleep_ms(50);
+    spi_init(config->spi, config->baudrate ? config->baudrate : 1000000);
 
-    gpio_init(cs_pin);
-    gpio_set_dir(cs_pin, GPIO_OUT);
-    gpio_put(cs_pin, 1);
+    spi_set_format(config->spi, 8, 0, 0, SPI_MSB_FIRST);
 
-    spi_init(spi0, 1000000);
+    gpio_set_function(config->sckPin, GPIO_FUNC_SPI);
+    gpio_set_function(config->mosiPin, GPIO_FUNC_SPI);
+    gpio_set_function(config->misoPin, GPIO_FUNC_SPI);
+#endif
+}
 
-    spi_set_format(spi0, 8, 0, 0, SPI_MSB_FIRST);
+/**
+ * Configures a reader whose pins are set up and whose hard reset has been
+ * released. Nothing is configured if the chip does not come up.
+ *
+ * @return STATUS_OK on success, STATUS_TIMEOUT if the chip did not answer
+ * after the hard or the soft reset.
+ */
+static StatusCode PCD_InitChip(MFRC522Ptr_t mfrc,
+							   const MFRC522_Config *config) {
+	mfrc->shadowValid = 0;
+	// Crystal start-up after the hard reset
+	StatusCode status = PCD_WaitReady(mfrc, MFRC522_WAKEUP_TIMEOUT_US);
+	if (status != STATUS_OK) {
+		return status; // No chip, or one that is not powered
+	}
 
-    gpio_set_function(sck_pin, GPIO_FUNC_SPI);
-    gpio_set_function(mosi_pin, GPIO_FUNC_SPI);
-    gpio_set_function(miso_pin, GPIO_FUNC_SPI);
+	if (config->baudrate == 0) { // Run as fast as the wiring allows
+		PCD_ProbeBaudrate(mfrc, MFRC522_MAX_BIT_RATE);
+	}
 
 	PCD_WriteRegister(mfrc, CommandReg, PCD_SoftReset);
+	mfrc->txRate = PCD_BITRATE_106; // Reset values of TxModeReg and RxModeReg
+	mfrc->rxRate = PCD_BITRATE_106;
+	status = PCD_WaitReady(mfrc, MFRC522_WAKEUP_TIMEOUT_US);
+	if (status != STATUS_OK) {
+		return status;
+	}
 
-	// When communicating with a PICC we need a timeout if something goes wrong.
-	// f_timer = 13.56 MHz / (2*TPreScaler+1) where TPreScaler =
-	// [TPrescaler_Hi:TPrescaler_Lo].
-	// TPrescaler_Hi are the four low bits in TModeReg. TPrescaler_Lo is
-	// TPrescalerReg.
-	PCD_WriteRegister(mfrc, TModeReg, 0x80); // TAuto=1; timer starts
-											 // automatically at the end of the
-											 // transmission in all
-											 // communication modes at all
-											 // speeds
-	PCD_WriteRegister(mfrc, TPrescalerReg,
-					  0xA9); // TPreScaler = TModeReg[3..0]:TPrescalerReg, ie
-							 // 0x0A9 = 169 => f_timer=40kHz, ie a timer period
-							 // of 25�s.
-	PCD_WriteRegister(
-		mfrc, TReloadRegH,
-		0x03); // Reload timer with 0x3E8 = 1000, ie 25ms before timeout.
-	PCD_WriteRegister(mfrc, TReloadRegL, 0xE8);
-
-	PCD_WriteRegister(mfrc, TxASKReg, 0x40); // Default 0x00. Force a 100 % ASK
-											 // modulation independent of the
-											 // ModGsPReg register setting
-	PCD_WriteRegister(mfrc, ModeReg, 0x3D);  // Default 0x3F. Set the preset
-											// value for the CRC coprocessor for
-											// the CalcCRC command to 0x6363
-											// (ISO 14443-3 part 6.2.4)
+	PCD_RunScript(mfrc, PCD_INIT_SCRIPT, PCD_SCRIPT_LENGTH(PCD_INIT_SCRIPT));
+	if (config->irqPin >= 0) {
+		PCD_SetIrqPin(mfrc, config->irqPin);
+	} else if (mfrc->irqPin >= 0) { // The reset disabled the IRQ output setup
+		PCD_WriteRegister(mfrc, ComIEnReg, 0x80);
+		PCD_WriteRegister(mfrc, DivIEnReg, 0x80);
+	}
+	if (mfrc->rfProfileSet) { // Calibrated settings, lost with the reset
+		PCD_SetRfProfile(mfrc, &mfrc->rfProfile);
+	}
 	PCD_AntennaOn(mfrc); // Enable the antenna driver pins TX1 and TX2 (they
 						 // were disabled by the reset)
-} // End PCD_Init()
+	return STATUS_OK;
+}
+
+/**
+ * Initializes the MFRC522 chip on the SPI instance and pins given in config.
+ * Several instances may share one SPI controller as long as they use
+ * different chip select pins and the same clock.
+ * The hard reset pulse is MFRC522_RESET_PULSE_US long, then the chip is
+ * polled until its oscillator runs instead of waiting a fixed time.
+ *
+ * @return STATUS_OK on success, STATUS_TIMEOUT if the chip did not come up
+ * within MFRC522_WAKEUP_TIMEOUT_US. The reader is unusable then, check the
+ * wiring and the supply.
+ */
+StatusCode PCD_InitWithConfig(MFRC522Ptr_t mfrc,
+							  const MFRC522_Config *config) {
+	PCD_InitPins(mfrc, config);
+	if (config->rstPin >= 0) {
+		busy_wait_us(MFRC522_RESET_PULSE_US);
+		gpio_put(config->rstPin, 1);
+	}
+	return PCD_InitChip(mfrc, config);
+} // End PCD_InitWithConfig()
+
+/**
+ * Initializes count readers like PCD_InitWithConfig(), with all of them
+ * held in hard reset and released together. Their oscillators start up in
+ * parallel, so the whole set costs about one crystal start-up time. A reader
+ * that does not come up does not stop the others.
+ *
+ * @return STATUS_OK if all readers came up, STATUS_TIMEOUT otherwise.
+ */
+StatusCode PCD_InitMany(MFRC522Ptr_t *mfrcs, const MFRC522_Config *configs,
+						size_t count) {
+	StatusCode result = STATUS_OK;
+
+	for (size_t i = 0; i < count; i++) {
+		PCD_InitPins(mfrcs[i], &configs[i]);
+	}
+	busy_wait_us(MFRC522_RESET_PULSE_US);
+	for (size_t i = 0; i < count; i++) {
+		if (configs[i].rstPin >= 0) {
+			gpio_put(configs[i].rstPin, 1);
+		}
+	}
+	for (size_t i = 0; i < count; i++) {
+		StatusCode status = PCD_InitChip(mfrcs[i], &configs[i]);
+		if (status != STATUS_OK) {
+			result = status;
+		}
+	}
+	return result;
+} // End PCD_InitMany()
 
 /**
  * Performs a soft reset on the MFRC522 chip and waits for it to be ready again.
+ *
+ * @return STATUS_OK on success, STATUS_TIMEOUT if the chip did not come back
+ * within MFRC522_WAKEUP_TIMEOUT_US.
  */
-void PCD_Reset(MFRC522Ptr_t mfrc) {
+StatusCode PCD_Reset(MFRC522Ptr_t mfrc) {
 	PCD_WriteRegister(mfrc, CommandReg,
 					  PCD_SoftReset); // Issue the SoftReset command.
+	mfrc->txRate = PCD_BITRATE_106;
+	mfrc->rxRate = PCD_BITRATE_106;
 	// The datasheet does not mention how long the SoftRest command takes to
 	// complete.
 	// But the MFRC522 might have been in soft power-down mode (triggered by bit
 	// 4 of CommandReg)
 	// Section 8.8.2 in the datasheet says the oscillator start-up time is the
-	// start up time of the crystal + 37,74�s. Let us be generous: 50ms.
-	//SysTick_Init();
-	sleep_ms(50);
-	// Wait for the PowerDown bit in CommandReg to be cleared
-	while (PCD_ReadRegister(mfrc, CommandReg) & (1 << 4)) {
-		// PCD still restarting - unlikely after waiting 50ms, but better safe
-		// than sorry.
-	}
+	// start up time of the crystal + 37,74�s. Poll for it, bounded by
+	// MFRC522_WAKEUP_TIMEOUT_US.
+	return PCD_WaitReady(mfrc, MFRC522_WAKEUP_TIMEOUT_US);
 } // End PCD_Reset()
 
 /**
- * Turns the antenna on by enabling pins TX1 and TX2.
- * After a reset these pins are disabled.
+ * Sets how long the MFRC522 timer waits for a PICC to answer after the end of
+ * a transmission. Rounded up to the 25�s timer period set in PCD_Init().
+ * The register shadow skips the writes if the value does not change.
+ */
+void PCD_SetTimeout(MFRC522Ptr_t mfrc, uint32_t timeoutUs) {
+	uint32_t reload = (timeoutUs + 24) / 25;
+	if (reload == 0) {
+		reload = 1;
+	} else if (reload > 0xFFFF) {
+		reload = 0xFFFF;
+	}
+	PCD_WriteRegister(mfrc, TReloadRegH, reload >> 8);
+	PCD_WriteRegister(mfrc, TReloadRegL, reload & 0xFF);
+} // End PCD_SetTimeout()
+
+// Frame waiting times per PCD_TimeoutClass, from the ISO/IEC 14443-3 frame
+// delay times and the MIFARE Classic (MF1S50yyX section 9) and Ultralight
+// (MF0ICU1 section 8) command timings, with some margin
+static const uint32_t PCD_DEFAULT_TIMEOUTS_US[PCD_TIMEOUT_COUNT] = {
+	[PCD_TIMEOUT_DEFAULT] = MFRC522_DEFAULT_TIMEOUT_US,
+	[PCD_TIMEOUT_REQA] = MFRC522_PRESENCE_TIMEOUT_US, // ATQA after ~91�s
+	[PCD_TIMEOUT_SELECT] = 1000,  // SAK/UID after ~91�s
+	[PCD_TIMEOUT_HALT] = 1000,	// Silence for 1ms means success
+	[PCD_TIMEOUT_AUTH] = 5000,	// Whole MFAuthent three pass exchange
+	[PCD_TIMEOUT_READ] = 5000,	// Ultralight: 5ms maximum
+	[PCD_TIMEOUT_WRITE] = 5000,   // ACK of the command phase
+	[PCD_TIMEOUT_WRITE_DATA] = 10000, // ACK after EEPROM programming
+	[PCD_TIMEOUT_VALUE] = 5000,	   // ACK of INC/DEC/RESTORE
+	[PCD_TIMEOUT_VALUE_DATA] = 1000,  // No answer unless NAK
+	[PCD_TIMEOUT_TRANSFER] = 10000,   // ACK after EEPROM programming
+	[PCD_TIMEOUT_TCL] = 5000, // FWT for FWI = 4, until an ATS says otherwise
+};
+
+/**
+ * Restores the timeout of every PCD_TimeoutClass to its default.
+ */
+void PCD_ResetCommandTimeouts(MFRC522Ptr_t mfrc) {
+	memcpy(mfrc->timeouts, PCD_DEFAULT_TIMEOUTS_US, sizeof(mfrc->timeouts));
+	mfrc->timeoutHint = PCD_TIMEOUT_AUTO;
+} // End PCD_ResetCommandTimeouts()
+
+/**
+ * Overrides the timeout PCD_CommunicateWithPICC() programs before exchanges
+ * of the given class.
+ */
+void PCD_SetCommandTimeout(MFRC522Ptr_t mfrc, PCD_TimeoutClass cls,
+						   uint32_t timeoutUs) {
+	if (cls < PCD_TIMEOUT_COUNT) {
+		mfrc->timeouts[cls] = timeoutUs;
+	}
+} // End PCD_SetCommandTimeout()
+
+/**
+ * @return The timeout used for exchanges of the given class.
+ */
+uint32_t PCD_GetCommandTimeout(MFRC522Ptr_t mfrc, PCD_TimeoutClass cls) {
+	return cls < PCD_TIMEOUT_COUNT ? mfrc->timeouts[cls] : 0;
+} // End PCD_GetCommandTimeout()
+
+/**
+ * Makes the next exchange use the timeout of cls instead of classifying its
+ * frame. Needed for frames that carry only data, like the second phase of
+ * MIFARE_Write().
+ */
+void PCD_SetNextTimeout(MFRC522Ptr_t mfrc, PCD_TimeoutClass cls) {
+	mfrc->timeoutHint = cls;
+} // End PCD_SetNextTimeout()
+
+/**
+ * Works out which PCD_TimeoutClass an exchange belongs to from the PCD
+ * command and the first uint8_t of the frame.
+ */
+static PCD_TimeoutClass PCD_ClassifyExchange(uint8_t command,
+											 uint8_t *sendData,
+											 uint8_t sendLen,
+											 uint8_t txLastBits) {
+	if (command == PCD_MFAuthent) {
+		return PCD_TIMEOUT_AUTH;
+	}
+	if (command != PCD_Transceive || sendLen == 0) {
+		return PCD_TIMEOUT_DEFAULT;
+	}
+	if (sendLen == 1 && txLastBits == 7) { // Short frame: REQA or WUPA
+		return PCD_TIMEOUT_REQA;
+	}
+	switch (sendData[0]) {
+	case PICC_CMD_SEL_CL1:
+	case PICC_CMD_SEL_CL2:
+	case PICC_CMD_SEL_CL3:
+		return PCD_TIMEOUT_SELECT;
+	case PICC_CMD_HLTA:
+		return sendLen == 4 ? PCD_TIMEOUT_HALT : PCD_TIMEOUT_DEFAULT;
+	case PICC_CMD_MF_READ:
+		return sendLen == 4 ? PCD_TIMEOUT_READ : PCD_TIMEOUT_DEFAULT;
+	case PICC_CMD_UL_FAST_READ:
+		return sendLen == 5 ? PCD_TIMEOUT_READ : PCD_TIMEOUT_DEFAULT;
+	case PICC_CMD_MF_WRITE:
+		return sendLen == 4 ? PCD_TIMEOUT_WRITE : PCD_TIMEOUT_DEFAULT;
+	case PICC_CMD_UL_WRITE:
+		return sendLen == 8 ? PCD_TIMEOUT_WRITE_DATA : PCD_TIMEOUT_DEFAULT;
+	case PICC_CMD_MF_DECREMENT:
+	case PICC_CMD_MF_INCREMENT:
+	case PICC_CMD_MF_RESTORE:
+		return sendLen == 4 ? PCD_TIMEOUT_VALUE : PCD_TIMEOUT_DEFAULT;
+	case PICC_CMD_MF_TRANSFER:
+		return sendLen == 4 ? PCD_TIMEOUT_TRANSFER : PCD_TIMEOUT_DEFAULT;
+	default:
+		return PCD_TIMEOUT_DEFAULT;
+	}
+}
+
+/**
+ * Enters soft power-down (CommandReg bit 4). The oscillator and the antenna
+ * field stop, all register values are kept.
+ */
+void PCD_SoftPowerDown(MFRC522Ptr_t mfrc) {
+	PCD_SetRegisterBitMask(mfrc, CommandReg, 0x10);
+} // End PCD_SoftPowerDown()
+
+/**
+ * Leaves soft power-down and waits for the oscillator to be running again,
+ * see section 8.6.2 of the datasheet.
+ *
+ * @return STATUS_OK once the MFRC522 is ready, STATUS_TIMEOUT otherwise.
+ */
+StatusCode PCD_SoftPowerUp(MFRC522Ptr_t mfrc) {
+	PCD_ClearRegisterBitMask(mfrc, CommandReg, 0x10);
+	absolute_time_t deadline = make_timeout_time_us(MFRC522_WAKEUP_TIMEOUT_US);
+	// The PowerDown bit reads 1 until the wake-up has completed
+	while (PCD_ReadRegister(mfrc, CommandReg) & 0x10) {
+		if (time_reached(deadline)) {
+			return STATUS_TIMEOUT;
+		}
+	}
+	return STATUS_OK;
+} // End PCD_SoftPowerUp()
+
+/**
+ * Switches the bit rates used to talk to the PICC, once negotiated with PPS
+ * (ISO/IEC 14443-4 part 5.6). ModWidthReg follows the transmit rate.
+ * Above 106 kbit/s the MFRC522 must add and check the CRC_A itself, so
+ * TxCRCEn and RxCRCEn are set for the direction concerned: frames are then
+ * sent without their CRC_A and received with it stripped, a wrong one is
+ * reported in ErrorReg.
+ * PICC_REQA_or_WUPA() goes back to 106 kbit/s on its own.
+ */
+void PCD_SetBitRate(MFRC522Ptr_t mfrc, PCD_BitRate txRate,
+					PCD_BitRate rxRate) {
+	// Modulation pulse widths per TxSpeed, from NXP AN10834
+	static const uint8_t MOD_WIDTH[] = {0x26, 0x15, 0x0A, 0x05};
+
+	if (txRate == mfrc->txRate && rxRate == mfrc->rxRate) {
+		return;
+	}
+	// TxCRCEn and RxCRCEn may only be cleared at 106 kbit/s (datasheet
+	// sections 9.3.2.2 and 9.3.2.3)
+	uint8_t value = PCD_ReadRegister(mfrc, TxModeReg) & 0x0F;
+	value |= (txRate << 4) | (txRate != PCD_BITRATE_106 ? 0x80 : 0x00);
+	PCD_WriteRegister(mfrc, TxModeReg, value); // TxCRCEn, TxSpeed
+	value = PCD_ReadRegister(mfrc, RxModeReg) & 0x0F;
+	value |= (rxRate << 4) | (rxRate != PCD_BITRATE_106 ? 0x80 : 0x00);
+	PCD_WriteRegister(mfrc, RxModeReg, value); // RxCRCEn, RxSpeed
+	PCD_WriteRegister(mfrc, ModWidthReg, MOD_WIDTH[txRate]);
+	mfrc->txRate = txRate;
+	mfrc->rxRate = rxRate;
+} // End PCD_SetBitRate()
+
+#if MFRC522_STATS
+/**
+ * Copies the counters gathered since the last MFRC522_ResetStats(). Each
+ * instance is updated only by the core that drives it, read it from the
+ * other core only as a rough snapshot.
+ */
+void MFRC522_GetStats(MFRC522Ptr_t mfrc, MFRC522_Stats *stats) {
+	memcpy(stats, &mfrc->stats, sizeof(*stats));
+} // End MFRC522_GetStats()
+
+/**
+ * Clears all counters of the instance.
+ */
+void MFRC522_ResetStats(MFRC522Ptr_t mfrc) {
+	memset(&mfrc->stats, 0, sizeof(mfrc->stats));
+} // End MFRC522_ResetStats()
+#endif
+
+/**
+ * Turns the antenna on by enabling pins TX1 and TX2.
+ * After a reset these pins are disabled.
  */
 void PCD_AntennaOn(MFRC522Ptr_t mfrc) {
 	uint8_t value = PCD_ReadRegister(mfrc, TxControlReg);
@@ -321,13 +1255,40 @@ uint8_t PCD_GetAntennaGain(MFRC522Ptr_t mfrc) {
  */
 void PCD_SetAntennaGain(MFRC522Ptr_t mfrc, uint8_t mask) {
 	if (PCD_GetAntennaGain(mfrc) != mask) { // only bother if there is a change
-		PCD_ClearRegisterBitMask(
-			mfrc, RFCfgReg, (0x07 << 4)); // clear needed to allow 000 pattern
-		PCD_SetRegisterBitMask(mfrc, RFCfgReg,
-							   mask & (0x07 << 4)); // only set RxGain[2:0] bits
+		uint8_t value = PCD_ReadRegister(mfrc, RFCfgReg) & ~(0x07 << 4);
+		PCD_WriteRegister(mfrc, RFCfgReg,
+						  value | (mask & (0x07 << 4))); // only RxGain[2:0]
 	}
 } // End PCD_SetAntennaGain()
 
+/**
+ * Reads the receiver and driver settings in use into profile.
+ */
+void PCD_GetRfProfile(MFRC522Ptr_t mfrc, PCD_RfProfile *profile) {
+	profile->rxGain = PCD_GetAntennaGain(mfrc);
+	profile->cwGsP = PCD_ReadRegister(mfrc, CWGsPReg) & 0x3F;
+	profile->modGsP = PCD_ReadRegister(mfrc, ModGsPReg) & 0x3F;
+	profile->demod = PCD_ReadRegister(mfrc, DemodReg);
+} // End PCD_GetRfProfile()
+
+/**
+ * Applies profile and keeps it for the instance, PCD_InitWithConfig() puts
+ * it back after the reset. A profile from PCD_CalibrateRf() can be stored
+ * elsewhere and set again on the next boot. NULL forgets the kept profile,
+ * the registers stay as they are until the next reset.
+ */
+void PCD_SetRfProfile(MFRC522Ptr_t mfrc, const PCD_RfProfile *profile) {
+	mfrc->rfProfileSet = profile != NULL;
+	if (!profile) {
+		return;
+	}
+	mfrc->rfProfile = *profile;
+	PCD_SetAntennaGain(mfrc, profile->rxGain);
+	PCD_WriteRegister(mfrc, CWGsPReg, profile->cwGsP & 0x3F);
+	PCD_WriteRegister(mfrc, ModGsPReg, profile->modGsP & 0x3F);
+	PCD_WriteRegister(mfrc, DemodReg, profile->demod);
+} // End PCD_SetRfProfile()
+
 /**
  * Performs the MFRC522 self test described in 16.1.1
  * Returns 0 if test is ok. Check what version of MFRC522 and put the buffer values in SELF_TEST_BYTES[]
@@ -336,7 +1297,10 @@ uint8_t PCD_SelfTest(MFRC522Ptr_t mfrc) {
 
     //Perform a soft reset
     PCD_WriteRegister(mfrc, CommandReg, PCD_SoftReset);
-    sleep_ms(50); //Allow the chip to reset
+    //Allow the chip to reset, a chip that does not come back fails the test
+    if (PCD_WaitReady(mfrc, MFRC522_WAKEUP_TIMEOUT_US) != STATUS_OK) {
+        return -1;
+    }
     //printf("Soft reset complete\n\r");
 
     //Clear the internal buffer by writing 25 bytes of 00h (and implement the config command)??.
@@ -436,39 +1400,33 @@ StatusCode PCD_TransceiveData(
 								   rxAlign, checkCRC);
 } // End PCD_TransceiveData()
 
+// Register setup before every exchange
+static const PCD_RegisterWrite PCD_EXCHANGE_PROLOGUE[] = {
+	{CommandReg, PCD_Idle}, // Stop any active command.
+	{ComIrqReg, 0x7F},		// Clear all seven interrupt request bits
+	{FIFOLevelReg, 0x80},   // FlushBuffer = 1, FIFO initialization
+};
+
 /**
- * Transfers data to the MFRC522 FIFO, executes a command, waits for completion
- *and transfers data back from the FIFO.
- * CRC validation can only be done if backData and backLen are specified.
- *
- * @return STATUS_OK on success, STATUS_??? otherwise.
+ * Loads the FIFO and starts a command, remembering what is needed to finish
+ * the exchange in mfrc->exchange. The argument meanings are the same as for
+ * PCD_CommunicateWithPICC(), framed tells that sendData and backData are
+ * PCD_Frame payloads.
  */
-StatusCode PCD_CommunicateWithPICC(
-	MFRC522Ptr_t mfrc,
-	uint8_t command, ///< The command to execute. One of the PCD_Command enums.
-	uint8_t waitIRq, ///< The bits in the ComIrqReg register that signals
-					 ///successful completion of the command.
-	uint8_t *sendData,  ///< Pointer to the data to transfer to the FIFO.
-	uint8_t sendLen,	///< Number of uint8_ts to transfer to the FIFO.
-	uint8_t *backData,  ///< NULL or pointer to buffer if data should be read
-						///back after executing the command.
-	uint8_t *backLen,   ///< In: Max number of uint8_ts to write to *backData.
-						///Out: The number of uint8_ts returned.
-	uint8_t *validBits, ///< In/Out: The number of valid bits in the last
-						///uint8_t. 0 for 8 valid bits.
-	uint8_t rxAlign,	///< In: Defines the bit position in backData[0] for the
-						///first bit received. Default 0.
-	bool checkCRC ///< In: True => The last two uint8_ts of the response is
-				  ///assumed to be a CRC_A that must be validated.
-	) {
-	//		backData=NULL;
-	//		backLen=NULL;
-	//		validBits=NULL;
-	//		rxAlign=0;
-	//		checkCRC=false;
-
-	uint8_t n, _validBits;
-	unsigned int i;
+static void PCD_BeginExchange(MFRC522Ptr_t mfrc, uint8_t command,
+							  uint8_t waitIRq, uint8_t *sendData,
+							  uint8_t sendLen, uint8_t *backData,
+							  uint8_t *backLen, uint8_t *validBits,
+							  uint8_t rxAlign, bool checkCRC, bool framed) {
+	PCD_Exchange *x = &mfrc->exchange;
+
+	x->waitIRq = waitIRq;
+	x->backData = backData;
+	x->backLen = backLen;
+	x->validBits = validBits;
+	x->rxAlign = rxAlign;
+	x->checkCRC = checkCRC;
+	x->framed = framed;
 
 	// Prepare values for BitFramingReg
 	uint8_t txLastBits = validBits ? *validBits : 0;
@@ -476,42 +1434,99 @@ StatusCode PCD_CommunicateWithPICC(
 		(rxAlign << 4) + txLastBits; // RxAlign = BitFramingReg[6..4].
 									 // TxLastBits = BitFramingReg[2..0]
 
-	PCD_WriteRegister(mfrc, CommandReg, PCD_Idle); // Stop any active command.
-	PCD_WriteRegister(mfrc, ComIrqReg,
-					  0x7F); // Clear all seven interrupt request bits
-	PCD_SetRegisterBitMask(mfrc, FIFOLevelReg,
-						   0x80); // FlushBuffer = 1, FIFO initialization
-	PCD_WriteNRegister(mfrc, FIFODataReg, sendLen,
-					   sendData); // Write sendData to the FIFO
+	PCD_RunScript(mfrc, PCD_EXCHANGE_PROLOGUE,
+				  PCD_SCRIPT_LENGTH(PCD_EXCHANGE_PROLOGUE));
+	if (framed) { // Write sendData to the FIFO
+		PCD_WriteFrameRegister(mfrc, FIFODataReg, sendLen, sendData);
+	} else {
+		PCD_WriteNRegister(mfrc, FIFODataReg, sendLen, sendData);
+	}
 	PCD_WriteRegister(mfrc, BitFramingReg, bitFraming); // Bit adjustments
+
+	// Wait only as long as this kind of command can take to be answered
+	PCD_TimeoutClass cls = mfrc->timeoutHint;
+	if (cls == PCD_TIMEOUT_AUTO) {
+		cls = PCD_ClassifyExchange(command, sendData, sendLen, txLastBits);
+	}
+	mfrc->timeoutHint = PCD_TIMEOUT_AUTO;
+	PCD_SetTimeout(mfrc, mfrc->timeouts[cls]);
+#if MFRC522_STATS
+	x->timeoutClass = cls;
+	x->startUs = time_us_64();
+#endif
+
+	if (mfrc->irqPin >= 0) {
+		// Drive the IRQ pin from the completion bits and the timer
+		PCD_WriteRegister(mfrc, ComIEnReg, 0x80 | waitIRq | 0x01);
+	}
 	PCD_WriteRegister(mfrc, CommandReg, command);		// Execute the command
 	if (command == PCD_Transceive) {
-		PCD_SetRegisterBitMask(
-			mfrc, BitFramingReg,
-			0x80); // StartSend=1, transmission of data starts
+		PCD_WriteRegister(mfrc, BitFramingReg,
+						  bitFraming |
+							  0x80); // StartSend=1, transmission of data starts
 	}
+	x->timeoutUs = mfrc->timeouts[cls];
+	x->deadline = make_timeout_time_us(MFRC522_IRQ_TIMEOUT_US + x->timeoutUs);
+} // End PCD_BeginExchange()
 
-	// Wait for the command to complete.
-	// In PCD_Init() we set the TAuto flag in TModeReg. This means the timer
-	// automatically starts when the PCD stops transmitting.
-	// Each iteration of the do-while-loop takes 17.86�s.
-	i = 2000;
-	while (1) {
-		n = PCD_ReadRegister(mfrc, ComIrqReg); // ComIrqReg[7..0] bits are: Set1
-											   // TxIRq RxIRq IdleIRq HiAlertIRq
-											   // LoAlertIRq ErrIRq TimerIRq
-		if (n & waitIRq) { // One of the interrupts that signal success has been
-						   // set.
-			break;
-		}
-		if (n & 0x01) { // Timer interrupt - nothing received in 25ms
-			return STATUS_TIMEOUT;
-		}
-		if (--i == 0) { // The emergency break. If all other conditions fail we
-						// will eventually terminate on this one after 35.7ms.
-						// Communication with the MFRC522 might be down.
-			return STATUS_TIMEOUT;
-		}
+#if MFRC522_STATS
+/**
+ * Books the wall time and outcome of the exchange started last.
+ */
+static void PCD_StatsRecordExchange(MFRC522Ptr_t mfrc, StatusCode status) {
+	MFRC522_Stats *stats = &mfrc->stats;
+	uint8_t cls = mfrc->exchange.timeoutClass;
+	uint64_t elapsed = time_us_64() - mfrc->exchange.startUs;
+	uint8_t bucket = 0;
+
+	while (bucket < MFRC522_STATS_BUCKETS - 1 &&
+		   elapsed >= (MFRC522_STATS_FIRST_BUCKET_US << bucket)) {
+		bucket++;
+	}
+	stats->exchanges[cls]++;
+	stats->histogram[cls][bucket]++;
+	stats->totalUs[cls] += elapsed;
+	if (elapsed > stats->maxUs[cls]) {
+		stats->maxUs[cls] = elapsed;
+	}
+	switch (status) {
+	case STATUS_TIMEOUT:
+		stats->timeouts++;
+		break;
+	case STATUS_CRC_WRONG:
+		stats->crcErrors++;
+		break;
+	case STATUS_COLLISION:
+		stats->collisions++;
+		break;
+	case STATUS_MIFARE_NACK:
+		stats->nacks++;
+		break;
+	case STATUS_OK:
+		break;
+	default:
+		stats->errors++;
+		break;
+	}
+}
+#endif
+
+/**
+ * Reads back the response of a stopped exchange and checks it, see
+ * PCD_EndExchange().
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+static StatusCode PCD_FinishExchange(MFRC522Ptr_t mfrc, uint8_t irq) {
+	PCD_Exchange *x = &mfrc->exchange;
+	uint8_t n, _validBits = 0;
+
+	if (mfrc->irqPin >= 0) {
+		PCD_WriteRegister(mfrc, ComIEnReg, 0x80);
+	}
+	if (!(irq & x->waitIRq)) { // Timer interrupt - nothing received in 25ms,
+							   // or no answer from the MFRC522 at all
+		return STATUS_TIMEOUT;
 	}
 
 	// Stop now if any errors except collisions were detected.
@@ -524,21 +1539,21 @@ StatusCode PCD_CommunicateWithPICC(
 	}
 
 	// If the caller wants data back, get it from the MFRC522.
-	if (backData && backLen) {
+	if (x->backData && x->backLen) {
 		n = PCD_ReadRegister(mfrc,
 							 FIFOLevelReg); // Number of uint8_ts in the FIFO
-		if (n > *backLen) {
+		if (n > *x->backLen) {
 			return STATUS_NO_ROOM;
 		}
-		*backLen = n; // Number of uint8_ts returned
-		PCD_ReadNRegister(mfrc, FIFODataReg, n, backData,
-						  rxAlign); // Get received data from FIFO
+		*x->backLen = n; // Number of uint8_ts returned
+		PCD_ReadN(mfrc, FIFODataReg, n, x->backData, x->rxAlign,
+				  x->framed); // Get received data from FIFO
 		_validBits = PCD_ReadRegister(mfrc, ControlReg) &
 					 0x07; // RxLastBits[2:0] indicates the number of valid bits
 						   // in the last received uint8_t. If this value is
 						   // 000b, the whole uint8_t is valid.
-		if (validBits) {
-			*validBits = _validBits;
+		if (x->validBits) {
+			*x->validBits = _validBits;
 		}
 	}
 
@@ -546,442 +1561,469 @@ StatusCode PCD_CommunicateWithPICC(
 	if (errorRegValue & 0x08) { // CollErr
 		return STATUS_COLLISION;
 	}
+	if (errorRegValue & 0x04) { // CRCErr, only checked with RxCRCEn set
+		return STATUS_CRC_WRONG;
+	}
 
 	// Perform CRC_A validation if requested.
-	if (backData && backLen && checkCRC) {
+	if (x->backData && x->backLen && x->checkCRC) {
 		// In this case a MIFARE Classic NAK is not OK.
-		if (*backLen == 1 && _validBits == 4) {
+		if (*x->backLen == 1 && _validBits == 4) {
 			return STATUS_MIFARE_NACK;
 		}
 		// We need at least the CRC_A value and all 8 bits of the last uint8_t
 		// must be received.
-		if (*backLen < 2 || _validBits != 0) {
+		if (*x->backLen < 2 || _validBits != 0) {
 			return STATUS_CRC_WRONG;
 		}
 		// Verify CRC_A - do our own calculation and store the control in
 		// controlBuffer.
 		uint8_t controlBuffer[2];
-		StatusCode status = PCD_CalculateCRC(mfrc, &backData[0], *backLen - 2,
-											 &controlBuffer[0]);
+		StatusCode status =
+			PCD_CalculateCRC(mfrc, &x->backData[0], *x->backLen - 2,
+							 &controlBuffer[0]);
 		if (status != STATUS_OK) {
 			return status;
 		}
-		if ((backData[*backLen - 2] != controlBuffer[0]) ||
-			(backData[*backLen - 1] != controlBuffer[1])) {
+		if ((x->backData[*x->backLen - 2] != controlBuffer[0]) ||
+			(x->backData[*x->backLen - 1] != controlBuffer[1])) {
 			return STATUS_CRC_WRONG;
 		}
 	}
 
 	return STATUS_OK;
-} // End PCD_CommunicateWithPICC()
+}
 
 /**
- * Transmits a REQuest command, Type A. Invites PICCs in state IDLE to go to
- *READY and prepare for anticollision or selection. 7 bit frame.
- * Beware: When two PICCs are in the field at the same time I often get
- *STATUS_TIMEOUT - probably due do bad antenna design.
+ * Finishes the exchange started by PCD_BeginExchange() once the command has
+ * stopped, irq being the last value read from ComIrqReg.
  *
  * @return STATUS_OK on success, STATUS_??? otherwise.
  */
-StatusCode PICC_RequestA(
-	MFRC522Ptr_t mfrc,
-	uint8_t *
-		bufferATQA,		///< The buffer to store the ATQA (Answer to request) in
-	uint8_t *bufferSize ///< Buffer size, at least two uint8_ts. Also number of
-						///uint8_ts returned if STATUS_OK.
-	) {
-	return PICC_REQA_or_WUPA(mfrc, PICC_CMD_REQA, bufferATQA, bufferSize);
-} // End PICC_RequestA()
+static StatusCode PCD_EndExchange(MFRC522Ptr_t mfrc, uint8_t irq) {
+	StatusCode status = PCD_FinishExchange(mfrc, irq);
+#if MFRC522_STATS
+	PCD_StatsRecordExchange(mfrc, status);
+#endif
+	return status;
+} // End PCD_EndExchange()
 
 /**
- * Transmits a Wake-UP command, Type A. Invites PICCs in state IDLE and HALT to
- *go to READY(*) and prepare for anticollision or selection. 7 bit frame.
- * Beware: When two PICCs are in the field at the same time I often get
- *STATUS_TIMEOUT - probably due do bad antenna design.
+ * PCD_CommunicateWithPICC(), with sendData and backData PCD_Frame payloads if
+ * framed.
+ */
+static StatusCode PCD_Communicate(MFRC522Ptr_t mfrc, uint8_t command,
+								  uint8_t waitIRq, uint8_t *sendData,
+								  uint8_t sendLen, uint8_t *backData,
+								  uint8_t *backLen, uint8_t *validBits,
+								  uint8_t rxAlign, bool checkCRC,
+								  bool framed) {
+	PCD_Exchange *x = &mfrc->exchange;
+	uint8_t n = 0;
+
+	if (x->active) { // An asynchronous exchange owns the FIFO
+		return STATUS_PENDING;
+	}
+	PCD_BeginExchange(mfrc, command, waitIRq, sendData, sendLen, backData,
+					  backLen, validBits, rxAlign, checkCRC, framed);
+
+	// Wait for the command to complete.
+	// In PCD_Init() we set the TAuto flag in TModeReg. This means the timer
+	// automatically starts when the PCD stops transmitting. x->deadline is
+	// the timeout of the exchange plus slack, should the timer never fire.
+	if (mfrc->irqPin >= 0) {
+		int64_t remaining =
+			absolute_time_diff_us(get_absolute_time(), x->deadline);
+		PCD_WaitIrqPin(mfrc, remaining > 0 ? (uint32_t)remaining : 0);
+		n = PCD_ReadRegister(mfrc, ComIrqReg);
+	} else {
+		do {
+			PCD_STAT_ADD(mfrc, irqWaitIterations, 1);
+			n = PCD_ReadRegister(mfrc, ComIrqReg); // ComIrqReg[7..0] bits are:
+												   // Set1 TxIRq RxIRq IdleIRq
+												   // HiAlertIRq LoAlertIRq
+												   // ErrIRq TimerIRq
+			if (n & waitIRq) { // One of the interrupts that signal success
+							   // has been set.
+				break;
+			}
+			if (n & 0x01) { // Timer interrupt - nothing received in time
+				break;
+			}
+		} while (!time_reached(x->deadline)); // Communication with the
+											  // MFRC522 might be down
+	}
+
+	return PCD_EndExchange(mfrc, n);
+}
+
+/**
+ * Transfers data to the MFRC522 FIFO, executes a command, waits for completion
+ *and transfers data back from the FIFO.
+ * CRC validation can only be done if backData and backLen are specified.
  *
  * @return STATUS_OK on success, STATUS_??? otherwise.
  */
-StatusCode PICC_WakeupA(
+StatusCode PCD_CommunicateWithPICC(
 	MFRC522Ptr_t mfrc,
-	uint8_t *
-		bufferATQA,		///< The buffer to store the ATQA (Answer to request) in
-	uint8_t *bufferSize ///< Buffer size, at least two uint8_ts. Also number of
-						///uint8_ts returned if STATUS_OK.
+	uint8_t command, ///< The command to execute. One of the PCD_Command enums.
+	uint8_t waitIRq, ///< The bits in the ComIrqReg register that signals
+					 ///successful completion of the command.
+	uint8_t *sendData,  ///< Pointer to the data to transfer to the FIFO.
+	uint8_t sendLen,	///< Number of uint8_ts to transfer to the FIFO.
+	uint8_t *backData,  ///< NULL or pointer to buffer if data should be read
+						///back after executing the command.
+	uint8_t *backLen,   ///< In: Max number of uint8_ts to write to *backData.
+						///Out: The number of uint8_ts returned.
+	uint8_t *validBits, ///< In/Out: The number of valid bits in the last
+						///uint8_t. 0 for 8 valid bits.
+	uint8_t rxAlign,	///< In: Defines the bit position in backData[0] for the
+						///first bit received. Default 0.
+	bool checkCRC ///< In: True => The last two uint8_ts of the response is
+				  ///assumed to be a CRC_A that must be validated.
 	) {
-	return PICC_REQA_or_WUPA(mfrc, PICC_CMD_WUPA, bufferATQA, bufferSize);
-} // End PICC_WakeupA()
+	//		backData=NULL;
+	//		backLen=NULL;
+	//		validBits=NULL;
+	//		rxAlign=0;
+	//		checkCRC=false;
+
+	return PCD_Communicate(mfrc, command, waitIRq, sendData, sendLen, backData,
+						   backLen, validBits, rxAlign, checkCRC, false);
+} // End PCD_CommunicateWithPICC()
+
+/**
+ * Initialises frame on storage, PCD_FRAME_STORAGE(size) uint8_ts owned by
+ * the caller, as an empty frame for up to size payload uint8_ts.
+ */
+void PCD_FrameInit(PCD_Frame *frame, uint8_t *storage, uint8_t size) {
+	frame->data = storage + PCD_FRAME_HEADROOM;
+	frame->length = 0;
+	frame->size = size;
+	frame->validBits = 0;
+} // End PCD_FrameInit()
 
 /**
- * Transmits REQA or WUPA commands.
- * Beware: When two PICCs are in the field at the same time I often get
- *STATUS_TIMEOUT - probably due do bad antenna design.
+ * Appends the CRC_A of the payload in the tailroom of frame. Call it once
+ * per payload: the frame does not record whether a CRC_A was appended.
  *
- * @return STATUS_OK on success, STATUS_??? otherwise.
+ * @return STATUS_OK on success, STATUS_NO_ROOM if the payload already
+ * reaches into the tailroom, as after appending a CRC_A to a full frame.
+ */
+StatusCode PCD_FrameAppendCRC(MFRC522Ptr_t mfrc, PCD_Frame *frame) {
+	if (frame->length > frame->size) {
+		return STATUS_NO_ROOM;
+	}
+	StatusCode status = PCD_CalculateCRC(mfrc, frame->data, frame->length,
+										 &frame->data[frame->length]);
+	if (status == STATUS_OK) {
+		frame->length += 2;
+	}
+	return status;
+} // End PCD_FrameAppendCRC()
+
+/**
+ * PCD_TransceiveData() with PCD_Frame buffers. The transport writes its
+ * header into the headroom and moves the payloads directly, without staging
+ * or copies. send may be back, as MIFARE_Read() does with its frame, and
+ * back may be NULL if no response is expected. send->validBits is sent as
+ * TxLastBits and the RxLastBits of the response come back in
+ * back->validBits. With checkCRC the response may fill the tailroom too, its
+ * CRC_A is validated and not counted in back->length.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise. back->length is 0 on
+ * failure.
  */
-StatusCode PICC_REQA_or_WUPA(
+StatusCode PCD_TransceiveFrame(
 	MFRC522Ptr_t mfrc,
-	uint8_t command, ///< The command to send - PICC_CMD_REQA or PICC_CMD_WUPA
-	uint8_t *
-		bufferATQA,		///< The buffer to store the ATQA (Answer to request) in
-	uint8_t *bufferSize ///< Buffer size, at least two uint8_ts. Also number of
-						///uint8_ts returned if STATUS_OK.
+	PCD_Frame *send, ///< The frame to send, CRC_A appended if needed.
+	PCD_Frame *back, ///< NULL or the frame to receive the response in.
+	bool checkCRC	 ///< In: True => The last two uint8_ts of the response is
+				  ///assumed to be a CRC_A that must be validated.
 	) {
-	uint8_t validBits;
-	StatusCode status;
+	uint8_t waitIRq = 0x30; // RxIRq and IdleIRq
+	uint8_t validBits = send->validBits;
+	uint8_t *backData = NULL;
+	uint8_t backLen = 0;
 
-	if (bufferATQA == NULL ||
-		*bufferSize < 2) { // The ATQA response is 2 uint8_ts long.
-		return STATUS_NO_ROOM;
-	}
-	PCD_ClearRegisterBitMask(mfrc, CollReg, 0x80); // ValuesAfterColl=1 => Bits
-												   // received after collision
-												   // are cleared.
-	validBits = 7; // For REQA and WUPA we need the short frame format -
-				   // transmit only 7 bits of the last (and only) uint8_t.
-				   // TxLastBits = BitFramingReg[2..0]
-	status = PCD_TransceiveData(mfrc, &command, 1, bufferATQA, bufferSize,
-								&validBits, 0, false);
-	if (status != STATUS_OK) {
-		return status;
+	if (back) {
+		uint16_t room = back->size + (checkCRC ? PCD_FRAME_TAILROOM : 0);
+		backData = back->data;
+		backLen = room < 0xFF ? room : 0xFF;
 	}
-	if (*bufferSize != 2 || validBits != 0) { // ATQA must be exactly 16 bits.
-		return STATUS_ERROR;
+	StatusCode status =
+		PCD_Communicate(mfrc, PCD_Transceive, waitIRq, send->data,
+						send->length, backData, back ? &backLen : NULL,
+						&validBits, 0, checkCRC, true);
+	if (back) {
+		back->length = 0;
+		back->validBits = validBits;
+		if (status == STATUS_OK) {
+			back->length = checkCRC ? backLen - 2 : backLen;
+		}
 	}
+	return status;
+} // End PCD_TransceiveFrame()
+
+/**
+ * Asynchronous variant of PCD_CommunicateWithPICC(). Loads the FIFO, starts
+ * the command and returns without waiting. Drive the exchange with
+ * PCD_PollCommunication() until it stops returning STATUS_PENDING.
+ * All buffers must stay valid until the exchange has completed.
+ *
+ * @return STATUS_OK if the command was started, STATUS_PENDING if another
+ * exchange is still running.
+ */
+StatusCode PCD_StartCommunicateWithPICC(
+	MFRC522Ptr_t mfrc,
+	uint8_t command, ///< The command to execute. One of the PCD_Command enums.
+	uint8_t waitIRq, ///< The bits in the ComIrqReg register that signals
+					 ///successful completion of the command.
+	uint8_t *sendData,  ///< Pointer to the data to transfer to the FIFO.
+	uint8_t sendLen,	///< Number of uint8_ts to transfer to the FIFO.
+	uint8_t *backData,  ///< NULL or pointer to buffer if data should be read
+						///back after executing the command.
+	uint8_t *backLen,   ///< In: Max number of uint8_ts to write to *backData.
+						///Out: The number of uint8_ts returned.
+	uint8_t *validBits, ///< In/Out: The number of valid bits in the last
+						///uint8_t. 0 for 8 valid bits.
+	uint8_t rxAlign,	///< In: Defines the bit position in backData[0] for the
+						///first bit received.
+	bool checkCRC, ///< In: True => The last two uint8_ts of the response is
+				   ///assumed to be a CRC_A that must be validated.
+	PCD_CompletionCallback callback, ///< NULL or function called once the
+									 ///exchange has completed.
+	void *context ///< Passed to callback unchanged.
+	) {
+	if (mfrc->exchange.active) {
+		return STATUS_PENDING;
+	}
+	mfrc->exchange.callback = callback;
+	mfrc->exchange.context = context;
+	PCD_BeginExchange(mfrc, command, waitIRq, sendData, sendLen, backData,
+					  backLen, validBits, rxAlign, checkCRC, false);
+	mfrc->exchange.active = true;
 	return STATUS_OK;
-} // End PICC_REQA_or_WUPA()
+} // End PCD_StartCommunicateWithPICC()
 
 /**
- * Transmits SELECT/ANTICOLLISION commands to select a single PICC.
- * Before calling this function the PICCs must be placed in the READY(*) state
- *by calling PICC_RequestA() or PICC_WakeupA().
- * On success:
- *		- The chosen PICC is in state ACTIVE(*) and all other PICCs have returned
- *to state IDLE/HALT. (Figure 7 of the ISO/IEC 14443-3 draft.)
- *		- The UID size and value of the chosen PICC is returned in *uid along with
- *the SAK.
+ * Asynchronous variant of PCD_TransceiveData(), see
+ * PCD_StartCommunicateWithPICC().
  *
- * A PICC UID consists of 4, 7 or 10 uint8_ts.
- * Only 4 uint8_ts can be specified in a SELECT command, so for the longer UIDs
- *two or three iterations are used:
- *		UID size	Number of UID uint8_ts		Cascade levels		Example of
- *PICC
- *		========	===================		==============		===============
- *		single				 4						1				MIFARE
- *Classic
- *		double				 7						2				MIFARE
- *Ultralight
- *		triple				10						3				Not currently in
- *use?
+ * @return STATUS_OK if the transceive was started, STATUS_PENDING if another
+ * exchange is still running.
+ */
+StatusCode PCD_StartTransceiveData(MFRC522Ptr_t mfrc, uint8_t *sendData,
+								   uint8_t sendLen, uint8_t *backData,
+								   uint8_t *backLen, uint8_t *validBits,
+								   uint8_t rxAlign, bool checkCRC,
+								   PCD_CompletionCallback callback,
+								   void *context) {
+	uint8_t waitIRq = 0x30; // RxIRq and IdleIRq
+	return PCD_StartCommunicateWithPICC(mfrc, PCD_Transceive, waitIRq, sendData,
+										sendLen, backData, backLen, validBits,
+										rxAlign, checkCRC, callback, context);
+} // End PCD_StartTransceiveData()
+
+/**
+ * Checks on the exchange started by PCD_StartCommunicateWithPICC(). Costs a
+ * single register read, or nothing but a GPIO read while the IRQ pin is
+ * idle. When the exchange has completed the response is fetched, the
+ * callback is called and the final status is returned.
  *
- * @return STATUS_OK on success, STATUS_??? otherwise.
+ * @return STATUS_PENDING while the command is still running, otherwise the
+ * result of the exchange. STATUS_INVALID if no exchange was started.
  */
-StatusCode PICC_Select(MFRC522Ptr_t mfrc,
-					   Uid *uid, ///< Pointer to Uid struct. Normally output,
-								 ///but can also be used to supply a known UID.
-					   uint8_t validBits ///< The number of known UID bits
-										 ///supplied in *uid. Normally 0. If set
-										 ///you must also supply uid->size.
-					   ) {
-	//		validBits=0;
-
-	bool uidComplete;
-	bool selectDone;
-	bool useCascadeTag;
-	uint8_t cascadeLevel = 1;
-	StatusCode result;
-	uint8_t count;
-	uint8_t index;
-	uint8_t uidIndex; // The first index in uid->uiduint8_t[] that is used in
-					  // the current Cascade Level.
-	int8_t currentLevelKnownBits; // The number of known UID bits in the current
-								  // Cascade Level.
-	uint8_t buffer[9];  // The SELECT/ANTICOLLISION commands uses a 7 uint8_t
-						// standard frame + 2 uint8_ts CRC_A
-	uint8_t bufferUsed; // The number of uint8_ts used in the buffer, ie the
-						// number of uint8_ts to transfer to the FIFO.
-	uint8_t rxAlign; // Used in BitFramingReg. Defines the bit position for the
-					 // first bit received.
-	uint8_t txLastBits; // Used in BitFramingReg. The number of valid bits in
-						// the last transmitted uint8_t.
-	uint8_t *responseBuffer;
-	uint8_t responseLength;
-
-	// Description of buffer structure:
-	//		uint8_t 0: SEL				Indicates the Cascade Level: PICC_CMD_SEL_CL1,
-	//PICC_CMD_SEL_CL2 or PICC_CMD_SEL_CL3
-	//		uint8_t 1: NVB					Number of Valid Bits (in complete command, not
-	//just the UID): High nibble: complete uint8_ts, Low nibble: Extra bits.
-	//		uint8_t 2: UID-data or CT		See explanation below. CT means Cascade
-	//Tag.
-	//		uint8_t 3: UID-data
-	//		uint8_t 4: UID-data
-	//		uint8_t 5: UID-data
-	//		uint8_t 6: BCC					Block Check Character - XOR of uint8_ts
-	//2-5
-	//		uint8_t 7: CRC_A
-	//		uint8_t 8: CRC_A
-	// The BCC and CRC_A are only transmitted if we know all the UID bits of the
-	// current Cascade Level.
-	//
-	// Description of uint8_ts 2-5: (Section 6.5.4 of the ISO/IEC 14443-3 draft:
-	// UID contents and cascade levels)
-	//		UID size	Cascade level	uint8_t2	uint8_t3	uint8_t4
-	//uint8_t5
-	//		========	=============	=====	=====	=====	=====
-	//		 4 uint8_ts		1			uid0	uid1	uid2	uid3
-	//		 7 uint8_ts		1			CT		uid0	uid1	uid2
-	//						2			uid3	uid4	uid5	uid6
-	//		10 uint8_ts		1			CT		uid0	uid1	uid2
-	//						2			CT		uid3	uid4	uid5
-	//						3			uid6	uid7	uid8	uid9
-
-	// Sanity checks
-	if (validBits > 80) {
+StatusCode PCD_PollCommunication(MFRC522Ptr_t mfrc) {
+	PCD_Exchange *x = &mfrc->exchange;
+	uint8_t n = 0;
+
+	if (!x->active) {
 		return STATUS_INVALID;
 	}
+	bool expired = time_reached(x->deadline);
+	if (mfrc->irqPin >= 0 && gpio_get(mfrc->irqPin) && !expired) {
+		return STATUS_PENDING;
+	}
+	PCD_STAT_ADD(mfrc, irqWaitIterations, 1);
+	n = PCD_ReadRegister(mfrc, ComIrqReg);
+	if (!(n & (x->waitIRq | 0x01)) && !expired) {
+		return STATUS_PENDING;
+	}
 
-	// Prepare MFRC522
-	PCD_ClearRegisterBitMask(mfrc, CollReg, 0x80); // ValuesAfterColl=1 => Bits
-												   // received after collision
-												   // are cleared.
-
-	// Repeat Cascade Level loop until we have a complete UID.
-	uidComplete = false;
-	while (!uidComplete) {
-		// Set the Cascade Level in the SEL uint8_t, find out if we need to use
-		// the Cascade Tag in uint8_t 2.
-		switch (cascadeLevel) {
-		case 1:
-			buffer[0] = PICC_CMD_SEL_CL1;
-			uidIndex = 0;
-			useCascadeTag =
-				validBits &&
-				uid->size >
-					4; // When we know that the UID has more than 4 uint8_ts
-			break;
+	x->active = false;
+	StatusCode status = PCD_EndExchange(mfrc, n);
+	if (x->callback) {
+		x->callback(mfrc, status, x->context);
+	}
+	return status;
+} // End PCD_PollCommunication()
 
-		case 2:
-			buffer[0] = PICC_CMD_SEL_CL2;
-			uidIndex = 3;
-			useCascadeTag =
-				validBits &&
-				uid->size >
-					7; // When we know that the UID has more than 7 uint8_ts
-			break;
+/**
+ * Cancels a running asynchronous exchange without calling its callback.
+ */
+void PCD_AbortCommunication(MFRC522Ptr_t mfrc) {
+	if (!mfrc->exchange.active) {
+		return;
+	}
+	mfrc->exchange.active = false;
+	PCD_WriteRegister(mfrc, CommandReg, PCD_Idle); // Stop any active command.
+	if (mfrc->irqPin >= 0) {
+		PCD_WriteRegister(mfrc, ComIEnReg, 0x80);
+	}
+} // End PCD_AbortCommunication()
 
-		case 3:
-			buffer[0] = PICC_CMD_SEL_CL3;
-			uidIndex = 6;
-			useCascadeTag = false; // Never used in CL3.
-			break;
+/**
+ * Moves what the FIFO holds to backData[*received..], at most backSize
+ * uint8_ts in total.
+ *
+ * @return false if the response does not fit in backData.
+ */
+static bool MFRC522_HOT(PCD_DrainFIFO)(MFRC522Ptr_t mfrc, uint8_t *backData,
+									   uint16_t backSize, uint16_t *received) {
+	uint8_t level = PCD_ReadRegister(mfrc, FIFOLevelReg) & 0x7F;
+	if (level == 0) {
+		return true;
+	}
+	if (*received + level > backSize) {
+		return false;
+	}
+	PCD_ReadNRegister(mfrc, FIFODataReg, level, &backData[*received], 0);
+	*received += level;
+	return true;
+}
+
+/**
+ * Executes the Transceive command for frames longer than the FIFO, in both
+ * directions. While sending, the FIFO is refilled each time LoAlert reports
+ * that it holds MFRC522_FIFO_WATER_LEVEL uint8_ts or less. While receiving,
+ * it is emptied each time HiAlert reports that it holds
+ * FIFO_SIZE - MFRC522_FIFO_WATER_LEVEL uint8_ts or more. Frames up to
+ * FSD = 256 (ISO/IEC 14443-4) and long FAST_READ responses fit.
+ * The CRC_A is checked on the MCU because the coprocessor only sees the
+ * FIFO.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MFRC522_HOT(PCD_TransceiveStream)(
+	MFRC522Ptr_t mfrc,
+	uint8_t *sendData, ///< Pointer to the data to send.
+	uint16_t sendLen,  ///< Number of uint8_ts to send.
+	uint8_t *backData, ///< Buffer for the response.
+	uint16_t *backLen, ///< In: Max number of uint8_ts to write to *backData.
+					   ///Out: The number of uint8_ts returned.
+	bool checkCRC ///< In: True => The last two uint8_ts of the response is
+				  ///assumed to be a CRC_A that must be validated.
+	) {
+	uint8_t waitIRq = 0x30; // RxIRq and IdleIRq
+	uint16_t sent = sendLen < FIFO_SIZE ? sendLen : FIFO_SIZE;
+	uint16_t received = 0;
+	bool receiving = false;
+	StatusCode status = STATUS_OK;
+	uint8_t n;
 
-		default:
-			return STATUS_INTERNAL_ERROR;
+	if (mfrc->exchange.active) { // An asynchronous exchange owns the FIFO
+		return STATUS_PENDING;
+	}
+	PCD_WriteRegister(mfrc, WaterLevelReg, MFRC522_FIFO_WATER_LEVEL);
+	PCD_BeginExchange(mfrc, PCD_Transceive, waitIRq, sendData, sent, NULL,
+					  NULL, NULL, 0, false, false);
+	PCD_WriteRegister(mfrc, ComIrqReg, 0x04); // LoAlertIRq latched on flush
+
+	// The deadline restarts with the timeout of the exchange whenever data
+	// moves, long frames take longer than one timeout
+	uint32_t restartUs = MFRC522_IRQ_TIMEOUT_US + mfrc->exchange.timeoutUs;
+	absolute_time_t deadline = mfrc->exchange.deadline;
+	for (;;) {
+		// Refill on LoAlertIRq, then wait for TxIRq, then drain on
+		// HiAlertIRq
+		uint8_t phaseIRq = receiving ? 0x08 : (sent < sendLen ? 0x04 : 0x40);
+		int64_t remaining = absolute_time_diff_us(get_absolute_time(), deadline);
+		if (mfrc->irqPin >= 0 && remaining > 0) {
+			PCD_WriteRegister(mfrc, ComIEnReg, 0x80 | waitIRq | phaseIRq | 0x01);
+			PCD_WaitIrqPin(mfrc, remaining);
+		}
+		PCD_STAT_ADD(mfrc, irqWaitIterations, 1);
+		n = PCD_ReadRegister(mfrc, ComIrqReg);
+		if (n & waitIRq) { // Done, collect the rest below
 			break;
 		}
-
-		// How many UID bits are known in this Cascade Level?
-		currentLevelKnownBits = validBits - (8 * uidIndex);
-		if (currentLevelKnownBits < 0) {
-			currentLevelKnownBits = 0;
+		if (n & phaseIRq & 0x04) { // LoAlertIRq
+			uint8_t room =
+				FIFO_SIZE - (PCD_ReadRegister(mfrc, FIFOLevelReg) & 0x7F);
+			uint16_t chunk = sendLen - sent < room ? sendLen - sent : room;
+			PCD_WriteNRegister(mfrc, FIFODataReg, chunk, &sendData[sent]);
+			sent += chunk;
+			PCD_WriteRegister(mfrc, ComIrqReg, 0x04); // Clear LoAlertIRq
+			deadline = make_timeout_time_us(restartUs);
+			continue;
 		}
-		// Copy the known bits from uid->uiduint8_t[] to buffer[]
-		index = 2; // destination index in buffer[]
-		if (useCascadeTag) {
-			buffer[index++] = PICC_CMD_CT;
+		if (n & phaseIRq & 0x40) { // TxIRq, the FIFO now only gets response
+			receiving = true;
+			PCD_WriteRegister(mfrc, ComIrqReg, 0x08); // HiAlertIRq from TX
+			continue;
 		}
-		uint8_t uint8_tsToCopy =
-			currentLevelKnownBits / 8 +
-			(currentLevelKnownBits % 8 ? 1 : 0); // The number of uint8_ts
-												 // needed to represent the
-												 // known bits for this level.
-		if (uint8_tsToCopy) {
-			uint8_t maxuint8_ts =
-				useCascadeTag ? 3 : 4; // Max 4 uint8_ts in each Cascade Level.
-									   // Only 3 left if we use the Cascade Tag
-			if (uint8_tsToCopy > maxuint8_ts) {
-				uint8_tsToCopy = maxuint8_ts;
+		if (n & phaseIRq & 0x08) { // HiAlertIRq
+			uint16_t before = received;
+			if (!PCD_DrainFIFO(mfrc, backData, *backLen, &received)) {
+				status = STATUS_NO_ROOM;
+				break;
 			}
-			for (count = 0; count < uint8_tsToCopy; count++) {
-				buffer[index++] = uid->uidByte[uidIndex + count];
+			PCD_WriteRegister(mfrc, ComIrqReg, 0x08); // Clear HiAlertIRq
+			if (received != before) {
+				deadline = make_timeout_time_us(restartUs);
 			}
+			continue;
 		}
-		// Now that the data has been copied we need to include the 8 bits in CT
-		// in currentLevelKnownBits
-		if (useCascadeTag) {
-			currentLevelKnownBits += 8;
+		if ((n & 0x01) || time_reached(deadline)) { // Nothing received
+			status = STATUS_TIMEOUT;
+			break;
 		}
+	}
 
-		// Repeat anti collision loop until we can transmit all UID bits + BCC
-		// and receive a SAK - max 32 iterations.
-		selectDone = false;
-		while (!selectDone) {
-			// Find out how many bits and uint8_ts to send and receive.
-			if (currentLevelKnownBits >= 32) { // All UID bits in this Cascade
-											   // Level are known. This is a
-											   // SELECT.
-				// printf(F("SELECT: currentLevelKnownBits="));
-				// printf(currentLevelKnownBits, DEC);
-				buffer[1] =
-					0x70; // NVB - Number of Valid Bits: Seven whole uint8_ts
-				// Calculate BCC - Block Check Character
-				buffer[6] = buffer[2] ^ buffer[3] ^ buffer[4] ^ buffer[5];
-				// Calculate CRC_A
-				result = PCD_CalculateCRC(mfrc, buffer, 7, &buffer[7]);
-				if (result != STATUS_OK) {
-					return result;
-				}
-				txLastBits = 0; // 0 => All 8 bits are valid.
-				bufferUsed = 9;
-				// Store response in the last 3 uint8_ts of buffer (BCC and
-				// CRC_A - not needed after tx)
-				responseBuffer = &buffer[6];
-				responseLength = 3;
-			} else { // This is an ANTICOLLISION.
-				// printf(F("ANTICOLLISION: currentLevelKnownBits="));
-				// printf(currentLevelKnownBits, DEC);
-				txLastBits = currentLevelKnownBits % 8;
-				count = currentLevelKnownBits /
-						8;		   // Number of whole uint8_ts in the UID part.
-				index = 2 + count; // Number of whole uint8_ts: SEL + NVB + UIDs
-				buffer[1] =
-					(index << 4) + txLastBits; // NVB - Number of Valid Bits
-				bufferUsed = index + (txLastBits ? 1 : 0);
-				// Store response in the unused part of buffer
-				responseBuffer = &buffer[index];
-				responseLength = sizeof(buffer) - index;
-			}
-
-			// Set bit adjustments
-			rxAlign = txLastBits; // Having a separate variable is overkill. But
-								  // it makes the next line easier to read.
-			PCD_WriteRegister(mfrc, BitFramingReg,
-							  (rxAlign << 4) +
-								  txLastBits); // RxAlign = BitFramingReg[6..4].
-											   // TxLastBits =
-											   // BitFramingReg[2..0]
-
-			// Transmit the buffer and receive the response.
-			result = PCD_TransceiveData(mfrc, buffer, bufferUsed,
-										responseBuffer, &responseLength,
-										&txLastBits, rxAlign, false);
-			if (result == STATUS_COLLISION) { // More than one PICC in the field
-											  // => collision.
-				uint8_t valueOfCollReg = PCD_ReadRegister(
-					mfrc, CollReg); // CollReg[7..0] bits are: ValuesAfterColl
-									// reserved CollPosNotValid CollPos[4:0]
-				if (valueOfCollReg & 0x20) { // CollPosNotValid
-					return STATUS_COLLISION; // Without a valid collision
-											 // position we cannot continue
-				}
-				uint8_t collisionPos =
-					valueOfCollReg & 0x1F; // Values 0-31, 0 means bit 32.
-				if (collisionPos == 0) {
-					collisionPos = 32;
-				}
-				if (collisionPos <=
-					currentLevelKnownBits) { // No progress - should not happen
-					return STATUS_INTERNAL_ERROR;
-				}
-				// Choose the PICC with the bit set.
-				currentLevelKnownBits = collisionPos;
-				count = (currentLevelKnownBits - 1) % 8; // The bit to modify
-				index = 1 + (currentLevelKnownBits / 8) +
-						(count ? 1 : 0); // First uint8_t is index 0.
-				buffer[index] |= (1 << count);
-			} else if (result != STATUS_OK) {
-				return result;
-			} else {							   // STATUS_OK
-				if (currentLevelKnownBits >= 32) { // This was a SELECT.
-					selectDone = true;			   // No more anticollision
-					// We continue below outside the while.
-				} else { // This was an ANTICOLLISION.
-					// We now have all 32 bits of the UID in this Cascade Level
-					currentLevelKnownBits = 32;
-					// Run loop again to do the SELECT.
-				}
-			}
-		} // End of while (!selectDone)
-
-		// We do not check the CBB - it was constructed by us above.
-
-		// Copy the found UID uint8_ts from buffer[] to uid->uiduint8_t[]
-		index = (buffer[2] == PICC_CMD_CT) ? 3 : 2; // source index in buffer[]
-		uint8_tsToCopy = (buffer[2] == PICC_CMD_CT) ? 3 : 4;
-		for (count = 0; count < uint8_tsToCopy; count++) {
-			uid->uidByte[uidIndex + count] = buffer[index++];
-		}
-
-		// Check response SAK (Select Acknowledge)
-		if (responseLength != 3 ||
-			txLastBits !=
-				0) { // SAK must be exactly 24 bits (1 uint8_t + CRC_A).
-			return STATUS_ERROR;
-		}
-		// Verify CRC_A - do our own calculation and store the control in
-		// buffer[2..3] - those uint8_ts are not needed anymore.
-		result = PCD_CalculateCRC(mfrc, responseBuffer, 1, &buffer[2]);
-		if (result != STATUS_OK) {
-			return result;
-		}
-		if ((buffer[2] != responseBuffer[1]) ||
-			(buffer[3] != responseBuffer[2])) {
-			return STATUS_CRC_WRONG;
-		}
-		if (responseBuffer[0] &
-			0x04) { // Cascade bit set - UID not complete yes
-			cascadeLevel++;
+	if (mfrc->irqPin >= 0) {
+		PCD_WriteRegister(mfrc, ComIEnReg, 0x80);
+	}
+	uint8_t _validBits = 0;
+	if (status == STATUS_OK) {
+		uint8_t errorRegValue = PCD_ReadRegister(mfrc, ErrorReg);
+		if (errorRegValue & 0x13) { // BufferOvfl ParityErr ProtocolErr
+			status = STATUS_ERROR;
+		} else if (!PCD_DrainFIFO(mfrc, backData, *backLen, &received)) {
+			status = STATUS_NO_ROOM;
+		} else if (errorRegValue & 0x08) { // CollErr
+			status = STATUS_COLLISION;
+		} else if (errorRegValue & 0x04) { // CRCErr, with RxCRCEn set
+			status = STATUS_CRC_WRONG;
 		} else {
-			uidComplete = true;
-			uid->sak = responseBuffer[0];
+			_validBits = PCD_ReadRegister(mfrc, ControlReg) & 0x07;
 		}
-	} // End of while (!uidComplete)
-
-	// Set correct uid->size
-	uid->size = 3 * cascadeLevel + 1;
-
-	return STATUS_OK;
-} // End PICC_Select()
-
-/**
- * Instructs a PICC in state ACTIVE(*) to go to state HALT.
- *
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode PICC_HaltA(MFRC522Ptr_t mfrc) {
-	StatusCode result;
-	uint8_t buffer[4];
-
-	// Build command buffer
-	buffer[0] = PICC_CMD_HLTA;
-	buffer[1] = 0;
-	// Calculate CRC_A
-	result = PCD_CalculateCRC(mfrc, buffer, 2, &buffer[2]);
-	if (result != STATUS_OK) {
-		return result;
-	}
-
-	// Send the command.
-	// The standard says:
-	//		If the PICC responds with any modulation during a period of 1 ms after
-	//the end of the frame containing the
-	//		HLTA command, this response shall be interpreted as 'not
-	//acknowledge'.
-	// We interpret that this way: Only STATUS_TIMEOUT is a success.
-	result = PCD_TransceiveData(mfrc, buffer, sizeof(buffer), NULL, 0, NULL, 0,
-								false);
-	if (result == STATUS_TIMEOUT) {
-		return STATUS_OK;
 	}
-	if (result == STATUS_OK) { // That is ironically NOT ok in this case ;-)
-		return STATUS_ERROR;
+	if (status != STATUS_OK) {
+		PCD_WriteRegister(mfrc, CommandReg, PCD_Idle);
 	}
-	return result;
-} // End PICC_HaltA()
+	PCD_WriteRegister(mfrc, WaterLevelReg, 0x08); // Reset value
+	*backLen = received;
 
-/*******************************************************************************
-*Functions for communicating with MIFARE PICCs
-*******************************************************************************/
+	if (status == STATUS_OK && received == 1 && _validBits == 4) {
+		status = STATUS_MIFARE_NACK; // 4 bit NAK
+	} else if (status == STATUS_OK && checkCRC) {
+		uint8_t controlBuffer[2];
+		if (received < 2 || _validBits != 0) {
+			status = STATUS_CRC_WRONG;
+		} else {
+			PCD_SoftwareCRC(backData, received - 2, controlBuffer);
+			if (backData[received - 2] != controlBuffer[0] ||
+				backData[received - 1] != controlBuffer[1]) {
+				status = STATUS_CRC_WRONG;
+			}
+		}
+	}
+#if MFRC522_STATS
+	PCD_StatsRecordExchange(mfrc, status);
+#endif
+	return status;
+} // End PCD_TransceiveStream()
 
 /**
  * Executes the MFRC522 MFAuthent command.
@@ -1023,8 +2065,13 @@ StatusCode PCD_Authenticate(
 	}
 
 	// Start the authentication.
-	return PCD_CommunicateWithPICC(mfrc, PCD_MFAuthent, waitIRq, &sendData[0],
-								   sizeof(sendData), NULL, 0, 0, 0, false);
+	StatusCode status =
+		PCD_CommunicateWithPICC(mfrc, PCD_MFAuthent, waitIRq, &sendData[0],
+								sizeof(sendData), NULL, 0, 0, 0, false);
+	if (status != STATUS_OK) {
+		PCD_STAT_ADD(mfrc, authFailures, 1);
+	}
+	return status;
 } // End PCD_Authenticate()
 
 /**
@@ -1041,1237 +2088,16 @@ void PCD_StopCrypto1(MFRC522Ptr_t mfrc) {
 													  // ModemState[2:0]
 } // End PCD_StopCrypto1()
 
-/**
- * Reads 16 uint8_ts (+ 2 uint8_ts CRC_A) from the active PICC.
- *
- * For MIFARE Classic the sector containing the block must be authenticated
- *before calling this function.
- *
- * For MIFARE Ultralight only addresses 00h to 0Fh are decoded.
- * The MF0ICU1 returns a NAK for higher addresses.
- * The MF0ICU1 responds to the READ command by sending 16 uint8_ts starting from
- *the page address defined by the command argument.
- * For example; if blockAddr is 03h then pages 03h, 04h, 05h, 06h are returned.
- * A roll-back is implemented: If blockAddr is 0Eh, then the contents of pages
- *0Eh, 0Fh, 00h and 01h are returned.
- *
- * The buffer must be at least 18 uint8_ts because a CRC_A is also returned.
- * Checks the CRC_A before returning STATUS_OK.
- *
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode MIFARE_Read(MFRC522Ptr_t mfrc,
-					   uint8_t blockAddr, ///< MIFARE Classic: The block
-										  ///(0-0xff) number. MIFARE Ultralight:
-										  ///The first page to return data from.
-					   uint8_t *buffer,   ///< The buffer to store the data in
-					   uint8_t *bufferSize ///< Buffer size, at least 18
-										   ///uint8_ts. Also number of uint8_ts
-										   ///returned if STATUS_OK.
-					   ) {
-	StatusCode result;
-
-	// Sanity check
-	if (buffer == NULL || *bufferSize < 18) {
-		return STATUS_NO_ROOM;
-	}
-
-	// Build command buffer
-	buffer[0] = PICC_CMD_MF_READ;
-	buffer[1] = blockAddr;
-	// Calculate CRC_A
-	result = PCD_CalculateCRC(mfrc, buffer, 2, &buffer[2]);
-	if (result != STATUS_OK) {
-		return result;
-	}
-
-	// Transmit the buffer and receive the response, validate CRC_A.
-	return PCD_TransceiveData(mfrc, buffer, 4, buffer, bufferSize, NULL, 0,
-							  true);
-} // End MIFARE_Read()
-
-/**
- * Writes 16 uint8_ts to the active PICC.
- *
- * For MIFARE Classic the sector containing the block must be authenticated
- *before calling this function.
- *
- * For MIFARE Ultralight the operation is called "COMPATIBILITY WRITE".
- * Even though 16 uint8_ts are transferred to the Ultralight PICC, only the
- *least significant 4 uint8_ts (uint8_ts 0 to 3)
- * are written to the specified address. It is recommended to set the remaining
- *uint8_ts 04h to 0Fh to all logic 0.
- * *
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode
-MIFARE_Write(MFRC522Ptr_t mfrc,
-			 uint8_t blockAddr, ///< MIFARE Classic: The block (0-0xff) number.
-								///MIFARE Ultralight: The page (2-15) to write
-								///to.
-			 uint8_t *buffer,   ///< The 16 uint8_ts to write to the PICC
-			 uint8_t bufferSize ///< Buffer size, must be at least 16 uint8_ts.
-								///Exactly 16 uint8_ts are written.
-			 ) {
-	StatusCode result;
-
-	// Sanity check
-	if (buffer == NULL || bufferSize < 16) {
-		return STATUS_INVALID;
-	}
-
-	// Mifare Classic protocol requires two communications to perform a write.
-	// Step 1: Tell the PICC we want to write to block blockAddr.
-	uint8_t cmdBuffer[2];
-	cmdBuffer[0] = PICC_CMD_MF_WRITE;
-	cmdBuffer[1] = blockAddr;
-	result = PCD_MIFARE_Transceive(
-		mfrc, cmdBuffer, 2,
-		false); // Adds CRC_A and checks that the response is MF_ACK.
-	if (result != STATUS_OK) {
-		return result;
-	}
-
-	// Step 2: Transfer the data
-	result = PCD_MIFARE_Transceive(
-		mfrc, buffer, bufferSize,
-		false); // Adds CRC_A and checks that the response is MF_ACK.
-	if (result != STATUS_OK) {
-		return result;
-	}
-
-	return STATUS_OK;
-} // End MIFARE_Write()
-
-/**
- * Writes a 4 uint8_t page to the active MIFARE Ultralight PICC.
- *
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode MIFARE_Ultralight_Write(
-	MFRC522Ptr_t mfrc,
-	uint8_t page,	  ///< The page (2-15) to write to.
-	uint8_t *buffer,   ///< The 4 uint8_ts to write to the PICC
-	uint8_t bufferSize ///< Buffer size, must be at least 4 uint8_ts. Exactly 4
-					   ///uint8_ts are written.
-	) {
-	StatusCode result;
-
-	// Sanity check
-	if (buffer == NULL || bufferSize < 4) {
-		return STATUS_INVALID;
-	}
-
-	// Build commmand buffer
-	uint8_t cmdBuffer[6];
-	cmdBuffer[0] = PICC_CMD_UL_WRITE;
-	cmdBuffer[1] = page;
-	memcpy(&cmdBuffer[2], buffer, 4);
-
-	// Perform the write
-	result = PCD_MIFARE_Transceive(
-		mfrc, cmdBuffer, 6,
-		false); // Adds CRC_A and checks that the response is MF_ACK.
-	if (result != STATUS_OK) {
-		return result;
-	}
-	return STATUS_OK;
-} // End MIFARE_Ultralight_Write()
-
-/**
- * MIFARE Decrement subtracts the delta from the value of the addressed block,
- *and stores the result in a volatile memory.
- * For MIFARE Classic only. The sector containing the block must be
- *authenticated before calling this function.
- * Only for blocks in "value block" mode, ie with access bits [C1 C2 C3] = [110]
- *or [001].
- * Use MIFARE_Transfer() to store the result in a block.
- *
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode MIFARE_Decrement(
-	MFRC522Ptr_t mfrc,
-	uint8_t blockAddr, ///< The block (0-0xff) number.
-	long delta ///< This number is subtracted from the value of block blockAddr.
-	) {
-	return MIFARE_TwoStepHelper(mfrc, PICC_CMD_MF_DECREMENT, blockAddr, delta);
-} // End MIFARE_Decrement()
-
-/**
- * MIFARE Increment adds the delta to the value of the addressed block, and
- *stores the result in a volatile memory.
- * For MIFARE Classic only. The sector containing the block must be
- *authenticated before calling this function.
- * Only for blocks in "value block" mode, ie with access bits [C1 C2 C3] = [110]
- *or [001].
- * Use MIFARE_Transfer() to store the result in a block.
- *
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode MIFARE_Increment(
-	MFRC522Ptr_t mfrc,
-	uint8_t blockAddr, ///< The block (0-0xff) number.
-	long delta ///< This number is added to the value of block blockAddr.
-	) {
-	return MIFARE_TwoStepHelper(mfrc, PICC_CMD_MF_INCREMENT, blockAddr, delta);
-} // End MIFARE_Increment()
-
-/**
- * MIFARE Restore copies the value of the addressed block into a volatile
- *memory.
- * For MIFARE Classic only. The sector containing the block must be
- *authenticated before calling this function.
- * Only for blocks in "value block" mode, ie with access bits [C1 C2 C3] = [110]
- *or [001].
- * Use MIFARE_Transfer() to store the result in a block.
- *
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode MIFARE_Restore(MFRC522Ptr_t mfrc,
-						  uint8_t blockAddr ///< The block (0-0xff) number.
-						  ) {
-	// The datasheet describes Restore as a two step operation, but does not
-	// explain what data to transfer in step 2.
-	// Doing only a single step does not work, so I chose to transfer 0L in step
-	// two.
-	return MIFARE_TwoStepHelper(mfrc, PICC_CMD_MF_RESTORE, blockAddr, 0L);
-} // End MIFARE_Restore()
-
-/**
- * Helper function for the two-step MIFARE Classic protocol operations
- *Decrement, Increment and Restore.
- *
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode
-MIFARE_TwoStepHelper(MFRC522Ptr_t mfrc,
-					 uint8_t command,   ///< The command to use
-					 uint8_t blockAddr, ///< The block (0-0xff) number.
-					 long data			///< The data to transfer in step 2
-					 ) {
-	StatusCode result;
-	uint8_t cmdBuffer[2]; // We only need room for 2 uint8_ts.
-
-	// Step 1: Tell the PICC the command and block address
-	cmdBuffer[0] = command;
-	cmdBuffer[1] = blockAddr;
-	result = PCD_MIFARE_Transceive(
-		mfrc, cmdBuffer, 2,
-		false); // Adds CRC_A and checks that the response is MF_ACK.
-	if (result != STATUS_OK) {
-		return result;
-	}
-
-	// Step 2: Transfer the data
-	result = PCD_MIFARE_Transceive(
-		mfrc, (uint8_t *)&data, 4,
-		true); // Adds CRC_A and accept timeout as success.
-	if (result != STATUS_OK) {
-		return result;
-	}
-
-	return STATUS_OK;
-} // End MIFARE_TwoStepHelper()
-
-/**
- * MIFARE Transfer writes the value stored in the volatile memory into one
- *MIFARE Classic block.
- * For MIFARE Classic only. The sector containing the block must be
- *authenticated before calling this function.
- * Only for blocks in "value block" mode, ie with access bits [C1 C2 C3] = [110]
- *or [001].
- *
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode MIFARE_Transfer(MFRC522Ptr_t mfrc,
-						   uint8_t blockAddr ///< The block (0-0xff) number.
-						   ) {
-	StatusCode result;
-	uint8_t cmdBuffer[2]; // We only need room for 2 uint8_ts.
-
-	// Tell the PICC we want to transfer the result into block blockAddr.
-	cmdBuffer[0] = PICC_CMD_MF_TRANSFER;
-	cmdBuffer[1] = blockAddr;
-	result = PCD_MIFARE_Transceive(
-		mfrc, cmdBuffer, 2,
-		false); // Adds CRC_A and checks that the response is MF_ACK.
-	if (result != STATUS_OK) {
-		return result;
-	}
-	return STATUS_OK;
-} // End MIFARE_Transfer()
-
-/**
- * Helper routine to read the current value from a Value Block.
- *
- * Only for MIFARE Classic and only for blocks in "value block" mode, that
- * is: with access bits [C1 C2 C3] = [110] or [001]. The sector containing
- * the block must be authenticated before calling this function.
- *
- * @param[in]   blockAddr   The block (0x00-0xff) number.
- * @param[out]  value       Current value of the Value Block.
- * @return STATUS_OK on success, STATUS_??? otherwise.
-  */
-StatusCode MIFARE_GetValue(MFRC522Ptr_t mfrc, uint8_t blockAddr, long *value) {
-	StatusCode status;
-	uint8_t buffer[18];
-	uint8_t size = sizeof(buffer);
-
-	// Read the block
-	status = MIFARE_Read(mfrc, blockAddr, buffer, &size);
-	if (status == STATUS_OK) {
-		// Extract the value
-		//			*value = (long(buffer[3])<<24) | (long(buffer[2])<<16) |
-		//(long(buffer[1])<<8) | long(buffer[0]);
-		//			long l_0 = buffer[0];
-		//			long l_8 = buffer[1]<<8;
-		//			long l_16 = buffer[2]<<16;
-		//			long l_24 = buffer[3]<<24;
-		//			*value =l_24 | l_16 | l_8 | l_0;
-		*value = ((long)(buffer[3]) << 24) | ((long)(buffer[2]) << 16) |
-				 ((long)(buffer[1]) << 8) | (long)(buffer[0]);
-	}
-	return status;
-} // End MIFARE_GetValue()
-
-/**
- * Helper routine to write a specific value into a Value Block.
- *
- * Only for MIFARE Classic and only for blocks in "value block" mode, that
- * is: with access bits [C1 C2 C3] = [110] or [001]. The sector containing
- * the block must be authenticated before calling this function.
- *
- * @param[in]   blockAddr   The block (0x00-0xff) number.
- * @param[in]   value       New value of the Value Block.
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode MIFARE_SetValue(MFRC522Ptr_t mfrc, uint8_t blockAddr, long value) {
-	uint8_t buffer[18];
-
-	// Translate the long into 4 uint8_ts; repeated 2x in value block
-	buffer[0] = buffer[8] = (value & 0xFF);
-	buffer[1] = buffer[9] = (value & 0xFF00) >> 8;
-	buffer[2] = buffer[10] = (value & 0xFF0000) >> 16;
-	buffer[3] = buffer[11] = (value & 0xFF000000) >> 24;
-	// Inverse 4 uint8_ts also found in value block
-	buffer[4] = ~buffer[0];
-	buffer[5] = ~buffer[1];
-	buffer[6] = ~buffer[2];
-	buffer[7] = ~buffer[3];
-	// Address 2x with inverse address 2x
-	buffer[12] = buffer[14] = blockAddr;
-	buffer[13] = buffer[15] = ~blockAddr;
-
-	// Write the whole data block
-	return MIFARE_Write(mfrc, blockAddr, buffer, 16);
-} // End MIFARE_SetValue()
-
-/**
- * Authenticate with a NTAG216.
- *
- * Only for NTAG216. First implemented by Gargantuanman.
- *
- * @param[in]   passWord   password.
- * @param[in]   pACK       result success???.
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode PCD_NTAG216_AUTH(MFRC522Ptr_t mfrc, uint8_t *passWord,
-							uint8_t pACK[]) // Authenticate with 32bit password
-{
-	StatusCode result;
-	uint8_t cmdBuffer[18]; // We need room for 16 uint8_ts data and 2 uint8_ts
-						   // CRC_A.
-
-	cmdBuffer[0] = 0x1B; // Comando de autentificacion
-
-	for (uint8_t i = 0; i < 4; i++)
-		cmdBuffer[i + 1] = passWord[i];
-
-	result = PCD_CalculateCRC(mfrc, cmdBuffer, 5, &cmdBuffer[5]);
-
-	if (result != STATUS_OK) {
-		return result;
-	}
-
-	// Transceive the data, store the reply in cmdBuffer[]
-	uint8_t waitIRq = 0x30; // RxIRq and IdleIRq
-	uint8_t cmdBufferSize = sizeof(cmdBuffer);
-	uint8_t validBits = 0;
-	uint8_t rxlength = 5;
-	result =
-		PCD_CommunicateWithPICC(mfrc, PCD_Transceive, waitIRq, cmdBuffer, 7,
-								cmdBuffer, &rxlength, &validBits, 0, false);
-
-	pACK[0] = cmdBuffer[0];
-	pACK[1] = cmdBuffer[1];
-
-	if (result != STATUS_OK) {
-		return result;
-	}
-
-	return STATUS_OK;
-} // End PCD_NTAG216_AUTH()
-
-/*******************************************************************************
-* Support functions
-*******************************************************************************/
-
-/**
- * Wrapper for MIFARE protocol communication.
- * Adds CRC_A, executes the Transceive command and checks that the response is
- *MF_ACK or a timeout.
- *
- * @return STATUS_OK on success, STATUS_??? otherwise.
- */
-StatusCode
-PCD_MIFARE_Transceive(MFRC522Ptr_t mfrc,
-					  uint8_t *sendData, ///< Pointer to the data to transfer to
-										 ///the FIFO. Do NOT include the CRC_A.
-					  uint8_t sendLen,   ///< Number of uint8_ts in sendData.
-					  bool acceptTimeout ///< True => A timeout is also success
-					  ) {
-	//		acceptTimeout = false;
-
-	StatusCode result;
-	uint8_t cmdBuffer[18]; // We need room for 16 uint8_ts data and 2 uint8_ts
-						   // CRC_A.
-
-	// Sanity check
-	if (sendData == NULL || sendLen > 16) {
-		return STATUS_INVALID;
-	}
-
-	// Copy sendData[] to cmdBuffer[] and add CRC_A
-	memcpy(cmdBuffer, sendData, sendLen);
-	result = PCD_CalculateCRC(mfrc, cmdBuffer, sendLen, &cmdBuffer[sendLen]);
-	if (result != STATUS_OK) {
-		return result;
-	}
-	sendLen += 2;
-
-	// Transceive the data, store the reply in cmdBuffer[]
-	uint8_t waitIRq = 0x30; // RxIRq and IdleIRq
-	uint8_t cmdBufferSize = sizeof(cmdBuffer);
-	uint8_t validBits = 0;
-	result = PCD_CommunicateWithPICC(mfrc, PCD_Transceive, waitIRq, cmdBuffer,
-									 sendLen, cmdBuffer, &cmdBufferSize,
-									 &validBits, 0, false);
-	if (acceptTimeout && result == STATUS_TIMEOUT) {
-		return STATUS_OK;
-	}
-	if (result != STATUS_OK) {
-		return result;
-	}
-	// The PICC must reply with a 4 bit ACK
-	if (cmdBufferSize != 1 || validBits != 4) {
-		return STATUS_ERROR;
-	}
-	if (cmdBuffer[0] != MF_ACK) {
-		return STATUS_MIFARE_NACK;
-	}
-	return STATUS_OK;
-} // End PCD_MIFARE_Transceive()
-
-/**
- * Returns const char pointer to a status code name.
- *
- * @return const char *
- */
-const char *GetStatusCodeName(StatusCode code ///< One of theStatusCode enums.
-							  ) {
-	switch (code) {
-	case STATUS_OK:
-		return "Success.";
-	case STATUS_ERROR:
-		return "Error in communication.";
-	case STATUS_COLLISION:
-		return "Collision detected.";
-	case STATUS_TIMEOUT:
-		return "Timeout in communication.";
-	case STATUS_NO_ROOM:
-		return "A buffer is not big enough.";
-	case STATUS_INTERNAL_ERROR:
-		return "Internal error in the code. Should not happen.";
-	case STATUS_INVALID:
-		return "Invalid argument.";
-	case STATUS_CRC_WRONG:
-		return "The CRC_A does not match.";
-	case STATUS_MIFARE_NACK:
-		return "A MIFARE PICC responded with NAK.";
-	default:
-		return "Unknown error";
-	}
-} // End GetStatusCodeName()
-
-/**
- * Translates the SAK (Select Acknowledge) to a PICC type.
- *
- * @return PICC_Type
- */
-PICC_Type
-PICC_GetType(uint8_t sak ///< The SAK uint8_t returned from PICC_Select().
-			 ) {
-	// http://www.nxp.com/documents/application_note/AN10833.pdf
-	// 3.2 Coding of Select Acknowledge (SAK)
-	// ignore 8-bit (iso14443 starts with LSBit = bit 1)
-	// fixes wrong type for manufacturer Infineon
-	// (http://nfc-tools.org/index.php?title=ISO14443A)
-	sak &= 0x7F;
-	switch (sak) {
-	case 0x04:
-		return PICC_TYPE_NOT_COMPLETE; // UID not complete
-	case 0x09:
-		return PICC_TYPE_MIFARE_MINI;
-	case 0x08:
-		return PICC_TYPE_MIFARE_1K;
-	case 0x18:
-		return PICC_TYPE_MIFARE_4K;
-	case 0x00:
-		return PICC_TYPE_MIFARE_UL;
-	case 0x10:
-	case 0x11:
-		return PICC_TYPE_MIFARE_PLUS;
-	case 0x01:
-		return PICC_TYPE_TNP3XXX;
-	case 0x20:
-		return PICC_TYPE_ISO_14443_4;
-	case 0x40:
-		return PICC_TYPE_ISO_18092;
-	default:
-		return PICC_TYPE_UNKNOWN;
-	}
-} // End PICC_GetType()
-
-/**
- * Returns const char pointer to the PICC type name.
- *
- * @return const char *
- */
-const char *PICC_GetTypeName(PICC_Type piccType ///< One of the PICC_Type enums.
-							 ) {
-	switch (piccType) {
-	case PICC_TYPE_ISO_14443_4:
-		return "PICC compliant with ISO/IEC 14443-4";
-	case PICC_TYPE_ISO_18092:
-		return "PICC compliant with ISO/IEC 18092 (NFC)";
-	case PICC_TYPE_MIFARE_MINI:
-		return "MIFARE Mini, 320 bytes";
-	case PICC_TYPE_MIFARE_1K:
-		return "MIFARE 1KB";
-	case PICC_TYPE_MIFARE_4K:
-		return "MIFARE 4KB";
-	case PICC_TYPE_MIFARE_UL:
-		return "MIFARE Ultralight or Ultralight C";
-	case PICC_TYPE_MIFARE_PLUS:
-		return "MIFARE Plus";
-	case PICC_TYPE_TNP3XXX:
-		return "MIFARE TNP3XXX";
-	case PICC_TYPE_NOT_COMPLETE:
-		return "SAK indicates UID is not complete.";
-	case PICC_TYPE_UNKNOWN:
-	default:
-		return "Unknown type";
-	}
-} // End PICC_GetTypeName()
-
-/**
- * Dumps debug info about the connected PCD to Serial.
- * Shows all known firmware versions
- */
-void PCD_DumpVersionToSerial(MFRC522Ptr_t mfrc) {
-	char string[2];
-	// Get the MFRC522 firmware version
-	uint8_t v = PCD_ReadRegister(mfrc, VersionReg);
-	printf("Firmware Version: 0x");
-	// print the hexa value of a unsigned char
-	sprintf(string, "%02X", (char)v);
-	printf(string);
-	// Lookup which version
-	switch (v) {
-	case 0x88:
-		printf(" = (clone)\r\n");
-		break;
-	case 0x90:
-		printf(" = v0.0\r\n");
-		break;
-	case 0x91:
-		printf(" = v1.0\r\n");
-		break;
-	case 0x92:
-		printf(" = v2.0\r\n");
-		break;
-	default:
-		printf(" = (unknown)\r\n");
-	}
-	// When 0x00 or 0xFF is returned, communication probably failed
-	if ((v == 0x00) || (v == 0xFF))
-		printf("WARNING: Communication failure, is the MFRC522 properly "
-				 "connected?\r\n");
-} // End PCD_DumpVersionToSerial()
-
-/**
- * Dumps debug info about the selected PICC to Serial.
- * On success the PICC is halted after dumping the data.
- * For MIFARE Classic the factory default key of 0xFFFFFFFFFFFF is tried.
- */
-void PICC_DumpToSerial(MFRC522Ptr_t mfrc, Uid *uid ///< Pointer to Uid struct
-												   ///returned from a successful
-												   ///PICC_Select().
-					   ) {
-	MIFARE_Key key;
-
-	// Dump UID, SAK and Type
-	PICC_DumpDetailsToSerial(uid);
-
-	// Dump contents
-	PICC_Type piccType = PICC_GetType(uid->sak);
-	switch (piccType) {
-	case PICC_TYPE_MIFARE_MINI:
-	case PICC_TYPE_MIFARE_1K:
-	case PICC_TYPE_MIFARE_4K:
-		// All keys are set to FFFFFFFFFFFFh at chip delivery from the factory.
-		for (uint8_t i = 0; i < 6; i++) {
-			key.keybyte[i] = 0xFF;
-		}
-		PICC_DumpMifareClassicToSerial(mfrc, uid, piccType, &key);
-		break;
-
-	case PICC_TYPE_MIFARE_UL:
-		PICC_DumpMifareUltralightToSerial(mfrc);
-		break;
-
-	case PICC_TYPE_ISO_14443_4:
-	case PICC_TYPE_ISO_18092:
-	case PICC_TYPE_MIFARE_PLUS:
-	case PICC_TYPE_TNP3XXX:
-		printf(
-			"Dumping memory contents not implemented for that PICC type.\r\n");
-		break;
-
-	case PICC_TYPE_UNKNOWN:
-	case PICC_TYPE_NOT_COMPLETE:
-	default:
-		break; // No memory dump here
-	}
-
-	printf("\r\n");
-	PICC_HaltA(mfrc); // Already done if it was a MIFARE Classic PICC.
-} // End PICC_DumpToSerial()
-
-/**
- * Dumps card info (UID,SAK,Type) about the selected PICC to Serial.
- */
-void PICC_DumpDetailsToSerial(Uid *uid ///< Pointer to Uid struct returned from
-									   ///a successful PICC_Select().
-							  ) {
-	char string[2];
-	// UID
-	printf("Card UID:");
-	for (uint8_t i = 0; i < uid->size; i++) {
-		if (uid->uidByte[i] < 0x10)
-			printf(" 0");
-		else
-			printf(" ");
-
-		// print the hexa value of a unsigned char
-		sprintf(string, "%02X", (char)uid->uidByte[i]);
-		printf(string);
-	}
-	printf("\r\n");
-
-	// SAK
-	printf("Card SAK: ");
-	if (uid->sak < 0x10)
-		printf("0");
-
-	// print the hexa value of a unsigned char
-	sprintf(string, "%02X", (char)uid->sak);
-	printf(string);
-
-	// (suggested) PICC type
-	PICC_Type piccType = PICC_GetType(uid->sak);
-	printf(" PICC type: ");
-	printf(PICC_GetTypeName(piccType));
-} // End PICC_DumpDetailsToSerial()
-
-/**
- * Dumps memory contents of a MIFARE Classic PICC.
- * On success the PICC is halted after dumping the data.
- */
-void PICC_DumpMifareClassicToSerial(
-	MFRC522Ptr_t mfrc,
-	Uid *uid,			///< Pointer to Uid struct returned from a successful
-						///PICC_Select().
-	PICC_Type piccType, ///< One of the PICC_Type enums.
-	MIFARE_Key *key		///< Key A used for all sectors.
-	) {
-	uint8_t no_of_sectors = 0;
-	switch (piccType) {
-	case PICC_TYPE_MIFARE_MINI:
-		// Has 5 sectors * 4 blocks/sector * 16 uint8_ts/block = 320 uint8_ts.
-		no_of_sectors = 5;
-		break;
-
-	case PICC_TYPE_MIFARE_1K:
-		// Has 16 sectors * 4 blocks/sector * 16 uint8_ts/block = 1024 uint8_ts.
-		no_of_sectors = 16;
-		break;
-
-	case PICC_TYPE_MIFARE_4K:
-		// Has (32 sectors * 4 blocks/sector + 8 sectors * 16 blocks/sector) *
-		// 16 uint8_ts/block = 4096 uint8_ts.
-		no_of_sectors = 40;
-		break;
-
-	default: // Should not happen. Ignore.
-		break;
-	}
-
-	// Dump sectors, highest address first.
-	if (no_of_sectors) {
-		printf("Sector Block   0  1  2  3   4  5  6  7   8  9 10 11  12 13 "
-				 "14 15  AccessBits\r\n");
-		for (int8_t i = no_of_sectors - 1; i >= 0; i--) {
-			PICC_DumpMifareClassicSectorToSerial(mfrc, uid, key, i);
-		}
-	}
-	PICC_HaltA(mfrc); // Halt the PICC before stopping the encrypted session.
-	PCD_StopCrypto1(mfrc);
-} // End PICC_DumpMifareClassicToSerial()
-
-/**
- * Dumps memory contents of a sector of a MIFARE Classic PICC.
- * Uses PCD_Authenticate(), MIFARE_Read() and PCD_StopCrypto1.
- * Always uses PICC_CMD_MF_AUTH_KEY_A because only Key A can always read the
- * sector trailer access bits.
- */
-void PICC_DumpMifareClassicSectorToSerial(
-	MFRC522Ptr_t mfrc,
-	Uid *uid,		 ///< Pointer to Uid struct returned from a successful
-					 ///PICC_Select().
-	MIFARE_Key *key, ///< Key A for the sector.
-	uint8_t sector   ///< The sector to dump, 0..39.
-	) {
-	char string[2];
-	uint8_t acces_bit;
-	StatusCode status;
-	uint8_t firstBlock; // Address of lowest address to dump actually last block
-						// dumped)
-	uint8_t no_of_blocks; // Number of blocks in sector
-	bool isSectorTrailer; // Set to true while handling the "last" (ie highest
-						  // address) in the sector.
-
-	// The access bits are stored in a peculiar fashion.
-	// There are four groups:
-	//		g[3]	Access bits for the sector trailer, block 3 (for sectors 0-31)
-	//or block 15 (for sectors 32-39)
-	//		g[2]	Access bits for block 2 (for sectors 0-31) or blocks 10-14 (for
-	//sectors 32-39)
-	//		g[1]	Access bits for block 1 (for sectors 0-31) or blocks 5-9 (for
-	//sectors 32-39)
-	//		g[0]	Access bits for block 0 (for sectors 0-31) or blocks 0-4 (for
-	//sectors 32-39)
-	// Each group has access bits [C1 C2 C3]. In this code C1 is MSB and C3 is
-	// LSB.
-	// The four CX bits are stored together in a nible cx and an inverted nible
-	// cx_.
-	uint8_t c1, c2, c3;	// Nibbles
-	uint8_t c1_, c2_, c3_; // Inverted nibbles
-	bool invertedError;	// True if one of the inverted nibbles did not match
-	uint8_t g[4];		   // Access bits for each of the four groups.
-	uint8_t group;		   // 0-3 - active group for access bits
-	bool firstInGroup;	 // True for the first block dumped in the group
-
-	// Determine position and size of sector.
-	if (sector < 32) { // Sectors 0..31 has 4 blocks each
-		no_of_blocks = 4;
-		firstBlock = sector * no_of_blocks;
-	} else if (sector < 40) { // Sectors 32-39 has 16 blocks each
-		no_of_blocks = 16;
-		firstBlock = 128 + (sector - 32) * no_of_blocks;
-	} else { // Illegal input, no MIFARE Classic PICC has more than 40 sectors.
-		return;
-	}
-
-	// Dump blocks, highest address first.
-	uint8_t uint8_tCount;
-	uint8_t buffer[18];
-	uint8_t blockAddr;
-	isSectorTrailer = true;
-	for (int8_t blockOffset = no_of_blocks - 1; blockOffset >= 0;
-		 blockOffset--) {
-		blockAddr = firstBlock + blockOffset;
-		// Sector number - only on first line
-		if (isSectorTrailer) {
-			if (sector < 10)
-				printf("   "); // Pad with spaces
-			else
-				printf("  "); // Pad with spaces
-			sprintf(string, "%u", sector);
-			printf(string);
-			printf("   ");
-		} else {
-			printf("       ");
-		}
-		// Block number
-		if (blockAddr < 10)
-			printf("   "); // Pad with spaces
-		else {
-			if (blockAddr < 100)
-				printf("  "); // Pad with spaces
-			else
-				printf(" "); // Pad with spaces
-		}
-		sprintf(string, "%u", blockAddr);
-		printf(string);
-		printf("  ");
-		// Establish encrypted communications before reading the first block
-		if (isSectorTrailer) {
-			status = PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A, firstBlock,
-									  key, uid);
-			if (status != STATUS_OK) {
-				printf("PCD_Authenticate() failed: ");
-				printf(GetStatusCodeName(status));
-				printf("\n");
-				return;
-			}
-		}
-		// Read block
-		uint8_tCount = sizeof(buffer);
-		status = MIFARE_Read(mfrc, blockAddr, buffer, &uint8_tCount);
-		if (status != STATUS_OK) {
-			printf("MIFARE_Read() failed: ");
-			printf(GetStatusCodeName(status));
-			continue;
-		}
-		// Dump data
-		for (uint8_t index = 0; index < 16; index++) {
-			if (buffer[index] < 0x10)
-				printf(" 0");
-			else
-				printf(" ");
-
-			// print the hexa value of a unsigned char
-			sprintf(string, "%02X", (char)buffer[index]);
-			printf(string);
-			if ((index % 4) == 3) {
-				printf(" ");
-			}
-		}
-		// Parse sector trailer data
-		if (isSectorTrailer) {
-			c1 = buffer[7] >> 4;
-			c2 = buffer[8] & 0xF;
-			c3 = buffer[8] >> 4;
-			c1_ = buffer[6] & 0xF;
-			c2_ = buffer[6] >> 4;
-			c3_ = buffer[7] & 0xF;
-			invertedError = (c1 != (~c1_ & 0xF)) || (c2 != (~c2_ & 0xF)) ||
-							(c3 != (~c3_ & 0xF));
-			g[0] = ((c1 & 1) << 2) | ((c2 & 1) << 1) | ((c3 & 1) << 0);
-			g[1] = ((c1 & 2) << 1) | ((c2 & 2) << 0) | ((c3 & 2) >> 1);
-			g[2] = ((c1 & 4) << 0) | ((c2 & 4) >> 1) | ((c3 & 4) >> 2);
-			g[3] = ((c1 & 8) >> 1) | ((c2 & 8) >> 2) | ((c3 & 8) >> 3);
-			isSectorTrailer = false;
-		}
-
-		// Which access group is this block in?
-		if (no_of_blocks == 4) {
-			group = blockOffset;
-			firstInGroup = true;
-		} else {
-			group = blockOffset / 5;
-			firstInGroup = (group == 3) || (group != (blockOffset + 1) / 5);
-		}
-
-		if (firstInGroup) {
-			// Print access bits
-			printf(" [ ");
-
-			acces_bit = (g[group] >> 2) & 1;
-			sprintf(string, "%u", acces_bit);
-			printf(string);
-			printf(" ");
-
-			acces_bit = (g[group] >> 1) & 1;
-			sprintf(string, "%u", acces_bit);
-			printf(string);
-			printf(" ");
-
-			acces_bit = (g[group] >> 0) & 1;
-			sprintf(string, "%u", acces_bit);
-			printf(string);
-
-			printf(" ] ");
-			if (invertedError) {
-				printf(" Inverted access bits did not match! ");
-			}
-		}
-
-		if (group != 3 &&
-			(g[group] == 1 ||
-			 g[group] == 6)) { // Not a sector trailer, a value block
-			long value = ((long)(buffer[3]) << 24) | ((long)(buffer[2]) << 16) |
-						 ((long)(buffer[1]) << 8) | (long)(buffer[0]);
-			printf(" Value=0x");
-
-			// print the hexa value of a unsigned char
-			sprintf(string, "%02X", (char)value);
-			printf(string);
-			printf(" Adr=0x");
-
-			// print the hexa value of a unsigned char
-			sprintf(string, "%02X", (char)buffer[12]);
-			printf(string);
-		}
-		printf("\r\n");
-	}
-
-	return;
-} // End PICC_DumpMifareClassicSectorToSerial()
-
-/**
- * Dumps memory contents of a MIFARE Ultralight PICC.
- */
-void PICC_DumpMifareUltralightToSerial(MFRC522Ptr_t mfrc) {
-	char string[2];
-	StatusCode status;
-	uint8_t uint8_tCount;
-	uint8_t buffer[18];
-	uint8_t i;
-
-	printf("Page  0  1  2  3\r\n");
-	// Try the mpages of the original Ultralight. Ultralight C has more pages.
-	for (uint8_t page = 0; page < 16;
-		 page += 4) { // Read returns data for 4 pages at a time.
-		// Read pages
-		uint8_tCount = sizeof(buffer);
-		status = MIFARE_Read(mfrc, page, buffer, &uint8_tCount);
-		if (status != STATUS_OK) {
-			printf("MIFARE_Read() failed: ");
-			printf(GetStatusCodeName(status));
-			break;
-		}
-		// Dump data
-		for (uint8_t offset = 0; offset < 4; offset++) {
-			i = page + offset;
-			if (i < 10)
-				printf("  "); // Pad with spaces
-			else
-				printf(" "); // Pad with spaces
-			sprintf(string, "%u", i);
-			printf(string);
-			printf("  ");
-			for (uint8_t index = 0; index < 4; index++) {
-				i = 4 * offset + index;
-				if (buffer[i] < 0x10)
-					printf(" 0");
-				else
-					printf(" ");
-
-				// print the hexa value of a unsigned char
-				sprintf(string, "%02X", (char)buffer[i]);
-				printf(string);
-			}
-			printf("\r\n");
-		}
-	}
-} // End PICC_DumpMifareUltralightToSerial()
-
-/**
- * Calculates the bit pattern needed for the specified access bits. In the [C1
- * C2 C3] tuples C1 is MSB (=4) and C3 is LSB (=1).
- */
-void MIFARE_SetAccessBits(
-	uint8_t *accessBitBuffer, ///< Pointer to uint8_t 6, 7 and 8 in the sector
-							  ///trailer. uint8_ts [0..2] will be set.
-	uint8_t g0, ///< Access bits [C1 C2 C3] for block 0 (for sectors 0-31) or
-				///blocks 0-4 (for sectors 32-39)
-	uint8_t g1, ///< Access bits C1 C2 C3] for block 1 (for sectors 0-31) or
-				///blocks 5-9 (for sectors 32-39)
-	uint8_t g2, ///< Access bits C1 C2 C3] for block 2 (for sectors 0-31) or
-				///blocks 10-14 (for sectors 32-39)
-	uint8_t g3  ///< Access bits C1 C2 C3] for the sector trailer, block 3 (for
-				///sectors 0-31) or block 15 (for sectors 32-39)
-	) {
-	uint8_t c1 =
-		((g3 & 4) << 1) | ((g2 & 4) << 0) | ((g1 & 4) >> 1) | ((g0 & 4) >> 2);
-	uint8_t c2 =
-		((g3 & 2) << 2) | ((g2 & 2) << 1) | ((g1 & 2) << 0) | ((g0 & 2) >> 1);
-	uint8_t c3 =
-		((g3 & 1) << 3) | ((g2 & 1) << 2) | ((g1 & 1) << 1) | ((g0 & 1) << 0);
-
-	accessBitBuffer[0] = (~c2 & 0xF) << 4 | (~c1 & 0xF);
-	accessBitBuffer[1] = c1 << 4 | (~c3 & 0xF);
-	accessBitBuffer[2] = c3 << 4 | c2;
-} // End MIFARE_SetAccessBits()
-
-/**
- * Performs the "magic sequence" needed to get Chinese UID changeable
- * Mifare cards to allow writing to sector 0, where the card UID is stored.
- *
- * Note that you do not need to have selected the card through REQA or WUPA,
- * this sequence works immediately when the card is in the reader vicinity.
- * This means you can use this method even on "bricked" cards that your reader
- *does
- * not recognise anymore (see MIFARE_UnbrickUidSector).
- *
- * Of course with non-bricked devices, you're free to select them before calling
- *this function.
- */
-bool MIFARE_OpenUidBackdoor(MFRC522Ptr_t mfrc, bool logErrors) {
-	char string[2];
-	// Magic sequence:
-	// > 50 00 57 CD (HALT + CRC)
-	// > 40 (7 bits only)
-	// < A (4 bits only)
-	// > 43
-	// < A (4 bits only)
-	// Then you can write to sector 0 without authenticating
-
-	PICC_HaltA(mfrc); // 50 00 57 CD
-
-	uint8_t cmd = 0x40;
-	uint8_t validBits =
-		7; /* Our command is only 7 bits. After receiving card response,
-		  this will contain amount of valid response bits. */
-	uint8_t response[32]; // Card's response is written here
-	uint8_t received;
-	StatusCode status =
-		PCD_TransceiveData(mfrc, &cmd, (uint8_t)1, response, &received,
-						   &validBits, (uint8_t)0, false); // 40
-	if (status != STATUS_OK) {
-		if (logErrors) {
-			printf("Card did not respond to 0x40 after HALT command. Are you "
-					 "sure it is a UID changeable one?\r\n");
-			printf("Error name: ");
-			printf(GetStatusCodeName(status));
-		}
-		return false;
-	}
-	if (received != 1 || response[0] != 0x0A) {
-		if (logErrors) {
-			printf("Got bad response on backdoor 0x40 command: ");
-
-			// print the hexa value of a unsigned char
-			sprintf(string, "%02X", (char)response[0]);
-			printf(string);
-			printf(" (");
-			sprintf(string, "%u", validBits);
-			printf(string);
-			printf(" valid bits)\r\n");
-		}
-		return false;
-	}
-
-	cmd = 0x43;
-	validBits = 8;
-	status = PCD_TransceiveData(mfrc, &cmd, (uint8_t)1, response, &received,
-								&validBits, (uint8_t)0, false); // 43
-	if (status != STATUS_OK) {
-		if (logErrors) {
-			printf("Error in communication at command 0x43, after "
-					 "successfully executing 0x40\r\n");
-			printf("Error name: ");
-			printf(GetStatusCodeName(status));
-		}
-		return false;
-	}
-	if (received != 1 || response[0] != 0x0A) {
-		if (logErrors) {
-			printf("Got bad response on backdoor 0x43 command: ");
-
-			// print the hexa value of a unsigned char
-			sprintf(string, "%02X", (char)response[0]);
-			printf(string);
-			printf(" (");
-			sprintf(string, "%u", validBits);
-			printf(string);
-			printf(" valid bits)\r\n");
-		}
-		return false;
-	}
-
-	// You can now write to sector 0 without authenticating!
-	return true;
-} // End MIFARE_OpenUidBackdoor()
-
-/**
- * Reads entire block 0, including all manufacturer data, and overwrites
- * that block with the new UID, a freshly calculated BCC, and the original
- * manufacturer data.
- *
- * It assumes a default KEY A of 0xFFFFFFFFFFFF.
- * Make sure to have selected the card before this function is called.
- */
-bool MIFARE_SetUid(MFRC522Ptr_t mfrc, uint8_t *newUid, uint8_t uidSize,
-				   bool logErrors) {
-
-	// UID + BCC uint8_t can not be larger than 16 together
-	if (!newUid || !uidSize || uidSize > 15) {
-		if (logErrors) {
-			printf("New UID buffer empty, size 0, or size > 15 given\r\n");
-		}
-		return false;
-	}
-
-	// Authenticate for reading
-	MIFARE_Key key = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-	StatusCode status = PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A,
-										 (uint8_t)1, &key, &(mfrc->uid));
-	if (status != STATUS_OK) {
-
-		if (status == STATUS_TIMEOUT) {
-			// We get a read timeout if no card is selected yet, so let's select
-			// one
-
-			// Wake the card up again if sleeping
-			//			  uint8_t atqa_answer[2];
-			//			  uint8_t atqa_size = 2;
-			//			  PICC_WakeupA(atqa_answer, &atqa_size);
-
-			if (!PICC_IsNewCardPresent(mfrc) || !PICC_ReadCardSerial(mfrc)) {
-				printf("No card was previously selected, and none are "
-						 "available. Failed to set UID.\r\n");
-				return false;
-			}
-
-			status = PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A, (uint8_t)1,
-									  &key, &(mfrc->uid));
-			if (status != STATUS_OK) {
-				// We tried, time to give up
-				if (logErrors) {
-					printf("Failed to authenticate to card for reading, "
-							 "could not set UID: \r\n");
-					printf(GetStatusCodeName(status));
-				}
-				return false;
-			}
-		} else {
-			if (logErrors) {
-				printf("PCD_Authenticate() failed: ");
-				printf(GetStatusCodeName(status));
-				printf("\n");
-			}
-			return false;
-		}
-	}
-
-	// Read block 0
-	uint8_t block0_buffer[18];
-	uint8_t uint8_tCount = sizeof(block0_buffer);
-	status = MIFARE_Read(mfrc, (uint8_t)0, block0_buffer, &uint8_tCount);
-	if (status != STATUS_OK) {
-		if (logErrors) {
-			printf("MIFARE_Read() failed: ");
-			printf(GetStatusCodeName(status));
-			printf(
-				"Are you sure your KEY A for sector 0 is 0xFFFFFFFFFFFF?\r\n");
-		}
-		return false;
-	}
-
-	// Write new UID to the data we just read, and calculate BCC uint8_t
-	uint8_t bcc = 0;
-	for (int i = 0; i < uidSize; i++) {
-		block0_buffer[i] = newUid[i];
-		bcc ^= newUid[i];
-	}
-
-	// Write BCC uint8_t to buffer
-	block0_buffer[uidSize] = bcc;
-
-	// Stop encrypted traffic so we can send raw uint8_ts
-	PCD_StopCrypto1(mfrc);
-
-	// Activate UID backdoor
-	if (!MIFARE_OpenUidBackdoor(mfrc, logErrors)) {
-		if (logErrors) {
-			printf("Activating the UID backdoor failed.\r\n");
-		}
-		return false;
-	}
-
-	// Write modified block 0 back to card
-	status = MIFARE_Write(mfrc, (uint8_t)0, block0_buffer, (uint8_t)16);
-	if (status != STATUS_OK) {
-		if (logErrors) {
-			printf("MIFARE_Write() failed: ");
-			printf(GetStatusCodeName(status));
-		}
-		return false;
-	}
-
-	// Wake the card up again
-	uint8_t atqa_answer[2];
-	uint8_t atqa_size = 2;
-	PICC_WakeupA(mfrc, atqa_answer, &atqa_size);
-
-	return true;
-}
-
-/**
- * Resets entire sector 0 to zeroes, so the card can be read again by readers.
- */
-bool MIFARE_UnbrickUidSector(MFRC522Ptr_t mfrc, bool logErrors) {
-	MIFARE_OpenUidBackdoor(mfrc, logErrors);
-
-	uint8_t block0_buffer[] = {0x01, 0x02, 0x03, 0x04, 0x04, 0x00, 0x00, 0x00,
-							   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-
-	// Write modified block 0 back to card
-	StatusCode status =
-		MIFARE_Write(mfrc, (uint8_t)0, block0_buffer, (uint8_t)16);
-	if (status != STATUS_OK) {
-		if (logErrors) {
-			printf("MIFARE_Write() failed: ");
-			printf(GetStatusCodeName(status));
-		}
-		return false;
-	}
-	return true;
-}
-
-/*******************************************************************************
-* Convenience functions - does not add extra functionality
-*******************************************************************************/
-
-/**
- * Returns true if a PICC responds to PICC_CMD_REQA.
- * Only "new" cards in state IDLE are invited. Sleeping cards in state HALT are
- *ignored.
- *
- * @return bool
- */
-bool PICC_IsNewCardPresent(MFRC522Ptr_t mfrc) {
-	uint8_t bufferATQA[2];
-	uint8_t bufferSize = sizeof(bufferATQA);
-	StatusCode result = PICC_RequestA(mfrc, bufferATQA, &bufferSize);
-	return (result == STATUS_OK || result == STATUS_COLLISION);
-} // End PICC_IsNewCardPresent()
-
-/**
- * Simple wrapper around PICC_Select.
- * Returns true if a UID could be read.
- * Remember to call PICC_IsNewCardPresent(), PICC_RequestA() or PICC_WakeupA()
- *first.
- * The read UID is available in the class variable uid.
- *
- * @return bool
- */
-bool PICC_ReadCardSerial(MFRC522Ptr_t mfrc) {
-	StatusCode result = PICC_Select(mfrc, &(mfrc->uid), 0);
-	return (result == STATUS_OK);
-} // End
-
-static inline void cs_select(const uint cs) {
+#if MFRC522_SPI_TRANSPORT
+static inline void MFRC522_HOT(cs_select)(const uint cs) {
     asm volatile("nop \n nop \n nop");
     gpio_put(cs, 0); // Active low
     asm volatile("nop \n nop \n nop");
 }
 
-static inline void cs_deselect(const uint cs) {
+static inline void MFRC522_HOT(cs_deselect)(const uint cs) {
     asm volatile("nop \n nop \n nop");
     gpio_put(cs, 1);
     asm volatile("nop \n nop \n nop");
-}
\ No newline at end of file
+}
+#endif
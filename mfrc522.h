@@ -20,39 +20,131 @@
 #include <stdio.h>
 #include <string.h> //some functions need NULL to be defined
 #include "pico/stdlib.h"
+
+// The SPI transport and the DMA and IRQ pin support need the RP2040
+// peripherals. The SDK's host platform (PICO_PLATFORM=host) has none, there
+// every instance is given a PCD_Transport such as the simulator of
+// mfrc522_sim.h.
+#ifndef MFRC522_SPI_TRANSPORT
+#define MFRC522_SPI_TRANSPORT PICO_ON_DEVICE
+#endif
+
+#if MFRC522_SPI_TRANSPORT
 #include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#else
+typedef struct spi_inst spi_inst_t; // Only ever NULL
+#endif
 
 /*******************************************************************************
  * Types/enumerations/variables
  ******************************************************************************/
-// send only one byte per transfer, see WriteRegister functions
-#define BUFFER_SIZE  1 
+// Staging for one pipelined burst: a full FIFO plus the address byte, see
+// PCD_ReadNRegister()
+#define BUFFER_SIZE  65 
+// Bursts shorter than this are not worth the DMA channel setup
+#define MFRC522_DMA_MIN_BURST 4
+// Script steps PCD_RunScript() hands to a transport's writeScript at once
+#define PCD_SCRIPT_BATCH 16
+// Free uint8_ts a PCD_Frame keeps in front of its payload: the SPI address
+// byte, and the length byte of the PIO transport before it
+#define PCD_FRAME_HEADROOM 2
+// Free uint8_ts a PCD_Frame keeps after its payload, for the CRC_A
+#define PCD_FRAME_TAILROOM 2
+// Storage of a PCD_Frame with room for size payload uint8_ts
+#define PCD_FRAME_STORAGE(size)                                                \
+	(PCD_FRAME_HEADROOM + (size) + PCD_FRAME_TAILROOM)
 // Defined as 4MHz in the original library
 #define MFRC522_BIT_RATE 4000000 
-// Used for ADT object allocation
-#define MFRC_MAX_INSTANCES 2	 
+// Highest SPI clock in the MFRC522 datasheet
+#define MFRC522_MAX_BIT_RATE 10000000
+// Timeout programmed by PCD_Init(): 25ms
+#define MFRC522_DEFAULT_TIMEOUT_US 25000
+// Timeout for REQA/WUPA, the ATQA arrives after about 91us
+#define MFRC522_PRESENCE_TIMEOUT_US 1000
+// PICCs need up to 5 ms of unmodulated field before they answer
+// (ISO/IEC 14443-3 part 6.1.1)
+#define MFRC522_FIELD_SETTLE_US 5000
+// Upper bound for the oscillator start-up after a reset or soft power-down
+#define MFRC522_WAKEUP_TIMEOUT_US 50000
+// Hard reset pulse on NRSTPD, the datasheet asks for at least 100ns
+#define MFRC522_RESET_PULSE_US 1
+// Sectors of a MIFARE Classic 4K, 32 of 4 blocks and 8 of 16 blocks
+#define MIFARE_MAX_SECTORS 40
+// Size of a MIFARE_KeyRing
+#define MIFARE_KEYRING_MAX_KEYS 8
+#define MIFARE_KEYRING_CACHE_SIZE 32
+// Operations one MIFARE_Transaction can queue
+#define MIFARE_TRANSACTION_MAX_OPS 8
+// Failed activations PICC_Inventory() tolerates before it gives up
+#define MFRC522_INVENTORY_RETRIES 3
+// Failed presence checks in a row before PICC_TrackerPoll() reports a
+// departure
+#define PICC_TRACKER_MISSES 2
+// Activations and reads PCD_CalibrateRf() runs per setting
+#define PCD_CALIBRATION_TRIALS 16
+// Used for ADT object allocation, can be raised from the build
+#ifndef MFRC_MAX_INSTANCES
+#define MFRC_MAX_INSTANCES 8
+#endif
+// Slack on top of the timeout of an exchange before the MCU stops waiting
+// for it, the MFRC522 timer fires first
+#define MFRC522_IRQ_TIMEOUT_US 40000
+#define MFRC522_CRC_IRQ_TIMEOUT_US 90000
+// Set to 1 from the build to gather MFRC522_Stats in every instance, costs
+// nothing when 0
+#ifndef MFRC522_STATS
+#define MFRC522_STATS 0
+#endif
+// Build profile, all can be set from the build. MFRC522_DEBUG=0 drops the
+// serial dumps and the status and type names of mfrc522_debug.c,
+// MFRC522_UID_TOOLS=0 the UID changing tools for magic MIFARE cards
+#ifndef MFRC522_DEBUG
+#define MFRC522_DEBUG 1
+#endif
+#ifndef MFRC522_UID_TOOLS
+#define MFRC522_UID_TOOLS MFRC522_DEBUG
+#endif
+#if MFRC522_UID_TOOLS && !MFRC522_DEBUG
+#error "MFRC522_UID_TOOLS logs through MFRC522_DEBUG"
+#endif
+// Set to 1 to run the register access and FIFO streaming from RAM, so XIP
+// cache misses cannot stretch SPI gaps while a frame is on air. This covers
+// the functions of this library on that path and the data they read, not
+// the SDK's blocking SPI and timer calls, see README.md
+#ifndef MFRC522_RAM_HOT_PATH
+#define MFRC522_RAM_HOT_PATH 0
+#endif
+#if MFRC522_RAM_HOT_PATH && PICO_ON_DEVICE
+#define MFRC522_HOT(func) __not_in_flash_func(func)
+#define MFRC522_HOT_DATA __not_in_flash("mfrc522")
+#else
+#define MFRC522_HOT(func) func
+#define MFRC522_HOT_DATA
+#endif
+// Exchange time histogram: bucket n counts exchanges shorter than
+// MFRC522_STATS_FIRST_BUCKET_US << n, the last one everything longer
+#define MFRC522_STATS_BUCKETS 8
+#define MFRC522_STATS_FIRST_BUCKET_US 125ULL
+// WaterLevelReg for frames longer than the FIFO: refilled at or below this
+// fill level, emptied at or above FIFO_SIZE minus it
+#define MFRC522_FIFO_WATER_LEVEL 32
+// Pages one FAST_READ command asks for, NTAG_FastRead() splits longer ranges
+#define NTAG_FAST_READ_MAX_PAGES 64
 // Reset pin to MFRC522
 #define RESET_PIN 20
 
-static const uint8_t FIFO_SIZE = 64; // Size of the MFRC522 FIFO
-
-static const uint cs_pin = 17;
-static const uint sck_pin = 18;
-static const uint mosi_pin = 19;
-static const uint miso_pin = 16;
-
-static const uint8_t SELF_TEST_BYTES[] = {
-	0x00, 0xEB, 0x66, 0xBA, 0x57, 0xBF, 0x23, 0x95,
-	0xD0, 0xE3, 0x0D, 0x3D, 0x27, 0x89, 0x5C, 0xDE,
-	0x9D, 0x3B, 0xA7, 0x00, 0x21, 0x5B, 0x89, 0x82,
-	0x51, 0x3A, 0xEB, 0x02, 0x0C, 0xA5, 0x00, 0x49,
-	0x7C, 0x84, 0x4D, 0xB3, 0xCC, 0xD2, 0x1B, 0x81,
-	0x5D, 0x48, 0x76, 0xD5, 0x71, 0x61, 0x21, 0xA9,
-	0x86, 0x96, 0x83, 0x38, 0xCF, 0x9D, 0x5B, 0x6D,
-	0xDC, 0x15, 0xBA, 0x3E, 0x7D, 0x95, 0x3B, 0x2F
-};
+// Size of the MFRC522 FIFO
+#define FIFO_SIZE 64
+// Default wiring, see MFRC522_GetDefaultConfig()
+#define MFRC522_CS_PIN 17
+#define MFRC522_SCK_PIN 18
+#define MFRC522_MOSI_PIN 19
+#define MFRC522_MISO_PIN 16
 
-//0x2F
+// FIFO contents PCD_SelfTest() expects from a version 2.0 MFRC522
+extern const uint8_t SELF_TEST_BYTES[FIFO_SIZE];
 
 /**
  * MFRC522 registers. Described in chapter 9 of the datasheet.
@@ -237,7 +329,9 @@ typedef enum _PICC_Command {
 	// http://www.nxp.com/documents/data_sheet/MF0ICU1.pdf, Section 8.6)
 	// The PICC_CMD_MF_READ and PICC_CMD_MF_WRITE can also be used for MIFARE
 	// Ultralight.
-	PICC_CMD_UL_WRITE = 0xA2 // Writes one 4 byte page to the PICC.
+	PICC_CMD_UL_WRITE = 0xA2, // Writes one 4 byte page to the PICC.
+	// NTAG21x only (from NTAG213/215/216 datasheet, Section 10.3)
+	PICC_CMD_UL_FAST_READ = 0x3A // Reads a range of pages in one frame.
 } PICC_Command;
 
 // MIFARE constants that does not fit anywhere else
@@ -278,9 +372,42 @@ typedef enum _StatusCode {
 	STATUS_INTERNAL_ERROR, // Internal error in the code. Should not happen ;-)
 	STATUS_INVALID,		   // Invalid argument.
 	STATUS_CRC_WRONG,	  // The CRC_A does not match
+	STATUS_PENDING,		   // An asynchronous exchange is still running
 	STATUS_MIFARE_NACK = 0xff // A MIFARE PICC responded with NAK.
 } StatusCode;
 
+// How CRC_A values are calculated, see PCD_SetCRCMode()
+typedef enum _PCD_CRCMode {
+	PCD_CRC_SOFTWARE,   // Table driven on the MCU, no SPI traffic (default)
+	PCD_CRC_COPROCESSOR // CalcCRC command of the MFRC522
+} PCD_CRCMode;
+
+// Bit rates of ISO/IEC 14443, the values are the TxSpeed/RxSpeed codes
+typedef enum _PCD_BitRate {
+	PCD_BITRATE_106 = 0, // kbit/s, used for activation
+	PCD_BITRATE_212 = 1,
+	PCD_BITRATE_424 = 2,
+	PCD_BITRATE_848 = 3
+} PCD_BitRate;
+
+// Groups of exchanges sharing a timeout, see PCD_SetCommandTimeout()
+typedef enum _PCD_TimeoutClass {
+	PCD_TIMEOUT_DEFAULT,	// Anything not listed below
+	PCD_TIMEOUT_REQA,		// REQA and WUPA
+	PCD_TIMEOUT_SELECT,		// ANTICOLLISION and SELECT
+	PCD_TIMEOUT_HALT,		// HLTA, a timeout is the expected outcome
+	PCD_TIMEOUT_AUTH,		// MFAuthent
+	PCD_TIMEOUT_READ,		// MIFARE Classic/Ultralight READ
+	PCD_TIMEOUT_WRITE,		// First phase of the MIFARE Classic WRITE
+	PCD_TIMEOUT_WRITE_DATA, // Data phase of WRITE, Ultralight WRITE
+	PCD_TIMEOUT_VALUE,		// First phase of INCREMENT/DECREMENT/RESTORE
+	PCD_TIMEOUT_VALUE_DATA, // Data phase of those, no answer expected
+	PCD_TIMEOUT_TRANSFER,   // TRANSFER
+	PCD_TIMEOUT_TCL,		// ISO/IEC 14443-4 blocks, FWT from the ATS
+	PCD_TIMEOUT_COUNT,
+	PCD_TIMEOUT_AUTO = 0xff // Classify the frame (PCD_SetNextTimeout())
+} PCD_TimeoutClass;
+
 // A struct used for passing the UID of a PICC.
 typedef struct {
 	uint8_t size; // Number of bytes in the UID. 4, 7 or 10.
@@ -292,20 +419,231 @@ typedef struct {
 // A struct used for passing a MIFARE Crypto1 key
 typedef struct { uint8_t keybyte[MF_KEY_SIZE]; } MIFARE_Key;
 
+// Wiring of one MFRC522, passed to PCD_InitWithConfig()
+typedef struct {
+	spi_inst_t *spi; // spi0 or spi1
+	uint baudrate;   // SPI clock in Hz, 0 => probe for the highest stable one
+	uint sckPin;
+	uint mosiPin;
+	uint misoPin;
+	uint csPin;
+	int rstPin; // -1 if NRSTPD is not wired to the Pico
+	int irqPin; // -1 to poll the interrupt registers instead
+} MFRC522_Config;
+
+// One step of a register script, see PCD_RunScript(). Scripts are meant to
+// be static const tables so that they stay in flash.
+typedef struct {
+	uint8_t reg;   // One of the PCD_Register enums
+	uint8_t value; // Value to write
+} PCD_RegisterWrite;
+
+// Number of steps of a script defined as an array
+#define PCD_SCRIPT_LENGTH(script) (sizeof(script) / sizeof((script)[0]))
+
+// A key a MIFARE_KeyRing can try
+typedef struct {
+	uint8_t command; // PICC_CMD_MF_AUTH_KEY_A or PICC_CMD_MF_AUTH_KEY_B
+	MIFARE_Key key;
+	uint16_t hits; // Successful authentications with this key
+} MIFARE_KeyRingKey;
+
+// The key that authenticated one sector of one PICC
+typedef struct {
+	uint8_t uidSize;
+	uint8_t uidByte[10];
+	uint8_t sector;
+	uint8_t keyIndex; // Index in MIFARE_KeyRing.keys
+} MIFARE_KeyRingEntry;
+
+// Candidate keys plus a cache of which key worked where, see
+// MIFARE_KeyRingAuthenticate()
+typedef struct {
+	MIFARE_KeyRingKey keys[MIFARE_KEYRING_MAX_KEYS];
+	uint8_t keyCount;
+	uint8_t order[MIFARE_KEYRING_MAX_KEYS]; // Key indices, most hits first
+	MIFARE_KeyRingEntry cache[MIFARE_KEYRING_CACHE_SIZE];
+	uint8_t cacheCount;
+	uint8_t cacheNext; // Entry replaced next once the cache is full
+} MIFARE_KeyRing;
+
+// What PICC_TrackerPoll() saw
+typedef enum _PICC_TrackerEvent {
+	PICC_TRACKER_NONE,	   // No PICC in the field
+	PICC_TRACKER_ARRIVED,  // A new PICC was selected
+	PICC_TRACKER_PRESENT,  // The tracked PICC is still there
+	PICC_TRACKER_MISSED,   // A check failed, the PICC is not ACTIVE now
+	PICC_TRACKER_DEPARTED  // The tracked PICC has left the field
+} PICC_TrackerEvent;
+
+// The PICC a presence tracker follows between polls, see PICC_TrackerPoll()
+typedef struct {
+	bool present;	   // A PICC is being tracked
+	Uid uid;		   // Its UID and SAK, kept after PICC_TRACKER_DEPARTED
+	uint8_t misses;	   // Failed presence checks in a row
+	uint8_t missLimit; // Failed checks that make a departure
+	bool wakeup; // The next arrival poll sends WUPA, after a departure
+	uint64_t arrivedUs; // time_us_64() of PICC_TRACKER_ARRIVED
+	uint64_t seenUs;	// time_us_64() of the last successful check
+} PICC_Tracker;
+
+// Receiver and driver settings that depend on antenna and enclosure, see
+// PCD_SetRfProfile()
+typedef struct {
+	uint8_t rxGain; // RxGain[2:0] of RFCfgReg, one of the PCD_RxGain masks
+	uint8_t cwGsP;	// CWGsPReg: p-driver conductance, the field strength
+	uint8_t modGsP; // ModGsPReg: p-driver conductance while modulating
+	uint8_t demod;	// DemodReg: channel selection and PLL time constants
+} PCD_RfProfile;
+
+// What PCD_CalibrateRf() measured for the profile it chose
+typedef struct {
+	PCD_RfProfile profile;
+	uint8_t successes; // Of PCD_CALIBRATION_TRIALS activations and reads
+	uint32_t meanUs;   // Mean time of a successful one
+	uint16_t settings; // Settings tried
+} PCD_Calibration;
+
+// One operation of a MIFARE_Transaction, frames ready to send
+typedef struct {
+	uint8_t command; // PICC_CMD_MF_INCREMENT, _DECREMENT, _RESTORE,
+					 // _TRANSFER or _WRITE
+	uint8_t blockAddr;
+	uint8_t frame[PCD_FRAME_STORAGE(2)]; // Command, block address, CRC_A
+	uint8_t data[PCD_FRAME_STORAGE(16)]; // Step 2 data and its CRC_A
+	uint8_t dataLen;  // 0 for TRANSFER, 4 for value operations, 16 for WRITE
+	StatusCode status; // STATUS_PENDING until MIFARE_TransactionRun() got here
+} MIFARE_TransactionOp;
+
+// Value operations and writes against one authenticated sector, see
+// MIFARE_TransactionRun()
+typedef struct {
+	MIFARE_TransactionOp ops[MIFARE_TRANSACTION_MAX_OPS];
+	uint8_t count;
+} MIFARE_Transaction;
+
 // A struct used to set GPIO pins of LPCXpresso4337 
 typedef struct {
 	uint8_t port;
 	uint8_t pin;
 } io_port_t;
 
+struct MFRC522_T;
+
+// How the register functions reach the chip, see PCD_SetTransport(). write
+// and read move count uint8_ts from or to the same register, reg being a
+// PCD_Register (SPI address). writeScript may be NULL, otherwise it writes
+// length single registers in order, which lets a transport send a whole
+// PCD_RunScript() in one go. writeFrame and readFrame may be NULL as well,
+// otherwise they work like write and read on the payload of a PCD_Frame: the
+// PCD_FRAME_HEADROOM uint8_ts in front of values are theirs to overwrite, so
+// headers go in place and the values move without a copy. Shadowing,
+// statistics and RxAlign are handled above the transport.
+typedef struct {
+	void (*write)(void *context, uint8_t reg, const uint8_t *values,
+				  uint8_t count);
+	void (*read)(void *context, uint8_t reg, uint8_t *values, uint8_t count);
+	void (*writeScript)(void *context, const PCD_RegisterWrite *steps,
+						size_t length);
+	void (*writeFrame)(void *context, uint8_t reg, uint8_t *values,
+					   uint8_t count);
+	void (*readFrame)(void *context, uint8_t reg, uint8_t *values,
+					  uint8_t count);
+} PCD_Transport;
+
+// A frame in caller-owned storage of PCD_FRAME_STORAGE(size) uint8_ts, see
+// PCD_FrameInit(). The room around the payload takes the transport header
+// and the CRC_A, so PCD_TransceiveFrame() sends from and receives into the
+// storage directly.
+typedef struct {
+	uint8_t *data;	// Payload, PCD_FRAME_HEADROOM uint8_ts into the storage
+	uint8_t length; // Payload uint8_ts, the CRC_A included once appended
+	uint8_t size;	// Payload capacity, without head- and tailroom
+	uint8_t validBits; // Valid bits in the last uint8_t, 0 for all eight
+} PCD_Frame;
+
+// Called when an asynchronous exchange has completed, see
+// PCD_StartCommunicateWithPICC()
+typedef void (*PCD_CompletionCallback)(struct MFRC522_T *mfrc,
+									   StatusCode status, void *context);
+
+// State of the exchange between PCD_CommunicateWithPICC() setting up the FIFO
+// and reading the response back
+typedef struct {
+	bool active; // An asynchronous exchange is running
+	uint8_t waitIRq;
+	uint8_t *backData;
+	uint8_t *backLen;
+	uint8_t *validBits;
+	uint8_t rxAlign;
+	bool checkCRC;
+	bool framed; // sendData and backData are PCD_Frame payloads
+	uint32_t timeoutUs;		  // mfrc->timeouts[] entry the exchange runs with
+	absolute_time_t deadline; // Give up even if the MFRC522 timer never fires
+	PCD_CompletionCallback callback;
+	void *context;
+#if MFRC522_STATS
+	uint8_t timeoutClass; // PCD_TimeoutClass the exchange is booked under
+	uint64_t startUs;	 // time_us_64() when the command was started
+#endif
+} PCD_Exchange;
+
+#if MFRC522_STATS
+// Counters of one instance, see MFRC522_GetStats()
+typedef struct {
+	// Per PCD_TimeoutClass: wall time from the start of the command to the
+	// checked response
+	uint32_t exchanges[PCD_TIMEOUT_COUNT];
+	uint32_t histogram[PCD_TIMEOUT_COUNT][MFRC522_STATS_BUCKETS];
+	uint64_t totalUs[PCD_TIMEOUT_COUNT];
+	uint32_t maxUs[PCD_TIMEOUT_COUNT];
+	uint32_t spiTransactions;   // Chip select frames
+	uint32_t spiBytes;		   // uint8_ts clocked, addresses included
+	uint32_t irqWaitIterations; // ComIrqReg/DivIrqReg polls and IRQ wake-ups
+	uint32_t timeouts;
+	uint32_t crcErrors;
+	uint32_t collisions;
+	uint32_t nacks;		   // STATUS_MIFARE_NACK
+	uint32_t errors;		   // Any other failed exchange
+	uint32_t authFailures; // Failed PCD_Authenticate()
+	uint32_t retries;	   // Frames sent again by mfrc522_retry.h
+	uint32_t reactivations; // PICCs woken and selected again by it
+	uint32_t retryFailures; // Operations it gave up on, budget or time spent
+} MFRC522_Stats;
+// Adds to a counter of mfrc->stats, compiled out without MFRC522_STATS
+#define PCD_STAT_ADD(mfrc, field, n) ((mfrc)->stats.field += (n))
+#else
+#define PCD_STAT_ADD(mfrc, field, n) ((void)0)
+#endif
+
 // A struct used to define a MFRC522 ADT object, useful when using more than one
 struct MFRC522_T {
 	Uid uid; // Used by PICC_ReadCardSerial().
 	// Variables used in the SSP(SPI) peripheral of the board
 	spi_inst_t *spi; // Select SSP0 or SSP1
 	uint _chipSelectPin; // = {1, 8}; // As default example use GPIO1[8]= P1_5
+	int _resetPin; // -1 if not wired
 	uint8_t Tx_Buf[BUFFER_SIZE];
 	uint8_t Rx_Buf[BUFFER_SIZE];
+	int dmaTx; // DMA channel feeding the SPI TX FIFO, -1 if not claimed
+	int dmaRx; // DMA channel draining the SPI RX FIFO, -1 if not claimed
+	int irqPin; // GPIO wired to the MFRC522 IRQ output, -1 to poll instead
+	const PCD_Transport *transport; // Register access, SPI by default
+	void *transportContext;			// Passed to the transport functions
+	PCD_Exchange exchange; // The transceive currently in progress
+	PCD_CRCMode crcMode;
+	uint32_t timeouts[PCD_TIMEOUT_COUNT]; // Per PCD_TimeoutClass, in �s
+	uint8_t timeoutHint; // Class of the next exchange, PCD_TIMEOUT_AUTO to
+						 // classify its frame
+	uint8_t shadow[64]; // Last value written to each register, by address
+	uint64_t shadowValid; // Bit n set when shadow[n] matches the chip
+	PCD_BitRate txRate; // PCD to PICC, in TxModeReg
+	PCD_BitRate rxRate; // PICC to PCD, in RxModeReg
+	PCD_RfProfile rfProfile; // Applied by PCD_InitWithConfig() if rfProfileSet
+	bool rfProfileSet;
+#if MFRC522_STATS
+	MFRC522_Stats stats;
+#endif
 };
 
 // Pointer to a MFRC5222 ADT object
@@ -313,9 +651,10 @@ typedef struct MFRC522_T *MFRC522Ptr_t;
 
 /**
  * Function to setup a MFRC522 ADT object
- * @return an initialized  ADT object
+ * @return an initialized  ADT object, NULL once MFRC_MAX_INSTANCES are in use
  */
 MFRC522Ptr_t MFRC522_Init();
+void MFRC522_GetDefaultConfig(MFRC522_Config *config);
 
 /*******************************************************************************
 * Basic interface functions for communicating with the MFRC522
@@ -329,23 +668,49 @@ void PCD_ReadNRegister(MFRC522Ptr_t mfrc, uint8_t reg, uint8_t count,
 void setBitMask(unsigned char reg, unsigned char mask);
 void PCD_SetRegisterBitMask(MFRC522Ptr_t mfrc, uint8_t reg, uint8_t mask);
 void PCD_ClearRegisterBitMask(MFRC522Ptr_t mfrc, uint8_t reg, uint8_t mask);
+void PCD_SetTransport(MFRC522Ptr_t mfrc, const PCD_Transport *transport,
+					  void *context);
+void PCD_RunScript(MFRC522Ptr_t mfrc, const PCD_RegisterWrite *script,
+				   size_t length);
+bool PCD_EnableDMA(MFRC522Ptr_t mfrc);
+void PCD_DisableDMA(MFRC522Ptr_t mfrc);
+void PCD_SetIrqPin(MFRC522Ptr_t mfrc, int pin);
 StatusCode PCD_CalculateCRC(MFRC522Ptr_t mfrc, uint8_t *data, uint8_t length,
 							uint8_t *result);
-							
-//Chip select for pi pico SPI
-static inline void cs_select(const uint cs);
-static inline void cs_deselect(const uint cs); 
+void PCD_SoftwareCRC(const uint8_t *data, uint16_t length, uint8_t *result);
+void PCD_SetCRCMode(MFRC522Ptr_t mfrc, PCD_CRCMode mode);
+
 
 /*******************************************************************************
 * Functions for manipulating the MFRC522
 *******************************************************************************/
-void PCD_Init(MFRC522Ptr_t mfrc, spi_inst_t *spi);
-void PCD_Reset(MFRC522Ptr_t mfrc);
+StatusCode PCD_Init(MFRC522Ptr_t mfrc, spi_inst_t *spi);
+StatusCode PCD_InitWithConfig(MFRC522Ptr_t mfrc, const MFRC522_Config *config);
+StatusCode PCD_InitMany(MFRC522Ptr_t *mfrcs, const MFRC522_Config *configs,
+						size_t count);
+uint PCD_ProbeBaudrate(MFRC522Ptr_t mfrc, uint maxBaudrate);
+StatusCode PCD_Reset(MFRC522Ptr_t mfrc);
 void PCD_AntennaOn(MFRC522Ptr_t mfrc);
 void PCD_AntennaOff(MFRC522Ptr_t mfrc);
 uint8_t PCD_GetAntennaGain(MFRC522Ptr_t mfrc);
 void PCD_SetAntennaGain(MFRC522Ptr_t mfrc, uint8_t mask);
+void PCD_GetRfProfile(MFRC522Ptr_t mfrc, PCD_RfProfile *profile);
+void PCD_SetRfProfile(MFRC522Ptr_t mfrc, const PCD_RfProfile *profile);
 uint8_t PCD_SelfTest(MFRC522Ptr_t mfrc);
+void PCD_SetTimeout(MFRC522Ptr_t mfrc, uint32_t timeoutUs);
+void PCD_ResetCommandTimeouts(MFRC522Ptr_t mfrc);
+void PCD_SetCommandTimeout(MFRC522Ptr_t mfrc, PCD_TimeoutClass cls,
+						   uint32_t timeoutUs);
+uint32_t PCD_GetCommandTimeout(MFRC522Ptr_t mfrc, PCD_TimeoutClass cls);
+void PCD_SetNextTimeout(MFRC522Ptr_t mfrc, PCD_TimeoutClass cls);
+void PCD_SoftPowerDown(MFRC522Ptr_t mfrc);
+StatusCode PCD_SoftPowerUp(MFRC522Ptr_t mfrc);
+void PCD_SetBitRate(MFRC522Ptr_t mfrc, PCD_BitRate txRate,
+					PCD_BitRate rxRate);
+#if MFRC522_STATS
+void MFRC522_GetStats(MFRC522Ptr_t mfrc, MFRC522_Stats *stats);
+void MFRC522_ResetStats(MFRC522Ptr_t mfrc);
+#endif
 
 /*******************************************************************************
 * Functions for communicating with PICCs
@@ -359,14 +724,37 @@ StatusCode PCD_CommunicateWithPICC(MFRC522Ptr_t mfrc, uint8_t command,
 								   uint8_t sendLen, uint8_t *backData,
 								   uint8_t *backLen, uint8_t *validBits,
 								   uint8_t rxAlign, bool checkCRC);
+StatusCode PCD_StartCommunicateWithPICC(
+	MFRC522Ptr_t mfrc, uint8_t command, uint8_t waitIRq, uint8_t *sendData,
+	uint8_t sendLen, uint8_t *backData, uint8_t *backLen, uint8_t *validBits,
+	uint8_t rxAlign, bool checkCRC, PCD_CompletionCallback callback,
+	void *context);
+StatusCode PCD_StartTransceiveData(MFRC522Ptr_t mfrc, uint8_t *sendData,
+								   uint8_t sendLen, uint8_t *backData,
+								   uint8_t *backLen, uint8_t *validBits,
+								   uint8_t rxAlign, bool checkCRC,
+								   PCD_CompletionCallback callback,
+								   void *context);
+StatusCode PCD_PollCommunication(MFRC522Ptr_t mfrc);
+void PCD_AbortCommunication(MFRC522Ptr_t mfrc);
+StatusCode PCD_TransceiveStream(MFRC522Ptr_t mfrc, uint8_t *sendData,
+								uint16_t sendLen, uint8_t *backData,
+								uint16_t *backLen, bool checkCRC);
+void PCD_FrameInit(PCD_Frame *frame, uint8_t *storage, uint8_t size);
+StatusCode PCD_FrameAppendCRC(MFRC522Ptr_t mfrc, PCD_Frame *frame);
+StatusCode PCD_TransceiveFrame(MFRC522Ptr_t mfrc, PCD_Frame *send,
+							   PCD_Frame *back, bool checkCRC);
 StatusCode PICC_RequestA(MFRC522Ptr_t mfrc, uint8_t *bufferATQA,
 						 uint8_t *bufferSize);
 StatusCode PICC_WakeupA(MFRC522Ptr_t mfrc, uint8_t *bufferATQA,
 						uint8_t *bufferSize);
+void PCD_PrepareRequestA(MFRC522Ptr_t mfrc);
 StatusCode PICC_REQA_or_WUPA(MFRC522Ptr_t mfrc, uint8_t command,
 							 uint8_t *bufferATQA, uint8_t *bufferSize);
 StatusCode PICC_Select(MFRC522Ptr_t mfrc, Uid *uid, uint8_t validBits);
+StatusCode PICC_SelectKnown(MFRC522Ptr_t mfrc, const Uid *uid);
 StatusCode PICC_HaltA(MFRC522Ptr_t mfrc);
+size_t PICC_Inventory(MFRC522Ptr_t mfrc, Uid *out, size_t max);
 
 /*******************************************************************************
 *Functions for communicating with MIFARE PICCs
@@ -388,18 +776,42 @@ StatusCode MIFARE_GetValue(MFRC522Ptr_t mfrc, uint8_t blockAddr, long *value);
 StatusCode MIFARE_SetValue(MFRC522Ptr_t mfrc, uint8_t blockAddr, long value);
 StatusCode PCD_NTAG216_AUTH(MFRC522Ptr_t mfrc, uint8_t *passWord,
 							uint8_t pACK[]);
+StatusCode NTAG_FastRead(MFRC522Ptr_t mfrc, uint8_t startPage, uint8_t endPage,
+						 uint8_t *out);
+uint16_t MIFARE_SectorsSize(uint8_t firstSector, uint8_t count);
+StatusCode MIFARE_ReadSectors(MFRC522Ptr_t mfrc, Uid *uid, uint8_t command,
+							  MIFARE_Key *key, uint8_t firstSector,
+							  uint8_t count, uint8_t *out, bool skipTrailers);
+void MIFARE_KeyRingInit(MIFARE_KeyRing *ring);
+int MIFARE_KeyRingAddKey(MIFARE_KeyRing *ring, uint8_t command,
+						 const MIFARE_Key *key);
+StatusCode MIFARE_KeyRingAuthenticate(MFRC522Ptr_t mfrc, MIFARE_KeyRing *ring,
+									  Uid *uid, uint8_t blockAddr,
+									  int *keyIndex);
+void MIFARE_TransactionInit(MIFARE_Transaction *transaction);
+StatusCode MIFARE_TransactionValue(MIFARE_Transaction *transaction,
+								   uint8_t command, uint8_t blockAddr,
+								   long delta);
+StatusCode MIFARE_TransactionTransfer(MIFARE_Transaction *transaction,
+									  uint8_t blockAddr);
+StatusCode MIFARE_TransactionWrite(MIFARE_Transaction *transaction,
+								   uint8_t blockAddr, const uint8_t *data);
+StatusCode MIFARE_TransactionRun(MFRC522Ptr_t mfrc,
+								 MIFARE_Transaction *transaction);
 
 /*******************************************************************************
 * Support functions
 *******************************************************************************/
 StatusCode PCD_MIFARE_Transceive(MFRC522Ptr_t mfrc, uint8_t *sendData,
 								 uint8_t sendLen, bool acceptTimeout);
-const char *GetStatusCodeName(StatusCode code);
-const char *PICC_GetTypeName(PICC_Type type);
+PICC_Type PICC_GetType(uint8_t sak);
 StatusCode MIFARE_TwoStepHelper(MFRC522Ptr_t mfrc, uint8_t command,
 								uint8_t blockAddr, long data);
 
+#if MFRC522_DEBUG
 // Support functions for debugging
+const char *GetStatusCodeName(StatusCode code);
+const char *PICC_GetTypeName(PICC_Type type);
 void PCD_DumpVersionToSerial(MFRC522Ptr_t mfrc);
 void PICC_DumpToSerial(MFRC522Ptr_t mfrc, Uid *uid);
 void PICC_DumpDetailsToSerial(Uid *uid);
@@ -408,19 +820,27 @@ void PICC_DumpMifareClassicToSerial(MFRC522Ptr_t mfrc, Uid *uid,
 void PICC_DumpMifareClassicSectorToSerial(MFRC522Ptr_t mfrc, Uid *uid,
 										  MIFARE_Key *key, uint8_t sector);
 void PICC_DumpMifareUltralightToSerial(MFRC522Ptr_t mfrc);
+#endif
 
 // Advanced functions for MIFARE
 void MIFARE_SetAccessBits(uint8_t *accessBitBuffer, uint8_t g0, uint8_t g1,
 						  uint8_t g2, uint8_t g3);
+#if MFRC522_UID_TOOLS
 bool MIFARE_OpenUidBackdoor(MFRC522Ptr_t mfrc, bool logErrors);
 bool MIFARE_SetUid(MFRC522Ptr_t mfrc, uint8_t *newUid, uint8_t uidSize,
 				   bool logErrors);
 bool MIFARE_UnbrickUidSector(MFRC522Ptr_t mfrc, bool logErrors);
+#endif
 
 /*******************************************************************************
 * Convenience functions - does not add extra functionality
 *******************************************************************************/
 bool PICC_IsNewCardPresent(MFRC522Ptr_t mfrc);
 bool PICC_ReadCardSerial(MFRC522Ptr_t mfrc);
+void PICC_TrackerInit(PICC_Tracker *tracker);
+void PICC_TrackerAdopt(PICC_Tracker *tracker, const Uid *uid);
+PICC_TrackerEvent PICC_TrackerPoll(MFRC522Ptr_t mfrc, PICC_Tracker *tracker);
+StatusCode PCD_CalibrateRf(MFRC522Ptr_t mfrc, MIFARE_Key *key,
+						   uint8_t blockAddr, PCD_Calibration *result);
 
 #endif
\ No newline at end of file
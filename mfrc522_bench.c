@@ -0,0 +1,225 @@
+/**
+* Hardware-in-the-loop benchmark for the mfrc522 library for pi pico c/c++ sdk
+*
+* Wire one MFRC522 as in MFRC522_GetDefaultConfig() and connect over USB.
+* Every result is printed as one JSON object per line, lines starting with
+* '#' are prompts for the operator. Keep the field empty until asked for a
+* PICC, then present a MIFARE Classic 1K with the default key or a NTAG21x.
+*/
+
+#include "mfrc522.h"
+#include "pico/stdio_usb.h"
+
+// Repetitions per measurement
+#define BENCH_REQA_POLLS 2000
+#define BENCH_SELECT_RUNS 200
+#define BENCH_READ_RUNS 200
+
+// Running minimum, maximum and sum of a latency measurement
+typedef struct {
+	uint32_t n;
+	uint64_t min;
+	uint64_t max;
+	uint64_t total;
+} BenchSample;
+
+static void Bench_Add(BenchSample *sample, uint64_t us) {
+	if (sample->n == 0 || us < sample->min) {
+		sample->min = us;
+	}
+	if (us > sample->max) {
+		sample->max = us;
+	}
+	sample->total += us;
+	sample->n++;
+}
+
+static void Bench_PrintValue(const char *name, double value, const char *unit,
+							 uint32_t n) {
+	printf("{\"bench\":\"%s\",\"value\":%.3f,\"unit\":\"%s\",\"n\":%lu}\n",
+		   name, value, unit, (unsigned long)n);
+}
+
+static void Bench_PrintSample(const char *name, const BenchSample *sample) {
+	if (sample->n == 0) {
+		printf("{\"bench\":\"%s\",\"error\":\"no successful run\"}\n", name);
+		return;
+	}
+	printf("{\"bench\":\"%s\",\"unit\":\"us\",\"n\":%lu,\"min\":%llu,"
+		   "\"avg\":%llu,\"max\":%llu}\n",
+		   name, (unsigned long)sample->n, (unsigned long long)sample->min,
+		   (unsigned long long)(sample->total / sample->n),
+		   (unsigned long long)sample->max);
+}
+
+static void Bench_PrintError(const char *name, StatusCode status) {
+	printf("{\"bench\":\"%s\",\"error\":\"%s\"}\n", name,
+		   GetStatusCodeName(status));
+}
+
+/**
+ * REQA rate with no PICC in the field, every REQA ends in a timeout.
+ */
+static void Bench_EmptyFieldPoll(MFRC522Ptr_t mfrc) {
+	uint64_t start = time_us_64();
+	for (uint32_t i = 0; i < BENCH_REQA_POLLS; i++) {
+		PICC_IsNewCardPresent(mfrc);
+	}
+	uint64_t elapsed = time_us_64() - start;
+	Bench_PrintValue("reqa_empty_poll_rate",
+					 BENCH_REQA_POLLS * 1000000.0 / elapsed, "Hz",
+					 BENCH_REQA_POLLS);
+}
+
+/**
+ * Time from WUPA to a complete UID for a PICC already in the field.
+ */
+static void Bench_PresenceToUid(MFRC522Ptr_t mfrc, Uid *uid) {
+	BenchSample sample = {0};
+	uint8_t bufferATQA[2];
+	uint8_t bufferSize;
+	Uid selected;
+
+	for (uint32_t i = 0; i < BENCH_SELECT_RUNS; i++) {
+		PICC_HaltA(mfrc);
+		PCD_StopCrypto1(mfrc);
+		bufferSize = sizeof(bufferATQA);
+		uint64_t start = time_us_64();
+		if (PICC_WakeupA(mfrc, bufferATQA, &bufferSize) == STATUS_OK &&
+			PICC_Select(mfrc, &selected, 0) == STATUS_OK) {
+			Bench_Add(&sample, time_us_64() - start);
+			*uid = selected;
+		}
+	}
+	Bench_PrintSample("presence_to_uid_latency", &sample);
+}
+
+/**
+ * MIFARE Classic 1K: one authenticated block read, then the whole card.
+ */
+static void Bench_Classic1K(MFRC522Ptr_t mfrc, Uid *uid) {
+	MIFARE_Key key = {{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}};
+	uint8_t buffer[18];
+	uint8_t size;
+	BenchSample sample = {0};
+
+	StatusCode status =
+		PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A, 4, &key, uid);
+	if (status != STATUS_OK) {
+		Bench_PrintError("block_read_latency", status);
+		return;
+	}
+	for (uint32_t i = 0; i < BENCH_READ_RUNS; i++) {
+		size = sizeof(buffer);
+		uint64_t start = time_us_64();
+		if (MIFARE_Read(mfrc, 4, buffer, &size) == STATUS_OK) {
+			Bench_Add(&sample, time_us_64() - start);
+		}
+	}
+	Bench_PrintSample("block_read_latency", &sample);
+
+	static uint8_t card[1024];
+	uint64_t start = time_us_64();
+	status = MIFARE_ReadSectors(mfrc, uid, PICC_CMD_MF_AUTH_KEY_A, &key, 0, 16,
+								card, false);
+	uint64_t elapsed = time_us_64() - start;
+	if (status != STATUS_OK) {
+		Bench_PrintError("classic_1k_read_time", status);
+		return;
+	}
+	Bench_PrintValue("classic_1k_read_time", elapsed, "us", 1);
+}
+
+/**
+ * NTAG21x: size from GET_VERSION, then the full memory with FAST_READ.
+ */
+static void Bench_Ntag(MFRC522Ptr_t mfrc) {
+	uint8_t command[3] = {0x60}; // GET_VERSION
+	uint8_t version[10];
+	uint8_t size = sizeof(version);
+	uint16_t pages;
+
+	PCD_CalculateCRC(mfrc, command, 1, &command[1]);
+	StatusCode status =
+		PCD_TransceiveData(mfrc, command, 3, version, &size, NULL, 0, true);
+	if (status != STATUS_OK) {
+		Bench_PrintError("ntag_full_read_time", status);
+		return;
+	}
+	switch (version[6]) { // Storage size
+	case 0x0F:
+		pages = 45; // NTAG213
+		break;
+	case 0x11:
+		pages = 135; // NTAG215
+		break;
+	case 0x13:
+		pages = 231; // NTAG216
+		break;
+	default:
+		printf("{\"bench\":\"ntag_full_read_time\",\"error\":\"unknown "
+			   "storage size 0x%02x\"}\n",
+			   version[6]);
+		return;
+	}
+
+	static uint8_t memory[231 * 4];
+	uint64_t start = time_us_64();
+	status = NTAG_FastRead(mfrc, 0, pages - 1, memory);
+	uint64_t elapsed = time_us_64() - start;
+	if (status != STATUS_OK) {
+		Bench_PrintError("ntag_full_read_time", status);
+		return;
+	}
+	Bench_PrintValue("ntag_full_read_time", elapsed, "us", pages * 4);
+}
+
+int main() {
+	MFRC522_Config config;
+	Uid uid;
+
+	stdio_init_all();
+	while (!stdio_usb_connected()) {
+		sleep_ms(100);
+	}
+
+	MFRC522Ptr_t mfrc = MFRC522_Init();
+	MFRC522_GetDefaultConfig(&config);
+	config.baudrate = 0; // Probe the fastest stable SPI clock
+	PCD_InitWithConfig(mfrc, &config);
+
+	printf("{\"bench\":\"chip_version\",\"value\":%u,\"unit\":\"\",\"n\":1}\n",
+		   PCD_ReadRegister(mfrc, VersionReg));
+	uint baudrate = PCD_ProbeBaudrate(mfrc, MFRC522_MAX_BIT_RATE);
+	Bench_PrintValue("max_spi_clock", baudrate, "Hz", 1);
+
+	printf("# Keep the field empty\n");
+	sleep_ms(2000);
+	Bench_EmptyFieldPoll(mfrc);
+
+	while (1) {
+		printf("# Present a MIFARE Classic 1K or NTAG21x\n");
+		while (!PICC_IsNewCardPresent(mfrc) || !PICC_ReadCardSerial(mfrc)) {
+		}
+		uid = mfrc->uid;
+		printf("{\"bench\":\"picc\",\"sak\":%u,\"type\":\"%s\"}\n", uid.sak,
+			   PICC_GetTypeName(PICC_GetType(uid.sak)));
+
+		Bench_PresenceToUid(mfrc, &uid);
+		switch (PICC_GetType(uid.sak)) {
+		case PICC_TYPE_MIFARE_1K:
+			Bench_Classic1K(mfrc, &uid);
+			break;
+		case PICC_TYPE_MIFARE_UL:
+			Bench_Ntag(mfrc);
+			break;
+		default:
+			break;
+		}
+		PICC_HaltA(mfrc);
+		PCD_StopCrypto1(mfrc);
+		printf("{\"bench\":\"done\"}\n");
+		printf("# Remove the PICC\n");
+		sleep_ms(3000);
+	}
+}
@@ -0,0 +1,171 @@
+/**
+* Dual-core mode for the mfrc522 library for pi pico c/c++ sdk
+* NOTE: Please also check the comments in mfrc522_core1.h.
+*/
+
+#include "mfrc522_core1.h"
+#include "pico/multicore.h"
+
+// Only touched by core1 once it has been launched
+static MFRC522_Core1Config core1Config;
+// Card events from core1 to core0
+static queue_t core1Events;
+// Events core1 could not queue because core0 fell behind
+static volatile uint32_t core1Dropped;
+// IRQ pins of the readers, handed over from core0 to core1 and back
+static int core1IrqPins[MFRC522_CORE1_MAX_READERS];
+
+// Handshake of MFRC522_Core1Stop() through the multicore FIFO
+#define MFRC522_CORE1_STOP_REQUEST 0x53544F50 // "STOP"
+#define MFRC522_CORE1_STOPPED 0x49444C45	  // "IDLE"
+
+/**
+ * Reads the requested block of a freshly selected PICC into event.
+ */
+static void MFRC522_Core1ReadBlock(MFRC522Ptr_t mfrc, MFRC522_CardEvent *event) {
+	uint8_t buffer[18];
+	uint8_t size = sizeof(buffer);
+
+	switch (event->type) {
+	case PICC_TYPE_MIFARE_MINI:
+	case PICC_TYPE_MIFARE_1K:
+	case PICC_TYPE_MIFARE_4K:
+		event->readStatus =
+			PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A,
+							 core1Config.blockAddr, &core1Config.key, &mfrc->uid);
+		if (event->readStatus != STATUS_OK) {
+			return;
+		}
+		break;
+	case PICC_TYPE_MIFARE_UL:
+		break;
+	default: // Nothing we know how to read
+		event->readStatus = STATUS_INVALID;
+		return;
+	}
+	event->readStatus = MIFARE_Read(mfrc, core1Config.blockAddr, buffer, &size);
+	if (event->readStatus == STATUS_OK) {
+		memcpy(event->data, buffer, sizeof(event->data));
+	}
+}
+
+/**
+ * core1 entry point: polls every reader in turn and queues an event for each
+ * PICC that could be selected.
+ */
+static void MFRC522_Core1Main(void) {
+	// GPIO interrupts are per core, core0 has released the IRQ pins
+	for (uint8_t i = 0; i < core1Config.readerCount; i++) {
+		if (core1IrqPins[i] >= 0) {
+			PCD_SetIrqPin(core1Config.readers[i], core1IrqPins[i]);
+		}
+	}
+
+	while (!multicore_fifo_rvalid() ||
+		   multicore_fifo_pop_blocking() != MFRC522_CORE1_STOP_REQUEST) {
+		bool seen = false;
+		for (uint8_t i = 0; i < core1Config.readerCount; i++) {
+			MFRC522Ptr_t mfrc = core1Config.readers[i];
+			if (!PICC_IsNewCardPresent(mfrc) || !PICC_ReadCardSerial(mfrc)) {
+				continue;
+			}
+			seen = true;
+
+			MFRC522_CardEvent event;
+			event.reader = i;
+			event.uid = mfrc->uid;
+			event.type = PICC_GetType(mfrc->uid.sak);
+			event.timestamp = time_us_64();
+			event.readStatus = STATUS_INVALID;
+			if (core1Config.readBlock) {
+				MFRC522_Core1ReadBlock(mfrc, &event);
+			}
+			PICC_HaltA(mfrc);
+			PCD_StopCrypto1(mfrc);
+
+			if (!queue_try_add(&core1Events, &event)) {
+				core1Dropped++;
+			}
+		}
+		if (!seen && core1Config.idleUs) {
+			sleep_us(core1Config.idleUs);
+		}
+	}
+
+	// Between two transactions: no chip select asserted, no exchange
+	// active. Release the IRQ pins so core0 can take them back.
+	for (uint8_t i = 0; i < core1Config.readerCount; i++) {
+		if (core1IrqPins[i] >= 0) {
+			PCD_SetIrqPin(core1Config.readers[i], -1);
+		}
+	}
+	multicore_fifo_push_blocking(MFRC522_CORE1_STOPPED);
+	while (1) {
+		__wfe(); // Until core0 resets this core
+	}
+}
+
+/**
+ * Launches the polling loop on core1. From now on the readers in config
+ * belong to core1 and must not be used from core0.
+ */
+void MFRC522_Core1Start(const MFRC522_Core1Config *config) {
+	core1Config = *config;
+	if (core1Config.readerCount > MFRC522_CORE1_MAX_READERS) {
+		core1Config.readerCount = MFRC522_CORE1_MAX_READERS;
+	}
+	// Disable the IRQ pins on core0 first, or both cores take the interrupt
+	for (uint8_t i = 0; i < core1Config.readerCount; i++) {
+		MFRC522Ptr_t mfrc = core1Config.readers[i];
+		core1IrqPins[i] = mfrc->irqPin;
+		if (mfrc->irqPin >= 0) {
+			PCD_SetIrqPin(mfrc, -1);
+		}
+	}
+	core1Dropped = 0;
+	queue_init(&core1Events, sizeof(MFRC522_CardEvent),
+			   MFRC522_CORE1_QUEUE_SIZE);
+	multicore_launch_core1(MFRC522_Core1Main);
+} // End MFRC522_Core1Start()
+
+/**
+ * Stops core1, the readers can then be used from core0 again, with their
+ * IRQ pins back on core0. core1 finishes the PICC it is busy with first, so
+ * no chip select, lock or exchange is left behind. Events still queued are
+ * discarded.
+ */
+void MFRC522_Core1Stop(void) {
+	multicore_fifo_push_blocking(MFRC522_CORE1_STOP_REQUEST);
+	while (multicore_fifo_pop_blocking() != MFRC522_CORE1_STOPPED) {
+	}
+	multicore_reset_core1();
+	queue_free(&core1Events);
+	for (uint8_t i = 0; i < core1Config.readerCount; i++) {
+		if (core1IrqPins[i] >= 0) {
+			PCD_SetIrqPin(core1Config.readers[i], core1IrqPins[i]);
+		}
+	}
+} // End MFRC522_Core1Stop()
+
+/**
+ * Takes the oldest card event without waiting.
+ *
+ * @return true if an event was copied to *event.
+ */
+bool MFRC522_Core1GetEvent(MFRC522_CardEvent *event) {
+	return queue_try_remove(&core1Events, event);
+} // End MFRC522_Core1GetEvent()
+
+/**
+ * Waits for the next card event.
+ */
+void MFRC522_Core1GetEventBlocking(MFRC522_CardEvent *event) {
+	queue_remove_blocking(&core1Events, event);
+} // End MFRC522_Core1GetEventBlocking()
+
+/**
+ * @return The number of events lost because the queue was full.
+ */
+uint32_t MFRC522_Core1Dropped(void) {
+	return core1Dropped;
+} // End MFRC522_Core1Dropped()
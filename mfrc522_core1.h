@@ -0,0 +1,57 @@
+/*
+ * mfrc522_core1.h
+ *
+ * Dual-core mode for the mfrc522 library for pi pico c/c++ sdk
+ *
+ * Runs the detect/select/read loop for one or more readers on core1 and hands
+ * finished card events to core0 through a pico queue_t. RF timing is then
+ * never delayed by the application, and RF timeouts never stall it. The
+ * multicore FIFO carries the stop request of MFRC522_Core1Stop(), leave it
+ * alone while core1 runs.
+ *
+ */
+
+#ifndef MFRC522_CORE1_h
+#define MFRC522_CORE1_h
+
+#include "mfrc522.h"
+#include "pico/util/queue.h"
+
+/*******************************************************************************
+ * Types/enumerations/variables
+ ******************************************************************************/
+// Card events buffered between the cores
+#define MFRC522_CORE1_QUEUE_SIZE 8
+// Readers core1 can poll
+#define MFRC522_CORE1_MAX_READERS 4
+
+// Work done on core1, set up by core0 before MFRC522_Core1Start()
+typedef struct {
+	MFRC522Ptr_t readers[MFRC522_CORE1_MAX_READERS]; // After PCD_Init()
+	uint8_t readerCount;
+	bool readBlock;	// Also read blockAddr of each new PICC
+	uint8_t blockAddr; // MIFARE Classic block or Ultralight page to read
+	MIFARE_Key key;	// Key A for blockAddr on MIFARE Classic PICCs
+	uint32_t idleUs;   // Pause after a poll round without PICCs, 0 for none
+} MFRC522_Core1Config;
+
+// One PICC seen by core1
+typedef struct {
+	uint8_t reader;		// Index in MFRC522_Core1Config.readers
+	Uid uid;			// UID and SAK of the PICC, now in state HALT
+	PICC_Type type;		// PICC_GetType(uid.sak)
+	uint64_t timestamp; // time_us_64() after PICC_Select()
+	StatusCode readStatus; // Result of the block read, if requested
+	uint8_t data[16];	  // Block contents if readStatus is STATUS_OK
+} MFRC522_CardEvent;
+
+/*******************************************************************************
+* Functions for running the readers on core1
+*******************************************************************************/
+void MFRC522_Core1Start(const MFRC522_Core1Config *config);
+void MFRC522_Core1Stop(void);
+bool MFRC522_Core1GetEvent(MFRC522_CardEvent *event);
+void MFRC522_Core1GetEventBlocking(MFRC522_CardEvent *event);
+uint32_t MFRC522_Core1Dropped(void);
+
+#endif
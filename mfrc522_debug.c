@@ -0,0 +1,714 @@
+/**
+* Serial dumps and UID changing tools of the mfrc522 library for pi pico c/c++
+* sdk. Compiled only with MFRC522_DEBUG and MFRC522_UID_TOOLS, see mfrc522.h.
+* NOTE: Please also check the comments in mfrc522.h.
+*/
+
+#include "mfrc522.h"
+
+#if MFRC522_DEBUG
+/*******************************************************************************
+* Support functions for debugging
+*******************************************************************************/
+
+/**
+ * Returns const char pointer to a status code name.
+ *
+ * @return const char *
+ */
+const char *GetStatusCodeName(StatusCode code ///< One of theStatusCode enums.
+							  ) {
+	switch (code) {
+	case STATUS_OK:
+		return "Success.";
+	case STATUS_ERROR:
+		return "Error in communication.";
+	case STATUS_COLLISION:
+		return "Collision detected.";
+	case STATUS_TIMEOUT:
+		return "Timeout in communication.";
+	case STATUS_NO_ROOM:
+		return "A buffer is not big enough.";
+	case STATUS_INTERNAL_ERROR:
+		return "Internal error in the code. Should not happen.";
+	case STATUS_INVALID:
+		return "Invalid argument.";
+	case STATUS_CRC_WRONG:
+		return "The CRC_A does not match.";
+	case STATUS_PENDING:
+		return "The exchange has not completed yet.";
+	case STATUS_MIFARE_NACK:
+		return "A MIFARE PICC responded with NAK.";
+	default:
+		return "Unknown error";
+	}
+} // End GetStatusCodeName()
+
+/**
+ * Returns const char pointer to the PICC type name.
+ *
+ * @return const char *
+ */
+const char *PICC_GetTypeName(PICC_Type piccType ///< One of the PICC_Type enums.
+							 ) {
+	switch (piccType) {
+	case PICC_TYPE_ISO_14443_4:
+		return "PICC compliant with ISO/IEC 14443-4";
+	case PICC_TYPE_ISO_18092:
+		return "PICC compliant with ISO/IEC 18092 (NFC)";
+	case PICC_TYPE_MIFARE_MINI:
+		return "MIFARE Mini, 320 bytes";
+	case PICC_TYPE_MIFARE_1K:
+		return "MIFARE 1KB";
+	case PICC_TYPE_MIFARE_4K:
+		return "MIFARE 4KB";
+	case PICC_TYPE_MIFARE_UL:
+		return "MIFARE Ultralight or Ultralight C";
+	case PICC_TYPE_MIFARE_PLUS:
+		return "MIFARE Plus";
+	case PICC_TYPE_TNP3XXX:
+		return "MIFARE TNP3XXX";
+	case PICC_TYPE_NOT_COMPLETE:
+		return "SAK indicates UID is not complete.";
+	case PICC_TYPE_UNKNOWN:
+	default:
+		return "Unknown type";
+	}
+} // End PICC_GetTypeName()
+
+/**
+ * Dumps debug info about the connected PCD to Serial.
+ * Shows all known firmware versions
+ */
+void PCD_DumpVersionToSerial(MFRC522Ptr_t mfrc) {
+	char string[2];
+	// Get the MFRC522 firmware version
+	uint8_t v = PCD_ReadRegister(mfrc, VersionReg);
+	printf("Firmware Version: 0x");
+	// print the hexa value of a unsigned char
+	sprintf(string, "%02X", (char)v);
+	printf(string);
+	// Lookup which version
+	switch (v) {
+	case 0x88:
+		printf(" = (clone)\r\n");
+		break;
+	case 0x90:
+		printf(" = v0.0\r\n");
+		break;
+	case 0x91:
+		printf(" = v1.0\r\n");
+		break;
+	case 0x92:
+		printf(" = v2.0\r\n");
+		break;
+	default:
+		printf(" = (unknown)\r\n");
+	}
+	// When 0x00 or 0xFF is returned, communication probably failed
+	if ((v == 0x00) || (v == 0xFF))
+		printf("WARNING: Communication failure, is the MFRC522 properly "
+				 "connected?\r\n");
+} // End PCD_DumpVersionToSerial()
+
+/**
+ * Dumps debug info about the selected PICC to Serial.
+ * On success the PICC is halted after dumping the data.
+ * For MIFARE Classic the factory default key of 0xFFFFFFFFFFFF is tried.
+ */
+void PICC_DumpToSerial(MFRC522Ptr_t mfrc, Uid *uid ///< Pointer to Uid struct
+												   ///returned from a successful
+												   ///PICC_Select().
+					   ) {
+	MIFARE_Key key;
+
+	// Dump UID, SAK and Type
+	PICC_DumpDetailsToSerial(uid);
+
+	// Dump contents
+	PICC_Type piccType = PICC_GetType(uid->sak);
+	switch (piccType) {
+	case PICC_TYPE_MIFARE_MINI:
+	case PICC_TYPE_MIFARE_1K:
+	case PICC_TYPE_MIFARE_4K:
+		// All keys are set to FFFFFFFFFFFFh at chip delivery from the factory.
+		for (uint8_t i = 0; i < 6; i++) {
+			key.keybyte[i] = 0xFF;
+		}
+		PICC_DumpMifareClassicToSerial(mfrc, uid, piccType, &key);
+		break;
+
+	case PICC_TYPE_MIFARE_UL:
+		PICC_DumpMifareUltralightToSerial(mfrc);
+		break;
+
+	case PICC_TYPE_ISO_14443_4:
+	case PICC_TYPE_ISO_18092:
+	case PICC_TYPE_MIFARE_PLUS:
+	case PICC_TYPE_TNP3XXX:
+		printf(
+			"Dumping memory contents not implemented for that PICC type.\r\n");
+		break;
+
+	case PICC_TYPE_UNKNOWN:
+	case PICC_TYPE_NOT_COMPLETE:
+	default:
+		break; // No memory dump here
+	}
+
+	printf("\r\n");
+	PICC_HaltA(mfrc); // Already done if it was a MIFARE Classic PICC.
+} // End PICC_DumpToSerial()
+
+/**
+ * Dumps card info (UID,SAK,Type) about the selected PICC to Serial.
+ */
+void PICC_DumpDetailsToSerial(Uid *uid ///< Pointer to Uid struct returned from
+									   ///a successful PICC_Select().
+							  ) {
+	char string[2];
+	// UID
+	printf("Card UID:");
+	for (uint8_t i = 0; i < uid->size; i++) {
+		if (uid->uidByte[i] < 0x10)
+			printf(" 0");
+		else
+			printf(" ");
+
+		// print the hexa value of a unsigned char
+		sprintf(string, "%02X", (char)uid->uidByte[i]);
+		printf(string);
+	}
+	printf("\r\n");
+
+	// SAK
+	printf("Card SAK: ");
+	if (uid->sak < 0x10)
+		printf("0");
+
+	// print the hexa value of a unsigned char
+	sprintf(string, "%02X", (char)uid->sak);
+	printf(string);
+
+	// (suggested) PICC type
+	PICC_Type piccType = PICC_GetType(uid->sak);
+	printf(" PICC type: ");
+	printf(PICC_GetTypeName(piccType));
+} // End PICC_DumpDetailsToSerial()
+
+/**
+ * Dumps memory contents of a MIFARE Classic PICC.
+ * On success the PICC is halted after dumping the data.
+ */
+void PICC_DumpMifareClassicToSerial(
+	MFRC522Ptr_t mfrc,
+	Uid *uid,			///< Pointer to Uid struct returned from a successful
+						///PICC_Select().
+	PICC_Type piccType, ///< One of the PICC_Type enums.
+	MIFARE_Key *key		///< Key A used for all sectors.
+	) {
+	uint8_t no_of_sectors = 0;
+	switch (piccType) {
+	case PICC_TYPE_MIFARE_MINI:
+		// Has 5 sectors * 4 blocks/sector * 16 uint8_ts/block = 320 uint8_ts.
+		no_of_sectors = 5;
+		break;
+
+	case PICC_TYPE_MIFARE_1K:
+		// Has 16 sectors * 4 blocks/sector * 16 uint8_ts/block = 1024 uint8_ts.
+		no_of_sectors = 16;
+		break;
+
+	case PICC_TYPE_MIFARE_4K:
+		// Has (32 sectors * 4 blocks/sector + 8 sectors * 16 blocks/sector) *
+		// 16 uint8_ts/block = 4096 uint8_ts.
+		no_of_sectors = 40;
+		break;
+
+	default: // Should not happen. Ignore.
+		break;
+	}
+
+	// Dump sectors, highest address first.
+	if (no_of_sectors) {
+		printf("Sector Block   0  1  2  3   4  5  6  7   8  9 10 11  12 13 "
+				 "14 15  AccessBits\r\n");
+		for (int8_t i = no_of_sectors - 1; i >= 0; i--) {
+			PICC_DumpMifareClassicSectorToSerial(mfrc, uid, key, i);
+		}
+	}
+	PICC_HaltA(mfrc); // Halt the PICC before stopping the encrypted session.
+	PCD_StopCrypto1(mfrc);
+} // End PICC_DumpMifareClassicToSerial()
+
+/**
+ * Dumps memory contents of a sector of a MIFARE Classic PICC.
+ * Uses PCD_Authenticate(), MIFARE_Read() and PCD_StopCrypto1.
+ * Always uses PICC_CMD_MF_AUTH_KEY_A because only Key A can always read the
+ * sector trailer access bits.
+ */
+void PICC_DumpMifareClassicSectorToSerial(
+	MFRC522Ptr_t mfrc,
+	Uid *uid,		 ///< Pointer to Uid struct returned from a successful
+					 ///PICC_Select().
+	MIFARE_Key *key, ///< Key A for the sector.
+	uint8_t sector   ///< The sector to dump, 0..39.
+	) {
+	char string[2];
+	uint8_t acces_bit;
+	StatusCode status;
+	uint8_t firstBlock; // Address of lowest address to dump actually last block
+						// dumped)
+	uint8_t no_of_blocks; // Number of blocks in sector
+	bool isSectorTrailer; // Set to true while handling the "last" (ie highest
+						  // address) in the sector.
+
+	// The access bits are stored in a peculiar fashion.
+	// There are four groups:
+	//		g[3]	Access bits for the sector trailer, block 3 (for sectors 0-31)
+	//or block 15 (for sectors 32-39)
+	//		g[2]	Access bits for block 2 (for sectors 0-31) or blocks 10-14 (for
+	//sectors 32-39)
+	//		g[1]	Access bits for block 1 (for sectors 0-31) or blocks 5-9 (for
+	//sectors 32-39)
+	//		g[0]	Access bits for block 0 (for sectors 0-31) or blocks 0-4 (for
+	//sectors 32-39)
+	// Each group has access bits [C1 C2 C3]. In this code C1 is MSB and C3 is
+	// LSB.
+	// The four CX bits are stored together in a nible cx and an inverted nible
+	// cx_.
+	uint8_t c1, c2, c3;	// Nibbles
+	uint8_t c1_, c2_, c3_; // Inverted nibbles
+	bool invertedError;	// True if one of the inverted nibbles did not match
+	uint8_t g[4];		   // Access bits for each of the four groups.
+	uint8_t group;		   // 0-3 - active group for access bits
+	bool firstInGroup;	 // True for the first block dumped in the group
+
+	// Determine position and size of sector.
+	if (sector < 32) { // Sectors 0..31 has 4 blocks each
+		no_of_blocks = 4;
+		firstBlock = sector * no_of_blocks;
+	} else if (sector < 40) { // Sectors 32-39 has 16 blocks each
+		no_of_blocks = 16;
+		firstBlock = 128 + (sector - 32) * no_of_blocks;
+	} else { // Illegal input, no MIFARE Classic PICC has more than 40 sectors.
+		return;
+	}
+
+	// Dump blocks, highest address first.
+	uint8_t uint8_tCount;
+	uint8_t buffer[18];
+	uint8_t blockAddr;
+	isSectorTrailer = true;
+	for (int8_t blockOffset = no_of_blocks - 1; blockOffset >= 0;
+		 blockOffset--) {
+		blockAddr = firstBlock + blockOffset;
+		// Sector number - only on first line
+		if (isSectorTrailer) {
+			if (sector < 10)
+				printf("   "); // Pad with spaces
+			else
+				printf("  "); // Pad with spaces
+			sprintf(string, "%u", sector);
+			printf(string);
+			printf("   ");
+		} else {
+			printf("       ");
+		}
+		// Block number
+		if (blockAddr < 10)
+			printf("   "); // Pad with spaces
+		else {
+			if (blockAddr < 100)
+				printf("  "); // Pad with spaces
+			else
+				printf(" "); // Pad with spaces
+		}
+		sprintf(string, "%u", blockAddr);
+		printf(string);
+		printf("  ");
+		// Establish encrypted communications before reading the first block
+		if (isSectorTrailer) {
+			status = PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A, firstBlock,
+									  key, uid);
+			if (status != STATUS_OK) {
+				printf("PCD_Authenticate() failed: ");
+				printf(GetStatusCodeName(status));
+				printf("\n");
+				return;
+			}
+		}
+		// Read block
+		uint8_tCount = sizeof(buffer);
+		status = MIFARE_Read(mfrc, blockAddr, buffer, &uint8_tCount);
+		if (status != STATUS_OK) {
+			printf("MIFARE_Read() failed: ");
+			printf(GetStatusCodeName(status));
+			continue;
+		}
+		// Dump data
+		for (uint8_t index = 0; index < 16; index++) {
+			if (buffer[index] < 0x10)
+				printf(" 0");
+			else
+				printf(" ");
+
+			// print the hexa value of a unsigned char
+			sprintf(string, "%02X", (char)buffer[index]);
+			printf(string);
+			if ((index % 4) == 3) {
+				printf(" ");
+			}
+		}
+		// Parse sector trailer data
+		if (isSectorTrailer) {
+			c1 = buffer[7] >> 4;
+			c2 = buffer[8] & 0xF;
+			c3 = buffer[8] >> 4;
+			c1_ = buffer[6] & 0xF;
+			c2_ = buffer[6] >> 4;
+			c3_ = buffer[7] & 0xF;
+			invertedError = (c1 != (~c1_ & 0xF)) || (c2 != (~c2_ & 0xF)) ||
+							(c3 != (~c3_ & 0xF));
+			g[0] = ((c1 & 1) << 2) | ((c2 & 1) << 1) | ((c3 & 1) << 0);
+			g[1] = ((c1 & 2) << 1) | ((c2 & 2) << 0) | ((c3 & 2) >> 1);
+			g[2] = ((c1 & 4) << 0) | ((c2 & 4) >> 1) | ((c3 & 4) >> 2);
+			g[3] = ((c1 & 8) >> 1) | ((c2 & 8) >> 2) | ((c3 & 8) >> 3);
+			isSectorTrailer = false;
+		}
+
+		// Which access group is this block in?
+		if (no_of_blocks == 4) {
+			group = blockOffset;
+			firstInGroup = true;
+		} else {
+			group = blockOffset / 5;
+			firstInGroup = (group == 3) || (group != (blockOffset + 1) / 5);
+		}
+
+		if (firstInGroup) {
+			// Print access bits
+			printf(" [ ");
+
+			acces_bit = (g[group] >> 2) & 1;
+			sprintf(string, "%u", acces_bit);
+			printf(string);
+			printf(" ");
+
+			acces_bit = (g[group] >> 1) & 1;
+			sprintf(string, "%u", acces_bit);
+			printf(string);
+			printf(" ");
+
+			acces_bit = (g[group] >> 0) & 1;
+			sprintf(string, "%u", acces_bit);
+			printf(string);
+
+			printf(" ] ");
+			if (invertedError) {
+				printf(" Inverted access bits did not match! ");
+			}
+		}
+
+		if (group != 3 &&
+			(g[group] == 1 ||
+			 g[group] == 6)) { // Not a sector trailer, a value block
+			long value = ((long)(buffer[3]) << 24) | ((long)(buffer[2]) << 16) |
+						 ((long)(buffer[1]) << 8) | (long)(buffer[0]);
+			printf(" Value=0x");
+
+			// print the hexa value of a unsigned char
+			sprintf(string, "%02X", (char)value);
+			printf(string);
+			printf(" Adr=0x");
+
+			// print the hexa value of a unsigned char
+			sprintf(string, "%02X", (char)buffer[12]);
+			printf(string);
+		}
+		printf("\r\n");
+	}
+
+	return;
+} // End PICC_DumpMifareClassicSectorToSerial()
+
+/**
+ * Dumps memory contents of a MIFARE Ultralight PICC.
+ */
+void PICC_DumpMifareUltralightToSerial(MFRC522Ptr_t mfrc) {
+	char string[2];
+	StatusCode status;
+	uint8_t uint8_tCount;
+	uint8_t buffer[18];
+	uint8_t i;
+
+	printf("Page  0  1  2  3\r\n");
+	// Try the mpages of the original Ultralight. Ultralight C has more pages.
+	for (uint8_t page = 0; page < 16;
+		 page += 4) { // Read returns data for 4 pages at a time.
+		// Read pages
+		uint8_tCount = sizeof(buffer);
+		status = MIFARE_Read(mfrc, page, buffer, &uint8_tCount);
+		if (status != STATUS_OK) {
+			printf("MIFARE_Read() failed: ");
+			printf(GetStatusCodeName(status));
+			break;
+		}
+		// Dump data
+		for (uint8_t offset = 0; offset < 4; offset++) {
+			i = page + offset;
+			if (i < 10)
+				printf("  "); // Pad with spaces
+			else
+				printf(" "); // Pad with spaces
+			sprintf(string, "%u", i);
+			printf(string);
+			printf("  ");
+			for (uint8_t index = 0; index < 4; index++) {
+				i = 4 * offset + index;
+				if (buffer[i] < 0x10)
+					printf(" 0");
+				else
+					printf(" ");
+
+				// print the hexa value of a unsigned char
+				sprintf(string, "%02X", (char)buffer[i]);
+				printf(string);
+			}
+			printf("\r\n");
+		}
+	}
+} // End PICC_DumpMifareUltralightToSerial()
+#endif
+
+#if MFRC522_UID_TOOLS
+/*******************************************************************************
+* Advanced functions for MIFARE
+*******************************************************************************/
+
+/**
+ * Performs the "magic sequence" needed to get Chinese UID changeable
+ * Mifare cards to allow writing to sector 0, where the card UID is stored.
+ *
+ * Note that you do not need to have selected the card through REQA or WUPA,
+ * this sequence works immediately when the card is in the reader vicinity.
+ * This means you can use this method even on "bricked" cards that your reader
+ *does
+ * not recognise anymore (see MIFARE_UnbrickUidSector).
+ *
+ * Of course with non-bricked devices, you're free to select them before calling
+ *this function.
+ */
+bool MIFARE_OpenUidBackdoor(MFRC522Ptr_t mfrc, bool logErrors) {
+	char string[2];
+	// Magic sequence:
+	// > 50 00 57 CD (HALT + CRC)
+	// > 40 (7 bits only)
+	// < A (4 bits only)
+	// > 43
+	// < A (4 bits only)
+	// Then you can write to sector 0 without authenticating
+
+	PICC_HaltA(mfrc); // 50 00 57 CD
+
+	uint8_t cmd = 0x40;
+	uint8_t validBits =
+		7; /* Our command is only 7 bits. After receiving card response,
+		  this will contain amount of valid response bits. */
+	uint8_t response[32]; // Card's response is written here
+	uint8_t received;
+	StatusCode status =
+		PCD_TransceiveData(mfrc, &cmd, (uint8_t)1, response, &received,
+						   &validBits, (uint8_t)0, false); // 40
+	if (status != STATUS_OK) {
+		if (logErrors) {
+			printf("Card did not respond to 0x40 after HALT command. Are you "
+					 "sure it is a UID changeable one?\r\n");
+			printf("Error name: ");
+			printf(GetStatusCodeName(status));
+		}
+		return false;
+	}
+	if (received != 1 || response[0] != 0x0A) {
+		if (logErrors) {
+			printf("Got bad response on backdoor 0x40 command: ");
+
+			// print the hexa value of a unsigned char
+			sprintf(string, "%02X", (char)response[0]);
+			printf(string);
+			printf(" (");
+			sprintf(string, "%u", validBits);
+			printf(string);
+			printf(" valid bits)\r\n");
+		}
+		return false;
+	}
+
+	cmd = 0x43;
+	validBits = 8;
+	status = PCD_TransceiveData(mfrc, &cmd, (uint8_t)1, response, &received,
+								&validBits, (uint8_t)0, false); // 43
+	if (status != STATUS_OK) {
+		if (logErrors) {
+			printf("Error in communication at command 0x43, after "
+					 "successfully executing 0x40\r\n");
+			printf("Error name: ");
+			printf(GetStatusCodeName(status));
+		}
+		return false;
+	}
+	if (received != 1 || response[0] != 0x0A) {
+		if (logErrors) {
+			printf("Got bad response on backdoor 0x43 command: ");
+
+			// print the hexa value of a unsigned char
+			sprintf(string, "%02X", (char)response[0]);
+			printf(string);
+			printf(" (");
+			sprintf(string, "%u", validBits);
+			printf(string);
+			printf(" valid bits)\r\n");
+		}
+		return false;
+	}
+
+	// You can now write to sector 0 without authenticating!
+	return true;
+} // End MIFARE_OpenUidBackdoor()
+
+/**
+ * Reads entire block 0, including all manufacturer data, and overwrites
+ * that block with the new UID, a freshly calculated BCC, and the original
+ * manufacturer data.
+ *
+ * It assumes a default KEY A of 0xFFFFFFFFFFFF.
+ * Make sure to have selected the card before this function is called.
+ */
+bool MIFARE_SetUid(MFRC522Ptr_t mfrc, uint8_t *newUid, uint8_t uidSize,
+				   bool logErrors) {
+
+	// UID + BCC uint8_t can not be larger than 16 together
+	if (!newUid || !uidSize || uidSize > 15) {
+		if (logErrors) {
+			printf("New UID buffer empty, size 0, or size > 15 given\r\n");
+		}
+		return false;
+	}
+
+	// Authenticate for reading
+	MIFARE_Key key = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+	StatusCode status = PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A,
+										 (uint8_t)1, &key, &(mfrc->uid));
+	if (status != STATUS_OK) {
+
+		if (status == STATUS_TIMEOUT) {
+			// We get a read timeout if no card is selected yet, so let's select
+			// one
+
+			// Wake the card up again if sleeping
+			//			  uint8_t atqa_answer[2];
+			//			  uint8_t atqa_size = 2;
+			//			  PICC_WakeupA(atqa_answer, &atqa_size);
+
+			if (!PICC_IsNewCardPresent(mfrc) || !PICC_ReadCardSerial(mfrc)) {
+				printf("No card was previously selected, and none are "
+						 "available. Failed to set UID.\r\n");
+				return false;
+			}
+
+			status = PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A, (uint8_t)1,
+									  &key, &(mfrc->uid));
+			if (status != STATUS_OK) {
+				// We tried, time to give up
+				if (logErrors) {
+					printf("Failed to authenticate to card for reading, "
+							 "could not set UID: \r\n");
+					printf(GetStatusCodeName(status));
+				}
+				return false;
+			}
+		} else {
+			if (logErrors) {
+				printf("PCD_Authenticate() failed: ");
+				printf(GetStatusCodeName(status));
+				printf("\n");
+			}
+			return false;
+		}
+	}
+
+	// Read block 0
+	uint8_t block0_buffer[18];
+	uint8_t uint8_tCount = sizeof(block0_buffer);
+	status = MIFARE_Read(mfrc, (uint8_t)0, block0_buffer, &uint8_tCount);
+	if (status != STATUS_OK) {
+		if (logErrors) {
+			printf("MIFARE_Read() failed: ");
+			printf(GetStatusCodeName(status));
+			printf(
+				"Are you sure your KEY A for sector 0 is 0xFFFFFFFFFFFF?\r\n");
+		}
+		return false;
+	}
+
+	// Write new UID to the data we just read, and calculate BCC uint8_t
+	uint8_t bcc = 0;
+	for (int i = 0; i < uidSize; i++) {
+		block0_buffer[i] = newUid[i];
+		bcc ^= newUid[i];
+	}
+
+	// Write BCC uint8_t to buffer
+	block0_buffer[uidSize] = bcc;
+
+	// Stop encrypted traffic so we can send raw uint8_ts
+	PCD_StopCrypto1(mfrc);
+
+	// Activate UID backdoor
+	if (!MIFARE_OpenUidBackdoor(mfrc, logErrors)) {
+		if (logErrors) {
+			printf("Activating the UID backdoor failed.\r\n");
+		}
+		return false;
+	}
+
+	// Write modified block 0 back to card
+	status = MIFARE_Write(mfrc, (uint8_t)0, block0_buffer, (uint8_t)16);
+	if (status != STATUS_OK) {
+		if (logErrors) {
+			printf("MIFARE_Write() failed: ");
+			printf(GetStatusCodeName(status));
+		}
+		return false;
+	}
+
+	// Wake the card up again
+	uint8_t atqa_answer[2];
+	uint8_t atqa_size = 2;
+	PICC_WakeupA(mfrc, atqa_answer, &atqa_size);
+
+	return true;
+}
+
+/**
+ * Resets entire sector 0 to zeroes, so the card can be read again by readers.
+ */
+bool MIFARE_UnbrickUidSector(MFRC522Ptr_t mfrc, bool logErrors) {
+	MIFARE_OpenUidBackdoor(mfrc, logErrors);
+
+	uint8_t block0_buffer[] = {0x01, 0x02, 0x03, 0x04, 0x04, 0x00, 0x00, 0x00,
+							   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+	// Write modified block 0 back to card
+	StatusCode status =
+		MIFARE_Write(mfrc, (uint8_t)0, block0_buffer, (uint8_t)16);
+	if (status != STATUS_OK) {
+		if (logErrors) {
+			printf("MIFARE_Write() failed: ");
+			printf(GetStatusCodeName(status));
+		}
+		return false;
+	}
+	return true;
+}
+#endif
@@ -0,0 +1,213 @@
+/**
+* Idle mode for the mfrc522 library for pi pico c/c++ sdk
+* NOTE: Please also check the comments in mfrc522_idle.h.
+*/
+
+#include "mfrc522_idle.h"
+#if PICO_ON_DEVICE
+#include "hardware/irq.h"
+#endif
+
+#if PICO_ON_DEVICE
+// Wake pins of all idle readers, one bit per GPIO. MFRC522_IdleWakePinHandler
+// serves all of them and is registered while any is set, so the wake pins take
+// a single shared handler slot of IO_IRQ_BANK0.
+static uint32_t idleWakePins;
+
+/**
+ * Shared GPIO handler for the wake pins. It only acknowledges the edge, the
+ * sleeping code re-checks the pin level after waking up.
+ */
+static void MFRC522_IdleWakePinHandler(void) {
+	for (uint pin = 0; pin < 32; pin++) {
+		if ((idleWakePins & (1u << pin)) &&
+			(gpio_get_irq_event_mask(pin) & GPIO_IRQ_EDGE_FALL)) {
+			gpio_acknowledge_irq(pin, GPIO_IRQ_EDGE_FALL);
+		}
+	}
+}
+#endif
+
+/**
+ * The default MFRC522_IdleSleep: __wfe() until until or until wakePin is low.
+ * Any interrupt ends a __wfe(), the falling edge of wakePin among them.
+ */
+static void MFRC522_IdleWait(absolute_time_t until, int wakePin,
+							 void *context) {
+	(void)context;
+	while (!best_effort_wfe_or_timeout(until)) {
+#if PICO_ON_DEVICE
+		if (wakePin >= 0 && !gpio_get(wakePin)) {
+			return;
+		}
+#else
+		(void)wakePin;
+#endif
+	}
+}
+
+/**
+ * @return true if the wake pin of idle is configured and low.
+ */
+static bool MFRC522_IdleWakePinLow(const MFRC522_Idle *idle) {
+#if PICO_ON_DEVICE
+	return idle->config.wakePin >= 0 && !gpio_get(idle->config.wakePin);
+#else
+	(void)idle;
+	return false;
+#endif
+}
+
+/**
+ * Fills in a scan window every MFRC522_IDLE_PERIOD_US, ISO/IEC 14443-3
+ * settling, soft power-down, no wake pin and the default sleep.
+ */
+void MFRC522_IdleConfigInit(MFRC522_IdleConfig *config) {
+	config->periodUs = MFRC522_IDLE_PERIOD_US;
+	config->settleUs = MFRC522_FIELD_SETTLE_US;
+	config->pcdMode = IDLE_PCD_SOFT_POWER_DOWN;
+	config->wakePin = -1;
+	config->sleep = NULL;
+	config->sleepContext = NULL;
+} // End MFRC522_IdleConfigInit()
+
+/**
+ * Prepares idle mode for a reader after PCD_Init(). The antenna is turned on
+ * and TxControlReg remembered, so that waking up later only writes it back.
+ * The wake pin, if any, gets a pull-up and a falling edge interrupt. It must
+ * be a GPIO of its own, not the IRQ pin given to PCD_SetIrqPin().
+ */
+void MFRC522_IdleBegin(MFRC522_Idle *idle, MFRC522Ptr_t mfrc,
+					   const MFRC522_IdleConfig *config) {
+	idle->mfrc = mfrc;
+	idle->config = *config;
+	PCD_AntennaOn(mfrc);
+	idle->txControl = PCD_ReadRegister(mfrc, TxControlReg);
+	idle->parked = false;
+
+#if PICO_ON_DEVICE
+	int pin = config->wakePin;
+	if (pin >= 0) {
+		gpio_init(pin);
+		gpio_set_dir(pin, GPIO_IN);
+		gpio_pull_up(pin);
+		if (idleWakePins == 0) { // The first wake pin
+			gpio_add_raw_irq_handler(pin, MFRC522_IdleWakePinHandler);
+		}
+		idleWakePins |= 1u << pin;
+		gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_FALL, true);
+		irq_set_enabled(IO_IRQ_BANK0, true);
+	}
+#endif
+} // End MFRC522_IdleBegin()
+
+/**
+ * Leaves idle mode: the MFRC522 is resumed and the wake pin released.
+ */
+void MFRC522_IdleEnd(MFRC522_Idle *idle) {
+	MFRC522_IdleResume(idle);
+#if PICO_ON_DEVICE
+	int pin = idle->config.wakePin;
+	if (pin >= 0) {
+		gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_FALL, false);
+		idleWakePins &= ~(1u << pin);
+		if (idleWakePins == 0) { // The last wake pin
+			gpio_remove_raw_irq_handler(pin, MFRC522_IdleWakePinHandler);
+		}
+	}
+#endif
+} // End MFRC522_IdleEnd()
+
+/**
+ * Puts the MFRC522 in the pcdMode of idle. The field is off afterwards, a
+ * PICC that was selected is lost.
+ */
+void MFRC522_IdlePark(MFRC522_Idle *idle) {
+	if (idle->parked) {
+		return;
+	}
+	if (idle->config.pcdMode == IDLE_PCD_FIELD_OFF) {
+		PCD_WriteRegister(idle->mfrc, TxControlReg, idle->txControl & ~0x03);
+	} else {
+		PCD_SoftPowerDown(idle->mfrc); // TxControlReg keeps the antenna on
+	}
+	idle->parked = true;
+} // End MFRC522_IdlePark()
+
+/**
+ * Brings a parked MFRC522 back with the field on and settled for
+ * settleUs. Nothing is written but TxControlReg or the PowerDown bit, the
+ * registers kept their values. Does nothing if the MFRC522 is not parked.
+ *
+ * @return STATUS_OK on success, STATUS_TIMEOUT if the oscillator did not
+ * start.
+ */
+StatusCode MFRC522_IdleResume(MFRC522_Idle *idle) {
+	if (!idle->parked) {
+		return STATUS_OK;
+	}
+	idle->parked = false;
+	if (idle->config.pcdMode == IDLE_PCD_FIELD_OFF) {
+		PCD_WriteRegister(idle->mfrc, TxControlReg, idle->txControl);
+	} else {
+		StatusCode status = PCD_SoftPowerUp(idle->mfrc);
+		if (status != STATUS_OK) {
+			return status;
+		}
+	}
+	sleep_us(idle->config.settleUs); // Let the PICCs power up
+	return STATUS_OK;
+} // End MFRC522_IdleResume()
+
+/**
+ * Sends one REQA per scan window until a PICC answers, with the reader
+ * parked and the RP2040 asleep in between. Windows start every periodUs,
+ * however long they take, and at once when the wake pin is pulled low.
+ * After IDLE_EVENT_CARD the field is on and the PICC is in state READY, call
+ * PICC_ReadCardSerial() next. Otherwise the MFRC522 is parked.
+ *
+ * @return The MFRC522_IdleEvent that ended the wait, IDLE_EVENT_TIMEOUT once
+ * timeoutMs (0 = wait forever) has passed.
+ */
+MFRC522_IdleEvent MFRC522_IdleWaitForCard(MFRC522_Idle *idle,
+										  uint32_t timeoutMs) {
+	const MFRC522_IdleConfig *config = &idle->config;
+	MFRC522_IdleSleep sleep = config->sleep ? config->sleep : MFRC522_IdleWait;
+	absolute_time_t deadline = make_timeout_time_ms(timeoutMs);
+	absolute_time_t window = get_absolute_time();
+	bool woken = false;
+
+	while (1) {
+		if (MFRC522_IdleResume(idle) != STATUS_OK) {
+			return IDLE_EVENT_ERROR;
+		}
+		if (PICC_IsNewCardPresent(idle->mfrc)) {
+			return IDLE_EVENT_CARD;
+		}
+		MFRC522_IdlePark(idle);
+		if (woken) {
+			return IDLE_EVENT_WAKE_PIN;
+		}
+
+		window = delayed_by_us(window, config->periodUs);
+		if (absolute_time_diff_us(get_absolute_time(), window) < 0) {
+			window = get_absolute_time(); // The window took a whole period
+		}
+		absolute_time_t until = window;
+		if (timeoutMs) {
+			if (absolute_time_diff_us(deadline, window) >= 0) {
+				until = deadline;
+			}
+			if (time_reached(deadline)) {
+				return IDLE_EVENT_TIMEOUT;
+			}
+		}
+		sleep(until, config->wakePin, config->sleepContext);
+		woken = MFRC522_IdleWakePinLow(idle);
+		if (woken) {
+			window = get_absolute_time();
+		} else if (timeoutMs && time_reached(deadline)) {
+			return IDLE_EVENT_TIMEOUT;
+		}
+	}
+} // End MFRC522_IdleWaitForCard()
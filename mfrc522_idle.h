@@ -0,0 +1,77 @@
+/*
+ * mfrc522_idle.h
+ *
+ * Duty-cycled idle mode for the mfrc522 library for pi pico c/c++ sdk
+ *
+ * Waits for a PICC with the reader parked between short scan windows. In a
+ * window the field comes back on, settles and a single REQA is sent. Between
+ * windows the MFRC522 has its antenna off or is in soft power-down, and the
+ * RP2040 sleeps until the next window or until a wake pin is pulled low. The
+ * register settings of PCD_Init() survive both, so waking up takes one or
+ * two register writes instead of a new initialisation.
+ *
+ */
+
+#ifndef MFRC522_IDLE_h
+#define MFRC522_IDLE_h
+
+#include "mfrc522.h"
+
+/*******************************************************************************
+ * Types/enumerations/variables
+ ******************************************************************************/
+// Defaults of MFRC522_IdleConfigInit()
+#define MFRC522_IDLE_PERIOD_US 250000 // From one scan window to the next
+
+// How the MFRC522 waits between scan windows
+typedef enum _MFRC522_IdlePcdMode {
+	IDLE_PCD_FIELD_OFF,		 // Antenna off, the oscillator keeps running
+	IDLE_PCD_SOFT_POWER_DOWN // CommandReg PowerDown, the oscillator stops too
+} MFRC522_IdlePcdMode;
+
+// What MFRC522_IdleWaitForCard() saw
+typedef enum _MFRC522_IdleEvent {
+	IDLE_EVENT_CARD,	 // A PICC answered the REQA, it is in state READY
+	IDLE_EVENT_WAKE_PIN, // The wake pin was pulled low, no PICC answered
+	IDLE_EVENT_TIMEOUT,	 // No PICC before the timeout
+	IDLE_EVENT_ERROR	 // The MFRC522 did not come out of soft power-down
+} MFRC522_IdleEvent;
+
+// Puts the RP2040 to sleep until until, or until wakePin (if >= 0) is low
+typedef void (*MFRC522_IdleSleep)(absolute_time_t until, int wakePin,
+								  void *context);
+
+// Duty cycle of MFRC522_IdleWaitForCard()
+typedef struct {
+	uint32_t periodUs; // From the start of one scan window to the next
+	uint32_t settleUs; // Field on before the REQA of a window
+	MFRC522_IdlePcdMode pcdMode;
+	// -1, or a GPIO that starts a window at once when pulled low. Not the IRQ
+	// pin of PCD_SetIrqPin(): MFRC522_IdleBegin() takes the GPIO over, and the
+	// MFRC522 does not drive its IRQ output while parked.
+	int wakePin;
+	MFRC522_IdleSleep sleep; // NULL to wait with __wfe()
+	void *sleepContext;		 // Passed to sleep
+} MFRC522_IdleConfig;
+
+// One reader in idle mode, see MFRC522_IdleBegin()
+typedef struct {
+	MFRC522Ptr_t mfrc;
+	MFRC522_IdleConfig config;
+	uint8_t txControl; // TxControlReg with the antenna on
+	bool parked;	   // The MFRC522 is in its pcdMode
+} MFRC522_Idle;
+
+/*******************************************************************************
+* Functions for idle mode
+*******************************************************************************/
+void MFRC522_IdleConfigInit(MFRC522_IdleConfig *config);
+void MFRC522_IdleBegin(MFRC522_Idle *idle, MFRC522Ptr_t mfrc,
+					   const MFRC522_IdleConfig *config);
+void MFRC522_IdleEnd(MFRC522_Idle *idle);
+void MFRC522_IdlePark(MFRC522_Idle *idle);
+StatusCode MFRC522_IdleResume(MFRC522_Idle *idle);
+MFRC522_IdleEvent MFRC522_IdleWaitForCard(MFRC522_Idle *idle,
+										  uint32_t timeoutMs);
+
+#endif
@@ -0,0 +1,1785 @@
+/**
+* ISO/IEC 14443-3, MIFARE and NTAG protocols of the mfrc522 library for pi pico
+* c/c++ sdk, on top of the exchanges of mfrc522.c
+* NOTE: Please also check the comments in mfrc522.h.
+*/
+
+#include "mfrc522.h"
+
+static StatusCode PCD_MIFARE_TransceiveFrame(MFRC522Ptr_t mfrc,
+											 PCD_Frame *frame,
+											 bool acceptTimeout);
+
+/*******************************************************************************
+* Functions for communicating with PICCs
+*******************************************************************************/
+
+/**
+ * Transmits a REQuest command, Type A. Invites PICCs in state IDLE to go to
+ *READY and prepare for anticollision or selection. 7 bit frame.
+ * Beware: When two PICCs are in the field at the same time I often get
+ *STATUS_TIMEOUT - probably due do bad antenna design.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode PICC_RequestA(
+	MFRC522Ptr_t mfrc,
+	uint8_t *
+		bufferATQA,		///< The buffer to store the ATQA (Answer to request) in
+	uint8_t *bufferSize ///< Buffer size, at least two uint8_ts. Also number of
+						///uint8_ts returned if STATUS_OK.
+	) {
+	return PICC_REQA_or_WUPA(mfrc, PICC_CMD_REQA, bufferATQA, bufferSize);
+} // End PICC_RequestA()
+
+/**
+ * Transmits a Wake-UP command, Type A. Invites PICCs in state IDLE and HALT to
+ *go to READY(*) and prepare for anticollision or selection. 7 bit frame.
+ * Beware: When two PICCs are in the field at the same time I often get
+ *STATUS_TIMEOUT - probably due do bad antenna design.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode PICC_WakeupA(
+	MFRC522Ptr_t mfrc,
+	uint8_t *
+		bufferATQA,		///< The buffer to store the ATQA (Answer to request) in
+	uint8_t *bufferSize ///< Buffer size, at least two uint8_ts. Also number of
+						///uint8_ts returned if STATUS_OK.
+	) {
+	return PICC_REQA_or_WUPA(mfrc, PICC_CMD_WUPA, bufferATQA, bufferSize);
+} // End PICC_WakeupA()
+
+/**
+ * Puts the reader in the state every REQA and WUPA is sent from: bits
+ * received after a collision are cleared, and both directions run at
+ * 106 kbit/s, whatever a T=CL session negotiated with PPS before.
+ */
+void PCD_PrepareRequestA(MFRC522Ptr_t mfrc) {
+	PCD_ClearRegisterBitMask(mfrc, CollReg, 0x80); // ValuesAfterColl=1 => Bits
+												   // received after collision
+												   // are cleared.
+	// Activation always runs at 106 kbit/s
+	PCD_SetBitRate(mfrc, PCD_BITRATE_106, PCD_BITRATE_106);
+} // End PCD_PrepareRequestA()
+
+/**
+ * Transmits REQA or WUPA commands.
+ * Beware: When two PICCs are in the field at the same time I often get
+ *STATUS_TIMEOUT - probably due do bad antenna design.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode PICC_REQA_or_WUPA(
+	MFRC522Ptr_t mfrc,
+	uint8_t command, ///< The command to send - PICC_CMD_REQA or PICC_CMD_WUPA
+	uint8_t *
+		bufferATQA,		///< The buffer to store the ATQA (Answer to request) in
+	uint8_t *bufferSize ///< Buffer size, at least two uint8_ts. Also number of
+						///uint8_ts returned if STATUS_OK.
+	) {
+	uint8_t validBits;
+	StatusCode status;
+
+	if (bufferATQA == NULL ||
+		*bufferSize < 2) { // The ATQA response is 2 uint8_ts long.
+		return STATUS_NO_ROOM;
+	}
+	PCD_PrepareRequestA(mfrc);
+	validBits = 7; // For REQA and WUPA we need the short frame format -
+				   // transmit only 7 bits of the last (and only) uint8_t.
+				   // TxLastBits = BitFramingReg[2..0]
+	status = PCD_TransceiveData(mfrc, &command, 1, bufferATQA, bufferSize,
+								&validBits, 0, false);
+	if (status != STATUS_OK) {
+		return status;
+	}
+	if (*bufferSize != 2 || validBits != 0) { // ATQA must be exactly 16 bits.
+		return STATUS_ERROR;
+	}
+	return STATUS_OK;
+} // End PICC_REQA_or_WUPA()
+
+/**
+ * Transmits SELECT/ANTICOLLISION commands to select a single PICC.
+ * Before calling this function the PICCs must be placed in the READY(*) state
+ *by calling PICC_RequestA() or PICC_WakeupA().
+ * On success:
+ *		- The chosen PICC is in state ACTIVE(*) and all other PICCs have returned
+ *to state IDLE/HALT. (Figure 7 of the ISO/IEC 14443-3 draft.)
+ *		- The UID size and value of the chosen PICC is returned in *uid along with
+ *the SAK.
+ *
+ * A PICC UID consists of 4, 7 or 10 uint8_ts.
+ * Only 4 uint8_ts can be specified in a SELECT command, so for the longer UIDs
+ *two or three iterations are used:
+ *		UID size	Number of UID uint8_ts		Cascade levels		Example of
+ *PICC
+ *		========	===================		==============		===============
+ *		single				 4						1				MIFARE
+ *Classic
+ *		double				 7						2				MIFARE
+ *Ultralight
+ *		triple				10						3				Not currently in
+ *use?
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode PICC_Select(MFRC522Ptr_t mfrc,
+					   Uid *uid, ///< Pointer to Uid struct. Normally output,
+								 ///but can also be used to supply a known UID.
+					   uint8_t validBits ///< The number of known UID bits
+										 ///supplied in *uid. Normally 0. If set
+										 ///you must also supply uid->size.
+					   ) {
+	//		validBits=0;
+
+	bool uidComplete;
+	bool selectDone;
+	bool useCascadeTag;
+	uint8_t cascadeLevel = 1;
+	StatusCode result;
+	uint8_t count;
+	uint8_t index;
+	uint8_t uidIndex; // The first index in uid->uiduint8_t[] that is used in
+					  // the current Cascade Level.
+	int8_t currentLevelKnownBits; // The number of known UID bits in the current
+								  // Cascade Level.
+	uint8_t buffer[9];  // The SELECT/ANTICOLLISION commands uses a 7 uint8_t
+						// standard frame + 2 uint8_ts CRC_A
+	uint8_t bufferUsed; // The number of uint8_ts used in the buffer, ie the
+						// number of uint8_ts to transfer to the FIFO.
+	uint8_t rxAlign; // Used in BitFramingReg. Defines the bit position for the
+					 // first bit received.
+	uint8_t txLastBits; // Used in BitFramingReg. The number of valid bits in
+						// the last transmitted uint8_t.
+	uint8_t *responseBuffer;
+	uint8_t responseLength;
+
+	// Description of buffer structure:
+	//		uint8_t 0: SEL				Indicates the Cascade Level: PICC_CMD_SEL_CL1,
+	//PICC_CMD_SEL_CL2 or PICC_CMD_SEL_CL3
+	//		uint8_t 1: NVB					Number of Valid Bits (in complete command, not
+	//just the UID): High nibble: complete uint8_ts, Low nibble: Extra bits.
+	//		uint8_t 2: UID-data or CT		See explanation below. CT means Cascade
+	//Tag.
+	//		uint8_t 3: UID-data
+	//		uint8_t 4: UID-data
+	//		uint8_t 5: UID-data
+	//		uint8_t 6: BCC					Block Check Character - XOR of uint8_ts
+	//2-5
+	//		uint8_t 7: CRC_A
+	//		uint8_t 8: CRC_A
+	// The BCC and CRC_A are only transmitted if we know all the UID bits of the
+	// current Cascade Level.
+	//
+	// Description of uint8_ts 2-5: (Section 6.5.4 of the ISO/IEC 14443-3 draft:
+	// UID contents and cascade levels)
+	//		UID size	Cascade level	uint8_t2	uint8_t3	uint8_t4
+	//uint8_t5
+	//		========	=============	=====	=====	=====	=====
+	//		 4 uint8_ts		1			uid0	uid1	uid2	uid3
+	//		 7 uint8_ts		1			CT		uid0	uid1	uid2
+	//						2			uid3	uid4	uid5	uid6
+	//		10 uint8_ts		1			CT		uid0	uid1	uid2
+	//						2			CT		uid3	uid4	uid5
+	//						3			uid6	uid7	uid8	uid9
+
+	// Sanity checks
+	if (validBits > 80) {
+		return STATUS_INVALID;
+	}
+
+	// Prepare MFRC522
+	PCD_ClearRegisterBitMask(mfrc, CollReg, 0x80); // ValuesAfterColl=1 => Bits
+												   // received after collision
+												   // are cleared.
+
+	// Repeat Cascade Level loop until we have a complete UID.
+	uidComplete = false;
+	while (!uidComplete) {
+		// Set the Cascade Level in the SEL uint8_t, find out if we need to use
+		// the Cascade Tag in uint8_t 2.
+		switch (cascadeLevel) {
+		case 1:
+			buffer[0] = PICC_CMD_SEL_CL1;
+			uidIndex = 0;
+			useCascadeTag =
+				validBits &&
+				uid->size >
+					4; // When we know that the UID has more than 4 uint8_ts
+			break;
+
+		case 2:
+			buffer[0] = PICC_CMD_SEL_CL2;
+			uidIndex = 3;
+			useCascadeTag =
+				validBits &&
+				uid->size >
+					7; // When we know that the UID has more than 7 uint8_ts
+			break;
+
+		case 3:
+			buffer[0] = PICC_CMD_SEL_CL3;
+			uidIndex = 6;
+			useCascadeTag = false; // Never used in CL3.
+			break;
+
+		default:
+			return STATUS_INTERNAL_ERROR;
+			break;
+		}
+
+		// How many UID bits are known in this Cascade Level?
+		currentLevelKnownBits = validBits - (8 * uidIndex);
+		if (currentLevelKnownBits < 0) {
+			currentLevelKnownBits = 0;
+		}
+		// Copy the known bits from uid->uiduint8_t[] to buffer[]
+		index = 2; // destination index in buffer[]
+		if (useCascadeTag) {
+			buffer[index++] = PICC_CMD_CT;
+		}
+		uint8_t uint8_tsToCopy =
+			currentLevelKnownBits / 8 +
+			(currentLevelKnownBits % 8 ? 1 : 0); // The number of uint8_ts
+												 // needed to represent the
+												 // known bits for this level.
+		if (uint8_tsToCopy) {
+			uint8_t maxuint8_ts =
+				useCascadeTag ? 3 : 4; // Max 4 uint8_ts in each Cascade Level.
+									   // Only 3 left if we use the Cascade Tag
+			if (uint8_tsToCopy > maxuint8_ts) {
+				uint8_tsToCopy = maxuint8_ts;
+			}
+			for (count = 0; count < uint8_tsToCopy; count++) {
+				buffer[index++] = uid->uidByte[uidIndex + count];
+			}
+		}
+		// Now that the data has been copied we need to include the 8 bits in CT
+		// in currentLevelKnownBits
+		if (useCascadeTag) {
+			currentLevelKnownBits += 8;
+		}
+
+		// Repeat anti collision loop until we can transmit all UID bits + BCC
+		// and receive a SAK - max 32 iterations.
+		selectDone = false;
+		while (!selectDone) {
+			// Find out how many bits and uint8_ts to send and receive.
+			if (currentLevelKnownBits >= 32) { // All UID bits in this Cascade
+											   // Level are known. This is a
+											   // SELECT.
+				// printf(F("SELECT: currentLevelKnownBits="));
+				// printf(currentLevelKnownBits, DEC);
+				buffer[1] =
+					0x70; // NVB - Number of Valid Bits: Seven whole uint8_ts
+				// Calculate BCC - Block Check Character
+				buffer[6] = buffer[2] ^ buffer[3] ^ buffer[4] ^ buffer[5];
+				// Calculate CRC_A
+				result = PCD_CalculateCRC(mfrc, buffer, 7, &buffer[7]);
+				if (result != STATUS_OK) {
+					return result;
+				}
+				txLastBits = 0; // 0 => All 8 bits are valid.
+				bufferUsed = 9;
+				// Store response in the last 3 uint8_ts of buffer (BCC and
+				// CRC_A - not needed after tx)
+				responseBuffer = &buffer[6];
+				responseLength = 3;
+			} else { // This is an ANTICOLLISION.
+				// printf(F("ANTICOLLISION: currentLevelKnownBits="));
+				// printf(currentLevelKnownBits, DEC);
+				txLastBits = currentLevelKnownBits % 8;
+				count = currentLevelKnownBits /
+						8;		   // Number of whole uint8_ts in the UID part.
+				index = 2 + count; // Number of whole uint8_ts: SEL + NVB + UIDs
+				buffer[1] =
+					(index << 4) + txLastBits; // NVB - Number of Valid Bits
+				bufferUsed = index + (txLastBits ? 1 : 0);
+				// Store response in the unused part of buffer
+				responseBuffer = &buffer[index];
+				responseLength = sizeof(buffer) - index;
+			}
+
+			// Set bit adjustments
+			rxAlign = txLastBits; // Having a separate variable is overkill. But
+								  // it makes the next line easier to read.
+			PCD_WriteRegister(mfrc, BitFramingReg,
+							  (rxAlign << 4) +
+								  txLastBits); // RxAlign = BitFramingReg[6..4].
+											   // TxLastBits =
+											   // BitFramingReg[2..0]
+
+			// Transmit the buffer and receive the response.
+			result = PCD_TransceiveData(mfrc, buffer, bufferUsed,
+										responseBuffer, &responseLength,
+										&txLastBits, rxAlign, false);
+			if (result == STATUS_COLLISION) { // More than one PICC in the field
+											  // => collision.
+				uint8_t valueOfCollReg = PCD_ReadRegister(
+					mfrc, CollReg); // CollReg[7..0] bits are: ValuesAfterColl
+									// reserved CollPosNotValid CollPos[4:0]
+				if (valueOfCollReg & 0x20) { // CollPosNotValid
+					return STATUS_COLLISION; // Without a valid collision
+											 // position we cannot continue
+				}
+				uint8_t collisionPos =
+					valueOfCollReg & 0x1F; // Values 0-31, 0 means bit 32.
+				if (collisionPos == 0) {
+					collisionPos = 32;
+				}
+				if (collisionPos <=
+					currentLevelKnownBits) { // No progress - should not happen
+					return STATUS_INTERNAL_ERROR;
+				}
+				// Choose the PICC with the bit set.
+				currentLevelKnownBits = collisionPos;
+				// Bit collisionPos - 1 of the cascade level is the colliding
+				// one, it sits in buffer[2 + (collisionPos - 1) / 8]
+				count = (currentLevelKnownBits - 1) % 8; // The bit to modify
+				index = 2 + (currentLevelKnownBits - 1) / 8;
+				buffer[index] |= (1 << count);
+			} else if (result != STATUS_OK) {
+				return result;
+			} else {							   // STATUS_OK
+				if (currentLevelKnownBits >= 32) { // This was a SELECT.
+					selectDone = true;			   // No more anticollision
+					// We continue below outside the while.
+				} else { // This was an ANTICOLLISION.
+					// We now have all 32 bits of the UID in this Cascade Level
+					currentLevelKnownBits = 32;
+					// Run loop again to do the SELECT.
+				}
+			}
+		} // End of while (!selectDone)
+
+		// We do not check the CBB - it was constructed by us above.
+
+		// Copy the found UID uint8_ts from buffer[] to uid->uiduint8_t[]
+		index = (buffer[2] == PICC_CMD_CT) ? 3 : 2; // source index in buffer[]
+		uint8_tsToCopy = (buffer[2] == PICC_CMD_CT) ? 3 : 4;
+		for (count = 0; count < uint8_tsToCopy; count++) {
+			uid->uidByte[uidIndex + count] = buffer[index++];
+		}
+
+		// Check response SAK (Select Acknowledge)
+		if (responseLength != 3 ||
+			txLastBits !=
+				0) { // SAK must be exactly 24 bits (1 uint8_t + CRC_A).
+			return STATUS_ERROR;
+		}
+		// Verify CRC_A - do our own calculation and store the control in
+		// buffer[2..3] - those uint8_ts are not needed anymore.
+		result = PCD_CalculateCRC(mfrc, responseBuffer, 1, &buffer[2]);
+		if (result != STATUS_OK) {
+			return result;
+		}
+		if ((buffer[2] != responseBuffer[1]) ||
+			(buffer[3] != responseBuffer[2])) {
+			return STATUS_CRC_WRONG;
+		}
+		if (responseBuffer[0] &
+			0x04) { // Cascade bit set - UID not complete yes
+			cascadeLevel++;
+		} else {
+			uidComplete = true;
+			uid->sak = responseBuffer[0];
+		}
+	} // End of while (!uidComplete)
+
+	// Set correct uid->size
+	uid->size = 3 * cascadeLevel + 1;
+
+	return STATUS_OK;
+} // End PICC_Select()
+
+/**
+ * Selects a PICC whose complete UID is already known, for example from a
+ * whitelist or an earlier PICC_Select(). There is no ANTICOLLISION, only one
+ * SELECT per cascade level, and the BCC and CRC_A of every SELECT frame are
+ * computed in software before the first one is sent. Call PICC_RequestA() or
+ * PICC_WakeupA() first.
+ * On success mfrc->uid holds the UID and the SAK the PICC answered with.
+ *
+ * @return STATUS_OK on success, STATUS_TIMEOUT if no PICC has this UID,
+ * STATUS_INVALID for a UID size other than 4, 7 or 10.
+ */
+StatusCode PICC_SelectKnown(MFRC522Ptr_t mfrc,
+							const Uid *uid ///< uid->size and uid->uidByte
+							) {
+	static const uint8_t selectCommands[3] = {
+		PICC_CMD_SEL_CL1, PICC_CMD_SEL_CL2, PICC_CMD_SEL_CL3};
+	// SEL, NVB, 4 UID bytes or CT + 3, BCC, then CRC_A in the tailroom
+	uint8_t storage[3][PCD_FRAME_STORAGE(7)];
+	PCD_Frame frames[3];
+	uint8_t levels;
+
+	switch (uid->size) {
+	case 4:
+		levels = 1;
+		break;
+	case 7:
+		levels = 2;
+		break;
+	case 10:
+		levels = 3;
+		break;
+	default:
+		return STATUS_INVALID;
+	}
+
+	for (uint8_t level = 0; level < levels; level++) {
+		PCD_FrameInit(&frames[level], storage[level], 7);
+		uint8_t *frame = frames[level].data;
+		frame[0] = selectCommands[level];
+		frame[1] = 0x70; // NVB: seven whole uint8_ts
+		if (level < levels - 1) { // More levels follow, CT + 3 uint8_ts
+			frame[2] = PICC_CMD_CT;
+			memcpy(&frame[3], &uid->uidByte[3 * level], 3);
+		} else {
+			memcpy(&frame[2], &uid->uidByte[3 * level], 4);
+		}
+		frame[6] = frame[2] ^ frame[3] ^ frame[4] ^ frame[5]; // BCC
+		PCD_SoftwareCRC(frame, 7, &frame[7]);
+		frames[level].length = 9;
+	}
+
+	uint8_t sakStorage[PCD_FRAME_STORAGE(1)]; // SAK and CRC_A
+	PCD_Frame sak;
+	PCD_FrameInit(&sak, sakStorage, 1);
+	for (uint8_t level = 0; level < levels; level++) {
+		StatusCode result =
+			PCD_TransceiveFrame(mfrc, &frames[level], &sak, true);
+		if (result != STATUS_OK) {
+			return result;
+		}
+		bool cascade = (sak.data[0] & 0x04) != 0; // UID not complete
+		if (sak.length != 1 || cascade != (level < levels - 1)) {
+			return STATUS_ERROR; // The PICC has a different UID size
+		}
+	}
+
+	Uid selected = *uid; // uid may be &mfrc->uid
+	selected.sak = sak.data[0];
+	mfrc->uid = selected;
+	return STATUS_OK;
+} // End PICC_SelectKnown()
+
+/**
+ * Instructs a PICC in state ACTIVE(*) to go to state HALT.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode PICC_HaltA(MFRC522Ptr_t mfrc) {
+	StatusCode result;
+	uint8_t storage[PCD_FRAME_STORAGE(2)];
+	PCD_Frame frame;
+
+	// Build command frame
+	PCD_FrameInit(&frame, storage, 2);
+	frame.data[0] = PICC_CMD_HLTA;
+	frame.data[1] = 0;
+	frame.length = 2;
+	// Calculate CRC_A
+	result = PCD_FrameAppendCRC(mfrc, &frame);
+	if (result != STATUS_OK) {
+		return result;
+	}
+
+	// Send the command.
+	// The standard says:
+	//		If the PICC responds with any modulation during a period of 1 ms after
+	//the end of the frame containing the
+	//		HLTA command, this response shall be interpreted as 'not
+	//acknowledge'.
+	// We interpret that this way: Only STATUS_TIMEOUT is a success.
+	result = PCD_TransceiveFrame(mfrc, &frame, NULL, false);
+	if (result == STATUS_TIMEOUT) {
+		return STATUS_OK;
+	}
+	if (result == STATUS_OK) { // That is ironically NOT ok in this case ;-)
+		return STATUS_ERROR;
+	}
+	return result;
+} // End PICC_HaltA()
+
+/**
+ * Finds every PICC in the field in one pass.
+ * Each round invites the PICCs still in state IDLE, lets PICC_Select() walk
+ * the collision tree to a single PICC (at each CollReg collision position the
+ * branch with the bit set wins), stores its UID and SAK and sends it to HALT
+ * so the next round resolves the remaining ones. The first round uses WUPA
+ * so that PICCs halted earlier are included as well.
+ * All inventoried PICCs are in state HALT afterwards, use PICC_WakeupA() and
+ * PICC_SelectKnown() to talk to one of them again.
+ *
+ * @return The number of UIDs written to out.
+ */
+size_t PICC_Inventory(MFRC522Ptr_t mfrc,
+					  Uid *out,  ///< Array receiving the UID and SAK of each PICC
+					  size_t max ///< Number of entries in out
+					  ) {
+	uint8_t bufferATQA[2];
+	uint8_t bufferSize;
+	StatusCode result;
+	size_t found = 0;
+	uint8_t failures = 0;
+	bool firstRound = true;
+
+	while (found < max && failures < MFRC522_INVENTORY_RETRIES) {
+		bufferSize = sizeof(bufferATQA);
+		result = firstRound ? PICC_WakeupA(mfrc, bufferATQA, &bufferSize)
+							: PICC_RequestA(mfrc, bufferATQA, &bufferSize);
+		firstRound = false;
+		if (result == STATUS_TIMEOUT) { // Nobody left in state IDLE
+			break;
+		}
+		// Differing ATQAs collide as well, anticollision sorts that out.
+		if (result != STATUS_OK && result != STATUS_COLLISION) {
+			failures++;
+			continue;
+		}
+
+		result = PICC_Select(mfrc, &out[found], 0);
+		if (result != STATUS_OK) {
+			// A failed frame sends the PICCs back to IDLE, the next REQA
+			// invites them again.
+			failures++;
+			continue;
+		}
+		PICC_HaltA(mfrc);
+
+		// A PICC that left and re-entered the field comes back as IDLE
+		bool duplicate = false;
+		for (size_t i = 0; i < found; i++) {
+			if (out[i].size == out[found].size &&
+				memcmp(out[i].uidByte, out[found].uidByte, out[i].size) == 0) {
+				duplicate = true;
+				break;
+			}
+		}
+		if (!duplicate) {
+			found++;
+		}
+	}
+	return found;
+} // End PICC_Inventory()
+
+/*******************************************************************************
+*Functions for communicating with MIFARE PICCs
+*******************************************************************************/
+
+
+/**
+ * Reads 16 uint8_ts (+ 2 uint8_ts CRC_A) from the active PICC.
+ *
+ * For MIFARE Classic the sector containing the block must be authenticated
+ *before calling this function.
+ *
+ * For MIFARE Ultralight only addresses 00h to 0Fh are decoded.
+ * The MF0ICU1 returns a NAK for higher addresses.
+ * The MF0ICU1 responds to the READ command by sending 16 uint8_ts starting from
+ *the page address defined by the command argument.
+ * For example; if blockAddr is 03h then pages 03h, 04h, 05h, 06h are returned.
+ * A roll-back is implemented: If blockAddr is 0Eh, then the contents of pages
+ *0Eh, 0Fh, 00h and 01h are returned.
+ *
+ * The buffer must be at least 18 uint8_ts because a CRC_A is also returned.
+ * Checks the CRC_A before returning STATUS_OK.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MIFARE_Read(MFRC522Ptr_t mfrc,
+					   uint8_t blockAddr, ///< MIFARE Classic: The block
+										  ///(0-0xff) number. MIFARE Ultralight:
+										  ///The first page to return data from.
+					   uint8_t *buffer,   ///< The buffer to store the data in
+					   uint8_t *bufferSize ///< Buffer size, at least 18
+										   ///uint8_ts. Also number of uint8_ts
+										   ///returned if STATUS_OK.
+					   ) {
+	StatusCode result;
+	uint8_t storage[PCD_FRAME_STORAGE(16)]; // Command, then data and CRC_A
+	PCD_Frame frame;
+
+	// Sanity check
+	if (buffer == NULL || *bufferSize < 18) {
+		return STATUS_NO_ROOM;
+	}
+
+	// Build the command frame, CRC_A in its tailroom
+	PCD_FrameInit(&frame, storage, 16);
+	frame.data[0] = PICC_CMD_MF_READ;
+	frame.data[1] = blockAddr;
+	frame.length = 2;
+	result = PCD_FrameAppendCRC(mfrc, &frame);
+	if (result != STATUS_OK) {
+		return result;
+	}
+
+	// The response replaces the command in the same storage, validate CRC_A
+	result = PCD_TransceiveFrame(mfrc, &frame, &frame, true);
+	if (result != STATUS_OK) {
+		return result;
+	}
+	*bufferSize = frame.length + 2; // The CRC_A is returned as well
+	memcpy(buffer, frame.data, *bufferSize);
+	return STATUS_OK;
+} // End MIFARE_Read()
+
+/**
+ * Writes 16 uint8_ts to the active PICC.
+ *
+ * For MIFARE Classic the sector containing the block must be authenticated
+ *before calling this function.
+ *
+ * For MIFARE Ultralight the operation is called "COMPATIBILITY WRITE".
+ * Even though 16 uint8_ts are transferred to the Ultralight PICC, only the
+ *least significant 4 uint8_ts (uint8_ts 0 to 3)
+ * are written to the specified address. It is recommended to set the remaining
+ *uint8_ts 04h to 0Fh to all logic 0.
+ * *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode
+MIFARE_Write(MFRC522Ptr_t mfrc,
+			 uint8_t blockAddr, ///< MIFARE Classic: The block (0-0xff) number.
+								///MIFARE Ultralight: The page (2-15) to write
+								///to.
+			 uint8_t *buffer,   ///< The 16 uint8_ts to write to the PICC
+			 uint8_t bufferSize ///< Buffer size, must be at least 16 uint8_ts.
+								///Exactly 16 uint8_ts are written.
+			 ) {
+	StatusCode result;
+
+	// Sanity check
+	if (buffer == NULL || bufferSize < 16) {
+		return STATUS_INVALID;
+	}
+
+	// Mifare Classic protocol requires two communications to perform a write.
+	// Step 1: Tell the PICC we want to write to block blockAddr.
+	uint8_t cmdBuffer[2];
+	cmdBuffer[0] = PICC_CMD_MF_WRITE;
+	cmdBuffer[1] = blockAddr;
+	result = PCD_MIFARE_Transceive(
+		mfrc, cmdBuffer, 2,
+		false); // Adds CRC_A and checks that the response is MF_ACK.
+	if (result != STATUS_OK) {
+		return result;
+	}
+
+	// Step 2: Transfer the data
+	PCD_SetNextTimeout(mfrc, PCD_TIMEOUT_WRITE_DATA);
+	result = PCD_MIFARE_Transceive(
+		mfrc, buffer, bufferSize,
+		false); // Adds CRC_A and checks that the response is MF_ACK.
+	if (result != STATUS_OK) {
+		return result;
+	}
+
+	return STATUS_OK;
+} // End MIFARE_Write()
+
+/**
+ * Writes a 4 uint8_t page to the active MIFARE Ultralight PICC.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MIFARE_Ultralight_Write(
+	MFRC522Ptr_t mfrc,
+	uint8_t page,	  ///< The page (2-15) to write to.
+	uint8_t *buffer,   ///< The 4 uint8_ts to write to the PICC
+	uint8_t bufferSize ///< Buffer size, must be at least 4 uint8_ts. Exactly 4
+					   ///uint8_ts are written.
+	) {
+	StatusCode result;
+	uint8_t storage[PCD_FRAME_STORAGE(6)];
+	PCD_Frame frame;
+
+	// Sanity check
+	if (buffer == NULL || bufferSize < 4) {
+		return STATUS_INVALID;
+	}
+
+	// Build the command frame, CRC_A in its tailroom
+	PCD_FrameInit(&frame, storage, 6);
+	frame.data[0] = PICC_CMD_UL_WRITE;
+	frame.data[1] = page;
+	memcpy(&frame.data[2], buffer, 4);
+	frame.length = 6;
+	result = PCD_FrameAppendCRC(mfrc, &frame);
+	if (result != STATUS_OK) {
+		return result;
+	}
+
+	// Perform the write, the response must be MF_ACK.
+	result = PCD_MIFARE_TransceiveFrame(mfrc, &frame, false);
+	if (result != STATUS_OK) {
+		return result;
+	}
+	return STATUS_OK;
+} // End MIFARE_Ultralight_Write()
+
+/**
+ * MIFARE Decrement subtracts the delta from the value of the addressed block,
+ *and stores the result in a volatile memory.
+ * For MIFARE Classic only. The sector containing the block must be
+ *authenticated before calling this function.
+ * Only for blocks in "value block" mode, ie with access bits [C1 C2 C3] = [110]
+ *or [001].
+ * Use MIFARE_Transfer() to store the result in a block.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MIFARE_Decrement(
+	MFRC522Ptr_t mfrc,
+	uint8_t blockAddr, ///< The block (0-0xff) number.
+	long delta ///< This number is subtracted from the value of block blockAddr.
+	) {
+	return MIFARE_TwoStepHelper(mfrc, PICC_CMD_MF_DECREMENT, blockAddr, delta);
+} // End MIFARE_Decrement()
+
+/**
+ * MIFARE Increment adds the delta to the value of the addressed block, and
+ *stores the result in a volatile memory.
+ * For MIFARE Classic only. The sector containing the block must be
+ *authenticated before calling this function.
+ * Only for blocks in "value block" mode, ie with access bits [C1 C2 C3] = [110]
+ *or [001].
+ * Use MIFARE_Transfer() to store the result in a block.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MIFARE_Increment(
+	MFRC522Ptr_t mfrc,
+	uint8_t blockAddr, ///< The block (0-0xff) number.
+	long delta ///< This number is added to the value of block blockAddr.
+	) {
+	return MIFARE_TwoStepHelper(mfrc, PICC_CMD_MF_INCREMENT, blockAddr, delta);
+} // End MIFARE_Increment()
+
+/**
+ * MIFARE Restore copies the value of the addressed block into a volatile
+ *memory.
+ * For MIFARE Classic only. The sector containing the block must be
+ *authenticated before calling this function.
+ * Only for blocks in "value block" mode, ie with access bits [C1 C2 C3] = [110]
+ *or [001].
+ * Use MIFARE_Transfer() to store the result in a block.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MIFARE_Restore(MFRC522Ptr_t mfrc,
+						  uint8_t blockAddr ///< The block (0-0xff) number.
+						  ) {
+	// The datasheet describes Restore as a two step operation, but does not
+	// explain what data to transfer in step 2.
+	// Doing only a single step does not work, so I chose to transfer 0L in step
+	// two.
+	return MIFARE_TwoStepHelper(mfrc, PICC_CMD_MF_RESTORE, blockAddr, 0L);
+} // End MIFARE_Restore()
+
+/**
+ * Helper function for the two-step MIFARE Classic protocol operations
+ *Decrement, Increment and Restore.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode
+MIFARE_TwoStepHelper(MFRC522Ptr_t mfrc,
+					 uint8_t command,   ///< The command to use
+					 uint8_t blockAddr, ///< The block (0-0xff) number.
+					 long data			///< The data to transfer in step 2
+					 ) {
+	StatusCode result;
+	uint8_t cmdBuffer[2]; // We only need room for 2 uint8_ts.
+
+	// Step 1: Tell the PICC the command and block address
+	cmdBuffer[0] = command;
+	cmdBuffer[1] = blockAddr;
+	result = PCD_MIFARE_Transceive(
+		mfrc, cmdBuffer, 2,
+		false); // Adds CRC_A and checks that the response is MF_ACK.
+	if (result != STATUS_OK) {
+		return result;
+	}
+
+	// Step 2: Transfer the data
+	PCD_SetNextTimeout(mfrc, PCD_TIMEOUT_VALUE_DATA);
+	result = PCD_MIFARE_Transceive(
+		mfrc, (uint8_t *)&data, 4,
+		true); // Adds CRC_A and accept timeout as success.
+	if (result != STATUS_OK) {
+		return result;
+	}
+
+	return STATUS_OK;
+} // End MIFARE_TwoStepHelper()
+
+/**
+ * MIFARE Transfer writes the value stored in the volatile memory into one
+ *MIFARE Classic block.
+ * For MIFARE Classic only. The sector containing the block must be
+ *authenticated before calling this function.
+ * Only for blocks in "value block" mode, ie with access bits [C1 C2 C3] = [110]
+ *or [001].
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MIFARE_Transfer(MFRC522Ptr_t mfrc,
+						   uint8_t blockAddr ///< The block (0-0xff) number.
+						   ) {
+	StatusCode result;
+	uint8_t cmdBuffer[2]; // We only need room for 2 uint8_ts.
+
+	// Tell the PICC we want to transfer the result into block blockAddr.
+	cmdBuffer[0] = PICC_CMD_MF_TRANSFER;
+	cmdBuffer[1] = blockAddr;
+	result = PCD_MIFARE_Transceive(
+		mfrc, cmdBuffer, 2,
+		false); // Adds CRC_A and checks that the response is MF_ACK.
+	if (result != STATUS_OK) {
+		return result;
+	}
+	return STATUS_OK;
+} // End MIFARE_Transfer()
+
+/**
+ * Helper routine to read the current value from a Value Block.
+ *
+ * Only for MIFARE Classic and only for blocks in "value block" mode, that
+ * is: with access bits [C1 C2 C3] = [110] or [001]. The sector containing
+ * the block must be authenticated before calling this function.
+ *
+ * @param[in]   blockAddr   The block (0x00-0xff) number.
+ * @param[out]  value       Current value of the Value Block.
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+  */
+StatusCode MIFARE_GetValue(MFRC522Ptr_t mfrc, uint8_t blockAddr, long *value) {
+	StatusCode status;
+	uint8_t buffer[18];
+	uint8_t size = sizeof(buffer);
+
+	// Read the block
+	status = MIFARE_Read(mfrc, blockAddr, buffer, &size);
+	if (status == STATUS_OK) {
+		// Extract the value
+		//			*value = (long(buffer[3])<<24) | (long(buffer[2])<<16) |
+		//(long(buffer[1])<<8) | long(buffer[0]);
+		//			long l_0 = buffer[0];
+		//			long l_8 = buffer[1]<<8;
+		//			long l_16 = buffer[2]<<16;
+		//			long l_24 = buffer[3]<<24;
+		//			*value =l_24 | l_16 | l_8 | l_0;
+		*value = ((long)(buffer[3]) << 24) | ((long)(buffer[2]) << 16) |
+				 ((long)(buffer[1]) << 8) | (long)(buffer[0]);
+	}
+	return status;
+} // End MIFARE_GetValue()
+
+/**
+ * Helper routine to write a specific value into a Value Block.
+ *
+ * Only for MIFARE Classic and only for blocks in "value block" mode, that
+ * is: with access bits [C1 C2 C3] = [110] or [001]. The sector containing
+ * the block must be authenticated before calling this function.
+ *
+ * @param[in]   blockAddr   The block (0x00-0xff) number.
+ * @param[in]   value       New value of the Value Block.
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MIFARE_SetValue(MFRC522Ptr_t mfrc, uint8_t blockAddr, long value) {
+	uint8_t buffer[18];
+
+	// Translate the long into 4 uint8_ts; repeated 2x in value block
+	buffer[0] = buffer[8] = (value & 0xFF);
+	buffer[1] = buffer[9] = (value & 0xFF00) >> 8;
+	buffer[2] = buffer[10] = (value & 0xFF0000) >> 16;
+	buffer[3] = buffer[11] = (value & 0xFF000000) >> 24;
+	// Inverse 4 uint8_ts also found in value block
+	buffer[4] = ~buffer[0];
+	buffer[5] = ~buffer[1];
+	buffer[6] = ~buffer[2];
+	buffer[7] = ~buffer[3];
+	// Address 2x with inverse address 2x
+	buffer[12] = buffer[14] = blockAddr;
+	buffer[13] = buffer[15] = ~blockAddr;
+
+	// Write the whole data block
+	return MIFARE_Write(mfrc, blockAddr, buffer, 16);
+} // End MIFARE_SetValue()
+
+/**
+ * Authenticate with a NTAG216.
+ *
+ * Only for NTAG216. First implemented by Gargantuanman.
+ *
+ * @param[in]   passWord   password.
+ * @param[in]   pACK       result success???.
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode PCD_NTAG216_AUTH(MFRC522Ptr_t mfrc, uint8_t *passWord,
+							uint8_t pACK[]) // Authenticate with 32bit password
+{
+	StatusCode result;
+	uint8_t cmdBuffer[18]; // We need room for 16 uint8_ts data and 2 uint8_ts
+						   // CRC_A.
+
+	cmdBuffer[0] = 0x1B; // Comando de autentificacion
+
+	for (uint8_t i = 0; i < 4; i++)
+		cmdBuffer[i + 1] = passWord[i];
+
+	result = PCD_CalculateCRC(mfrc, cmdBuffer, 5, &cmdBuffer[5]);
+
+	if (result != STATUS_OK) {
+		return result;
+	}
+
+	// Transceive the data, store the reply in cmdBuffer[]
+	uint8_t waitIRq = 0x30; // RxIRq and IdleIRq
+	uint8_t cmdBufferSize = sizeof(cmdBuffer);
+	uint8_t validBits = 0;
+	uint8_t rxlength = 5;
+	result =
+		PCD_CommunicateWithPICC(mfrc, PCD_Transceive, waitIRq, cmdBuffer, 7,
+								cmdBuffer, &rxlength, &validBits, 0, false);
+
+	pACK[0] = cmdBuffer[0];
+	pACK[1] = cmdBuffer[1];
+
+	if (result != STATUS_OK) {
+		return result;
+	}
+
+	return STATUS_OK;
+} // End PCD_NTAG216_AUTH()
+
+/**
+ * Reads pages startPage to endPage of a NTAG21x with FAST_READ into out,
+ * which must hold (endPage - startPage + 1) * 4 uint8_ts.
+ * Ranges longer than NTAG_FAST_READ_MAX_PAGES are split into several
+ * commands. The FIFO is emptied during reception, so each command may
+ * return far more than FIFO_SIZE uint8_ts.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode NTAG_FastRead(MFRC522Ptr_t mfrc,
+						 uint8_t startPage, ///< First page to read
+						 uint8_t endPage,   ///< Last page to read, included
+						 uint8_t *out) {
+	uint8_t response[NTAG_FAST_READ_MAX_PAGES * 4 + 2];
+	uint8_t cmdBuffer[5];
+	StatusCode status;
+
+	if (out == NULL || endPage < startPage) {
+		return STATUS_INVALID;
+	}
+
+	uint16_t page = startPage;
+	while (page <= endPage) {
+		uint16_t last = page + NTAG_FAST_READ_MAX_PAGES - 1;
+		if (last > endPage) {
+			last = endPage;
+		}
+		uint16_t expected = (last - page + 1) * 4;
+
+		cmdBuffer[0] = PICC_CMD_UL_FAST_READ;
+		cmdBuffer[1] = page;
+		cmdBuffer[2] = last;
+		status = PCD_CalculateCRC(mfrc, cmdBuffer, 3, &cmdBuffer[3]);
+		if (status != STATUS_OK) {
+			return status;
+		}
+
+		uint16_t responseLen = sizeof(response);
+		status = PCD_TransceiveStream(mfrc, cmdBuffer, sizeof(cmdBuffer),
+									  response, &responseLen, true);
+		if (status != STATUS_OK) {
+			return status;
+		}
+		if (responseLen != expected + 2) {
+			return STATUS_ERROR;
+		}
+
+		memcpy(out, response, expected);
+		out += expected;
+		page = last + 1;
+	}
+	return STATUS_OK;
+} // End NTAG_FastRead()
+
+/**
+ * Gives the address of the first block and the number of blocks of a MIFARE
+ * Classic sector. Sectors 0..31 have 4 blocks, sectors 32..39 (4K only)
+ * have 16.
+ *
+ * @return false for sectors above 39.
+ */
+static bool MIFARE_SectorBlocks(uint8_t sector, uint8_t *firstBlock,
+								uint8_t *blocks) {
+	if (sector < 32) {
+		*blocks = 4;
+		*firstBlock = sector * 4;
+	} else if (sector < MIFARE_MAX_SECTORS) {
+		*blocks = 16;
+		*firstBlock = 128 + (sector - 32) * 16;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @return The number of uint8_ts MIFARE_ReadSectors() writes for count
+ * sectors starting at firstSector, 0 if the range is not valid.
+ */
+uint16_t MIFARE_SectorsSize(uint8_t firstSector, uint8_t count) {
+	uint8_t firstBlock = 0, lastBlock = 0, blocks = 0;
+	// Summed in int, a range past sector 255 must not wrap around
+	if (count == 0 || (int)firstSector + count > MIFARE_MAX_SECTORS ||
+		!MIFARE_SectorBlocks(firstSector, &firstBlock, &blocks) ||
+		!MIFARE_SectorBlocks(firstSector + count - 1, &lastBlock, &blocks)) {
+		return 0;
+	}
+	return (uint16_t)(lastBlock + blocks - firstBlock) * 16;
+} // End MIFARE_SectorsSize()
+
+/**
+ * Reads whole sectors of a MIFARE Classic PICC into a memory image.
+ * Each sector is authenticated once and its blocks are then read back to
+ * back. Block n of the range ends up at out[16 * (n - first block)], so a
+ * read of all sectors gives the same layout as the card (1K or 4K image).
+ * With skipTrailers the sector trailers are not read and their place in out
+ * is left untouched; Key A is usually not readable anyway.
+ * The PICC must be selected. Crypto1 stays on when this returns, call
+ * PICC_HaltA() and PCD_StopCrypto1() when done. After a failed
+ * authentication the PICC has to be selected again.
+ *
+ * @return STATUS_OK on success, STATUS_??? of the first failed operation
+ * otherwise.
+ */
+StatusCode MIFARE_ReadSectors(
+	MFRC522Ptr_t mfrc,
+	Uid *uid,			 ///< UID of the selected PICC
+	uint8_t command,	 ///< PICC_CMD_MF_AUTH_KEY_A or PICC_CMD_MF_AUTH_KEY_B
+	MIFARE_Key *key,	 ///< Key used for every sector
+	uint8_t firstSector, ///< First sector to read
+	uint8_t count,		 ///< Number of sectors to read
+	uint8_t *out, ///< At least MIFARE_SectorsSize(firstSector, count) uint8_ts
+	bool skipTrailers ///< Do not read the sector trailers
+	) {
+	uint8_t buffer[18];
+	uint8_t size;
+	uint8_t imageBase = 0, firstBlock = 0, blocks = 0;
+	int end = (int)firstSector + count; // Sector after the range, at most 40
+	StatusCode status;
+
+	if (out == NULL || MIFARE_SectorsSize(firstSector, count) == 0 ||
+		!MIFARE_SectorBlocks(firstSector, &imageBase, &blocks)) {
+		return STATUS_INVALID;
+	}
+
+	for (int sector = firstSector; sector < end; sector++) {
+		if (!MIFARE_SectorBlocks(sector, &firstBlock, &blocks)) {
+			return STATUS_INVALID;
+		}
+		status = PCD_Authenticate(mfrc, command, firstBlock, key, uid);
+		if (status != STATUS_OK) {
+			return status;
+		}
+		uint8_t dataBlocks = skipTrailers ? blocks - 1 : blocks;
+		for (uint8_t i = 0; i < dataBlocks; i++) {
+			uint8_t blockAddr = firstBlock + i;
+			size = sizeof(buffer);
+			status = MIFARE_Read(mfrc, blockAddr, buffer, &size);
+			if (status != STATUS_OK) {
+				return status;
+			}
+			memcpy(&out[(uint16_t)(blockAddr - imageBase) * 16], buffer, 16);
+		}
+	}
+	return STATUS_OK;
+} // End MIFARE_ReadSectors()
+
+/**
+ * Empties a key ring.
+ */
+void MIFARE_KeyRingInit(MIFARE_KeyRing *ring) {
+	memset(ring, 0, sizeof(*ring));
+} // End MIFARE_KeyRingInit()
+
+/**
+ * Adds a candidate key. Keys are tried in the order they were added until
+ * their success counts reorder them.
+ *
+ * @return The index of the key, -1 if the ring is full.
+ */
+int MIFARE_KeyRingAddKey(MIFARE_KeyRing *ring,
+						 uint8_t command, ///< PICC_CMD_MF_AUTH_KEY_A or
+										  ///PICC_CMD_MF_AUTH_KEY_B
+						 const MIFARE_Key *key) {
+	if (ring->keyCount >= MIFARE_KEYRING_MAX_KEYS) {
+		return -1;
+	}
+	uint8_t index = ring->keyCount++;
+	ring->keys[index].command = command;
+	ring->keys[index].key = *key;
+	ring->keys[index].hits = 0;
+	ring->order[index] = index;
+	return index;
+} // End MIFARE_KeyRingAddKey()
+
+/**
+ * Looks up the cache entry of a (UID, sector) pair.
+ *
+ * @return The entry, NULL if the pair is not cached.
+ */
+static MIFARE_KeyRingEntry *MIFARE_KeyRingFind(MIFARE_KeyRing *ring, Uid *uid,
+											   uint8_t sector) {
+	for (uint8_t i = 0; i < ring->cacheCount; i++) {
+		MIFARE_KeyRingEntry *entry = &ring->cache[i];
+		if (entry->sector == sector && entry->uidSize == uid->size &&
+			memcmp(entry->uidByte, uid->uidByte, uid->size) == 0) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Records a successful key: caches it for the (UID, sector) pair and moves
+ * it up in the try order.
+ */
+static void MIFARE_KeyRingLearn(MIFARE_KeyRing *ring, Uid *uid, uint8_t sector,
+								uint8_t keyIndex) {
+	MIFARE_KeyRingEntry *entry = MIFARE_KeyRingFind(ring, uid, sector);
+	if (entry == NULL) {
+		if (ring->cacheCount < MIFARE_KEYRING_CACHE_SIZE) {
+			entry = &ring->cache[ring->cacheCount++];
+		} else { // Full, replace the oldest entry
+			entry = &ring->cache[ring->cacheNext];
+			ring->cacheNext = (ring->cacheNext + 1) % MIFARE_KEYRING_CACHE_SIZE;
+		}
+		entry->uidSize = uid->size;
+		memcpy(entry->uidByte, uid->uidByte, uid->size);
+		entry->sector = sector;
+	}
+	entry->keyIndex = keyIndex;
+
+	if (ring->keys[keyIndex].hits < UINT16_MAX) {
+		ring->keys[keyIndex].hits++;
+	}
+	// One insertion sort step keeps order[] sorted by hits, most first
+	for (uint8_t i = 1; i < ring->keyCount; i++) {
+		uint8_t k = ring->order[i];
+		uint8_t j = i;
+		while (j > 0 && ring->keys[ring->order[j - 1]].hits < ring->keys[k].hits) {
+			ring->order[j] = ring->order[j - 1];
+			j--;
+		}
+		ring->order[j] = k;
+	}
+}
+
+/**
+ * Brings a PICC back to state ACTIVE after a failed authentication, which
+ * leaves it in state IDLE.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+static StatusCode MIFARE_Reactivate(MFRC522Ptr_t mfrc, Uid *uid) {
+	uint8_t bufferATQA[2];
+	uint8_t bufferSize = sizeof(bufferATQA);
+
+	PCD_StopCrypto1(mfrc);
+	StatusCode status = PICC_WakeupA(mfrc, bufferATQA, &bufferSize);
+	if (status != STATUS_OK) {
+		return status;
+	}
+	return PICC_SelectKnown(mfrc, uid);
+}
+
+/**
+ * Authenticates the sector containing blockAddr with the keys of the ring.
+ * The key that worked last time for this UID and sector is tried first,
+ * then the others in order of past success. Between attempts the PICC is
+ * woken up and selected again, as a failed authentication sends it to state
+ * IDLE.
+ * The PICC must be selected before the call.
+ *
+ * @return STATUS_OK on success, STATUS_??? of the last attempt otherwise.
+ */
+StatusCode MIFARE_KeyRingAuthenticate(
+	MFRC522Ptr_t mfrc,
+	MIFARE_KeyRing *ring,
+	Uid *uid,		   ///< UID of the selected PICC
+	uint8_t blockAddr, ///< Any block of the sector to authenticate
+	int *keyIndex	  ///< Out: Index of the key that worked. May be NULL.
+	) {
+	uint8_t sector =
+		blockAddr < 128 ? blockAddr / 4 : 32 + (blockAddr - 128) / 16;
+	StatusCode status = STATUS_INVALID;
+	int cached = -1;
+	bool first = true;
+
+	MIFARE_KeyRingEntry *entry = MIFARE_KeyRingFind(ring, uid, sector);
+	if (entry) {
+		cached = entry->keyIndex;
+	}
+
+	// Try the cached key, then the rest in learned order
+	for (int i = -1; i < ring->keyCount; i++) {
+		int k = i < 0 ? cached : ring->order[i];
+		if (k < 0 || (i >= 0 && k == cached)) {
+			continue;
+		}
+		if (!first) {
+			status = MIFARE_Reactivate(mfrc, uid);
+			if (status != STATUS_OK) { // The PICC has left the field
+				return status;
+			}
+		}
+		first = false;
+
+		status = PCD_Authenticate(mfrc, ring->keys[k].command, blockAddr,
+								  &ring->keys[k].key, uid);
+		if (status == STATUS_OK) {
+			MIFARE_KeyRingLearn(ring, uid, sector, k);
+			if (keyIndex) {
+				*keyIndex = k;
+			}
+			return STATUS_OK;
+		}
+	}
+	return status;
+} // End MIFARE_KeyRingAuthenticate()
+
+/**
+ * Empties a transaction.
+ */
+void MIFARE_TransactionInit(MIFARE_Transaction *transaction) {
+	transaction->count = 0;
+} // End MIFARE_TransactionInit()
+
+/**
+ * Appends an operation with its frames, CRC_A included, built up front so
+ * that MIFARE_TransactionRun() only has to move them to the FIFO.
+ *
+ * @return STATUS_OK on success, STATUS_NO_ROOM if the transaction is full.
+ */
+static StatusCode MIFARE_TransactionAdd(MIFARE_Transaction *transaction,
+										uint8_t command, uint8_t blockAddr,
+										const uint8_t *data, uint8_t dataLen) {
+	if (transaction->count >= MIFARE_TRANSACTION_MAX_OPS) {
+		return STATUS_NO_ROOM;
+	}
+	MIFARE_TransactionOp *op = &transaction->ops[transaction->count++];
+	op->command = command;
+	op->blockAddr = blockAddr;
+	op->status = STATUS_PENDING;
+	uint8_t *frame = &op->frame[PCD_FRAME_HEADROOM];
+	frame[0] = command;
+	frame[1] = blockAddr;
+	PCD_SoftwareCRC(frame, 2, &frame[2]);
+	op->dataLen = dataLen;
+	if (dataLen) {
+		uint8_t *payload = &op->data[PCD_FRAME_HEADROOM];
+		memcpy(payload, data, dataLen);
+		PCD_SoftwareCRC(payload, dataLen, &payload[dataLen]);
+	}
+	return STATUS_OK;
+}
+
+/**
+ * Queues MIFARE_Increment(), MIFARE_Decrement() or MIFARE_Restore() of
+ * blockAddr by delta.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MIFARE_TransactionValue(
+	MIFARE_Transaction *transaction,
+	uint8_t command,   ///< PICC_CMD_MF_INCREMENT, PICC_CMD_MF_DECREMENT or
+					   ///PICC_CMD_MF_RESTORE
+	uint8_t blockAddr, ///< The block (0-0xff) number.
+	long delta		   ///< Ignored by PICC_CMD_MF_RESTORE
+	) {
+	if (command != PICC_CMD_MF_INCREMENT && command != PICC_CMD_MF_DECREMENT &&
+		command != PICC_CMD_MF_RESTORE) {
+		return STATUS_INVALID;
+	}
+	if (command == PICC_CMD_MF_RESTORE) {
+		delta = 0;
+	}
+	uint8_t data[4] = {delta & 0xFF, (delta >> 8) & 0xFF, (delta >> 16) & 0xFF,
+					   (delta >> 24) & 0xFF};
+	return MIFARE_TransactionAdd(transaction, command, blockAddr, data, 4);
+} // End MIFARE_TransactionValue()
+
+/**
+ * Queues MIFARE_Transfer() of the internal data register to blockAddr.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MIFARE_TransactionTransfer(MIFARE_Transaction *transaction,
+									  uint8_t blockAddr) {
+	return MIFARE_TransactionAdd(transaction, PICC_CMD_MF_TRANSFER, blockAddr,
+								 NULL, 0);
+} // End MIFARE_TransactionTransfer()
+
+/**
+ * Queues MIFARE_Write() of 16 uint8_ts to blockAddr.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MIFARE_TransactionWrite(MIFARE_Transaction *transaction,
+								   uint8_t blockAddr, const uint8_t *data) {
+	if (data == NULL) {
+		return STATUS_INVALID;
+	}
+	return MIFARE_TransactionAdd(transaction, PICC_CMD_MF_WRITE, blockAddr,
+								 data, 16);
+} // End MIFARE_TransactionWrite()
+
+/**
+ * Runs the queued operations back to back against the authenticated sector.
+ * Each operation gets its own status in ops[i].status. A MIFARE Classic PICC
+ * drops the authentication on the first NAK, so the run stops there and the
+ * operations left keep STATUS_PENDING.
+ *
+ * @return STATUS_OK if all operations succeeded, else the first failure.
+ */
+StatusCode MIFARE_TransactionRun(MFRC522Ptr_t mfrc,
+								 MIFARE_Transaction *transaction) {
+	for (uint8_t i = 0; i < transaction->count; i++) {
+		MIFARE_TransactionOp *op = &transaction->ops[i];
+		bool write = op->command == PICC_CMD_MF_WRITE;
+		PCD_Frame frame;
+
+		// Step 1: the command and block address, answered with an ACK
+		PCD_FrameInit(&frame, op->frame, 2);
+		frame.length = 4;
+		op->status = PCD_MIFARE_TransceiveFrame(mfrc, &frame, false);
+		if (op->status == STATUS_OK && op->dataLen) {
+			// Step 2: the data. Only WRITE answers it, value operations stay
+			// silent unless they fail.
+			PCD_SetNextTimeout(mfrc, write ? PCD_TIMEOUT_WRITE_DATA
+										   : PCD_TIMEOUT_VALUE_DATA);
+			PCD_FrameInit(&frame, op->data, 16);
+			frame.length = op->dataLen + 2;
+			op->status = PCD_MIFARE_TransceiveFrame(mfrc, &frame, !write);
+		}
+		if (op->status != STATUS_OK) {
+			return op->status;
+		}
+	}
+	return STATUS_OK;
+} // End MIFARE_TransactionRun()
+
+/*******************************************************************************
+* Support functions
+*******************************************************************************/
+
+/**
+ * Sends a frame that already ends with its CRC_A and checks that the
+ * response is MF_ACK or a timeout.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+static StatusCode PCD_MIFARE_TransceiveFrame(MFRC522Ptr_t mfrc,
+											 PCD_Frame *frame,
+											 bool acceptTimeout) {
+	uint8_t ackStorage[PCD_FRAME_STORAGE(16)];
+	PCD_Frame ack;
+
+	PCD_FrameInit(&ack, ackStorage, 16);
+	StatusCode result = PCD_TransceiveFrame(mfrc, frame, &ack, false);
+	if (acceptTimeout && result == STATUS_TIMEOUT) {
+		return STATUS_OK;
+	}
+	if (result != STATUS_OK) {
+		return result;
+	}
+	// The PICC must reply with a 4 bit ACK
+	if (ack.length != 1 || ack.validBits != 4) {
+		return STATUS_ERROR;
+	}
+	if (ack.data[0] != MF_ACK) {
+		return STATUS_MIFARE_NACK;
+	}
+	return STATUS_OK;
+}
+
+/**
+ * Wrapper for MIFARE protocol communication.
+ * Adds CRC_A, executes the Transceive command and checks that the response is
+ *MF_ACK or a timeout.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode
+PCD_MIFARE_Transceive(MFRC522Ptr_t mfrc,
+					  uint8_t *sendData, ///< Pointer to the data to transfer to
+										 ///the FIFO. Do NOT include the CRC_A.
+					  uint8_t sendLen,   ///< Number of uint8_ts in sendData.
+					  bool acceptTimeout ///< True => A timeout is also success
+					  ) {
+	//		acceptTimeout = false;
+
+	StatusCode result;
+	uint8_t storage[PCD_FRAME_STORAGE(16)]; // 16 uint8_ts data, then CRC_A
+	PCD_Frame frame;
+
+	// Sanity check
+	if (sendData == NULL || sendLen > 16) {
+		return STATUS_INVALID;
+	}
+
+	// Copy sendData[] to the frame and add CRC_A
+	PCD_FrameInit(&frame, storage, 16);
+	memcpy(frame.data, sendData, sendLen);
+	frame.length = sendLen;
+	result = PCD_FrameAppendCRC(mfrc, &frame);
+	if (result != STATUS_OK) {
+		return result;
+	}
+
+	return PCD_MIFARE_TransceiveFrame(mfrc, &frame, acceptTimeout);
+} // End PCD_MIFARE_Transceive()
+
+/**
+ * Translates the SAK (Select Acknowledge) to a PICC type.
+ *
+ * @return PICC_Type
+ */
+PICC_Type
+PICC_GetType(uint8_t sak ///< The SAK uint8_t returned from PICC_Select().
+			 ) {
+	// http://www.nxp.com/documents/application_note/AN10833.pdf
+	// 3.2 Coding of Select Acknowledge (SAK)
+	// ignore 8-bit (iso14443 starts with LSBit = bit 1)
+	// fixes wrong type for manufacturer Infineon
+	// (http://nfc-tools.org/index.php?title=ISO14443A)
+	sak &= 0x7F;
+	switch (sak) {
+	case 0x04:
+		return PICC_TYPE_NOT_COMPLETE; // UID not complete
+	case 0x09:
+		return PICC_TYPE_MIFARE_MINI;
+	case 0x08:
+		return PICC_TYPE_MIFARE_1K;
+	case 0x18:
+		return PICC_TYPE_MIFARE_4K;
+	case 0x00:
+		return PICC_TYPE_MIFARE_UL;
+	case 0x10:
+	case 0x11:
+		return PICC_TYPE_MIFARE_PLUS;
+	case 0x01:
+		return PICC_TYPE_TNP3XXX;
+	case 0x20:
+		return PICC_TYPE_ISO_14443_4;
+	case 0x40:
+		return PICC_TYPE_ISO_18092;
+	default:
+		return PICC_TYPE_UNKNOWN;
+	}
+} // End PICC_GetType()
+
+/**
+ * Calculates the bit pattern needed for the specified access bits. In the [C1
+ * C2 C3] tuples C1 is MSB (=4) and C3 is LSB (=1).
+ */
+void MIFARE_SetAccessBits(
+	uint8_t *accessBitBuffer, ///< Pointer to uint8_t 6, 7 and 8 in the sector
+							  ///trailer. uint8_ts [0..2] will be set.
+	uint8_t g0, ///< Access bits [C1 C2 C3] for block 0 (for sectors 0-31) or
+				///blocks 0-4 (for sectors 32-39)
+	uint8_t g1, ///< Access bits C1 C2 C3] for block 1 (for sectors 0-31) or
+				///blocks 5-9 (for sectors 32-39)
+	uint8_t g2, ///< Access bits C1 C2 C3] for block 2 (for sectors 0-31) or
+				///blocks 10-14 (for sectors 32-39)
+	uint8_t g3  ///< Access bits C1 C2 C3] for the sector trailer, block 3 (for
+				///sectors 0-31) or block 15 (for sectors 32-39)
+	) {
+	uint8_t c1 =
+		((g3 & 4) << 1) | ((g2 & 4) << 0) | ((g1 & 4) >> 1) | ((g0 & 4) >> 2);
+	uint8_t c2 =
+		((g3 & 2) << 2) | ((g2 & 2) << 1) | ((g1 & 2) << 0) | ((g0 & 2) >> 1);
+	uint8_t c3 =
+		((g3 & 1) << 3) | ((g2 & 1) << 2) | ((g1 & 1) << 1) | ((g0 & 1) << 0);
+
+	accessBitBuffer[0] = (~c2 & 0xF) << 4 | (~c1 & 0xF);
+	accessBitBuffer[1] = c1 << 4 | (~c3 & 0xF);
+	accessBitBuffer[2] = c3 << 4 | c2;
+} // End MIFARE_SetAccessBits()
+
+/*******************************************************************************
+* Convenience functions - does not add extra functionality
+*******************************************************************************/
+
+/**
+ * Returns true if a PICC responds to PICC_CMD_REQA.
+ * Only "new" cards in state IDLE are invited. Sleeping cards in state HALT are
+ *ignored.
+ *
+ * @return bool
+ */
+bool PICC_IsNewCardPresent(MFRC522Ptr_t mfrc) {
+	uint8_t bufferATQA[2];
+	uint8_t bufferSize = sizeof(bufferATQA);
+	StatusCode result = PICC_RequestA(mfrc, bufferATQA, &bufferSize);
+	return (result == STATUS_OK || result == STATUS_COLLISION);
+} // End PICC_IsNewCardPresent()
+
+/**
+ * Simple wrapper around PICC_Select.
+ * Returns true if a UID could be read.
+ * Remember to call PICC_IsNewCardPresent(), PICC_RequestA() or PICC_WakeupA()
+ *first.
+ * The read UID is available in the class variable uid.
+ *
+ * @return bool
+ */
+bool PICC_ReadCardSerial(MFRC522Ptr_t mfrc) {
+	StatusCode result = PICC_Select(mfrc, &(mfrc->uid), 0);
+	return (result == STATUS_OK);
+} // End
+
+/**
+ * Prepares a tracker that follows no PICC yet.
+ */
+void PICC_TrackerInit(PICC_Tracker *tracker) {
+	memset(tracker, 0, sizeof(*tracker));
+	tracker->missLimit = PICC_TRACKER_MISSES;
+} // End PICC_TrackerInit()
+
+/**
+ * Starts tracking a PICC the caller has selected itself, as if
+ * PICC_TrackerPoll() had reported it PICC_TRACKER_ARRIVED. The next poll
+ * checks its presence.
+ */
+void PICC_TrackerAdopt(PICC_Tracker *tracker, const Uid *uid) {
+	tracker->present = true;
+	tracker->uid = *uid;
+	tracker->misses = 0;
+	tracker->wakeup = false;
+	tracker->arrivedUs = time_us_64();
+	tracker->seenUs = tracker->arrivedUs;
+} // End PICC_TrackerAdopt()
+
+/**
+ * Checks that the tracked PICC is still in the field and leaves it ACTIVE.
+ * HLTA is the one frame an ACTIVE PICC leaves its state for in a defined
+ * way, so the PICC is halted, woken with WUPA and selected again with
+ * PICC_SelectKnown().
+ */
+static bool PICC_TrackerCheck(MFRC522Ptr_t mfrc, PICC_Tracker *tracker) {
+	uint8_t bufferATQA[2];
+	uint8_t bufferSize = sizeof(bufferATQA);
+
+	PCD_StopCrypto1(mfrc);
+	PICC_HaltA(mfrc);
+	StatusCode result = PICC_WakeupA(mfrc, bufferATQA, &bufferSize);
+	if (result != STATUS_OK && result != STATUS_COLLISION) {
+		return false; // STATUS_COLLISION: other PICCs woke up as well
+	}
+	return PICC_SelectKnown(mfrc, &tracker->uid) == STATUS_OK;
+}
+
+/**
+ * One presence poll. Without a tracked PICC this is PICC_IsNewCardPresent()
+ * and PICC_ReadCardSerial(), a PICC that answers is reported once as
+ * PICC_TRACKER_ARRIVED. Afterwards every poll only checks that this PICC is
+ * still there, a few ms of air time, and reports PICC_TRACKER_PRESENT.
+ * A failed check is PICC_TRACKER_MISSED, until missLimit checks in a row
+ * have failed, then PICC_TRACKER_DEPARTED. The first failed check leaves the
+ * PICC HALTed if it is still there, so the first poll after a departure
+ * sends WUPA instead of REQA. Other PICCs are not looked for while one is
+ * tracked.
+ * After ARRIVED and PRESENT the PICC is ACTIVE and mfrc->uid holds its UID,
+ * as after PICC_ReadCardSerial(). Crypto1 is stopped by every check, MIFARE
+ * Classic sectors have to be authenticated again.
+ */
+PICC_TrackerEvent PICC_TrackerPoll(MFRC522Ptr_t mfrc, PICC_Tracker *tracker) {
+	if (!tracker->present) {
+		uint8_t bufferATQA[2];
+		uint8_t bufferSize = sizeof(bufferATQA);
+		uint8_t command = tracker->wakeup ? PICC_CMD_WUPA : PICC_CMD_REQA;
+		tracker->wakeup = false;
+		StatusCode result =
+			PICC_REQA_or_WUPA(mfrc, command, bufferATQA, &bufferSize);
+		if ((result != STATUS_OK && result != STATUS_COLLISION) ||
+			!PICC_ReadCardSerial(mfrc)) {
+			return PICC_TRACKER_NONE;
+		}
+		PICC_TrackerAdopt(tracker, &mfrc->uid);
+		return PICC_TRACKER_ARRIVED;
+	}
+
+	if (PICC_TrackerCheck(mfrc, tracker)) {
+		tracker->misses = 0;
+		tracker->seenUs = time_us_64();
+		return PICC_TRACKER_PRESENT;
+	}
+	if (++tracker->misses < tracker->missLimit) {
+		return PICC_TRACKER_MISSED; // Give a weak coupling another chance
+	}
+	tracker->present = false;
+	tracker->wakeup = true;
+	return PICC_TRACKER_DEPARTED;
+} // End PICC_TrackerPoll()
+
+// Settings PCD_CalibrateRf() tries, one register at a time
+static const uint8_t PCD_CALIBRATION_RX_GAINS[] = {
+	RxGain_18dB, RxGain_23dB, RxGain_33dB,
+	RxGain_38dB, RxGain_43dB, RxGain_48dB};
+static const uint8_t PCD_CALIBRATION_GS_P[] = {0x3F, 0x30, 0x20,
+											   0x18, 0x10, 0x08};
+static const uint8_t PCD_CALIBRATION_DEMODS[] = {
+	0x4D, // Reset value: stronger channel, frozen during communication
+	0x0D, // Stronger channel, not frozen
+	0x8D, // I and Q channels combined
+	0x45, // Default channel selection, shorter TauRcv
+	0x4F, // Default channel selection, longer TauSync
+};
+
+/**
+ * One calibration trial: wakes the halted reference PICC, selects it, reads
+ * blockAddr and halts it again.
+ *
+ * @return true if the block was read, *elapsedUs is how long it took.
+ */
+static bool PCD_CalibrationTrial(MFRC522Ptr_t mfrc, const Uid *uid,
+								 MIFARE_Key *key, uint8_t blockAddr,
+								 uint32_t *elapsedUs) {
+	uint8_t buffer[18];
+	uint8_t size = sizeof(buffer);
+	uint64_t start = time_us_64();
+
+	bool ok = PICC_WakeupA(mfrc, buffer, &size) == STATUS_OK &&
+			  PICC_SelectKnown(mfrc, uid) == STATUS_OK &&
+			  (!key || PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A,
+										blockAddr, key,
+										&mfrc->uid) == STATUS_OK);
+	size = sizeof(buffer);
+	ok = ok && MIFARE_Read(mfrc, blockAddr, buffer, &size) == STATUS_OK;
+	*elapsedUs = time_us_64() - start;
+	// A PICC left ACTIVE by a failed step goes back to IDLE on the next
+	// WUPA, which then fails once more
+	PICC_HaltA(mfrc);
+	PCD_StopCrypto1(mfrc);
+	return ok;
+}
+
+/**
+ * Runs PCD_CALIBRATION_TRIALS trials with profile applied.
+ *
+ * @return true if profile did better than *best, which it then replaces.
+ */
+static bool PCD_CalibrationMeasure(MFRC522Ptr_t mfrc, const Uid *uid,
+								   MIFARE_Key *key, uint8_t blockAddr,
+								   const PCD_RfProfile *profile,
+								   PCD_Calibration *best) {
+	uint8_t successes = 0;
+	uint64_t totalUs = 0;
+	uint32_t elapsedUs;
+
+	PCD_SetRfProfile(mfrc, profile);
+	best->settings++;
+	for (uint8_t i = 0; i < PCD_CALIBRATION_TRIALS; i++) {
+		if (PCD_CalibrationTrial(mfrc, uid, key, blockAddr, &elapsedUs)) {
+			successes++;
+			totalUs += elapsedUs;
+		}
+	}
+	uint32_t meanUs = successes ? totalUs / successes : 0;
+	if (successes < best->successes ||
+		(successes == best->successes &&
+		 (successes == 0 || meanUs >= best->meanUs))) {
+		return false;
+	}
+	best->profile = *profile;
+	best->successes = successes;
+	best->meanUs = meanUs;
+	return true;
+}
+
+/**
+ * Tunes the RF settings of the reader in its enclosure. With a reference
+ * PICC in the field, it sweeps RxGain, CWGsPReg, ModGsPReg and DemodReg one
+ * at a time, keeping the best value of each. Every setting gets
+ * PCD_CALIBRATION_TRIALS trials. A trial wakes the PICC, selects it and
+ * reads blockAddr. Settings with more successful trials win, and equal ones
+ * go to the lower mean time. ModGsPReg is left out while TxASKReg forces
+ * 100 % ASK, as PCD_Init() sets it, because the modulation ignores it then.
+ * The best profile stays set with PCD_SetRfProfile(). A sweep takes a few
+ * seconds.
+ *
+ * @return STATUS_OK on success, STATUS_TIMEOUT if no PICC answered,
+ * STATUS_ERROR if no setting could read blockAddr. The profile in use before
+ * is kept then.
+ */
+StatusCode PCD_CalibrateRf(
+	MFRC522Ptr_t mfrc,
+	MIFARE_Key *key,	   ///< Key A for blockAddr on MIFARE Classic, NULL for
+						   ///PICCs that READ without authentication.
+	uint8_t blockAddr,	   ///< The block or page read by each trial.
+	PCD_Calibration *result ///< Out: The chosen profile and its figures.
+	) {
+	uint8_t atqa[2];
+	uint8_t atqaSize = sizeof(atqa);
+	PCD_RfProfile before;
+	PCD_RfProfile profile;
+	Uid uid;
+
+	PCD_GetRfProfile(mfrc, &before);
+	bool wasSet = mfrc->rfProfileSet;
+	if (PICC_WakeupA(mfrc, atqa, &atqaSize) != STATUS_OK) {
+		return STATUS_TIMEOUT;
+	}
+	StatusCode status = PICC_Select(mfrc, &uid, 0);
+	PICC_HaltA(mfrc);
+	if (status != STATUS_OK) {
+		return status;
+	}
+
+	memset(result, 0, sizeof(*result));
+	result->profile = before; // Where the sweep starts
+	PCD_CalibrationMeasure(mfrc, &uid, key, blockAddr, &before, result);
+	for (uint8_t i = 0; i < sizeof(PCD_CALIBRATION_RX_GAINS); i++) {
+		profile = result->profile;
+		profile.rxGain = PCD_CALIBRATION_RX_GAINS[i];
+		PCD_CalibrationMeasure(mfrc, &uid, key, blockAddr, &profile, result);
+	}
+	for (uint8_t i = 0; i < sizeof(PCD_CALIBRATION_GS_P); i++) {
+		profile = result->profile;
+		profile.cwGsP = PCD_CALIBRATION_GS_P[i];
+		PCD_CalibrationMeasure(mfrc, &uid, key, blockAddr, &profile, result);
+	}
+	if (!(PCD_ReadRegister(mfrc, TxASKReg) & 0x40)) { // Force100ASK off
+		for (uint8_t i = 0; i < sizeof(PCD_CALIBRATION_GS_P); i++) {
+			profile = result->profile;
+			profile.modGsP = PCD_CALIBRATION_GS_P[i];
+			PCD_CalibrationMeasure(mfrc, &uid, key, blockAddr, &profile,
+								   result);
+		}
+	}
+	for (uint8_t i = 0; i < sizeof(PCD_CALIBRATION_DEMODS); i++) {
+		profile = result->profile;
+		profile.demod = PCD_CALIBRATION_DEMODS[i];
+		PCD_CalibrationMeasure(mfrc, &uid, key, blockAddr, &profile, result);
+	}
+
+	if (result->successes == 0) {
+		PCD_SetRfProfile(mfrc, &before);
+		if (!wasSet) {
+			PCD_SetRfProfile(mfrc, NULL);
+		}
+		return STATUS_ERROR;
+	}
+	PCD_SetRfProfile(mfrc, &result->profile);
+	return STATUS_OK;
+} // End PCD_CalibrateRf()
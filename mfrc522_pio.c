@@ -0,0 +1,234 @@
+/**
+* PIO SPI transport for the mfrc522 library for pi pico c/c++ sdk
+* NOTE: Please also check the comments in mfrc522_pio.h.
+*/
+
+#include "mfrc522_pio.h"
+#include "mfrc522_pio.pio.h"
+#include "hardware/dma.h"
+
+// Where mfrc522_spi is loaded in each PIO block, and how many buses use it
+static uint programOffset[NUM_PIOS];
+static uint8_t programUsers[NUM_PIOS];
+
+/**
+ * Sends txLen uint8_ts of tx and collects the rxLen uint8_ts clocked in
+ * meanwhile in rx, or drops them if rx is NULL. rxLen is txLen minus one
+ * length byte per frame, and the call returns after the last frame has been
+ * clocked.
+ */
+static void MFRC522_HOT(MFRC522_PioTransfer)(MFRC522_Pio *bus,
+											 const uint8_t *tx, uint txLen,
+											 uint8_t *rx, uint rxLen) {
+	io_rw_8 *txFifo = (io_rw_8 *)&bus->pio->txf[bus->sm];
+	io_rw_8 *rxFifo = (io_rw_8 *)&bus->pio->rxf[bus->sm];
+	uint8_t discard;
+
+	if (bus->dmaTx >= 0 && rxLen >= MFRC522_DMA_MIN_BURST) {
+		dma_channel_config c = dma_channel_get_default_config(bus->dmaTx);
+		channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+		channel_config_set_read_increment(&c, true);
+		channel_config_set_write_increment(&c, false);
+		channel_config_set_dreq(&c, pio_get_dreq(bus->pio, bus->sm, true));
+		dma_channel_configure(bus->dmaTx, &c, txFifo, tx, txLen, false);
+
+		c = dma_channel_get_default_config(bus->dmaRx);
+		channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+		channel_config_set_read_increment(&c, false);
+		channel_config_set_write_increment(&c, rx != NULL);
+		channel_config_set_dreq(&c, pio_get_dreq(bus->pio, bus->sm, false));
+		dma_channel_configure(bus->dmaRx, &c, rx ? rx : &discard, rxFifo,
+							  rxLen, false);
+
+		dma_start_channel_mask((1u << bus->dmaTx) | (1u << bus->dmaRx));
+		dma_channel_wait_for_finish_blocking(bus->dmaRx);
+		return;
+	}
+
+	uint sent = 0;
+	uint received = 0;
+	while (received < rxLen) {
+		if (sent < txLen && !pio_sm_is_tx_fifo_full(bus->pio, bus->sm)) {
+			*txFifo = tx[sent++];
+		}
+		if (!pio_sm_is_rx_fifo_empty(bus->pio, bus->sm)) {
+			discard = *rxFifo;
+			if (rx) {
+				rx[received] = discard;
+			}
+			received++;
+		}
+	}
+}
+
+/**
+ * PIO transport: writes count uint8_ts to one register. Longer writes than
+ * one frame holds are split, the MFRC522 sees the same register writes.
+ */
+static void MFRC522_HOT(MFRC522_PioWrite)(void *context, uint8_t reg,
+										  const uint8_t *values,
+										  uint8_t count) {
+	MFRC522_Pio *bus = context;
+
+	while (count > 0) {
+		uint8_t chunk = MIN(count, MFRC522_PIO_FRAME_SIZE - 2);
+		bus->tx[0] = chunk; // Address and chunk, minus one
+		bus->tx[1] = 0x00 | reg;
+		memcpy(&bus->tx[2], values, chunk);
+		MFRC522_PioTransfer(bus, bus->tx, chunk + 2, NULL, chunk + 1);
+		values += chunk;
+		count -= chunk;
+	}
+}
+
+/**
+ * PIO transport: pipelined read of count uint8_ts from one register in one
+ * frame, see PCD_SpiRead() in mfrc522.c. PCD_ReadNRegister() never asks for
+ * more than BUFFER_SIZE - 1.
+ */
+static void MFRC522_HOT(MFRC522_PioRead)(void *context, uint8_t reg,
+										 uint8_t *values, uint8_t count) {
+	MFRC522_Pio *bus = context;
+
+	bus->tx[0] = count; // count addresses and the stop byte, minus one
+	memset(&bus->tx[1], 0x80 | reg, count);
+	bus->tx[count + 1] = 0x00; // Stop reading
+	MFRC522_PioTransfer(bus, bus->tx, count + 2, bus->rx, count + 1);
+
+	// rx[0] was clocked in while the first address was sent
+	memcpy(values, &bus->rx[1], count);
+}
+
+/**
+ * PIO transport: MFRC522_PioWrite() of a PCD_Frame payload. The length and
+ * address bytes go in the headroom and the frame leaves straight from the
+ * caller's storage.
+ */
+static void MFRC522_HOT(MFRC522_PioWriteFrame)(void *context, uint8_t reg,
+											   uint8_t *values,
+											   uint8_t count) {
+	MFRC522_Pio *bus = context;
+	uint8_t *frame = values - 2;
+
+	frame[0] = count; // Address and values, minus one
+	frame[1] = 0x00 | reg;
+	MFRC522_PioTransfer(bus, frame, count + 2, NULL, count + 1);
+}
+
+/**
+ * PIO transport: MFRC522_PioRead() into a PCD_Frame payload. The byte clocked
+ * in with the first address lands in the headroom, the answers right in
+ * values.
+ */
+static void MFRC522_HOT(MFRC522_PioReadFrame)(void *context, uint8_t reg,
+											  uint8_t *values, uint8_t count) {
+	MFRC522_Pio *bus = context;
+
+	bus->tx[0] = count; // count addresses and the stop byte, minus one
+	memset(&bus->tx[1], 0x80 | reg, count);
+	bus->tx[count + 1] = 0x00; // Stop reading
+	MFRC522_PioTransfer(bus, bus->tx, count + 2, values - 1, count + 1);
+}
+
+/**
+ * PIO transport: one two-uint8_t frame per step, queued back to back so the
+ * state machine runs the whole batch from a single DMA transfer.
+ */
+static void MFRC522_HOT(MFRC522_PioWriteScript)(
+	void *context, const PCD_RegisterWrite *steps, size_t length) {
+	MFRC522_Pio *bus = context;
+
+	while (length > 0) {
+		uint count = MIN(length, MFRC522_PIO_FRAME_SIZE / 3);
+		for (uint i = 0; i < count; i++) {
+			bus->tx[3 * i] = 1; // Address and value, minus one
+			bus->tx[3 * i + 1] = 0x00 | steps[i].reg;
+			bus->tx[3 * i + 2] = steps[i].value;
+		}
+		MFRC522_PioTransfer(bus, bus->tx, 3 * count, NULL, 2 * count);
+		steps += count;
+		length -= count;
+	}
+}
+
+const PCD_Transport MFRC522_PIO_TRANSPORT = {
+	MFRC522_PioWrite, MFRC522_PioRead, MFRC522_PioWriteScript,
+	MFRC522_PioWriteFrame, MFRC522_PioReadFrame};
+
+/**
+ * Runs the bus of a reader on a free state machine of pio and routes the
+ * register access of mfrc through it. config is the wiring, with
+ * config->sckPin == config->csPin + 1 and baudrate 0 for MFRC522_BIT_RATE.
+ * config->spi is set to NULL so that PCD_InitWithConfig(mfrc, config), the
+ * next call, leaves the pins to the state machine. A pair of DMA channels is
+ * claimed if available, without them the CPU feeds the FIFOs.
+ *
+ * @return false if the pins do not fit or pio has no free state machine or
+ * program space.
+ */
+bool MFRC522_PioAttach(MFRC522_Pio *bus, MFRC522Ptr_t mfrc, PIO pio,
+					   MFRC522_Config *config) {
+	uint index = pio_get_index(pio);
+
+	if (config->sckPin != config->csPin + 1) {
+		return false;
+	}
+	int sm = pio_claim_unused_sm(pio, false);
+	if (sm < 0) {
+		return false;
+	}
+	if (programUsers[index] == 0) {
+		if (!pio_can_add_program(pio, &mfrc522_spi_program)) {
+			pio_sm_unclaim(pio, sm);
+			return false;
+		}
+		programOffset[index] = pio_add_program(pio, &mfrc522_spi_program);
+	}
+	programUsers[index]++;
+
+	uint baudrate = config->baudrate ? config->baudrate : MFRC522_BIT_RATE;
+	bus->pio = pio;
+	bus->sm = sm;
+	mfrc522_spi_program_init(pio, sm, programOffset[index],
+							 MIN(baudrate, MFRC522_MAX_BIT_RATE), config->csPin,
+							 config->mosiPin, config->misoPin);
+
+	bus->dmaTx = dma_claim_unused_channel(false);
+	bus->dmaRx = dma_claim_unused_channel(false);
+	if (bus->dmaTx < 0 || bus->dmaRx < 0) {
+		if (bus->dmaTx >= 0) {
+			dma_channel_unclaim(bus->dmaTx);
+		}
+		if (bus->dmaRx >= 0) {
+			dma_channel_unclaim(bus->dmaRx);
+		}
+		bus->dmaTx = -1;
+		bus->dmaRx = -1;
+	}
+
+	PCD_SetTransport(mfrc, &MFRC522_PIO_TRANSPORT, bus);
+	config->spi = NULL;
+	return true;
+} // End MFRC522_PioAttach()
+
+/**
+ * Stops the state machine of bus, releases it and its DMA channels and puts
+ * mfrc back on the SPI transport. The program is unloaded with its last bus.
+ */
+void MFRC522_PioDetach(MFRC522_Pio *bus, MFRC522Ptr_t mfrc) {
+	uint index = pio_get_index(bus->pio);
+
+	pio_sm_set_enabled(bus->pio, bus->sm, false);
+	pio_sm_unclaim(bus->pio, bus->sm);
+	if (--programUsers[index] == 0) {
+		pio_remove_program(bus->pio, &mfrc522_spi_program,
+						   programOffset[index]);
+	}
+	if (bus->dmaTx >= 0) {
+		dma_channel_unclaim(bus->dmaTx);
+		dma_channel_unclaim(bus->dmaRx);
+	}
+	bus->dmaTx = -1;
+	bus->dmaRx = -1;
+	PCD_SetTransport(mfrc, NULL, NULL);
+} // End MFRC522_PioDetach()
@@ -0,0 +1,51 @@
+/*
+ * mfrc522_pio.h
+ *
+ * PIO SPI transport for the mfrc522 library for pi pico c/c++ sdk
+ *
+ * Runs the SPI bus of a reader on a PIO state machine instead of a hardware
+ * SPI block. The program of mfrc522_pio.pio does the CS framing itself, so
+ * a whole register access, a pipelined FIFO read or a complete register
+ * script goes out as one DMA transfer without the CPU toggling pins. The
+ * hardware SPI blocks stay free for other peripherals, and with eight state
+ * machines up to eight readers get their own bus.
+ *
+ * CS and SCK are side-set pins: SCK must be the GPIO right above CS, as in
+ * the default wiring of mfrc522.h (CS 17, SCK 18).
+ *
+ */
+
+#ifndef MFRC522_PIO_h
+#define MFRC522_PIO_h
+
+#include "mfrc522.h"
+#include "hardware/pio.h"
+
+/*******************************************************************************
+ * Types/enumerations/variables
+ ******************************************************************************/
+// Largest transfer: the length byte plus a BUFFER_SIZE burst, or register
+// script steps of three uint8_ts each
+#define MFRC522_PIO_FRAME_SIZE (BUFFER_SIZE + 1)
+
+// One bus run by a state machine, set up by MFRC522_PioAttach()
+typedef struct {
+	PIO pio;
+	uint sm;
+	int dmaTx; // -1 if no channel was free, the CPU feeds the FIFOs
+	int dmaRx;
+	uint8_t tx[MFRC522_PIO_FRAME_SIZE]; // Frames as the program expects them
+	uint8_t rx[MFRC522_PIO_FRAME_SIZE]; // uint8_ts clocked in
+} MFRC522_Pio;
+
+// The transport MFRC522_PioAttach() installs, context is the MFRC522_Pio
+extern const PCD_Transport MFRC522_PIO_TRANSPORT;
+
+/*******************************************************************************
+* Functions for the PIO transport
+*******************************************************************************/
+bool MFRC522_PioAttach(MFRC522_Pio *bus, MFRC522Ptr_t mfrc, PIO pio,
+					   MFRC522_Config *config);
+void MFRC522_PioDetach(MFRC522_Pio *bus, MFRC522Ptr_t mfrc);
+
+#endif
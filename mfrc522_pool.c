@@ -0,0 +1,148 @@
+/**
+* Reader pool scheduler for the mfrc522 library for pi pico c/c++ sdk
+* NOTE: Please also check the comments in mfrc522_pool.h.
+*/
+
+#include "mfrc522_pool.h"
+
+/**
+ * Prepares an empty pool.
+ * With maxActiveFields below the number of readers the antennas take turns:
+ * a reader only switches its field on for its own polling slot. Otherwise
+ * all fields stay on and only the REQA exchanges are interleaved.
+ */
+void MFRC522_PoolInit(MFRC522_Pool *pool, uint8_t maxActiveFields) {
+	memset(pool, 0, sizeof(*pool));
+	pool->maxActiveFields = maxActiveFields ? maxActiveFields : 1;
+	pool->fieldSettleUs = MFRC522_POOL_FIELD_SETTLE_US;
+} // End MFRC522_PoolInit()
+
+/**
+ * Adds a reader that has already been set up with PCD_InitWithConfig().
+ * Its antenna is switched off until the scheduler gives it a slot.
+ *
+ * @return The reader index reported in events, -1 if the pool is full.
+ */
+int MFRC522_PoolAdd(MFRC522_Pool *pool, MFRC522Ptr_t mfrc) {
+	if (pool->count >= MFRC522_POOL_MAX_READERS) {
+		return -1;
+	}
+	MFRC522_PoolSlot *slot = &pool->slots[pool->count];
+	memset(slot, 0, sizeof(*slot));
+	slot->mfrc = mfrc;
+	slot->state = POOL_STATE_IDLE;
+	PCD_AntennaOff(mfrc);
+	return pool->count++;
+} // End MFRC522_PoolAdd()
+
+/**
+ * Appends an event, counting it as dropped when the queue is full.
+ */
+static void MFRC522_PoolPush(MFRC522_Pool *pool, uint8_t reader) {
+	uint8_t next = (pool->tail + 1) % MFRC522_POOL_QUEUE_SIZE;
+	if (next == pool->head) {
+		pool->dropped++;
+		return;
+	}
+	MFRC522_PoolEvent *event = &pool->queue[pool->tail];
+	event->reader = reader;
+	event->mfrc = pool->slots[reader].mfrc;
+	event->uid = pool->slots[reader].mfrc->uid;
+	event->timestamp = time_us_64();
+	pool->tail = next;
+}
+
+/**
+ * Ends the polling slot of a reader, handing its field to the next one if
+ * the fields are time sliced.
+ */
+static void MFRC522_PoolEndSlot(MFRC522_Pool *pool, MFRC522_PoolSlot *slot) {
+	if (pool->count > pool->maxActiveFields && slot->fieldOn) {
+		PCD_AntennaOff(slot->mfrc);
+		slot->fieldOn = false;
+		pool->activeFields--;
+	}
+	slot->state = POOL_STATE_IDLE;
+}
+
+/**
+ * Runs one non-blocking scheduling step over all readers: grants field slots,
+ * sends REQA once a field has settled and collects the answers. Only a
+ * reader that has seen an ATQA blocks, for the PICC_Select() and
+ * PICC_HaltA() of the detected PICC. Call this from the main loop as often
+ * as possible.
+ */
+void MFRC522_PoolPoll(MFRC522_Pool *pool) {
+	for (uint8_t i = 0; i < pool->count; i++) {
+		MFRC522_PoolSlot *slot = &pool->slots[i];
+		MFRC522Ptr_t mfrc = slot->mfrc;
+		StatusCode status;
+
+		switch (slot->state) {
+		case POOL_STATE_IDLE:
+			if (slot->fieldOn) { // The field is still up from the last slot
+				slot->readyAt = get_absolute_time();
+			} else if (pool->activeFields < pool->maxActiveFields) {
+				PCD_AntennaOn(mfrc);
+				slot->fieldOn = true;
+				pool->activeFields++;
+				slot->readyAt = make_timeout_time_us(pool->fieldSettleUs);
+			} else {
+				break; // Wait for another reader to end its slot
+			}
+			slot->state = POOL_STATE_SETTLING;
+			// Fall through, the field may be ready already
+
+		case POOL_STATE_SETTLING:
+			if (!time_reached(slot->readyAt)) {
+				break;
+			}
+			PCD_PrepareRequestA(mfrc); // As PICC_REQA_or_WUPA() does
+			slot->command = PICC_CMD_REQA;
+			slot->bufferSize = sizeof(slot->bufferATQA);
+			slot->validBits = 7; // Short frame, see PICC_REQA_or_WUPA()
+			status = PCD_StartTransceiveData(
+				mfrc, &slot->command, 1, slot->bufferATQA, &slot->bufferSize,
+				&slot->validBits, 0, false, NULL, NULL);
+			if (status != STATUS_OK) {
+				MFRC522_PoolEndSlot(pool, slot);
+				break;
+			}
+			slot->state = POOL_STATE_REQA;
+			break;
+
+		case POOL_STATE_REQA:
+			status = PCD_PollCommunication(mfrc);
+			if (status == STATUS_PENDING) {
+				break; // Carry on with the other readers meanwhile
+			}
+			// What PICC_IsNewCardPresent() accepts: an ATQA of exactly 16
+			// bits as PICC_REQA_or_WUPA() checks it, or a collision of
+			// several of them
+			if ((status == STATUS_OK && slot->bufferSize == 2 &&
+				 slot->validBits == 0) ||
+				status == STATUS_COLLISION) {
+				if (PICC_Select(mfrc, &mfrc->uid, 0) == STATUS_OK) {
+					PICC_HaltA(mfrc);
+					MFRC522_PoolPush(pool, i);
+				}
+			}
+			MFRC522_PoolEndSlot(pool, slot);
+			break;
+		}
+	}
+} // End MFRC522_PoolPoll()
+
+/**
+ * Takes the oldest event from the queue.
+ *
+ * @return true if an event was copied to *event.
+ */
+bool MFRC522_PoolGetEvent(MFRC522_Pool *pool, MFRC522_PoolEvent *event) {
+	if (pool->head == pool->tail) {
+		return false;
+	}
+	*event = pool->queue[pool->head];
+	pool->head = (pool->head + 1) % MFRC522_POOL_QUEUE_SIZE;
+	return true;
+} // End MFRC522_PoolGetEvent()
@@ -0,0 +1,76 @@
+/*
+ * mfrc522_pool.h
+ *
+ * Reader pool scheduler for the mfrc522 library for pi pico c/c++ sdk
+ *
+ * Polls any number of MFRC522 readers, on one or both SPI controllers, from
+ * a single loop. Antenna fields are staggered so that neighbouring antennas
+ * do not disturb each other, and while one reader waits for a PICC to answer
+ * the SPI bus is used to start or finish exchanges on the others.
+ * Detected PICCs are reported through one event queue.
+ *
+ */
+
+#ifndef MFRC522_POOL_h
+#define MFRC522_POOL_h
+
+#include "mfrc522.h"
+
+/*******************************************************************************
+ * Types/enumerations/variables
+ ******************************************************************************/
+// Readers one pool can schedule
+#define MFRC522_POOL_MAX_READERS MFRC_MAX_INSTANCES
+// Events buffered until MFRC522_PoolGetEvent() is called
+#define MFRC522_POOL_QUEUE_SIZE 16
+// Field settling time before the first REQA of a slot
+#define MFRC522_POOL_FIELD_SETTLE_US MFRC522_FIELD_SETTLE_US
+
+// Where a reader is in its polling slot
+typedef enum _MFRC522_PoolState {
+	POOL_STATE_IDLE,	 // Waiting for a free field slot
+	POOL_STATE_SETTLING, // Antenna on, giving PICCs time to power up
+	POOL_STATE_REQA		 // REQA sent, waiting for an ATQA
+} MFRC522_PoolState;
+
+// A PICC detected by one of the readers of a pool
+typedef struct {
+	uint8_t reader;		// Index returned by MFRC522_PoolAdd()
+	MFRC522Ptr_t mfrc;  // The reader that detected the PICC
+	Uid uid;			// UID and SAK of the PICC, now in state HALT
+	uint64_t timestamp; // time_us_64() when the PICC was selected
+} MFRC522_PoolEvent;
+
+// Scheduling state of one reader
+typedef struct {
+	MFRC522Ptr_t mfrc;
+	MFRC522_PoolState state;
+	bool fieldOn;			 // Antenna driver enabled
+	absolute_time_t readyAt; // End of the field settling time
+	uint8_t command;		 // REQA frame, must outlive the async exchange
+	uint8_t bufferATQA[2];
+	uint8_t bufferSize;
+	uint8_t validBits;
+} MFRC522_PoolSlot;
+
+typedef struct {
+	MFRC522_PoolSlot slots[MFRC522_POOL_MAX_READERS];
+	uint8_t count;			 // Number of readers in slots[]
+	uint8_t maxActiveFields; // Antennas allowed on at the same time
+	uint8_t activeFields;	// Antennas currently on
+	uint32_t fieldSettleUs;
+	MFRC522_PoolEvent queue[MFRC522_POOL_QUEUE_SIZE];
+	uint8_t head; // Next event to hand out
+	uint8_t tail; // Next free entry
+	uint32_t dropped; // Events lost because the queue was full
+} MFRC522_Pool;
+
+/*******************************************************************************
+* Functions for scheduling several readers
+*******************************************************************************/
+void MFRC522_PoolInit(MFRC522_Pool *pool, uint8_t maxActiveFields);
+int MFRC522_PoolAdd(MFRC522_Pool *pool, MFRC522Ptr_t mfrc);
+void MFRC522_PoolPoll(MFRC522_Pool *pool);
+bool MFRC522_PoolGetEvent(MFRC522_Pool *pool, MFRC522_PoolEvent *event);
+
+#endif
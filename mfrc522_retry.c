@@ -0,0 +1,291 @@
+/**
+* Retry layer for the mfrc522 library for pi pico c/c++ sdk
+* NOTE: Please also check the comments in mfrc522_retry.h.
+*/
+
+#include "mfrc522_retry.h"
+
+// Arguments of the operations retried by the functions below
+typedef struct {
+	uint8_t command;
+	uint8_t blockAddr;
+	MIFARE_Key *key;
+} MFRC522_RetryAuthArgs;
+
+typedef struct {
+	uint8_t *sendData;
+	uint8_t sendLen;
+	uint8_t *backData;
+	uint8_t *backLen;
+	uint8_t backSize; // *backLen on entry, restored for every attempt
+	bool checkCRC;
+} MFRC522_RetryTransceiveArgs;
+
+typedef struct {
+	uint8_t blockAddr;
+	uint8_t *buffer;
+	uint8_t *bufferSize;
+	uint8_t size; // *bufferSize on entry, restored for every attempt
+} MFRC522_RetryBlockArgs;
+
+/**
+ * Fills in the MFRC522_RETRY_* defaults.
+ */
+void MFRC522_RetryPolicyInit(MFRC522_RetryPolicy *policy) {
+	policy->resends = MFRC522_RETRY_RESENDS;
+	policy->reactivations = MFRC522_RETRY_REACTIVATIONS;
+	policy->deadlineUs = MFRC522_RETRY_DEADLINE_US;
+	policy->backoffUs = MFRC522_RETRY_BACKOFF_US;
+	policy->maxBackoffUs = MFRC522_RETRY_MAX_BACKOFF_US;
+} // End MFRC522_RetryPolicyInit()
+
+/**
+ * Tells how an attempt that ended with status can be recovered. Lost and
+ * damaged frames are transient, the PICC stays ACTIVE and the frame can be
+ * sent again. In an authenticated session the PICC drops the authentication
+ * on an error, and Crypto1 of PCD and PICC may be out of step, so the PICC
+ * has to be reactivated. Everything else, a NAK included, is final.
+ *
+ * @return The MFRC522_RetryAction for status.
+ */
+MFRC522_RetryAction MFRC522_RetryClassify(
+	StatusCode status,
+	bool authenticated ///< Crypto1 was on for the attempt
+	) {
+	switch (status) {
+	case STATUS_TIMEOUT:   // Frame or answer lost
+	case STATUS_CRC_WRONG: // Answer damaged
+	case STATUS_COLLISION: // Answer disturbed
+	case STATUS_ERROR:	   // Parity or protocol error
+		return authenticated ? RETRY_ACTION_REACTIVATE : RETRY_ACTION_RESEND;
+	default:
+		return RETRY_ACTION_NONE;
+	}
+} // End MFRC522_RetryClassify()
+
+/**
+ * Starts a session with the PICC selected with uid, without authentication
+ * and with the default policy. session->policy may be changed afterwards.
+ */
+void MFRC522_RetryBegin(MFRC522_RetrySession *session, MFRC522Ptr_t mfrc,
+						const Uid *uid) {
+	session->mfrc = mfrc;
+	MFRC522_RetryPolicyInit(&session->policy);
+	session->uid = *uid;
+	session->authCommand = 0;
+	session->authBlock = 0;
+} // End MFRC522_RetryBegin()
+
+/**
+ * Brings the PICC of session back to state ACTIVE, authenticated again if
+ * the session is. The PICC is halted first because an ACTIVE PICC does not
+ * answer WUPA.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+static StatusCode MFRC522_RetryReactivate(MFRC522_RetrySession *session) {
+	MFRC522Ptr_t mfrc = session->mfrc;
+	uint8_t bufferATQA[2];
+	uint8_t bufferSize = sizeof(bufferATQA);
+
+	PCD_StopCrypto1(mfrc);
+	PICC_HaltA(mfrc);
+	StatusCode status = PICC_WakeupA(mfrc, bufferATQA, &bufferSize);
+	if (status != STATUS_OK) {
+		return status;
+	}
+	status = PICC_SelectKnown(mfrc, &session->uid);
+	if (status != STATUS_OK || session->authCommand == 0) {
+		return status;
+	}
+	return PCD_Authenticate(mfrc, session->authCommand, session->authBlock,
+							&session->key, &session->uid);
+}
+
+/**
+ * MFRC522_RetryRun(), with authenticated telling whether a failed attempt
+ * leaves Crypto1 to be restarted.
+ */
+static StatusCode MFRC522_RetryRunAs(MFRC522_RetrySession *session,
+									 MFRC522_RetryOp op, void *context,
+									 bool authenticated) {
+	const MFRC522_RetryPolicy *policy = &session->policy;
+	absolute_time_t deadline = make_timeout_time_us(policy->deadlineUs);
+	uint8_t resends = policy->resends;
+	uint8_t reactivations = policy->reactivations;
+	uint32_t backoffUs = policy->backoffUs;
+	bool reactivate = false;
+
+	for (;;) {
+		StatusCode status =
+			reactivate ? MFRC522_RetryReactivate(session) : op(session, context);
+		if (status == STATUS_OK && reactivate) {
+			reactivate = false;
+			continue; // Now the operation itself
+		}
+		MFRC522_RetryAction action =
+			MFRC522_RetryClassify(status, authenticated || reactivate);
+		if (action == RETRY_ACTION_NONE) {
+			return status;
+		}
+		if (action == RETRY_ACTION_RESEND && resends == 0) {
+			action = RETRY_ACTION_REACTIVATE; // The PICC may have left ACTIVE
+		}
+		if ((action == RETRY_ACTION_REACTIVATE && reactivations == 0) ||
+			absolute_time_diff_us(get_absolute_time(), deadline) <
+				(int64_t)backoffUs) {
+			PCD_STAT_ADD(session->mfrc, retryFailures, 1);
+			return status;
+		}
+
+		sleep_us(backoffUs);
+		backoffUs = backoffUs * 2 < policy->maxBackoffUs ? backoffUs * 2
+														 : policy->maxBackoffUs;
+		if (action == RETRY_ACTION_RESEND) {
+			resends--;
+			PCD_STAT_ADD(session->mfrc, retries, 1);
+		} else {
+			reactivations--;
+			reactivate = true;
+			PCD_STAT_ADD(session->mfrc, reactivations, 1);
+		}
+	}
+}
+
+/**
+ * Runs op until it succeeds, fails for good or the policy of session is
+ * spent. Each failed attempt is classified by MFRC522_RetryClassify(): op
+ * is called again, after reactivating the PICC if needed, with a pause in
+ * between. op must leave the PICC ACTIVE as it found it and repeat the
+ * exact same frames on each call.
+ *
+ * @return STATUS_OK on success, the status of the last attempt otherwise.
+ */
+StatusCode MFRC522_RetryRun(MFRC522_RetrySession *session,
+							MFRC522_RetryOp op, void *context) {
+	return MFRC522_RetryRunAs(session, op, context, session->authCommand != 0);
+} // End MFRC522_RetryRun()
+
+static StatusCode MFRC522_RetryAuthOp(MFRC522_RetrySession *session,
+									  void *context) {
+	MFRC522_RetryAuthArgs *args = context;
+	return PCD_Authenticate(session->mfrc, args->command, args->blockAddr,
+							args->key, &session->uid);
+}
+
+/**
+ * Authenticates the sector containing blockAddr and keeps the key, so that
+ * later operations of the session can authenticate again after a
+ * reactivation. A failed authentication sends the PICC to state IDLE, so
+ * each retry is a reactivation. A wrong key is only known to be wrong once
+ * the budget is spent.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise. The session is then
+ * no longer authenticated.
+ */
+StatusCode MFRC522_RetryAuthenticate(
+	MFRC522_RetrySession *session,
+	uint8_t command,   ///< PICC_CMD_MF_AUTH_KEY_A or PICC_CMD_MF_AUTH_KEY_B
+	uint8_t blockAddr, ///< The block number. See numbering in the comments
+					   ///in the .h file.
+	MIFARE_Key *key ///< Pointer to the Crypteo1 key to use (6 uint8_ts)
+	) {
+	MFRC522_RetryAuthArgs args = {command, blockAddr, key};
+
+	session->authCommand = 0; // Reactivations before success select only
+	StatusCode status =
+		MFRC522_RetryRunAs(session, MFRC522_RetryAuthOp, &args, true);
+	if (status == STATUS_OK) {
+		session->authCommand = command;
+		session->authBlock = blockAddr;
+		session->key = *key;
+	}
+	return status;
+} // End MFRC522_RetryAuthenticate()
+
+static StatusCode MFRC522_RetryTransceiveOp(MFRC522_RetrySession *session,
+											void *context) {
+	MFRC522_RetryTransceiveArgs *args = context;
+	if (args->backLen) {
+		*args->backLen = args->backSize;
+	}
+	return PCD_TransceiveData(session->mfrc, args->sendData, args->sendLen,
+							  args->backData, args->backLen, NULL, 0,
+							  args->checkCRC);
+}
+
+/**
+ * PCD_TransceiveData() of whole uint8_ts, retried under the policy of
+ * session. backData must not overlap sendData, the frame is sent again as
+ * it is.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MFRC522_RetryTransceive(
+	MFRC522_RetrySession *session,
+	uint8_t *sendData, ///< Pointer to the data to transfer to the FIFO.
+	uint8_t sendLen,   ///< Number of uint8_ts to transfer to the FIFO.
+	uint8_t *backData, ///< NULL or pointer to buffer if data should be read
+					   ///back after executing the command.
+	uint8_t *backLen,  ///< In: Max number of uint8_ts to write to *backData.
+					   ///Out: The number of uint8_ts returned.
+	bool checkCRC ///< In: True => The last two uint8_ts of the response is
+				  ///assumed to be a CRC_A that must be validated.
+	) {
+	MFRC522_RetryTransceiveArgs args = {sendData, sendLen, backData, backLen,
+										backLen ? *backLen : 0, checkCRC};
+	return MFRC522_RetryRun(session, MFRC522_RetryTransceiveOp, &args);
+} // End MFRC522_RetryTransceive()
+
+static StatusCode MFRC522_RetryReadOp(MFRC522_RetrySession *session,
+									  void *context) {
+	MFRC522_RetryBlockArgs *args = context;
+	*args->bufferSize = args->size;
+	return MIFARE_Read(session->mfrc, args->blockAddr, args->buffer,
+					   args->bufferSize);
+}
+
+/**
+ * MIFARE_Read() retried under the policy of session. For MIFARE Classic the
+ * session must have been authenticated with MFRC522_RetryAuthenticate().
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MFRC522_RetryRead(
+	MFRC522_RetrySession *session,
+	uint8_t blockAddr,	 ///< MIFARE Classic: The block (0-0xff) number.
+						 ///MIFARE Ultralight: The first page to return data
+						 ///from.
+	uint8_t *buffer,	 ///< The buffer to store the data in
+	uint8_t *bufferSize ///< Buffer size, at least 18 uint8_ts. Also number of
+						///uint8_ts returned if STATUS_OK.
+	) {
+	MFRC522_RetryBlockArgs args = {blockAddr, buffer, bufferSize, *bufferSize};
+	return MFRC522_RetryRun(session, MFRC522_RetryReadOp, &args);
+} // End MFRC522_RetryRead()
+
+static StatusCode MFRC522_RetryWriteOp(MFRC522_RetrySession *session,
+									   void *context) {
+	MFRC522_RetryBlockArgs *args = context;
+	return MIFARE_Write(session->mfrc, args->blockAddr, args->buffer,
+						args->size);
+}
+
+/**
+ * MIFARE_Write() retried under the policy of session. Writing the same 16
+ * uint8_ts again is harmless, so a write whose ACK was lost is simply
+ * repeated. For MIFARE Classic the session must have been authenticated
+ * with MFRC522_RetryAuthenticate().
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode MFRC522_RetryWrite(
+	MFRC522_RetrySession *session,
+	uint8_t blockAddr, ///< MIFARE Classic: The block (0-0xff) number.
+					   ///MIFARE Ultralight: The page (2-15) to write to.
+	uint8_t *buffer,   ///< The 16 uint8_ts to write to the PICC
+	uint8_t bufferSize ///< Buffer size, must be at least 16 uint8_ts.
+	) {
+	MFRC522_RetryBlockArgs args = {blockAddr, buffer, NULL, bufferSize};
+	return MFRC522_RetryRun(session, MFRC522_RetryWriteOp, &args);
+} // End MFRC522_RetryWrite()
@@ -0,0 +1,90 @@
+/*
+ * mfrc522_retry.h
+ *
+ * Retry layer for the mfrc522 library for pi pico c/c++ sdk
+ *
+ * Runs exchanges and MIFARE operations against one PICC and recovers from
+ * transient RF errors under a policy. An answer that was lost or damaged on
+ * air is recovered by sending the same frame again. If the PICC was
+ * authenticated, or if resending does not help, the PICC is woken, selected
+ * with its known UID and authenticated again first. Each operation has its
+ * own budget of resends and reactivations and a total deadline, and the
+ * pause between attempts doubles up to a limit. Retries are counted in
+ * MFRC522_Stats.
+ *
+ * Only idempotent operations should be retried. A value operation followed
+ * by TRANSFER can be applied twice if the ACK of the TRANSFER is lost.
+ *
+ */
+
+#ifndef MFRC522_RETRY_h
+#define MFRC522_RETRY_h
+
+#include "mfrc522.h"
+
+/*******************************************************************************
+ * Types/enumerations/variables
+ ******************************************************************************/
+// Defaults of MFRC522_RetryPolicyInit()
+#define MFRC522_RETRY_RESENDS 2		   // Same frame again
+#define MFRC522_RETRY_REACTIVATIONS 1   // Wake, select and authenticate again
+#define MFRC522_RETRY_DEADLINE_US 100000 // Per operation, retries included
+#define MFRC522_RETRY_BACKOFF_US 500	   // Pause before the first retry
+#define MFRC522_RETRY_MAX_BACKOFF_US 4000
+
+// How a failed attempt is recovered, see MFRC522_RetryClassify()
+typedef enum _MFRC522_RetryAction {
+	RETRY_ACTION_NONE,	  // Final, report the status
+	RETRY_ACTION_RESEND,	  // The PICC is still ACTIVE, send the frame again
+	RETRY_ACTION_REACTIVATE // Wake, select and authenticate the PICC first
+} MFRC522_RetryAction;
+
+// Budgets of one operation
+typedef struct {
+	uint8_t resends;	   // Attempts with the same frame
+	uint8_t reactivations; // Attempts after reactivating the PICC
+	uint32_t deadlineUs;   // Time for the operation, retries included
+	uint32_t backoffUs;	   // Pause before the first retry, doubled after each
+	uint32_t maxBackoffUs; // Longest pause
+} MFRC522_RetryPolicy;
+
+// A selected PICC and what it takes to bring it back, see
+// MFRC522_RetryBegin()
+typedef struct {
+	MFRC522Ptr_t mfrc;
+	MFRC522_RetryPolicy policy; // Used by every operation of the session
+	Uid uid;					// As selected
+	uint8_t authCommand; // PICC_CMD_MF_AUTH_KEY_A or _B, 0 if not needed
+	uint8_t authBlock;	 // Any block of the authenticated sector
+	MIFARE_Key key;
+} MFRC522_RetrySession;
+
+// One attempt of an operation run by MFRC522_RetryRun()
+typedef StatusCode (*MFRC522_RetryOp)(MFRC522_RetrySession *session,
+									  void *context);
+
+/*******************************************************************************
+* Functions for retried operations
+*******************************************************************************/
+void MFRC522_RetryPolicyInit(MFRC522_RetryPolicy *policy);
+MFRC522_RetryAction MFRC522_RetryClassify(StatusCode status,
+										  bool authenticated);
+void MFRC522_RetryBegin(MFRC522_RetrySession *session, MFRC522Ptr_t mfrc,
+						const Uid *uid);
+StatusCode MFRC522_RetryRun(MFRC522_RetrySession *session,
+							MFRC522_RetryOp op, void *context);
+StatusCode MFRC522_RetryAuthenticate(MFRC522_RetrySession *session,
+									 uint8_t command, uint8_t blockAddr,
+									 MIFARE_Key *key);
+StatusCode MFRC522_RetryTransceive(MFRC522_RetrySession *session,
+								   uint8_t *sendData, uint8_t sendLen,
+								   uint8_t *backData, uint8_t *backLen,
+								   bool checkCRC);
+StatusCode MFRC522_RetryRead(MFRC522_RetrySession *session,
+							 uint8_t blockAddr, uint8_t *buffer,
+							 uint8_t *bufferSize);
+StatusCode MFRC522_RetryWrite(MFRC522_RetrySession *session,
+							  uint8_t blockAddr, uint8_t *buffer,
+							  uint8_t bufferSize);
+
+#endif
@@ -0,0 +1,1090 @@
+/**
+* Simulated MFRC522 and PICCs for the mfrc522 library for pi pico c/c++ sdk
+*/
+
+#include "mfrc522_sim.h"
+#include "mfrc522_tcl.h"
+
+// Register number of a PCD_Register
+#define SIM_REG(reg) ((reg) >> 1)
+// What the running command is doing
+#define SIM_PHASE_IDLE 0 // Nothing, or waiting for StartSend
+#define SIM_PHASE_TX 1	 // Sending the FIFO, phaseNs is when the next
+						 // uint8_t has left
+#define SIM_PHASE_WAIT 2 // Waiting for an answer or the timer
+#define SIM_PHASE_RX 3	 // Receiving, phaseNs is when the next uint8_t is in
+#define SIM_PHASE_AUTH 4 // MFAuthent, done at phaseNs
+// MIFARE Classic ACK and NAK, 4 bit answers
+#define SIM_ACK 0x0A
+#define SIM_NAK 0x04
+#define SIM_NAK_UL 0x00
+
+static bool SimBit(const uint8_t *data, uint16_t bit) {
+	return (data[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static void SimSetBit(uint8_t *data, uint16_t bit, bool value) {
+	if (value) {
+		data[bit >> 3] |= 1 << (bit & 7);
+	} else {
+		data[bit >> 3] &= ~(1 << (bit & 7));
+	}
+}
+
+/**
+ * Time one uint8_t with its parity bit takes on air at the bit rate in
+ * TxModeReg or RxModeReg, 128 / fc per bit at 106 kBd.
+ */
+static uint32_t MFRC522_SimByteNs(const MFRC522_Sim *sim, uint8_t modeReg) {
+	uint8_t speed = (sim->regs[SIM_REG(modeReg)] >> 4) & 0x07;
+	if (speed > PCD_BITRATE_848) {
+		speed = PCD_BITRATE_848;
+	}
+	return (9 * 9439) >> speed;
+}
+
+/**
+ * Period the timer is programmed for, TPrescalEven = 0 (datasheet section
+ * 8.5).
+ */
+static uint64_t MFRC522_SimTimerNs(const MFRC522_Sim *sim) {
+	uint32_t prescaler = ((sim->regs[SIM_REG(TModeReg)] & 0x0F) << 8) |
+						 sim->regs[SIM_REG(TPrescalerReg)];
+	uint32_t reload = (sim->regs[SIM_REG(TReloadRegH)] << 8) |
+					  sim->regs[SIM_REG(TReloadRegL)];
+	return (uint64_t)(reload + 1) * (2 * prescaler + 1) * 1000000000ULL /
+		   13560000;
+}
+
+/**
+ * Register values after a reset, datasheet chapter 9.
+ */
+static void MFRC522_SimReset(MFRC522_Sim *sim) {
+	memset(sim->regs, 0, sizeof(sim->regs));
+	sim->regs[SIM_REG(CommandReg)] = 0x20;
+	sim->regs[SIM_REG(ComIEnReg)] = 0x80;
+	sim->regs[SIM_REG(ComIrqReg)] = 0x14;
+	sim->regs[SIM_REG(Status1Reg)] = 0x21;
+	sim->regs[SIM_REG(WaterLevelReg)] = 0x08;
+	sim->regs[SIM_REG(ControlReg)] = 0x10;
+	sim->regs[SIM_REG(CollReg)] = 0xA0;
+	sim->regs[SIM_REG(ModeReg)] = 0x3F;
+	sim->regs[SIM_REG(TxControlReg)] = 0x80;
+	sim->regs[SIM_REG(TxSelReg)] = 0x10;
+	sim->regs[SIM_REG(RxSelReg)] = 0x84;
+	sim->regs[SIM_REG(RxThresholdReg)] = 0x84;
+	sim->regs[SIM_REG(DemodReg)] = 0x4D;
+	sim->regs[SIM_REG(MfTxReg)] = 0x62;
+	sim->regs[SIM_REG(SerialSpeedReg)] = 0xEB;
+	sim->regs[SIM_REG(CRCResultRegH)] = 0xFF;
+	sim->regs[SIM_REG(CRCResultRegL)] = 0xFF;
+	sim->regs[SIM_REG(ModWidthReg)] = 0x26;
+	sim->regs[SIM_REG(RFCfgReg)] = 0x48;
+	sim->regs[SIM_REG(GsNReg)] = 0x88;
+	sim->regs[SIM_REG(CWGsPReg)] = 0x20;
+	sim->regs[SIM_REG(ModGsPReg)] = 0x20;
+	sim->regs[SIM_REG(VersionReg)] = 0x92;
+	sim->fifoLen = 0;
+	sim->phase = SIM_PHASE_IDLE;
+	sim->timerNs = 0;
+}
+
+/**
+ * Sets up an empty field with the MFRC522 just out of reset.
+ */
+void MFRC522_SimInit(MFRC522_Sim *sim) {
+	memset(sim, 0, sizeof(*sim));
+	sim->spiHz = MFRC522_BIT_RATE;
+	sim->spiGapNs = MFRC522_SIM_SPI_GAP_NS;
+	MFRC522_SimReset(sim);
+} // End MFRC522_SimInit()
+
+/**
+ * Routes the register access of mfrc to sim and fills in config for
+ * PCD_InitWithConfig(): no SPI, no reset or IRQ pin.
+ */
+void MFRC522_SimAttach(MFRC522_Sim *sim, MFRC522Ptr_t mfrc,
+					   MFRC522_Config *config) {
+	PCD_SetTransport(mfrc, &MFRC522_SIM_TRANSPORT, sim);
+	MFRC522_GetDefaultConfig(config);
+	config->spi = NULL;
+	config->baudrate = sim->spiHz;
+	config->rstPin = -1;
+	config->irqPin = -1;
+} // End MFRC522_SimAttach()
+
+/**
+ * Puts a PICC in the field, in state IDLE with the memory it leaves the
+ * factory with: transport keys FFFFFFFFFFFF for a MIFARE Classic, an empty
+ * NDEF capability container for an NTAG21x.
+ *
+ * @return The PICC for the script to change, NULL if the field is full or
+ * uidSize does not suit the type.
+ */
+MFRC522_SimPicc *MFRC522_SimAddPicc(MFRC522_Sim *sim,
+									MFRC522_SimPiccType type,
+									const uint8_t *uid, uint8_t uidSize) {
+	static const uint8_t ntagPages[] = {0, 45, 135, 231};
+	static const uint8_t ntagStorage[] = {0, 0x0F, 0x11, 0x13};
+	static const uint8_t ntagCC[] = {0, 0x12, 0x3E, 0x6D};
+
+	if (sim->piccCount >= MFRC522_SIM_MAX_PICCS) {
+		return NULL;
+	}
+	if (type == SIM_PICC_MIFARE_1K || type == SIM_PICC_ISO14443_4
+			? (uidSize != 4 && uidSize != 7)
+			: uidSize != 7) {
+		return NULL;
+	}
+	MFRC522_SimPicc *picc = &sim->piccs[sim->piccCount++];
+	memset(picc, 0, sizeof(*picc));
+	picc->type = type;
+	picc->present = true;
+	picc->uidSize = uidSize;
+	memcpy(picc->uidByte, uid, uidSize);
+	picc->atqa[0] = uidSize == 4 ? 0x04 : 0x44;
+	picc->responseDelayUs = MFRC522_SIM_FDT_US;
+	picc->authSector = -1;
+
+	if (type == SIM_PICC_MIFARE_1K) {
+		picc->sak = 0x08;
+		picc->memorySize = 1024;
+		memcpy(picc->memory, uid, uidSize);
+		if (uidSize == 4) {
+			picc->memory[4] = uid[0] ^ uid[1] ^ uid[2] ^ uid[3];
+		}
+		picc->memory[5] = picc->sak;
+		for (uint8_t sector = 0; sector < 16; sector++) {
+			uint8_t *trailer = &picc->memory[(sector * 4 + 3) * 16];
+			memset(trailer, 0xFF, 16);
+			trailer[6] = 0xFF; // Transport configuration access bits
+			trailer[7] = 0x07;
+			trailer[8] = 0x80;
+			trailer[9] = 0x69;
+		}
+	} else if (type == SIM_PICC_ISO14443_4) {
+		// FSCI 5, 212 to 848 kBd in either direction, FWI 8, SFGI 0
+		const uint8_t ats[] = {0x05, 0x75, 0x77, 0x80, 0x00};
+		picc->sak = 0x20;
+		picc->memorySize = MFRC522_SIM_MEMORY_SIZE; // APDU and response
+		memcpy(picc->ats, ats, sizeof(ats));
+	} else {
+		uint8_t *page = picc->memory;
+		picc->sak = 0x00;
+		picc->memorySize = ntagPages[type] * 4;
+		page[0] = uid[0];
+		page[1] = uid[1];
+		page[2] = uid[2];
+		page[3] = PICC_CMD_CT ^ uid[0] ^ uid[1] ^ uid[2]; // BCC0
+		memcpy(&page[4], &uid[3], 4);
+		page[8] = uid[3] ^ uid[4] ^ uid[5] ^ uid[6]; // BCC1
+		page[9] = 0x48;
+		page[12] = 0xE1; // Capability container, NDEF version 1.0
+		page[13] = 0x10;
+		page[14] = ntagCC[type];
+		const uint8_t version[8] = {0x00, 0x04, 0x04, 0x02, 0x01,
+									0x00, ntagStorage[type], 0x03};
+		memcpy(picc->version, version, sizeof(version));
+	}
+	return picc;
+} // End MFRC522_SimAddPicc()
+
+/**
+ * Moves a PICC into or out of the field. Taking it out powers it down, it
+ * comes back in state IDLE.
+ */
+void MFRC522_SimSetPresent(MFRC522_SimPicc *picc, bool present) {
+	if (!present) {
+		picc->state = SIM_PICC_IDLE;
+		picc->authSector = -1;
+		picc->pending = 0;
+		picc->transferValid = false;
+		picc->dr = PCD_BITRATE_106;
+		picc->ds = PCD_BITRATE_106;
+		picc->responseLen = 0;
+		picc->wtxLeft = 0;
+	}
+	picc->present = present;
+} // End MFRC522_SimSetPresent()
+
+/**
+ * Queues a fault for the next answer a PICC sends. Faults are used up in
+ * the order they were queued, one per answer.
+ *
+ * @return false if MFRC522_SIM_MAX_FAULTS are already queued.
+ */
+bool MFRC522_SimInjectFault(MFRC522_Sim *sim, MFRC522_SimFault fault) {
+	if (sim->faultCount >= MFRC522_SIM_MAX_FAULTS) {
+		return false;
+	}
+	sim->faults[(sim->faultHead + sim->faultCount) % MFRC522_SIM_MAX_FAULTS] =
+		fault;
+	sim->faultCount++;
+	return true;
+} // End MFRC522_SimInjectFault()
+
+/**
+ * Lets virtual time pass without register accesses, for example for the
+ * host sleeping between two polls.
+ */
+void MFRC522_SimAdvanceUs(MFRC522_Sim *sim, uint64_t us) {
+	sim->nowNs += us * 1000;
+} // End MFRC522_SimAdvanceUs()
+
+/**
+ * @return The virtual time in microseconds since MFRC522_SimInit().
+ */
+uint64_t MFRC522_SimNowUs(const MFRC522_Sim *sim) {
+	return sim->nowNs / 1000;
+} // End MFRC522_SimNowUs()
+
+/*******************************************************************************
+* PICC model
+*******************************************************************************/
+
+static bool MFRC522_SimCheckCRC(const uint8_t *frame, uint16_t len) {
+	uint8_t crc[2];
+	if (len < 3) {
+		return false;
+	}
+	PCD_SoftwareCRC(frame, len - 2, crc);
+	return frame[len - 2] == crc[0] && frame[len - 1] == crc[1];
+}
+
+/**
+ * Appends the CRC_A to the len uint8_ts at out.
+ *
+ * @return The answer length in bits.
+ */
+static uint16_t MFRC522_SimWithCRC(uint8_t *out, uint16_t len) {
+	PCD_SoftwareCRC(out, len, &out[len]);
+	return (len + 2) * 8;
+}
+
+static uint16_t MFRC522_SimNak(uint8_t *out, uint8_t nak) {
+	out[0] = nak;
+	return 4;
+}
+
+/**
+ * The 5 uint8_ts a PICC answers with in cascade level level: UID part,
+ * cascade tag if more levels follow, and BCC.
+ *
+ * @return true if more cascade levels follow.
+ */
+static bool MFRC522_SimCascade(const MFRC522_SimPicc *picc, uint8_t level,
+							   uint8_t *cl) {
+	uint8_t levels = picc->uidSize == 4 ? 1 : picc->uidSize == 7 ? 2 : 3;
+	bool more = level + 1 < levels;
+	const uint8_t *part = &picc->uidByte[level * 3];
+	uint8_t i = 0;
+
+	if (more) {
+		cl[i++] = PICC_CMD_CT;
+	}
+	while (i < 4) {
+		cl[i++] = *part++;
+	}
+	cl[4] = cl[0] ^ cl[1] ^ cl[2] ^ cl[3];
+	return more;
+}
+
+/**
+ * ANTICOLLISION and SELECT in state READY.
+ *
+ * @return The answer length in bits, 0 for no answer.
+ */
+static uint16_t MFRC522_SimAnticollision(MFRC522_SimPicc *picc,
+										 const uint8_t *frame, uint16_t bits,
+										 uint8_t *out, uint16_t *offset) {
+	uint8_t cl[5];
+
+	if (bits < 16 || frame[0] != PICC_CMD_SEL_CL1 + 2 * picc->level) {
+		picc->state = SIM_PICC_IDLE;
+		return 0;
+	}
+	bool more = MFRC522_SimCascade(picc, picc->level, cl);
+	if (frame[1] == 0x70 && bits == 72) { // SELECT
+		if (!MFRC522_SimCheckCRC(frame, 9) || memcmp(&frame[2], cl, 5) != 0) {
+			return 0; // Another PICC is meant, stay READY
+		}
+		if (more) {
+			picc->level++;
+			out[0] = 0x04; // Cascade bit, UID not complete
+		} else {
+			picc->state = SIM_PICC_ACTIVE;
+			picc->authSector = -1;
+			picc->pending = 0;
+			out[0] = picc->sak;
+		}
+		return MFRC522_SimWithCRC(out, 1);
+	}
+
+	// ANTICOLLISION: NVB gives the number of valid bits sent
+	uint16_t known = bits - 16;
+	if (known >= 40 || ((frame[1] >> 4) - 2) * 8 + (frame[1] & 0x07) != known) {
+		return 0;
+	}
+	for (uint16_t i = 0; i < known; i++) {
+		if (SimBit(&frame[2], i) != SimBit(cl, i)) {
+			return 0;
+		}
+	}
+	memset(out, 0, 5);
+	for (uint16_t i = known; i < 40; i++) {
+		SimSetBit(out, i - known, SimBit(cl, i));
+	}
+	*offset = known;
+	return 40 - known;
+}
+
+static bool MFRC522_SimIsValueBlock(const uint8_t *block) {
+	for (uint8_t i = 0; i < 4; i++) {
+		if (block[i] != block[8 + i] || (block[i] ^ block[4 + i]) != 0xFF) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * MIFARE Classic 1K commands in state ACTIVE, CRC_A already checked.
+ *
+ * @return The answer length in bits, 0 for no answer.
+ */
+static uint16_t MFRC522_SimClassic(MFRC522_SimPicc *picc,
+								   const uint8_t *frame, uint16_t len,
+								   uint8_t *out) {
+	uint8_t command = frame[0];
+	uint8_t block = frame[1];
+
+	if (picc->pending) { // Second frame of a two step command
+		uint8_t pending = picc->pending;
+		uint8_t *target = &picc->memory[picc->pendingBlock * 16];
+		picc->pending = 0;
+		if (pending == PICC_CMD_MF_WRITE) {
+			if (len != 18) {
+				return MFRC522_SimNak(out, SIM_NAK);
+			}
+			memcpy(target, frame, 16);
+			return MFRC522_SimNak(out, SIM_ACK);
+		}
+		if (len != 6) {
+			return MFRC522_SimNak(out, SIM_NAK);
+		}
+		int32_t value, delta;
+		memcpy(&value, target, 4); // Little endian like the Pico and PCs
+		memcpy(&delta, frame, 4);
+		if (pending == PICC_CMD_MF_INCREMENT) {
+			value += delta;
+		} else if (pending == PICC_CMD_MF_DECREMENT) {
+			value -= delta;
+		}
+		picc->transferValue = value;
+		picc->transferValid = true;
+		return 0; // Value operations are not acknowledged
+	}
+
+	if (len != 4 || block >= 64) {
+		return len == 4 ? MFRC522_SimNak(out, SIM_NAK) : 0;
+	}
+	if (picc->authSector != block / 4) {
+		return MFRC522_SimNak(out, SIM_NAK);
+	}
+	uint8_t *data = &picc->memory[block * 16];
+	switch (command) {
+	case PICC_CMD_MF_READ:
+		memcpy(out, data, 16);
+		return MFRC522_SimWithCRC(out, 16);
+	case PICC_CMD_MF_WRITE:
+		picc->pending = command;
+		picc->pendingBlock = block;
+		return MFRC522_SimNak(out, SIM_ACK);
+	case PICC_CMD_MF_DECREMENT:
+	case PICC_CMD_MF_INCREMENT:
+	case PICC_CMD_MF_RESTORE:
+		if (block % 4 == 3 || !MFRC522_SimIsValueBlock(data)) {
+			return MFRC522_SimNak(out, SIM_NAK);
+		}
+		picc->pending = command;
+		picc->pendingBlock = block;
+		return MFRC522_SimNak(out, SIM_ACK);
+	case PICC_CMD_MF_TRANSFER:
+		if (block % 4 == 3 || !picc->transferValid) {
+			return MFRC522_SimNak(out, SIM_NAK);
+		}
+		memcpy(&data[0], &picc->transferValue, 4);
+		memcpy(&data[8], &picc->transferValue, 4);
+		for (uint8_t i = 0; i < 4; i++) {
+			data[4 + i] = ~data[i];
+		}
+		picc->transferValid = false;
+		return MFRC522_SimNak(out, SIM_ACK);
+	default:
+		return MFRC522_SimNak(out, SIM_NAK);
+	}
+}
+
+/**
+ * NTAG21x commands in state ACTIVE, CRC_A already checked.
+ *
+ * @return The answer length in bits, 0 for no answer.
+ */
+static uint16_t MFRC522_SimNtag(MFRC522_SimPicc *picc, const uint8_t *frame,
+								uint16_t len, uint8_t *out) {
+	uint16_t pages = picc->memorySize / 4;
+
+	if (picc->pending == PICC_CMD_MF_WRITE) { // COMPATIBILITY WRITE data
+		picc->pending = 0;
+		if (len != 18) {
+			return MFRC522_SimNak(out, SIM_NAK_UL);
+		}
+		memcpy(&picc->memory[picc->pendingBlock * 4], frame, 4);
+		return MFRC522_SimNak(out, SIM_ACK);
+	}
+
+	switch (frame[0]) {
+	case 0x60: // GET_VERSION
+		if (len != 3) {
+			break;
+		}
+		memcpy(out, picc->version, 8);
+		return MFRC522_SimWithCRC(out, 8);
+	case PICC_CMD_MF_READ: // Four pages, rolling over at the end
+		if (len != 4 || frame[1] >= pages) {
+			break;
+		}
+		for (uint8_t i = 0; i < 16; i++) {
+			out[i] = picc->memory[((frame[1] + i / 4) % pages) * 4 + i % 4];
+		}
+		return MFRC522_SimWithCRC(out, 16);
+	case PICC_CMD_UL_FAST_READ:
+		if (len != 5 || frame[1] > frame[2] || frame[2] >= pages ||
+			frame[2] - frame[1] >= NTAG_FAST_READ_MAX_PAGES) {
+			break;
+		}
+		memcpy(out, &picc->memory[frame[1] * 4], (frame[2] - frame[1] + 1) * 4);
+		return MFRC522_SimWithCRC(out, (frame[2] - frame[1] + 1) * 4);
+	case PICC_CMD_UL_WRITE:
+		if (len != 8 || frame[1] < 2 || frame[1] >= pages) {
+			break;
+		}
+		memcpy(&picc->memory[frame[1] * 4], &frame[2], 4);
+		return MFRC522_SimNak(out, SIM_ACK);
+	case PICC_CMD_MF_WRITE:
+		if (len != 4 || frame[1] < 2 || frame[1] >= pages) {
+			break;
+		}
+		picc->pending = PICC_CMD_MF_WRITE;
+		picc->pendingBlock = frame[1];
+		return MFRC522_SimNak(out, SIM_ACK);
+	default:
+		break;
+	}
+	return MFRC522_SimNak(out, SIM_NAK_UL);
+}
+
+/**
+ * The I-block of the response in memory[] that starts at responseSent, as
+ * long as the FSD allows.
+ *
+ * @return The answer length in bits.
+ */
+static uint16_t MFRC522_SimTclResponse(MFRC522_SimPicc *picc, uint8_t *out) {
+	uint16_t left = picc->responseLen - picc->responseSent;
+	bool more = left > picc->fsd - 3;
+
+	picc->blockLen = more ? picc->fsd - 3 : left;
+	out[0] = TCL_PCB_I_BLOCK | picc->blockNumber |
+			 (more ? TCL_PCB_CHAINING : 0);
+	memcpy(&out[1], &picc->memory[picc->responseSent], picc->blockLen);
+	return MFRC522_SimWithCRC(out, picc->blockLen + 1);
+}
+
+/**
+ * ISO/IEC 14443-4 PICC in states ACTIVE and PROTOCOL, CRC_A already checked.
+ * Blocks follow the rules of ISO/IEC 14443-4 part 7.5.4, without CID and
+ * NAD. The APDU is collected in memory[] and answered there, with
+ * wtxRequests S(WTX) first.
+ *
+ * @return The answer length in bits, 0 for no answer.
+ */
+static uint16_t MFRC522_SimTcl(MFRC522_SimPicc *picc, const uint8_t *frame,
+							   uint16_t len, uint8_t *out) {
+	static const uint16_t fsdTable[9] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+	uint8_t pcb = frame[0];
+	uint16_t inf = len - 3; // Between PCB and CRC_A
+	bool ppsAllowed = picc->ppsAllowed;
+
+	if (picc->state == SIM_PICC_ACTIVE) {
+		if (pcb != TCL_CMD_RATS || len != 4) {
+			return 0;
+		}
+		picc->fsd = fsdTable[(frame[1] >> 4) > 8 ? 8 : frame[1] >> 4];
+		picc->state = SIM_PICC_PROTOCOL;
+		picc->ppsAllowed = true;
+		picc->blockNumber = 1; // Rule C
+		picc->apduLen = 0;
+		picc->responseLen = 0;
+		picc->wtxLeft = 0;
+		memcpy(out, picc->ats, picc->ats[0]);
+		return MFRC522_SimWithCRC(out, picc->ats[0]);
+	}
+
+	picc->ppsAllowed = false;
+	if (pcb == TCL_CMD_PPS) {
+		if (!ppsAllowed || len != 5 || frame[1] != 0x11) {
+			return 0;
+		}
+		picc->dr = frame[2] & 0x03; // In force after the answer
+		picc->ds = (frame[2] >> 2) & 0x03;
+		out[0] = TCL_CMD_PPS;
+		return MFRC522_SimWithCRC(out, 1);
+	}
+	if (pcb == TCL_PCB_S_DESELECT && len == 3) {
+		picc->state = SIM_PICC_HALT;
+		picc->dr = PCD_BITRATE_106;
+		picc->ds = PCD_BITRATE_106;
+		out[0] = TCL_PCB_S_DESELECT;
+		return MFRC522_SimWithCRC(out, 1);
+	}
+
+	if ((pcb & 0xE2) == TCL_PCB_I_BLOCK) {
+		picc->blockNumber = pcb & 0x01; // Rule D
+		picc->responseLen = 0;
+		if (picc->apduLen + inf > sizeof(picc->memory) - 2) {
+			picc->apduLen = 0;
+			return 0;
+		}
+		memcpy(&picc->memory[picc->apduLen], &frame[1], inf);
+		picc->apduLen += inf;
+		if (!(pcb & TCL_PCB_CHAINING)) {
+			picc->memory[picc->apduLen++] = 0x90; // SW1 SW2
+			picc->memory[picc->apduLen++] = 0x00;
+			picc->responseLen = picc->apduLen;
+			picc->responseSent = 0;
+			picc->apduLen = 0;
+			picc->wtxLeft = picc->wtxRequests;
+		}
+	} else if (pcb == TCL_PCB_S_WTX && len == 4 && picc->wtxLeft) {
+		picc->wtxLeft--; // Granted
+	} else if ((pcb & 0xE6) == TCL_PCB_R_ACK && len == 3) {
+		if ((pcb & 0x01) != picc->blockNumber) {
+			if (pcb & 0x10) { // Rule 12: R(NAK) is answered with R(ACK)
+				out[0] = TCL_PCB_R_ACK | picc->blockNumber;
+				return MFRC522_SimWithCRC(out, 1);
+			}
+			if (!picc->responseLen ||
+				picc->responseSent + picc->blockLen >= picc->responseLen) {
+				return 0;
+			}
+			picc->blockNumber ^= 1; // Rule 13: the next chained block
+			picc->responseSent += picc->blockLen;
+		} // Rule 11: otherwise the last block again
+	} else {
+		return 0;
+	}
+
+	if (picc->wtxLeft) {
+		out[0] = TCL_PCB_S_WTX;
+		out[1] = 0x01; // WTXM
+		return MFRC522_SimWithCRC(out, 2);
+	}
+	if (!picc->responseLen) { // The PCD is chaining
+		out[0] = TCL_PCB_R_ACK | picc->blockNumber;
+		return MFRC522_SimWithCRC(out, 1);
+	}
+	return MFRC522_SimTclResponse(picc, out);
+}
+
+/**
+ * What one PICC answers to the frame of bits bits the PCD has sent.
+ *
+ * @return The answer length in bits, 0 for no answer. *offset is the
+ * number of UID bits before the answer for ANTICOLLISION, where the
+ * MFRC522 reports collision positions relative to the cascade level.
+ */
+static uint16_t MFRC522_SimPiccAnswer(MFRC522_SimPicc *picc,
+									  const uint8_t *frame, uint16_t bits,
+									  uint8_t *out, uint16_t *offset) {
+	uint16_t len = (bits + 7) / 8;
+
+	*offset = 0;
+	if (!picc->present) {
+		return 0;
+	}
+	if (bits == 7) { // Short frame
+		bool wake = frame[0] == PICC_CMD_WUPA;
+		if ((frame[0] == PICC_CMD_REQA || wake) &&
+			(picc->state == SIM_PICC_IDLE ||
+			 (wake && picc->state == SIM_PICC_HALT))) {
+			picc->state = SIM_PICC_READY;
+			picc->level = 0;
+			memcpy(out, picc->atqa, 2);
+			return 16;
+		}
+		if (picc->state == SIM_PICC_READY || picc->state == SIM_PICC_ACTIVE) {
+			picc->state = SIM_PICC_IDLE; // Not expected in these states
+		}
+		return 0;
+	}
+
+	switch (picc->state) {
+	case SIM_PICC_READY:
+		return MFRC522_SimAnticollision(picc, frame, bits, out, offset);
+	case SIM_PICC_ACTIVE:
+		if (bits % 8 || !MFRC522_SimCheckCRC(frame, len)) {
+			return 0;
+		}
+		if (frame[0] == PICC_CMD_HLTA && len == 4 && frame[1] == 0x00 &&
+			!picc->pending) {
+			picc->state = SIM_PICC_HALT;
+			return 0;
+		}
+		if (picc->type == SIM_PICC_ISO14443_4) {
+			return MFRC522_SimTcl(picc, frame, len, out);
+		}
+		if (picc->type == SIM_PICC_MIFARE_1K) {
+			return MFRC522_SimClassic(picc, frame, len, out);
+		}
+		return MFRC522_SimNtag(picc, frame, len, out);
+	case SIM_PICC_PROTOCOL:
+		if (bits % 8 || !MFRC522_SimCheckCRC(frame, len)) {
+			return 0;
+		}
+		return MFRC522_SimTcl(picc, frame, len, out);
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Collects the answers of all PICCs to the frame in tx[] and lays them out
+ * in rx[] the way the MFRC522 receives them, colliding bits included.
+ * Only PICCs at the bit rates of TxModeReg and RxModeReg take part. The
+ * frame delay time of the first PICC that answered stands for all of them.
+ *
+ * @return false if nothing was answered.
+ */
+static bool MFRC522_SimAnswer(MFRC522_Sim *sim, uint32_t *delayUs) {
+	// Shared by all simulators, they are only ever driven from one core
+	static uint8_t answers[MFRC522_SIM_MAX_PICCS][MFRC522_SIM_MAX_FRAME];
+	uint16_t lengths[MFRC522_SIM_MAX_PICCS];
+	uint8_t txLastBits = sim->regs[SIM_REG(BitFramingReg)] & 0x07;
+	uint8_t rxAlign = (sim->regs[SIM_REG(BitFramingReg)] >> 4) & 0x07;
+	uint16_t bits = sim->txLen * 8 - (txLastBits ? 8 - txLastBits : 0);
+	uint8_t txMode = sim->regs[SIM_REG(TxModeReg)];
+	uint8_t rxMode = sim->regs[SIM_REG(RxModeReg)];
+	uint16_t offset = 0, longest = 0;
+	uint8_t responders = 0, first = 0;
+
+	if (sim->txLen == 0) {
+		return false;
+	}
+	for (uint8_t i = 0; i < sim->piccCount; i++) {
+		uint16_t known = 0;
+		lengths[i] = 0;
+		if (((txMode >> 4) & 0x07) == sim->piccs[i].dr &&
+			((rxMode >> 4) & 0x07) == sim->piccs[i].ds) {
+			lengths[i] = MFRC522_SimPiccAnswer(&sim->piccs[i], sim->tx, bits,
+											   answers[i], &known);
+		}
+		if (lengths[i]) {
+			if (responders++ == 0) {
+				first = i;
+				offset = known;
+			}
+			if (lengths[i] > longest) {
+				longest = lengths[i];
+			}
+		}
+	}
+	if (responders == 0) {
+		return false;
+	}
+	*delayUs = sim->piccs[first].responseDelayUs;
+
+	sim->rxErrors = 0;
+	if (sim->faultCount) {
+		MFRC522_SimFault fault = sim->faults[sim->faultHead];
+		sim->faultHead = (sim->faultHead + 1) % MFRC522_SIM_MAX_FAULTS;
+		sim->faultCount--;
+		if (fault == SIM_FAULT_TIMEOUT) {
+			return false;
+		}
+		if (fault == SIM_FAULT_CRC) {
+			for (uint8_t i = 0; i < sim->piccCount; i++) {
+				if (lengths[i] >= 8) {
+					answers[i][lengths[i] / 8 - 1] ^= 0x01;
+				}
+			}
+		} else {
+			sim->rxErrors |= 0x02; // ParityErr
+		}
+	}
+	// TxCRCEn and RxCRCEn may only be cleared at 106 kBd, the model fails
+	// the exchange otherwise
+	if (((txMode & 0x70) && !(txMode & 0x80)) ||
+		((rxMode & 0x70) && !(rxMode & 0x80))) {
+		sim->rxErrors |= 0x01; // ProtocolErr
+	}
+
+	// Superimpose the answers bit by bit. A collision is any bit the PICCs
+	// disagree on, or that only some of them send.
+	bool keepAfterColl = sim->regs[SIM_REG(CollReg)] & 0x80;
+	int collision = -1;
+	memset(sim->rx, 0, sizeof(sim->rx));
+	for (uint16_t j = 0; j < longest; j++) {
+		bool value = SimBit(answers[first], j) && j < lengths[first];
+		bool differ = false;
+		for (uint8_t i = first + 1; i < sim->piccCount; i++) {
+			if (lengths[i] == 0) {
+				continue;
+			}
+			bool other = j < lengths[i] && SimBit(answers[i], j);
+			differ |= other != value || (j < lengths[i]) != (j < lengths[first]);
+			value |= other;
+		}
+		if (differ && collision < 0) {
+			collision = j;
+		}
+		if (collision >= 0 && !keepAfterColl) {
+			value = false; // ValuesAfterColl = 0 clears them
+		}
+		SimSetBit(sim->rx, rxAlign + j, value);
+	}
+
+	sim->rxLen = (rxAlign + longest + 7) / 8;
+	sim->rxLastBits = (rxAlign + longest) % 8;
+	sim->rxCollReg = 0x20; // CollPosNotValid
+	if (collision >= 0) {
+		uint16_t position = offset + collision + 1;
+		sim->rxErrors |= 0x08; // CollErr
+		sim->rxCollReg = position <= 32 ? (position & 0x1F) : 0x20;
+	}
+
+	// RxCRCEn: the MFRC522 checks the CRC_A and keeps it out of the FIFO
+	sim->rxStrip = 0;
+	if (rxMode & 0x80) {
+		if (sim->rxLastBits || rxAlign ||
+			!MFRC522_SimCheckCRC(sim->rx, sim->rxLen)) {
+			sim->rxErrors |= 0x04; // CRCErr
+		}
+		sim->rxStrip = sim->rxLen < 2 ? sim->rxLen : 2;
+	}
+	return true;
+}
+
+/*******************************************************************************
+* MFRC522 model
+*******************************************************************************/
+
+static void MFRC522_SimPush(MFRC522_Sim *sim, uint8_t value) {
+	if (sim->fifoLen >= sizeof(sim->fifo)) {
+		sim->regs[SIM_REG(ErrorReg)] |= 0x10; // BufferOvfl
+		return;
+	}
+	sim->fifo[sim->fifoLen++] = value;
+}
+
+static uint8_t MFRC522_SimPop(MFRC522_Sim *sim) {
+	if (sim->fifoLen == 0) {
+		return 0;
+	}
+	uint8_t value = sim->fifo[0];
+	memmove(sim->fifo, &sim->fifo[1], --sim->fifoLen);
+	return value;
+}
+
+/**
+ * LoAlert and HiAlert in Status1Reg and ComIrqReg follow the FIFO level.
+ * The interrupt bits stay set until cleared, and cannot be cleared while
+ * the condition lasts.
+ */
+static void MFRC522_SimUpdateAlerts(MFRC522_Sim *sim) {
+	uint8_t water = sim->regs[SIM_REG(WaterLevelReg)] & 0x3F;
+	uint8_t status = sim->regs[SIM_REG(Status1Reg)] & ~0x0B;
+
+	if (sim->fifoLen <= water) {
+		status |= 0x01;
+		sim->regs[SIM_REG(ComIrqReg)] |= 0x04;
+	}
+	if (sizeof(sim->fifo) - sim->fifoLen <= water) {
+		status |= 0x02;
+		sim->regs[SIM_REG(ComIrqReg)] |= 0x08;
+	}
+	if (sim->timerNs) {
+		status |= 0x08; // TRunning
+	}
+	sim->regs[SIM_REG(Status1Reg)] = status;
+}
+
+/**
+ * End of the PCD frame at endNs: start the timer and schedule the answer.
+ */
+static void MFRC522_SimEndTx(MFRC522_Sim *sim, uint64_t endNs) {
+	sim->regs[SIM_REG(ComIrqReg)] |= 0x40; // TxIRq
+	sim->timerNs = 0;
+	if (sim->regs[SIM_REG(TModeReg)] & 0x80) { // TAuto
+		sim->timerNs = endNs + MFRC522_SimTimerNs(sim);
+	}
+	sim->phase = SIM_PHASE_WAIT;
+	uint32_t delayUs;
+	if (!MFRC522_SimAnswer(sim, &delayUs)) {
+		return;
+	}
+	uint64_t startNs = endNs + delayUs * 1000ULL;
+	if (sim->timerNs && startNs >= sim->timerNs) {
+		return; // Too late, the timer fires first
+	}
+	sim->timerNs = 0; // Stopped by the first bit received
+	sim->rxDone = 0;
+	sim->phase = SIM_PHASE_RX;
+	sim->phaseNs = startNs + MFRC522_SimByteNs(sim, RxModeReg);
+}
+
+/**
+ * Lets the running command make the progress due by the current virtual
+ * time.
+ */
+static void MFRC522_SimStep(MFRC522_Sim *sim) {
+	if (sim->phase == SIM_PHASE_TX) {
+		uint32_t byteNs = MFRC522_SimByteNs(sim, TxModeReg);
+		while (sim->phase == SIM_PHASE_TX && sim->nowNs >= sim->phaseNs) {
+			if (sim->txLen < sizeof(sim->tx)) {
+				sim->tx[sim->txLen++] = MFRC522_SimPop(sim);
+			}
+			if (sim->fifoLen == 0) { // Nothing left, the frame ends here
+				uint64_t endNs = sim->phaseNs;
+				if ((sim->regs[SIM_REG(TxModeReg)] & 0x80) && // TxCRCEn
+					sim->txLen + 2 <= sizeof(sim->tx)) {
+					PCD_SoftwareCRC(sim->tx, sim->txLen, &sim->tx[sim->txLen]);
+					sim->txLen += 2;
+					endNs += 2 * byteNs;
+				}
+				MFRC522_SimEndTx(sim, endNs);
+			} else {
+				sim->phaseNs += byteNs;
+			}
+		}
+	}
+	if (sim->phase == SIM_PHASE_RX) {
+		uint32_t byteNs = MFRC522_SimByteNs(sim, RxModeReg);
+		while (sim->rxDone < sim->rxLen && sim->nowNs >= sim->phaseNs) {
+			uint8_t value = sim->rx[sim->rxDone++];
+			if (sim->rxDone + sim->rxStrip <= sim->rxLen) {
+				MFRC522_SimPush(sim, value);
+			}
+			sim->phaseNs += byteNs;
+		}
+		if (sim->rxDone == sim->rxLen) {
+			sim->regs[SIM_REG(ErrorReg)] |= sim->rxErrors;
+			sim->regs[SIM_REG(CollReg)] =
+				(sim->regs[SIM_REG(CollReg)] & 0x80) | sim->rxCollReg;
+			sim->regs[SIM_REG(ControlReg)] = 0x10 | sim->rxLastBits;
+			sim->regs[SIM_REG(ComIrqReg)] |= 0x20; // RxIRq
+			sim->phase = SIM_PHASE_IDLE;
+		}
+	}
+	if (sim->phase == SIM_PHASE_AUTH && sim->nowNs >= sim->phaseNs) {
+		if (sim->authOk) {
+			sim->regs[SIM_REG(Status2Reg)] |= 0x08; // MFCrypto1On
+			sim->regs[SIM_REG(ComIrqReg)] |= 0x10;	// IdleIRq
+			sim->regs[SIM_REG(CommandReg)] &= ~0x0F;
+			sim->phase = SIM_PHASE_IDLE;
+		} else { // The PICC stops answering, only the timer ends this
+			sim->phase = SIM_PHASE_WAIT;
+			sim->timerNs = sim->phaseNs + MFRC522_SimTimerNs(sim);
+		}
+	}
+	if (sim->timerNs && sim->nowNs >= sim->timerNs) {
+		sim->regs[SIM_REG(ComIrqReg)] |= 0x01; // TimerIRq
+		sim->timerNs = 0;
+		if (sim->phase == SIM_PHASE_WAIT) {
+			sim->phase = SIM_PHASE_IDLE;
+		}
+	}
+	MFRC522_SimUpdateAlerts(sim);
+}
+
+/**
+ * MFAuthent with the 12 uint8_ts in the FIFO: command, block, key, UID.
+ * Only the key is checked, against the sector trailer of the ACTIVE PICC.
+ */
+static void MFRC522_SimAuthenticate(MFRC522_Sim *sim) {
+	uint8_t data[12] = {0};
+	MFRC522_SimPicc *picc = NULL;
+
+	for (uint8_t i = 0; i < sizeof(data) && sim->fifoLen; i++) {
+		data[i] = MFRC522_SimPop(sim);
+	}
+	for (uint8_t i = 0; i < sim->piccCount; i++) {
+		if (sim->piccs[i].present && sim->piccs[i].state == SIM_PICC_ACTIVE &&
+			sim->piccs[i].type == SIM_PICC_MIFARE_1K) {
+			picc = &sim->piccs[i];
+			break;
+		}
+	}
+	sim->authOk = false;
+	if (picc && data[1] < 64) {
+		uint8_t sector = data[1] / 4;
+		const uint8_t *trailer = &picc->memory[(sector * 4 + 3) * 16];
+		const uint8_t *key =
+			data[0] == PICC_CMD_MF_AUTH_KEY_A ? trailer : &trailer[10];
+		sim->authOk = (data[0] == PICC_CMD_MF_AUTH_KEY_A ||
+					   data[0] == PICC_CMD_MF_AUTH_KEY_B) &&
+					  memcmp(key, &data[2], MF_KEY_SIZE) == 0;
+		if (sim->authOk) {
+			picc->authSector = sector;
+		} else {
+			picc->state = SIM_PICC_IDLE; // A failed authentication ends
+										 // the session
+		}
+	}
+	sim->phase = SIM_PHASE_AUTH;
+	sim->phaseNs = sim->nowNs + MFRC522_SIM_AUTH_US * 1000ULL;
+}
+
+static void MFRC522_SimCommand(MFRC522_Sim *sim, uint8_t value) {
+	uint8_t command = value & 0x0F;
+
+	if (command == PCD_SoftReset) {
+		MFRC522_SimReset(sim);
+		return;
+	}
+	if (command == PCD_NoCmdChange) {
+		command = sim->regs[SIM_REG(CommandReg)] & 0x0F;
+	}
+	sim->regs[SIM_REG(CommandReg)] = (value & 0x30) | command;
+	sim->phase = SIM_PHASE_IDLE;
+	sim->timerNs = 0;
+
+	switch (command) {
+	case PCD_Mem: // The 25 uint8_ts go to a buffer nobody reads back
+		for (uint8_t i = 0; i < 25 && sim->fifoLen; i++) {
+			MFRC522_SimPop(sim);
+		}
+		sim->regs[SIM_REG(CommandReg)] &= ~0x0F;
+		sim->regs[SIM_REG(ComIrqReg)] |= 0x10; // IdleIRq
+		break;
+	case PCD_CalcCRC:
+		if ((sim->regs[SIM_REG(AutoTestReg)] & 0x0F) == PCD_EnableSelfTest) {
+			sim->fifoLen = 0;
+			for (uint8_t i = 0; i < sizeof(SELF_TEST_BYTES); i++) {
+				MFRC522_SimPush(sim, SELF_TEST_BYTES[i]);
+			}
+		} else {
+			uint8_t crc[2];
+			PCD_SoftwareCRC(sim->fifo, sim->fifoLen, crc);
+			sim->regs[SIM_REG(CRCResultRegL)] = crc[0];
+			sim->regs[SIM_REG(CRCResultRegH)] = crc[1];
+			sim->fifoLen = 0;
+		}
+		sim->regs[SIM_REG(DivIrqReg)] |= 0x04; // CRCIRq
+		break;
+	case PCD_MFAuthent:
+		sim->regs[SIM_REG(ErrorReg)] = 0;
+		MFRC522_SimAuthenticate(sim);
+		break;
+	default: // Transceive waits for StartSend
+		break;
+	}
+}
+
+static void MFRC522_SimWriteRegister(MFRC522_Sim *sim, uint8_t reg,
+									 uint8_t value) {
+	uint8_t *r = &sim->regs[SIM_REG(reg)];
+
+	switch (reg) {
+	case CommandReg:
+		MFRC522_SimCommand(sim, value);
+		return;
+	case ComIrqReg:
+	case DivIrqReg:
+		if (value & 0x80) { // Set1
+			*r |= value & 0x7F;
+		} else {
+			*r &= ~value;
+		}
+		break;
+	case FIFODataReg:
+		MFRC522_SimPush(sim, value);
+		break;
+	case FIFOLevelReg:
+		if (value & 0x80) { // FlushBuffer
+			sim->fifoLen = 0;
+			sim->regs[SIM_REG(ErrorReg)] &= ~0x10;
+		}
+		break;
+	case BitFramingReg:
+		*r = value & 0x7F;
+		if ((value & 0x80) &&
+			(sim->regs[SIM_REG(CommandReg)] & 0x0F) == PCD_Transceive) {
+			sim->regs[SIM_REG(ErrorReg)] = 0;
+			sim->txLen = 0;
+			sim->frames++;
+			sim->phase = SIM_PHASE_TX;
+			sim->phaseNs = sim->nowNs + MFRC522_SimByteNs(sim, TxModeReg);
+		}
+		break;
+	case Status2Reg: // MFCrypto1On can only be cleared
+		*r = (value & 0xC0) | (*r & value & 0x08) | (*r & 0x07);
+		break;
+	case CollReg:
+		*r = (value & 0x80) | (*r & 0x7F);
+		break;
+	case ErrorReg:
+	case Status1Reg:
+	case ControlReg:
+	case VersionReg:
+		break; // Read-only here
+	default:
+		*r = value;
+		break;
+	}
+	MFRC522_SimUpdateAlerts(sim);
+}
+
+static uint8_t MFRC522_SimReadRegister(MFRC522_Sim *sim, uint8_t reg) {
+	switch (reg) {
+	case FIFODataReg: {
+		uint8_t value = MFRC522_SimPop(sim);
+		MFRC522_SimUpdateAlerts(sim);
+		return value;
+	}
+	case FIFOLevelReg:
+		return sim->fifoLen;
+	default:
+		return sim->regs[SIM_REG(reg)];
+	}
+}
+
+/**
+ * Time of one chip select frame of count + 1 uint8_ts.
+ */
+static void MFRC522_SimSpiFrame(MFRC522_Sim *sim, uint8_t count) {
+	sim->nowNs += sim->spiGapNs + (count + 1) * 8000000000ULL / sim->spiHz;
+	sim->spiTransactions++;
+	MFRC522_SimStep(sim);
+}
+
+static void MFRC522_SimWrite(void *context, uint8_t reg,
+							 const uint8_t *values, uint8_t count) {
+	MFRC522_Sim *sim = context;
+	MFRC522_SimSpiFrame(sim, count);
+	for (uint8_t i = 0; i < count; i++) {
+		MFRC522_SimWriteRegister(sim, reg & 0x7E, values[i]);
+	}
+}
+
+static void MFRC522_SimRead(void *context, uint8_t reg, uint8_t *values,
+							uint8_t count) {
+	MFRC522_Sim *sim = context;
+	MFRC522_SimSpiFrame(sim, count);
+	for (uint8_t i = 0; i < count; i++) {
+		values[i] = MFRC522_SimReadRegister(sim, reg & 0x7E);
+	}
+}
+
+const PCD_Transport MFRC522_SIM_TRANSPORT = {
+	MFRC522_SimWrite, MFRC522_SimRead, NULL, NULL, NULL};
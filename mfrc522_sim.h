@@ -0,0 +1,156 @@
+/*
+ * mfrc522_sim.h
+ *
+ * Simulated MFRC522 and PICCs for the mfrc522 library for pi pico c/c++ sdk
+ *
+ * A PCD_Transport that answers register accesses the way an MFRC522 with
+ * scripted PICCs in its field would, so that the library can be exercised
+ * and timed without a reader: on the Pico itself, or on a PC with the SDK's
+ * host platform (PICO_PLATFORM=host).
+ * The chip model covers the FIFO with its water level alerts, Transceive
+ * with bit-oriented frames and collisions, MFAuthent, CalcCRC, the timer and
+ * the self test, and the bit rates up to 848 kBd with the CRC_A the MFRC522
+ * adds and checks itself above 106 kBd. PICCs follow the ISO/IEC 14443-3
+ * state machine and answer MIFARE Classic 1K or NTAG21x commands from their
+ * memory, or ISO/IEC 14443-4 blocks. Crypto1 is not modelled, frames stay
+ * in the clear after an authentication.
+ *
+ * Time is virtual. Every register access and every frame on air advances a
+ * clock by what it takes on a real reader, see MFRC522_SimNowUs().
+ *
+ */
+
+#ifndef MFRC522_SIM_h
+#define MFRC522_SIM_h
+
+#include "mfrc522.h"
+
+/*******************************************************************************
+ * Types/enumerations/variables
+ ******************************************************************************/
+// PICCs one simulated field can hold
+#define MFRC522_SIM_MAX_PICCS 8
+// Largest PICC memory, a MIFARE Classic 1K
+#define MFRC522_SIM_MEMORY_SIZE 1024
+// Longest ATS a PICC can be given, TL included
+#define MFRC522_SIM_MAX_ATS 16
+// Faults MFRC522_SimInjectFault() can queue
+#define MFRC522_SIM_MAX_FAULTS 16
+// Longest frame in either direction: 64 FAST_READ pages plus CRC_A
+#define MFRC522_SIM_MAX_FRAME 260
+// Frame delay time from the end of a PCD frame to the PICC answer,
+// (9 * 128 + 84) / fc (ISO/IEC 14443-3 part 6.2.1.1)
+#define MFRC522_SIM_FDT_US 92
+// MFAuthent: the four frames the MFRC522 exchanges on its own
+#define MFRC522_SIM_AUTH_US 2100
+// Cost of one chip select frame besides the clocked bits
+#define MFRC522_SIM_SPI_GAP_NS 1000
+
+// PICCs the simulator knows how to answer for
+typedef enum _MFRC522_SimPiccType {
+	SIM_PICC_MIFARE_1K, // SAK 0x08, 4 or 7 byte UID
+	SIM_PICC_NTAG213,	// SAK 0x00, 7 byte UID, 45 pages
+	SIM_PICC_NTAG215,	// 135 pages
+	SIM_PICC_NTAG216,	// 231 pages
+	SIM_PICC_ISO14443_4 // SAK 0x20, 4 or 7 byte UID, answers each APDU with
+						// the APDU itself and SW 9000
+} MFRC522_SimPiccType;
+
+// ISO/IEC 14443-3 PICC states
+typedef enum _MFRC522_SimPiccState {
+	SIM_PICC_IDLE,
+	SIM_PICC_READY,
+	SIM_PICC_ACTIVE,
+	SIM_PICC_HALT,
+	SIM_PICC_PROTOCOL // ISO/IEC 14443-4, after RATS
+} MFRC522_SimPiccState;
+
+// Disturbances applied to the next PICC answers, see MFRC522_SimInjectFault()
+typedef enum _MFRC522_SimFault {
+	SIM_FAULT_TIMEOUT, // The answer is lost
+	SIM_FAULT_CRC,	   // One bit of the last uint8_t is flipped
+	SIM_FAULT_PARITY   // The MFRC522 reports a parity error
+} MFRC522_SimFault;
+
+// One PICC. Everything up to memory[] may be changed by the test script.
+typedef struct {
+	MFRC522_SimPiccType type;
+	bool present; // In the field, see MFRC522_SimSetPresent()
+	uint8_t uidSize;
+	uint8_t uidByte[10];
+	uint8_t sak;
+	uint8_t atqa[2];
+	uint8_t version[8];		  // GET_VERSION answer, NTAG21x only
+	uint32_t responseDelayUs; // Frame delay time, MFRC522_SIM_FDT_US
+	uint8_t ats[MFRC522_SIM_MAX_ATS]; // RATS answer, ISO/IEC 14443-4 only
+	uint8_t wtxRequests;			  // S(WTX) sent before each response
+	uint16_t memorySize;	  // uint8_ts of memory[] in use
+	uint8_t memory[MFRC522_SIM_MEMORY_SIZE]; // Blocks or pages
+	MFRC522_SimPiccState state;
+	uint8_t level;		   // Cascade level being selected, 0 for CL1
+	int8_t authSector;	   // Sector MFAuthent succeeded for, -1 for none
+	uint8_t pending;	   // Command waiting for its second frame, 0 if none
+	uint8_t pendingBlock;  // Block or page of the pending command
+	int32_t transferValue; // MIFARE transfer buffer
+	bool transferValid;
+	PCD_BitRate dr;		   // PCD to PICC bit rate set with PPS
+	PCD_BitRate ds;		   // PICC to PCD bit rate set with PPS
+	bool ppsAllowed;	   // Only the first block after the ATS may be PPS
+	uint8_t blockNumber;   // ISO/IEC 14443-4 block number
+	uint16_t fsd;		   // Frame size the PCD announced in RATS
+	uint16_t apduLen;	   // uint8_ts of the APDU chained in, in memory[]
+	uint16_t responseLen;  // Response chained out of memory[], 0 if none
+	uint16_t responseSent; // uint8_ts of the response acknowledged
+	uint16_t blockLen;	   // INF uint8_ts in the last I-block sent
+	uint8_t wtxLeft;	   // S(WTX) still to send before the response
+} MFRC522_SimPicc;
+
+// The simulated MFRC522 and its field
+typedef struct {
+	uint8_t regs[64]; // By register number, the SPI address >> 1
+	uint8_t fifo[64];
+	uint8_t fifoLen;
+	uint8_t phase;		   // What the running command is doing
+	uint64_t phaseNs;	   // When the next uint8_t is due, or the phase ends
+	uint64_t timerNs;	   // When TimerIRq is set, 0 while stopped
+	bool authOk;		   // Outcome of the running MFAuthent
+	uint8_t tx[MFRC522_SIM_MAX_FRAME]; // Frame on air from the PCD
+	uint16_t txLen;
+	uint8_t rx[MFRC522_SIM_MAX_FRAME]; // Answer on air, RxAlign applied
+	uint16_t rxLen;
+	uint16_t rxDone;	// uint8_ts of rx[] already in the FIFO
+	uint8_t rxStrip;	// Last uint8_ts of rx[] kept out of the FIFO, the
+						// CRC_A with RxCRCEn
+	uint8_t rxLastBits; // ControlReg RxLastBits once rx[] is complete
+	uint8_t rxErrors;	// ErrorReg bits once rx[] is complete
+	uint8_t rxCollReg;	// CollReg CollPosNotValid and CollPos
+	MFRC522_SimPicc piccs[MFRC522_SIM_MAX_PICCS];
+	uint8_t piccCount;
+	MFRC522_SimFault faults[MFRC522_SIM_MAX_FAULTS];
+	uint8_t faultHead;
+	uint8_t faultCount;
+	uint64_t nowNs;			  // Virtual time
+	uint32_t spiHz;			  // Clock the register accesses are timed at
+	uint32_t spiGapNs;		  // Added to every chip select frame
+	uint32_t spiTransactions; // Register accesses seen
+	uint32_t frames;		  // Frames sent by the PCD
+} MFRC522_Sim;
+
+// The transport MFRC522_SimAttach() installs, context is the MFRC522_Sim
+extern const PCD_Transport MFRC522_SIM_TRANSPORT;
+
+/*******************************************************************************
+* Functions for the simulated reader
+*******************************************************************************/
+void MFRC522_SimInit(MFRC522_Sim *sim);
+void MFRC522_SimAttach(MFRC522_Sim *sim, MFRC522Ptr_t mfrc,
+					   MFRC522_Config *config);
+MFRC522_SimPicc *MFRC522_SimAddPicc(MFRC522_Sim *sim,
+									MFRC522_SimPiccType type,
+									const uint8_t *uid, uint8_t uidSize);
+void MFRC522_SimSetPresent(MFRC522_SimPicc *picc, bool present);
+bool MFRC522_SimInjectFault(MFRC522_Sim *sim, MFRC522_SimFault fault);
+void MFRC522_SimAdvanceUs(MFRC522_Sim *sim, uint64_t us);
+uint64_t MFRC522_SimNowUs(const MFRC522_Sim *sim);
+
+#endif
@@ -0,0 +1,748 @@
+/**
+* Simulated benchmark for the mfrc522 library for pi pico c/c++ sdk
+*
+* Runs the measurements of mfrc522_bench.c against the simulator of
+* mfrc522_sim.h, plus scenarios that are hard to set up by hand: several
+* PICCs at once, lost answers and a randomised anticollision fuzz. Builds for
+* the Pico and for the SDK's host platform. Times are virtual microseconds,
+* so results only change when the library changes how it talks to the chip.
+* Every result is printed as one JSON object per line, with the register
+* accesses (SPI transactions) per operation. Every check is printed the same
+* way, and the exit code is non-zero if any failed, so the bench can gate CI.
+*/
+
+#include "mfrc522_sim.h"
+#include "mfrc522_idle.h"
+#include "mfrc522_retry.h"
+#include "mfrc522_tcl.h"
+
+// Repetitions per measurement
+#define SIM_BENCH_REQA_POLLS 2000
+#define SIM_BENCH_SELECT_RUNS 200
+#define SIM_BENCH_READ_RUNS 200
+// PICCs in the field for the inventory
+#define SIM_BENCH_INVENTORY_PICCS 4
+// Every n-th answer is lost in the fault scenario
+#define SIM_BENCH_FAULT_INTERVAL 10
+// Fields of random PICCs the anticollision fuzz resolves, and its seed
+#define SIM_BENCH_FUZZ_ROUNDS 2000
+#define SIM_BENCH_FUZZ_SEED 0x2545F491
+// Frame delay of the slow PICC, and the READ timeout that still covers it
+#define SIM_BENCH_SLOW_FDT_US 20000
+#define SIM_BENCH_SLOW_TIMEOUT_US 30000
+// APDU of the T=CL scenario, chained to the PICC in FSC blocks and echoed
+// back in FSD blocks, and the S(WTX) the PICC asks for before each response
+#define SIM_BENCH_TCL_APDU_SIZE 300
+#define SIM_BENCH_TCL_RUNS 50
+#define SIM_BENCH_TCL_WTX 2
+
+// Virtual time and register accesses of what is being measured
+typedef struct {
+	uint64_t us;
+	uint32_t spi;
+} SimBench_Span;
+
+// Regression limits of a result, 0 where a bound is not checked
+typedef struct {
+	const char *name;
+	double min;
+	double max;
+	double maxSpi; // Register accesses per operation
+} SimBench_Limit;
+
+// About 10% off the results of this tree. Tighten them when the library gets
+// faster, loosen them only on purpose.
+static const SimBench_Limit SIM_BENCH_LIMITS[] = {
+	{"reqa_empty_poll_rate", 800, 0, 252},
+	{"presence_to_uid_latency", 0, 2600, 513},
+	{"known_uid_select_latency", 0, 1760, 347},
+	{"block_read_latency", 0, 2270, 445},
+	{"classic_1k_read_time", 0, 183000, 36000},
+	{"ntag_full_read_time", 0, 89800, 17600},
+	{"inventory_time", 0, 20400, 4030},
+	{"presence_check_latency", 0, 3320, 657},
+	{"tcl_activate_latency", 0, 2210, 435},
+	{"tcl_apdu_latency", 0, 9810, 1700},
+	{"idle_wake_field_off_latency", 0, 460, 91},
+	{"idle_wake_power_down_latency", 0, 470, 93},
+};
+
+static MFRC522_Sim sim;
+static uint32_t failedChecks;
+
+/**
+ * Prints a check and counts it if it failed.
+ */
+static void SimBench_Check(const char *name, bool pass) {
+	printf("{\"check\":\"%s\",\"pass\":%s}\n", name, pass ? "true" : "false");
+	if (!pass) {
+		failedChecks++;
+	}
+}
+
+/**
+ * Prints a result, with spi register accesses per operation unless spi is
+ * negative, and checks it against SIM_BENCH_LIMITS.
+ */
+static void SimBench_PrintValue(const char *name, double value,
+								const char *unit, uint32_t n, double spi) {
+	printf("{\"bench\":\"%s\",\"value\":%.3f,\"unit\":\"%s\",\"n\":%lu,", name,
+		   value, unit, (unsigned long)n);
+	if (spi >= 0) {
+		printf("\"spi\":%.1f,", spi);
+	}
+	printf("\"clock\":\"virtual\"}\n");
+
+	for (size_t i = 0; i < sizeof(SIM_BENCH_LIMITS) / sizeof(SIM_BENCH_LIMITS[0]);
+		 i++) {
+		const SimBench_Limit *limit = &SIM_BENCH_LIMITS[i];
+		if (strcmp(limit->name, name) == 0) {
+			SimBench_Check(name, (!limit->min || value >= limit->min) &&
+									 (!limit->max || value <= limit->max) &&
+									 (!limit->maxSpi || spi <= limit->maxSpi));
+		}
+	}
+}
+
+/**
+ * A measurement that could not be taken, which fails the run.
+ */
+static void SimBench_PrintError(const char *name, StatusCode status) {
+	printf("{\"bench\":\"%s\",\"error\":\"%s\"}\n", name,
+		   GetStatusCodeName(status));
+	failedChecks++;
+}
+
+static SimBench_Span SimBench_Now(void) {
+	SimBench_Span now = {MFRC522_SimNowUs(&sim), sim.spiTransactions};
+	return now;
+}
+
+/**
+ * Adds what happened since start to *total.
+ */
+static void SimBench_Add(SimBench_Span *total, SimBench_Span start) {
+	SimBench_Span now = SimBench_Now();
+	total->us += now.us - start.us;
+	total->spi += now.spi - start.spi;
+}
+
+/**
+ * Prints total spread over ops operations.
+ */
+static void SimBench_PrintSpan(const char *name, SimBench_Span total,
+							   uint32_t ops) {
+	SimBench_PrintValue(name, (double)total.us / ops, "us", ops,
+						(double)total.spi / ops);
+}
+
+/**
+ * Empties the field and resets the reader, then puts the given PICCs in.
+ */
+static void SimBench_Field(MFRC522Ptr_t mfrc, uint8_t count,
+						   MFRC522_SimPiccType type) {
+	MFRC522_Config config;
+	uint8_t uid[7] = {0x04, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60};
+
+	MFRC522_SimInit(&sim);
+	MFRC522_SimAttach(&sim, mfrc, &config);
+	StatusCode status = PCD_InitWithConfig(mfrc, &config);
+	if (status != STATUS_OK) {
+		SimBench_PrintError("pcd_init", status);
+	}
+	for (uint8_t i = 0; i < count; i++) {
+		uid[1] = 0x10 + 0x0B * i; // Same first byte, the next one collides
+		MFRC522_SimAddPicc(&sim, type, uid,
+						   type == SIM_PICC_MIFARE_1K ? 4 : 7);
+	}
+}
+
+static void SimBench_EmptyFieldPoll(MFRC522Ptr_t mfrc) {
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, 0, SIM_PICC_MIFARE_1K);
+	SimBench_Span start = SimBench_Now();
+	for (uint32_t i = 0; i < SIM_BENCH_REQA_POLLS; i++) {
+		PICC_IsNewCardPresent(mfrc);
+	}
+	SimBench_Add(&total, start);
+	SimBench_PrintValue("reqa_empty_poll_rate",
+						SIM_BENCH_REQA_POLLS * 1000000.0 / total.us, "Hz",
+						SIM_BENCH_REQA_POLLS,
+						(double)total.spi / SIM_BENCH_REQA_POLLS);
+}
+
+static void SimBench_PresenceToUid(MFRC522Ptr_t mfrc) {
+	uint8_t bufferATQA[2];
+	uint8_t bufferSize;
+	Uid uid;
+	uint32_t n = 0;
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, 1, SIM_PICC_MIFARE_1K);
+	for (uint32_t i = 0; i < SIM_BENCH_SELECT_RUNS; i++) {
+		PICC_HaltA(mfrc);
+		bufferSize = sizeof(bufferATQA);
+		SimBench_Span start = SimBench_Now();
+		if (PICC_WakeupA(mfrc, bufferATQA, &bufferSize) == STATUS_OK &&
+			PICC_Select(mfrc, &uid, 0) == STATUS_OK) {
+			SimBench_Add(&total, start);
+			n++;
+		}
+	}
+	if (n != SIM_BENCH_SELECT_RUNS) {
+		SimBench_PrintError("presence_to_uid_latency", STATUS_ERROR);
+		return;
+	}
+	SimBench_PrintSpan("presence_to_uid_latency", total, n);
+	SimBench_Check("presence_to_uid",
+				   uid.size == 4 && memcmp(uid.uidByte, sim.piccs[0].uidByte,
+										   4) == 0);
+
+	// The same activation with the UID known in advance
+	n = 0;
+	total = (SimBench_Span){0, 0};
+	for (uint32_t i = 0; i < SIM_BENCH_SELECT_RUNS; i++) {
+		PICC_HaltA(mfrc);
+		bufferSize = sizeof(bufferATQA);
+		SimBench_Span start = SimBench_Now();
+		if (PICC_WakeupA(mfrc, bufferATQA, &bufferSize) == STATUS_OK &&
+			PICC_SelectKnown(mfrc, &uid) == STATUS_OK) {
+			SimBench_Add(&total, start);
+			n++;
+		}
+	}
+	if (n != SIM_BENCH_SELECT_RUNS) {
+		SimBench_PrintError("known_uid_select_latency", STATUS_ERROR);
+		return;
+	}
+	SimBench_PrintSpan("known_uid_select_latency", total, n);
+}
+
+static void SimBench_Classic1K(MFRC522Ptr_t mfrc) {
+	MIFARE_Key key = {{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}};
+	static uint8_t card[1024];
+	uint8_t buffer[18];
+	uint8_t size;
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, 1, SIM_PICC_MIFARE_1K);
+	uint8_t *memory = sim.piccs[0].memory;
+	for (uint16_t block = 1; block < 64; block++) { // Block 0 is the UID
+		if (block % 4 != 3) {
+			for (uint8_t i = 0; i < 16; i++) {
+				memory[block * 16 + i] = block * 7 + i;
+			}
+		}
+	}
+	if (!PICC_IsNewCardPresent(mfrc) || !PICC_ReadCardSerial(mfrc)) {
+		SimBench_PrintError("block_read_latency", STATUS_ERROR);
+		return;
+	}
+	StatusCode status =
+		PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A, 4, &key, &mfrc->uid);
+	if (status != STATUS_OK) {
+		SimBench_PrintError("block_read_latency", status);
+		return;
+	}
+	uint32_t failed = 0;
+	SimBench_Span start = SimBench_Now();
+	for (uint32_t i = 0; i < SIM_BENCH_READ_RUNS; i++) {
+		size = sizeof(buffer);
+		if (MIFARE_Read(mfrc, 4, buffer, &size) != STATUS_OK) {
+			failed++;
+		}
+	}
+	SimBench_Add(&total, start);
+	SimBench_PrintSpan("block_read_latency", total, SIM_BENCH_READ_RUNS);
+	SimBench_Check("block_read", failed == 0 && size == 18 &&
+									 memcmp(buffer, &memory[4 * 16], 16) == 0);
+
+	total = (SimBench_Span){0, 0};
+	start = SimBench_Now();
+	status = MIFARE_ReadSectors(mfrc, &mfrc->uid, PICC_CMD_MF_AUTH_KEY_A, &key,
+								0, 16, card, false);
+	SimBench_Add(&total, start);
+	if (status != STATUS_OK) {
+		SimBench_PrintError("classic_1k_read_time", status);
+		return;
+	}
+	SimBench_PrintSpan("classic_1k_read_time", total, 1);
+	bool same = true;
+	for (uint16_t block = 0; block < 64; block++) {
+		if (block % 4 != 3) { // Key A of a trailer reads back as zeros
+			same = same &&
+				   memcmp(&card[block * 16], &memory[block * 16], 16) == 0;
+		}
+	}
+	SimBench_Check("classic_1k_image", same);
+	SimBench_Check("read_sectors_range",
+				   MIFARE_SectorsSize(39, 218) == 0 &&
+					   MIFARE_ReadSectors(mfrc, &mfrc->uid,
+										  PICC_CMD_MF_AUTH_KEY_A, &key, 16,
+										  241, card, false) == STATUS_INVALID);
+}
+
+static void SimBench_Ntag216(MFRC522Ptr_t mfrc) {
+	static uint8_t memory[231 * 4];
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, 1, SIM_PICC_NTAG216);
+	for (uint16_t i = 16; i < sizeof(memory); i++) { // Past UID and CC
+		sim.piccs[0].memory[i] = i * 13;
+	}
+	if (!PICC_IsNewCardPresent(mfrc) || !PICC_ReadCardSerial(mfrc)) {
+		SimBench_PrintError("ntag_full_read_time", STATUS_ERROR);
+		return;
+	}
+	SimBench_Span start = SimBench_Now();
+	StatusCode status = NTAG_FastRead(mfrc, 0, 230, memory);
+	SimBench_Add(&total, start);
+	if (status != STATUS_OK) {
+		SimBench_PrintError("ntag_full_read_time", status);
+		return;
+	}
+	SimBench_PrintValue("ntag_full_read_time", total.us, "us", sizeof(memory),
+						total.spi);
+	SimBench_Check("ntag_full_read",
+				   memcmp(memory, sim.piccs[0].memory, sizeof(memory)) == 0);
+}
+
+/**
+ * @return true if found[] holds exactly the count PICCs of the simulator.
+ */
+static bool SimBench_AllFound(const Uid *found, size_t n, uint8_t count) {
+	if (n != count) {
+		return false;
+	}
+	for (uint8_t i = 0; i < count; i++) {
+		const MFRC522_SimPicc *picc = &sim.piccs[i];
+		bool seen = false;
+		for (size_t j = 0; j < n && !seen; j++) {
+			seen = found[j].size == picc->uidSize &&
+				   memcmp(found[j].uidByte, picc->uidByte, picc->uidSize) == 0;
+		}
+		if (!seen) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * PICC_Inventory() with several PICCs answering at once.
+ */
+static void SimBench_Inventory(MFRC522Ptr_t mfrc) {
+	Uid uids[SIM_BENCH_INVENTORY_PICCS];
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, SIM_BENCH_INVENTORY_PICCS, SIM_PICC_MIFARE_1K);
+	SimBench_Span start = SimBench_Now();
+	size_t found = PICC_Inventory(mfrc, uids, SIM_BENCH_INVENTORY_PICCS);
+	SimBench_Add(&total, start);
+	if (!SimBench_AllFound(uids, found, SIM_BENCH_INVENTORY_PICCS)) {
+		printf("{\"bench\":\"inventory_time\",\"error\":\"found %u of %u\"}\n",
+			   (unsigned)found, SIM_BENCH_INVENTORY_PICCS);
+		failedChecks++;
+		return;
+	}
+	SimBench_PrintValue("inventory_time", total.us, "us", found, total.spi);
+}
+
+static uint32_t fuzzState = SIM_BENCH_FUZZ_SEED;
+
+// xorshift32, the same sequence on every run
+static uint32_t SimBench_Random(void) {
+	fuzzState ^= fuzzState << 13;
+	fuzzState ^= fuzzState >> 17;
+	fuzzState ^= fuzzState << 5;
+	return fuzzState;
+}
+
+/**
+ * Makes UID number index of a field, different from the ones before it.
+ * Most UIDs copy an earlier one up to a random bit and differ from there on,
+ * so collisions happen at every bit position, byte boundaries included.
+ */
+static void SimBench_RandomUid(uint8_t uids[][7], uint8_t *sizes,
+							   uint8_t index) {
+	uint8_t *uid = uids[index];
+	bool unique;
+
+	do {
+		sizes[index] = SimBench_Random() % 2 ? 4 : 7;
+		for (uint8_t i = 0; i < sizes[index]; i++) {
+			uid[i] = SimBench_Random();
+		}
+		uint8_t other = index ? SimBench_Random() % index : 0;
+		if (index && sizes[other] == sizes[index] && SimBench_Random() % 4) {
+			uint8_t bit = SimBench_Random() % (sizes[index] * 8);
+			for (uint8_t i = 0; i < bit / 8; i++) {
+				uid[i] = uids[other][i];
+			}
+			uint8_t mask = (1 << (bit % 8)) - 1; // Bits before the collision
+			uid[bit / 8] = (uids[other][bit / 8] & mask) |
+						   (~uids[other][bit / 8] & (1 << (bit % 8))) |
+						   (uid[bit / 8] & ~mask & ~(1 << (bit % 8)));
+		}
+		// The cascade tag cannot start the UID bytes of a cascade level
+		unique = uid[0] != PICC_CMD_CT &&
+				 (sizes[index] == 4 || uid[3] != PICC_CMD_CT);
+		for (uint8_t i = 0; i < index && unique; i++) {
+			unique = sizes[i] != sizes[index] ||
+					 memcmp(uids[i], uid, sizes[index]) != 0;
+		}
+	} while (!unique);
+}
+
+/**
+ * PICC_Inventory() against SIM_BENCH_FUZZ_ROUNDS fields of 2 to
+ * MFRC522_SIM_MAX_PICCS random PICCs, 4 and 7 byte UIDs mixed.
+ */
+static void SimBench_AnticollisionFuzz(MFRC522Ptr_t mfrc) {
+	uint8_t uids[MFRC522_SIM_MAX_PICCS][7];
+	uint8_t sizes[MFRC522_SIM_MAX_PICCS];
+	Uid found[MFRC522_SIM_MAX_PICCS];
+	SimBench_Span total = {0, 0};
+	uint32_t piccs = 0;
+	uint32_t failed = 0;
+
+	for (uint32_t round = 0; round < SIM_BENCH_FUZZ_ROUNDS; round++) {
+		uint8_t count = 2 + SimBench_Random() % (MFRC522_SIM_MAX_PICCS - 1);
+		SimBench_Field(mfrc, 0, SIM_PICC_MIFARE_1K);
+		for (uint8_t i = 0; i < count; i++) {
+			SimBench_RandomUid(uids, sizes, i);
+			MFRC522_SimAddPicc(&sim,
+							   sizes[i] == 4 ? SIM_PICC_MIFARE_1K
+											 : SIM_PICC_NTAG213,
+							   uids[i], sizes[i]);
+		}
+		SimBench_Span start = SimBench_Now();
+		size_t n = PICC_Inventory(mfrc, found, MFRC522_SIM_MAX_PICCS);
+		SimBench_Add(&total, start);
+		piccs += count;
+		if (!SimBench_AllFound(found, n, count)) {
+			failed++;
+		}
+	}
+	SimBench_PrintSpan("anticollision_fuzz_latency", total, piccs);
+	SimBench_PrintValue("anticollision_fuzz_failures", failed, "",
+						SIM_BENCH_FUZZ_ROUNDS, -1);
+	SimBench_Check("anticollision_fuzz", failed == 0);
+}
+
+/**
+ * PICC_TrackerPoll() on a PICC left on the reader, then how long it takes to
+ * notice that the PICC is gone, and whether a PICC that was only halted is
+ * found again.
+ */
+static void SimBench_Tracker(MFRC522Ptr_t mfrc) {
+	PICC_Tracker tracker;
+	uint32_t n = 0;
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, 1, SIM_PICC_MIFARE_1K);
+	PICC_TrackerInit(&tracker);
+	if (PICC_TrackerPoll(mfrc, &tracker) != PICC_TRACKER_ARRIVED) {
+		SimBench_PrintError("presence_check_latency", STATUS_ERROR);
+		return;
+	}
+	SimBench_Span start = SimBench_Now();
+	for (uint32_t i = 0; i < SIM_BENCH_SELECT_RUNS; i++) {
+		if (PICC_TrackerPoll(mfrc, &tracker) == PICC_TRACKER_PRESENT &&
+			tracker.misses == 0) {
+			n++;
+		}
+	}
+	SimBench_Add(&total, start);
+	if (n != SIM_BENCH_SELECT_RUNS) {
+		SimBench_PrintError("presence_check_latency", STATUS_ERROR);
+		return;
+	}
+	SimBench_PrintSpan("presence_check_latency", total, n);
+
+	// Lost answers to the checks, the PICC stays behind in HALT
+	PICC_TrackerEvent events[PICC_TRACKER_MISSES];
+	for (uint8_t i = 0; i < PICC_TRACKER_MISSES; i++) {
+		MFRC522_SimInjectFault(&sim, SIM_FAULT_TIMEOUT);
+		events[i] = PICC_TrackerPoll(mfrc, &tracker);
+	}
+	sim.piccs[0].state = SIM_PICC_HALT;
+	SimBench_Check("tracker_missed",
+				   events[0] == PICC_TRACKER_MISSED &&
+					   events[PICC_TRACKER_MISSES - 1] ==
+						   PICC_TRACKER_DEPARTED);
+	SimBench_Check("tracker_halted_rearrival",
+				   PICC_TrackerPoll(mfrc, &tracker) == PICC_TRACKER_ARRIVED);
+
+	MFRC522_SimSetPresent(&sim.piccs[0], false);
+	total = (SimBench_Span){0, 0};
+	start = SimBench_Now();
+	while (PICC_TrackerPoll(mfrc, &tracker) != PICC_TRACKER_DEPARTED) {
+	}
+	SimBench_Add(&total, start);
+	SimBench_PrintSpan("departure_latency", total, 1);
+}
+
+/**
+ * PCD_CalibrateRf() against an NTAG216. The simulator has no RF model, so
+ * every setting does equally well and only the cost of the sweep is of
+ * interest.
+ */
+static void SimBench_Calibration(MFRC522Ptr_t mfrc) {
+	PCD_Calibration calibration;
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, 1, SIM_PICC_NTAG216);
+	SimBench_Span start = SimBench_Now();
+	StatusCode status = PCD_CalibrateRf(mfrc, NULL, 4, &calibration);
+	SimBench_Add(&total, start);
+	if (status != STATUS_OK) {
+		SimBench_PrintError("rf_calibration_time", status);
+		return;
+	}
+	SimBench_PrintValue("rf_calibration_time", total.us, "us",
+						calibration.settings, total.spi);
+	SimBench_PrintValue("rf_calibration_successes", calibration.successes, "",
+						PCD_CALIBRATION_TRIALS, -1);
+	SimBench_Check("rf_calibration",
+				   calibration.successes == PCD_CALIBRATION_TRIALS);
+}
+
+/**
+ * Block reads while every SIM_BENCH_FAULT_INTERVAL-th answer is lost: what
+ * the timeouts cost.
+ */
+static void SimBench_LostAnswers(MFRC522Ptr_t mfrc) {
+	MIFARE_Key key = {{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}};
+	uint8_t buffer[18];
+	uint8_t size;
+	uint32_t failed = 0;
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, 1, SIM_PICC_MIFARE_1K);
+	if (!PICC_IsNewCardPresent(mfrc) || !PICC_ReadCardSerial(mfrc) ||
+		PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A, 4, &key, &mfrc->uid) !=
+			STATUS_OK) {
+		SimBench_PrintError("lost_answer_read_latency", STATUS_ERROR);
+		return;
+	}
+	SimBench_Span start = SimBench_Now();
+	for (uint32_t i = 0; i < SIM_BENCH_READ_RUNS; i++) {
+		if (i % SIM_BENCH_FAULT_INTERVAL == 0) {
+			MFRC522_SimInjectFault(&sim, SIM_FAULT_TIMEOUT);
+		}
+		size = sizeof(buffer);
+		if (MIFARE_Read(mfrc, 4, buffer, &size) != STATUS_OK) {
+			failed++;
+		}
+	}
+	SimBench_Add(&total, start);
+	SimBench_PrintSpan("lost_answer_read_latency", total, SIM_BENCH_READ_RUNS);
+	SimBench_PrintValue("lost_answer_read_failures", failed, "",
+						SIM_BENCH_READ_RUNS, -1);
+	SimBench_Check("lost_answer_reads",
+				   failed == SIM_BENCH_READ_RUNS / SIM_BENCH_FAULT_INTERVAL);
+}
+
+/**
+ * A block read from a PICC that answers after SIM_BENCH_SLOW_FDT_US, with
+ * the READ timeout raised to cover it. The MCU must wait as long as the
+ * timeout allows.
+ */
+static void SimBench_SlowPicc(MFRC522Ptr_t mfrc) {
+	MIFARE_Key key = {{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}};
+	uint8_t buffer[18];
+	uint8_t size = sizeof(buffer);
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, 1, SIM_PICC_MIFARE_1K);
+	if (!PICC_IsNewCardPresent(mfrc) || !PICC_ReadCardSerial(mfrc) ||
+		PCD_Authenticate(mfrc, PICC_CMD_MF_AUTH_KEY_A, 4, &key, &mfrc->uid) !=
+			STATUS_OK) {
+		SimBench_PrintError("slow_picc_read_latency", STATUS_ERROR);
+		return;
+	}
+	sim.piccs[0].responseDelayUs = SIM_BENCH_SLOW_FDT_US;
+	PCD_SetCommandTimeout(mfrc, PCD_TIMEOUT_READ, SIM_BENCH_SLOW_TIMEOUT_US);
+	SimBench_Span start = SimBench_Now();
+	StatusCode status = MIFARE_Read(mfrc, 4, buffer, &size);
+	SimBench_Add(&total, start);
+	PCD_ResetCommandTimeouts(mfrc);
+	if (status != STATUS_OK) {
+		SimBench_PrintError("slow_picc_read_latency", status);
+		return;
+	}
+	SimBench_PrintSpan("slow_picc_read_latency", total, 1);
+}
+
+/**
+ * T=CL: RATS and PPS up to 848 kBd, where the MFRC522 handles the CRC_A,
+ * APDUs chained in both directions with waiting time extensions granted,
+ * a lost and a damaged answer recovered, and S(DESELECT) back to 106 kBd.
+ */
+static void SimBench_Tcl(MFRC522Ptr_t mfrc) {
+	static uint8_t command[SIM_BENCH_TCL_APDU_SIZE];
+	static uint8_t response[SIM_BENCH_TCL_APDU_SIZE + 2];
+	static TCL_Session session;
+	uint16_t responseLen;
+	uint32_t failed = 0;
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, 1, SIM_PICC_ISO14443_4);
+	if (!PICC_IsNewCardPresent(mfrc) || !PICC_ReadCardSerial(mfrc)) {
+		SimBench_PrintError("tcl_activate_latency", STATUS_ERROR);
+		return;
+	}
+	SimBench_Span start = SimBench_Now();
+	StatusCode status =
+		TCL_Activate(mfrc, &session, &mfrc->uid, PCD_BITRATE_848);
+	SimBench_Add(&total, start);
+	if (status != STATUS_OK) {
+		SimBench_PrintError("tcl_activate_latency", status);
+		return;
+	}
+	SimBench_PrintSpan("tcl_activate_latency", total, 1);
+	// TxCRCEn and RxCRCEn go with the higher rates
+	SimBench_Check("tcl_pps", session.txRate == PCD_BITRATE_848 &&
+								  session.rxRate == PCD_BITRATE_848 &&
+								  sim.regs[TxModeReg >> 1] == 0xB0 &&
+								  sim.regs[RxModeReg >> 1] == 0xB0);
+
+	for (uint16_t i = 0; i < sizeof(command); i++) {
+		command[i] = i * 7;
+	}
+	sim.piccs[0].wtxRequests = SIM_BENCH_TCL_WTX;
+	total = (SimBench_Span){0, 0};
+	for (uint32_t i = 0; i < SIM_BENCH_TCL_RUNS; i++) {
+		responseLen = sizeof(response);
+		start = SimBench_Now();
+		status = TCL_Transceive(&session, command, sizeof(command), response,
+								&responseLen);
+		SimBench_Add(&total, start);
+		if (status != STATUS_OK || responseLen != sizeof(response) ||
+			memcmp(response, command, sizeof(command)) != 0 ||
+			response[sizeof(command)] != 0x90) {
+			failed++;
+		}
+	}
+	SimBench_PrintSpan("tcl_apdu_latency", total, SIM_BENCH_TCL_RUNS);
+	SimBench_Check("tcl_apdu_chaining", failed == 0);
+
+	// The first R(ACK) of the PICC is lost, the one sent again damaged
+	MFRC522_SimInjectFault(&sim, SIM_FAULT_TIMEOUT);
+	MFRC522_SimInjectFault(&sim, SIM_FAULT_CRC);
+	responseLen = sizeof(response);
+	status = TCL_Transceive(&session, command, sizeof(command), response,
+							&responseLen);
+	SimBench_Check("tcl_recovery", status == STATUS_OK &&
+									   responseLen == sizeof(response) &&
+									   sim.faultCount == 0);
+
+	status = TCL_Deselect(&session);
+	SimBench_Check("tcl_deselect", status == STATUS_OK &&
+									   sim.piccs[0].state == SIM_PICC_HALT &&
+									   sim.regs[TxModeReg >> 1] == 0x00 &&
+									   sim.regs[RxModeReg >> 1] == 0x00);
+}
+
+/**
+ * From a parked reader to the ATQA of the PICC on it in the first scan
+ * window of MFRC522_IdleWaitForCard(), for pcdMode. The settling time is a
+ * sleep and not in the virtual clock.
+ */
+static void SimBench_IdleWake(MFRC522Ptr_t mfrc, const char *name,
+							  MFRC522_IdlePcdMode pcdMode) {
+	MFRC522_IdleConfig config;
+	MFRC522_Idle idle;
+	SimBench_Span total = {0, 0};
+
+	MFRC522_IdleConfigInit(&config);
+	config.pcdMode = pcdMode;
+	MFRC522_IdleBegin(&idle, mfrc, &config);
+	SimBench_Field(mfrc, 1, SIM_PICC_MIFARE_1K);
+	for (uint32_t i = 0; i < SIM_BENCH_SELECT_RUNS; i++) {
+		MFRC522_IdlePark(&idle);
+		SimBench_Span start = SimBench_Now();
+		MFRC522_IdleEvent event = MFRC522_IdleWaitForCard(&idle, 0);
+		SimBench_Add(&total, start);
+		if (event != IDLE_EVENT_CARD) {
+			SimBench_PrintError(name, STATUS_ERROR);
+			MFRC522_IdleEnd(&idle);
+			return;
+		}
+		MFRC522_SimSetPresent(&sim.piccs[0], false); // Back to IDLE
+		MFRC522_SimSetPresent(&sim.piccs[0], true);
+	}
+	MFRC522_IdleEnd(&idle);
+	SimBench_PrintSpan(name, total, SIM_BENCH_SELECT_RUNS);
+}
+
+/**
+ * The reads of SimBench_LostAnswers() through MFRC522_RetryRead(), with lost
+ * and damaged answers in turn.
+ */
+static void SimBench_Retried(MFRC522Ptr_t mfrc) {
+	MIFARE_Key key = {{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}};
+	MFRC522_RetrySession session;
+	uint8_t buffer[18];
+	uint8_t size;
+	uint32_t failed = 0;
+	SimBench_Span total = {0, 0};
+
+	SimBench_Field(mfrc, 1, SIM_PICC_MIFARE_1K);
+	if (!PICC_IsNewCardPresent(mfrc) || !PICC_ReadCardSerial(mfrc)) {
+		SimBench_PrintError("retried_read_latency", STATUS_ERROR);
+		return;
+	}
+	MFRC522_RetryBegin(&session, mfrc, &mfrc->uid);
+	session.policy.backoffUs = 0; // Sleeps do not advance the virtual clock
+	StatusCode status =
+		MFRC522_RetryAuthenticate(&session, PICC_CMD_MF_AUTH_KEY_A, 4, &key);
+	if (status != STATUS_OK) {
+		SimBench_PrintError("retried_read_latency", status);
+		return;
+	}
+	SimBench_Span start = SimBench_Now();
+	for (uint32_t i = 0; i < SIM_BENCH_READ_RUNS; i++) {
+		if (i % SIM_BENCH_FAULT_INTERVAL == 0) {
+			MFRC522_SimInjectFault(&sim, i % (2 * SIM_BENCH_FAULT_INTERVAL)
+											 ? SIM_FAULT_CRC
+											 : SIM_FAULT_TIMEOUT);
+		}
+		size = sizeof(buffer);
+		if (MFRC522_RetryRead(&session, 4, buffer, &size) != STATUS_OK) {
+			failed++;
+		}
+	}
+	SimBench_Add(&total, start);
+	SimBench_PrintSpan("retried_read_latency", total, SIM_BENCH_READ_RUNS);
+	SimBench_PrintValue("retried_read_failures", failed, "",
+						SIM_BENCH_READ_RUNS, -1);
+	SimBench_Check("retried_reads", failed == 0);
+}
+
+int main() {
+	stdio_init_all();
+
+	MFRC522Ptr_t mfrc = MFRC522_Init();
+	SimBench_EmptyFieldPoll(mfrc);
+	SimBench_PresenceToUid(mfrc);
+	SimBench_Classic1K(mfrc);
+	SimBench_Ntag216(mfrc);
+	SimBench_Inventory(mfrc);
+	SimBench_AnticollisionFuzz(mfrc);
+	SimBench_Tracker(mfrc);
+	SimBench_Calibration(mfrc);
+	SimBench_LostAnswers(mfrc);
+	SimBench_SlowPicc(mfrc);
+	SimBench_Retried(mfrc);
+	SimBench_Tcl(mfrc);
+	SimBench_IdleWake(mfrc, "idle_wake_field_off_latency",
+					  IDLE_PCD_FIELD_OFF);
+	SimBench_IdleWake(mfrc, "idle_wake_power_down_latency",
+					  IDLE_PCD_SOFT_POWER_DOWN);
+	printf("{\"bench\":\"done\",\"failed\":%lu}\n",
+		   (unsigned long)failedChecks);
+	return failedChecks ? 1 : 0;
+}
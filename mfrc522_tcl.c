@@ -0,0 +1,336 @@
+/**
+* ISO/IEC 14443-4 (T=CL) layer for the mfrc522 library for pi pico c/c++ sdk
+* NOTE: Please also check the comments in mfrc522_tcl.h.
+*/
+
+#include "mfrc522_tcl.h"
+
+// Frame waiting time during activation, 65536/fc + 16.4 * 256/fc rounded up
+// (ISO/IEC 14443-4 part 5.7)
+#define TCL_ACTIVATION_FWT_US 5300
+// Frame sizes for FSCI 0..8 (ISO/IEC 14443-4 part 5.2.3)
+static const uint16_t TCL_FSC_TABLE[9] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+
+/**
+ * Converts a FWI or SFGI into microseconds: 256 * 16/fc * 2^fwi, plus the
+ * 49152/fc the PCD must allow on top (ISO/IEC 14443-4 part 7.2).
+ */
+static uint32_t TCL_FwtUs(uint8_t fwi) {
+	return (uint32_t)(((uint64_t)4096 << fwi) * 100 / 1356) + 3625;
+}
+
+/**
+ * Appends the CRC_A to frame[0..len-1], sends it and receives the answer in
+ * session->rx, CRC_A checked and stripped. frame needs two spare uint8_ts.
+ * Above 106 kbit/s the MFRC522 adds and checks the CRC_A itself, see
+ * PCD_SetBitRate().
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+static StatusCode TCL_SendFrame(TCL_Session *session, uint8_t *frame,
+								uint16_t len, uint16_t *rxLen) {
+	bool softTx = session->txRate == PCD_BITRATE_106;
+	bool softRx = session->rxRate == PCD_BITRATE_106;
+	if (softTx) {
+		PCD_SoftwareCRC(frame, len, &frame[len]);
+		len += 2;
+	}
+	*rxLen = sizeof(session->rx);
+	PCD_SetNextTimeout(session->mfrc, PCD_TIMEOUT_TCL);
+	StatusCode status = PCD_TransceiveStream(session->mfrc, frame, len,
+											 session->rx, rxLen, softRx);
+	if (status == STATUS_OK && softRx) {
+		*rxLen -= 2;
+	}
+	return status;
+}
+
+static bool TCL_IsIBlock(uint8_t pcb) {
+	return (pcb & 0xE2) == TCL_PCB_I_BLOCK;
+}
+
+static bool TCL_IsRAck(uint8_t pcb) {
+	return (pcb & 0xF6) == TCL_PCB_R_ACK;
+}
+
+/**
+ * Sends an I-block or an R(ACK) and returns the I-block or R(ACK) the PICC
+ * answers with (ISO/IEC 14443-4 part 7.5.4). S(WTX) requests are granted on
+ * the way. A missing or damaged answer is recovered with R(NAK), or by
+ * repeating the R(ACK) while the PICC is chaining.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+static StatusCode TCL_ExchangeBlock(TCL_Session *session, uint8_t *block,
+									uint16_t len, uint16_t *rxLen) {
+	MFRC522Ptr_t mfrc = session->mfrc;
+	uint8_t control[4]; // R(NAK) or S(WTX) plus CRC_A
+	uint8_t *frame = block;
+	uint16_t frameLen = len;
+	bool acking = TCL_IsRAck(block[0]);
+	uint8_t retries = 0;
+	StatusCode status;
+
+	for (;;) {
+		status = TCL_SendFrame(session, frame, frameLen, rxLen);
+		PCD_SetCommandTimeout(mfrc, PCD_TIMEOUT_TCL, session->fwtUs);
+
+		if (status == STATUS_OK && *rxLen >= 1) {
+			uint8_t pcb = session->rx[0];
+			if (pcb == TCL_PCB_S_WTX && *rxLen == 2) {
+				// Grant the extension: FWT * WTXM for the next answer only
+				uint8_t wtxm = session->rx[1] & 0x3F;
+				control[0] = TCL_PCB_S_WTX;
+				control[1] = wtxm;
+				frame = control;
+				frameLen = 2;
+				PCD_SetCommandTimeout(mfrc, PCD_TIMEOUT_TCL,
+									  session->fwtUs * (wtxm ? wtxm : 1));
+				continue;
+			}
+			if (TCL_IsIBlock(pcb)) {
+				return STATUS_OK;
+			}
+			if (TCL_IsRAck(pcb) && !acking) {
+				if ((pcb & 0x01) == session->blockNumber) {
+					return STATUS_OK; // Our chained I-block arrived
+				}
+				// The PICC missed our last I-block, send it again
+				frame = block;
+				frameLen = len;
+			} else {
+				status = STATUS_ERROR; // Not a valid answer here
+			}
+		}
+		if (++retries > TCL_MAX_RETRIES) {
+			return status == STATUS_OK ? STATUS_ERROR : status;
+		}
+		if (status != STATUS_OK) {
+			if (acking) {
+				frame = block; // The R(ACK) asks for the same block again
+				frameLen = len;
+			} else {
+				control[0] = TCL_PCB_R_NAK | session->blockNumber;
+				frame = control;
+				frameLen = 1;
+			}
+		}
+	}
+}
+
+/**
+ * Negotiates the fastest bit rates allowed by both maxRate and the TA(1)
+ * interface byte of the ATS, then sends PPS and switches the MFRC522 over.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+static StatusCode TCL_NegotiateBitRate(TCL_Session *session, uint8_t ta,
+									   PCD_BitRate maxRate) {
+	uint8_t dr = 0, ds = 0; // PCD to PICC and PICC to PCD
+	for (uint8_t rate = 1; rate <= maxRate && rate <= PCD_BITRATE_848; rate++) {
+		if (ta & (0x01 << (rate - 1))) {
+			dr = rate;
+		}
+		if (ta & (0x10 << (rate - 1))) {
+			ds = rate;
+		}
+	}
+	if (ta & 0x80) { // Only the same rate in both directions
+		dr = ds = 0;
+		for (uint8_t rate = 1; rate <= maxRate && rate <= PCD_BITRATE_848;
+			 rate++) {
+			if ((ta & (0x01 << (rate - 1))) && (ta & (0x10 << (rate - 1)))) {
+				dr = ds = rate;
+			}
+		}
+	}
+	if (dr == 0 && ds == 0) {
+		return STATUS_OK; // Stay at 106 kbit/s
+	}
+
+	uint8_t frame[5];
+	uint16_t rxLen;
+	frame[0] = TCL_CMD_PPS;
+	frame[1] = 0x11; // PPS1 follows
+	frame[2] = (ds << 2) | dr;
+	StatusCode status = TCL_SendFrame(session, frame, 3, &rxLen);
+	if (status != STATUS_OK) {
+		return status;
+	}
+	if (rxLen != 1 || session->rx[0] != TCL_CMD_PPS) {
+		return STATUS_ERROR;
+	}
+	PCD_SetBitRate(session->mfrc, dr, ds);
+	session->txRate = dr;
+	session->rxRate = ds;
+	return STATUS_OK;
+}
+
+/**
+ * Activates a PICC selected with PICC_Select(): sends RATS, applies the ATS
+ * and raises the bit rate up to maxRate with PPS. The frame waiting time
+ * from the ATS is used for all later blocks, capped at the 1.6s the
+ * MFRC522 timer reaches.
+ *
+ * @return STATUS_OK on success, STATUS_INVALID if the SAK does not announce
+ * ISO/IEC 14443-4, STATUS_??? otherwise.
+ */
+StatusCode TCL_Activate(MFRC522Ptr_t mfrc, TCL_Session *session,
+						Uid *uid,			///< UID and SAK of the PICC
+						PCD_BitRate maxRate ///< PCD_BITRATE_106 to skip PPS
+						) {
+	uint8_t frame[4];
+	uint16_t rxLen;
+	StatusCode status;
+
+	if (!(uid->sak & 0x20)) {
+		return STATUS_INVALID;
+	}
+	session->mfrc = mfrc;
+	session->atsLen = 0;
+	session->fsc = TCL_FSC_TABLE[2];
+	session->fwi = 4;
+	session->fwtUs = TCL_ACTIVATION_FWT_US;
+	session->txRate = PCD_BITRATE_106;
+	session->rxRate = PCD_BITRATE_106;
+	session->blockNumber = 0;
+	PCD_SetCommandTimeout(mfrc, PCD_TIMEOUT_TCL, TCL_ACTIVATION_FWT_US);
+
+	frame[0] = TCL_CMD_RATS;
+	frame[1] = TCL_FSDI << 4; // CID 0
+	status = TCL_SendFrame(session, frame, 2, &rxLen);
+	if (status != STATUS_OK) {
+		return status;
+	}
+	uint8_t tl = session->rx[0];
+	if (rxLen == 0 || tl != rxLen || tl > TCL_MAX_ATS_SIZE) {
+		return STATUS_ERROR;
+	}
+	memcpy(session->ats, session->rx, tl);
+	session->atsLen = tl;
+
+	// Interface bytes, defaults apply to those left out (part 5.2)
+	uint8_t ta = 0, tb = 0x40;
+	if (tl > 1) {
+		uint8_t t0 = session->ats[1];
+		uint8_t i = 2;
+		session->fsc = TCL_FSC_TABLE[(t0 & 0x0F) > 8 ? 8 : (t0 & 0x0F)];
+		if ((t0 & 0x10) && i < tl) {
+			ta = session->ats[i++];
+		}
+		if ((t0 & 0x20) && i < tl) {
+			tb = session->ats[i++];
+		}
+	}
+	session->fwi = tb >> 4;
+	if (session->fwi > 14) { // RFU, use the default
+		session->fwi = 4;
+	}
+	session->fwtUs = TCL_FwtUs(session->fwi);
+	PCD_SetCommandTimeout(mfrc, PCD_TIMEOUT_TCL, session->fwtUs);
+
+	// Start-up frame guard time before the next frame
+	uint8_t sfgi = tb & 0x0F;
+	if (sfgi > 0 && sfgi < 15) {
+		sleep_us(TCL_FwtUs(sfgi));
+	}
+
+	return TCL_NegotiateBitRate(session, ta, maxRate);
+} // End TCL_Activate()
+
+/**
+ * Sends an APDU to the activated PICC and returns its response, chaining
+ * both directions as needed (ISO/IEC 14443-4 part 7.5.2).
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode TCL_Transceive(TCL_Session *session,
+						  const uint8_t *command, ///< The APDU to send
+						  uint16_t commandLen,
+						  uint8_t *response, ///< Buffer for the response APDU
+						  uint16_t *responseLen ///< In: Size of response.
+												///Out: Number of uint8_ts
+												///returned.
+						  ) {
+	uint16_t fsc = session->fsc < TCL_FSD ? session->fsc : TCL_FSD;
+	uint16_t maxInf = fsc - 3; // PCB and CRC_A
+	uint16_t offset = 0, received = 0, rxLen;
+	uint8_t ack[3];
+	StatusCode status;
+
+	// PCD chaining: every block but the last is answered with R(ACK)
+	for (;;) {
+		uint16_t chunk = commandLen - offset;
+		if (chunk > maxInf) {
+			chunk = maxInf;
+		}
+		bool more = offset + chunk < commandLen;
+		session->tx[0] = TCL_PCB_I_BLOCK | session->blockNumber |
+						 (more ? TCL_PCB_CHAINING : 0);
+		memcpy(&session->tx[1], &command[offset], chunk);
+		status = TCL_ExchangeBlock(session, session->tx, chunk + 1, &rxLen);
+		if (status != STATUS_OK) {
+			return status;
+		}
+		if (!more) {
+			break;
+		}
+		if (!TCL_IsRAck(session->rx[0])) {
+			return STATUS_ERROR;
+		}
+		session->blockNumber ^= 1;
+		offset += chunk;
+	}
+
+	// PICC chaining: acknowledge each block until one without the chaining
+	// bit arrives
+	for (;;) {
+		uint8_t pcb = session->rx[0];
+		if (!TCL_IsIBlock(pcb) || (pcb & 0x01) != session->blockNumber) {
+			return STATUS_ERROR;
+		}
+		session->blockNumber ^= 1;
+		if (received + rxLen - 1 > *responseLen) {
+			return STATUS_NO_ROOM;
+		}
+		memcpy(&response[received], &session->rx[1], rxLen - 1);
+		received += rxLen - 1;
+		if (!(pcb & TCL_PCB_CHAINING)) {
+			break;
+		}
+		ack[0] = TCL_PCB_R_ACK | session->blockNumber;
+		status = TCL_ExchangeBlock(session, ack, 1, &rxLen);
+		if (status != STATUS_OK) {
+			return status;
+		}
+	}
+	*responseLen = received;
+	return STATUS_OK;
+} // End TCL_Transceive()
+
+/**
+ * Sends S(DESELECT), which puts the PICC in state HALT, and returns the
+ * MFRC522 to 106 kbit/s.
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+StatusCode TCL_Deselect(TCL_Session *session) {
+	uint8_t frame[3];
+	uint16_t rxLen;
+	StatusCode status = STATUS_ERROR;
+
+	for (uint8_t i = 0; i <= TCL_MAX_RETRIES; i++) {
+		frame[0] = TCL_PCB_S_DESELECT;
+		status = TCL_SendFrame(session, frame, 1, &rxLen);
+		if (status == STATUS_OK) {
+			if (rxLen == 1 && session->rx[0] == TCL_PCB_S_DESELECT) {
+				break;
+			}
+			status = STATUS_ERROR;
+		}
+	}
+	PCD_SetBitRate(session->mfrc, PCD_BITRATE_106, PCD_BITRATE_106);
+	session->txRate = PCD_BITRATE_106;
+	session->rxRate = PCD_BITRATE_106;
+	return status;
+} // End TCL_Deselect()
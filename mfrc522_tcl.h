@@ -0,0 +1,69 @@
+/*
+ * mfrc522_tcl.h
+ *
+ * ISO/IEC 14443-4 (T=CL) layer for the mfrc522 library for pi pico c/c++ sdk
+ *
+ * Takes a PICC selected with PICC_Select() whose SAK announces ISO/IEC
+ * 14443-4 support, activates it with RATS, raises the bit rate with PPS and
+ * exchanges APDUs with it. Long APDUs and responses are chained, lost or
+ * damaged blocks are recovered with R-blocks and waiting time extensions
+ * requested by the PICC are granted.
+ * CID and NAD are not used, so one PICC at a time per reader.
+ *
+ */
+
+#ifndef MFRC522_TCL_h
+#define MFRC522_TCL_h
+
+#include "mfrc522.h"
+
+/*******************************************************************************
+ * Types/enumerations/variables
+ ******************************************************************************/
+// Frame size the PCD accepts (FSD), FSDI = 8. PCD_TransceiveStream()
+// handles frames longer than the FIFO.
+#define TCL_FSD 256
+#define TCL_FSDI 8
+// Longest ATS, TL included
+#define TCL_MAX_ATS_SIZE 20
+// Times a block is repeated or an R(NAK) sent before giving up
+#define TCL_MAX_RETRIES 2
+
+// ISO/IEC 14443-4 commands and block types (part 5 and 7.1)
+typedef enum _TCL_Command {
+	TCL_CMD_RATS = 0xE0,	// Request for answer to select
+	TCL_CMD_PPS = 0xD0,		// Protocol and parameter selection, CID 0
+	TCL_PCB_I_BLOCK = 0x02, // I-block, OR the block number
+	TCL_PCB_CHAINING = 0x10, // I-block with more data to follow
+	TCL_PCB_R_ACK = 0xA2,   // R(ACK), OR the block number
+	TCL_PCB_R_NAK = 0xB2,   // R(NAK), OR the block number
+	TCL_PCB_S_DESELECT = 0xC2,
+	TCL_PCB_S_WTX = 0xF2
+} TCL_Command;
+
+// An activated ISO/IEC 14443-4 PICC
+typedef struct {
+	MFRC522Ptr_t mfrc;
+	uint8_t ats[TCL_MAX_ATS_SIZE]; // Answer to select, TL first
+	uint8_t atsLen;
+	uint16_t fsc;		// Largest frame the PICC accepts, CRC_A included
+	uint8_t fwi;		// Frame waiting time integer
+	uint32_t fwtUs;		// Frame waiting time, ISO/IEC 14443-4 part 7.2
+	PCD_BitRate txRate; // Negotiated PCD to PICC bit rate
+	PCD_BitRate rxRate; // Negotiated PICC to PCD bit rate
+	uint8_t blockNumber; // Toggles with each acknowledged I-block
+	uint8_t tx[TCL_FSD];
+	uint8_t rx[TCL_FSD];
+} TCL_Session;
+
+/*******************************************************************************
+* Functions for ISO/IEC 14443-4 PICCs
+*******************************************************************************/
+StatusCode TCL_Activate(MFRC522Ptr_t mfrc, TCL_Session *session, Uid *uid,
+						PCD_BitRate maxRate);
+StatusCode TCL_Transceive(TCL_Session *session, const uint8_t *command,
+						  uint16_t commandLen, uint8_t *response,
+						  uint16_t *responseLen);
+StatusCode TCL_Deselect(TCL_Session *session);
+
+#endif